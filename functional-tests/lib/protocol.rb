@@ -0,0 +1,753 @@
+require 'xdr'
+require 'xdr_utils'
+
+include XDR
+include XDRUtils
+
+def pack_version(v)
+    [
+        pack_uint((v.major)), 
+        pack_uint((v.minor)), 
+        pack_uint((v.patch)), 
+    ].join
+end
+
+def unpack_version(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :major),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :minor),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :patch)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_compression(v)
+    begin
+        table = begin
+            last = 0
+            table = Hash.new
+            table[:COMPRESS_NONE] = last
+            last = last + 1
+
+            table[:COMPRESS_LZ4] = last
+            last = last + 1
+
+            table[:COMPRESS_ZSTD] = last
+            last = last + 1
+
+            table
+        end
+        pack_enum(table, v)
+    end
+
+end
+
+def unpack_compression(txt)
+    unpacker = begin
+        table = Array.new
+        last = 0
+        table << EnumDetail.new(last, :COMPRESS_NONE)
+        last = last + 1
+        table << EnumDetail.new(last, :COMPRESS_LZ4)
+        last = last + 1
+        table << EnumDetail.new(last, :COMPRESS_ZSTD)
+        last = last + 1
+        unpack_enum_fn(table)
+    end
+    unpacker.call(txt)
+end
+
+
+def pack_logon_detail(v)
+    [
+        pack_version((v.v)), 
+        pack_uint((v.codecs).length) + 
+            pack_array((v.codecs).length, (v.codecs)) {|v| pack_compression(v)}, 
+    ].join
+end
+
+def unpack_logon_detail(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_version(txt)},
+            :v),
+        FieldDetail.new(
+            unpack_var_array_fn(
+                lambda {|txt| unpack_compression(txt)}),
+            :codecs)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_device_binding(v)
+    [
+        pack_uint((v.shortname)), 
+        pack_string((v.logical_name)), 
+        pack_string((v.path)), 
+    ].join
+end
+
+def unpack_device_binding(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :shortname),
+        FieldDetail.new(
+            lambda {|txt| unpack_string(txt)},
+            :logical_name),
+        FieldDetail.new(
+            lambda {|txt| unpack_string(txt)},
+            :path)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_io_detail(v)
+    [
+        pack_uint((v.dev)), 
+        pack_uhyper((v.sector)), 
+        pack_compression((v.codec)), 
+        pack_uint((v.len)), 
+        begin
+            pack_uint((v.data).length) + 
+                pack_raw((v.data))
+
+        end, 
+    ].join
+end
+
+def unpack_io_detail(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :dev),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :sector),
+        FieldDetail.new(
+            lambda {|txt| unpack_compression(txt)},
+            :codec),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :len),
+        FieldDetail.new(
+            unpack_var_opaque_fn(),
+            :data)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_transaction_id(v)
+    pack_hyper(v)
+
+end
+
+def unpack_transaction_id(txt)
+    unpacker = lambda {|txt| unpack_hyper(txt)}
+
+    unpacker.call(txt)
+end
+
+
+def pack_drop_detail(v)
+    [
+        pack_transaction_id((v.t)), 
+    ].join
+end
+
+def unpack_drop_detail(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_transaction_id(txt)},
+            :t)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_merge_detail(v)
+    [
+        pack_transaction_id((v.t)), 
+    ].join
+end
+
+def unpack_merge_detail(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_transaction_id(txt)},
+            :t)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_command_type(v)
+    begin
+        table = begin
+            last = 0
+            table = Hash.new
+            table[:LOGON] = last
+            last = last + 1
+
+            table[:JOURNAL_OPEN] = last
+            last = last + 1
+
+            table[:JOURNAL_CLOSE] = last
+            last = last + 1
+
+            table[:JOURNAL_FIRST_TRANSACTION] = last
+            last = last + 1
+
+            table[:JOURNAL_LAST_TRANSACTION] = last
+            last = last + 1
+
+            table[:JOURNAL_IO] = last
+            last = last + 1
+
+            table[:JOURNAL_COMMIT] = last
+            last = last + 1
+
+            table[:JOURNAL_ROLLBACK] = last
+            last = last + 1
+
+            table[:JOURNAL_DROP] = last
+            last = last + 1
+
+            table[:MERGE] = last
+            last = last + 1
+
+            table[:STATS] = last
+            last = last + 1
+
+            table
+        end
+        pack_enum(table, v)
+    end
+
+end
+
+def unpack_command_type(txt)
+    unpacker = begin
+        table = Array.new
+        last = 0
+        table << EnumDetail.new(last, :LOGON)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_OPEN)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_CLOSE)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_FIRST_TRANSACTION)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_LAST_TRANSACTION)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_IO)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_COMMIT)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_ROLLBACK)
+        last = last + 1
+        table << EnumDetail.new(last, :JOURNAL_DROP)
+        last = last + 1
+        table << EnumDetail.new(last, :MERGE)
+        last = last + 1
+        table << EnumDetail.new(last, :STATS)
+        last = last + 1
+        unpack_enum_fn(table)
+    end
+    unpacker.call(txt)
+end
+
+
+def pack_command(v)
+    [
+        pack_command_type((v.discriminator)),
+        case (v.discriminator)
+        when :LOGON
+            pack_logon_detail((v.logon))
+        when :JOURNAL_OPEN
+            pack_uint((v.devices).length) + 
+                pack_array((v.devices).length, (v.devices)) {|v| pack_device_binding(v)}
+        when :JOURNAL_CLOSE
+            ''
+        when :JOURNAL_FIRST_TRANSACTION
+            ''
+        when :JOURNAL_LAST_TRANSACTION
+            ''
+        when :JOURNAL_IO
+            pack_io_detail((v.io))
+        when :JOURNAL_COMMIT
+            ''
+        when :JOURNAL_ROLLBACK
+            ''
+        when :JOURNAL_DROP
+            pack_drop_detail((v.drop))
+        when :MERGE
+            pack_merge_detail((v.merge))
+        when :STATS
+            ''
+        end
+    ].join
+end
+
+def unpack_command(txt)
+    unpacker = unpack_union_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_command_type(txt)},
+            :discriminator),
+        [
+            CaseDetail.new(
+                :LOGON,
+                lambda {|txt| unpack_logon_detail(txt)},
+                :logon),
+            CaseDetail.new(
+                :JOURNAL_OPEN,
+                unpack_var_array_fn(
+                    lambda {|txt| unpack_device_binding(txt)}),
+                :devices),
+            CaseDetail.new(
+                :JOURNAL_CLOSE,
+                unpack_void_fn(),
+                nil),
+            CaseDetail.new(
+                :JOURNAL_FIRST_TRANSACTION,
+                unpack_void_fn(),
+                nil),
+            CaseDetail.new(
+                :JOURNAL_LAST_TRANSACTION,
+                unpack_void_fn(),
+                nil),
+            CaseDetail.new(
+                :JOURNAL_IO,
+                lambda {|txt| unpack_io_detail(txt)},
+                :io),
+            CaseDetail.new(
+                :JOURNAL_COMMIT,
+                unpack_void_fn(),
+                nil),
+            CaseDetail.new(
+                :JOURNAL_ROLLBACK,
+                unpack_void_fn(),
+                nil),
+            CaseDetail.new(
+                :JOURNAL_DROP,
+                lambda {|txt| unpack_drop_detail(txt)},
+                :drop),
+            CaseDetail.new(
+                :MERGE,
+                lambda {|txt| unpack_merge_detail(txt)},
+                :merge),
+            CaseDetail.new(
+                :STATS,
+                unpack_void_fn(),
+                nil)
+        ],
+        nil)
+    unpacker.call(txt)
+end
+
+
+def pack_msg_header(v)
+    [
+        pack_uint((v.msg_size)), 
+        pack_uint((v.request_id)), 
+    ].join
+end
+
+def unpack_msg_header(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :msg_size),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :request_id)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_flow_control(v)
+    [
+        pack_uint((v.max_message)), 
+        pack_uint((v.bytes)), 
+        pack_uint((v.requests)), 
+    ].join
+end
+
+def unpack_flow_control(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :max_message),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :requests)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_logon_response(v)
+    [
+        pack_flow_control((v.credit)), 
+        pack_compression((v.codec)), 
+    ].join
+end
+
+def unpack_logon_response(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_flow_control(txt)},
+            :credit),
+        FieldDetail.new(
+            lambda {|txt| unpack_compression(txt)},
+            :codec)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_latency_summary(v)
+    [
+        pack_uhyper((v.p50)), 
+        pack_uhyper((v.p99)), 
+        pack_uhyper((v.p999)), 
+        pack_uhyper((v.max)), 
+    ].join
+end
+
+def unpack_latency_summary(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :p50),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :p99),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :p999),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :max)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_command_summary(v)
+    [
+        pack_command_type((v.cmd)), 
+        pack_uhyper((v.count)), 
+        pack_uhyper((v.bytes)), 
+        pack_latency_summary((v.latency)), 
+    ].join
+end
+
+def unpack_command_summary(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_command_type(txt)},
+            :cmd),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :count),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_latency_summary(txt)},
+            :latency)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_connection_summary(v)
+    [
+        pack_uint((v.id)), 
+        pack_uhyper((v.requests)), 
+        pack_uhyper((v.bytes)), 
+        pack_uint((v.queued_bytes)), 
+        pack_uint((v.held_bytes)), 
+        pack_uint((v.peak_held_bytes)), 
+    ].join
+end
+
+def unpack_connection_summary(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :id),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :requests),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :queued_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :held_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uint(txt)},
+            :peak_held_bytes)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_dedup_summary(v)
+    [
+        pack_uhyper((v.ios)), 
+        pack_uhyper((v.bytes)), 
+        pack_uhyper((v.zero_ios)), 
+        pack_uhyper((v.zero_bytes)), 
+        pack_uhyper((v.dup_ios)), 
+        pack_uhyper((v.dup_bytes)), 
+    ].join
+end
+
+def unpack_dedup_summary(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :ios),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :zero_ios),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :zero_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :dup_ios),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :dup_bytes)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_device_summary(v)
+    [
+        pack_string((v.name)), 
+        pack_uhyper((v.journalled_bytes)), 
+        pack_uhyper((v.replayed_bytes)), 
+        pack_uhyper((v.coalesced_bytes)), 
+    ].join
+end
+
+def unpack_device_summary(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_string(txt)},
+            :name),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :journalled_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :replayed_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :coalesced_bytes)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_journal_summary(v)
+    [
+        pack_uhyper((v.used_bytes)), 
+        pack_uhyper((v.capacity_bytes)), 
+        pack_uhyper((v.reclaimed_bytes)), 
+        pack_uhyper((v.reclaim_rate)), 
+        pack_uhyper((v.recycled_segments)), 
+        pack_uhyper((v.throttled_commits)), 
+        pack_uhyper((v.stalled_commits)), 
+    ].join
+end
+
+def unpack_journal_summary(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :used_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :capacity_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :reclaimed_bytes),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :reclaim_rate),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :recycled_segments),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :throttled_commits),
+        FieldDetail.new(
+            lambda {|txt| unpack_uhyper(txt)},
+            :stalled_commits)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_stats_summary(v)
+    [
+        pack_uint((v.commands).length) + 
+            pack_array((v.commands).length, (v.commands)) {|v| pack_command_summary(v)}, 
+        pack_uint((v.connections).length) + 
+            pack_array((v.connections).length, (v.connections)) {|v| pack_connection_summary(v)}, 
+        pack_dedup_summary((v.dedup)), 
+        pack_uint((v.devices).length) + 
+            pack_array((v.devices).length, (v.devices)) {|v| pack_device_summary(v)}, 
+        pack_journal_summary((v.journal)), 
+    ].join
+end
+
+def unpack_stats_summary(txt)
+    unpacker = unpack_struct_fn(
+        FieldDetail.new(
+            unpack_var_array_fn(
+                lambda {|txt| unpack_command_summary(txt)}),
+            :commands),
+        FieldDetail.new(
+            unpack_var_array_fn(
+                lambda {|txt| unpack_connection_summary(txt)}),
+            :connections),
+        FieldDetail.new(
+            lambda {|txt| unpack_dedup_summary(txt)},
+            :dedup),
+        FieldDetail.new(
+            unpack_var_array_fn(
+                lambda {|txt| unpack_device_summary(txt)}),
+            :devices),
+        FieldDetail.new(
+            lambda {|txt| unpack_journal_summary(txt)},
+            :journal)
+    )
+    unpacker.call(txt)
+end
+
+
+def pack_response_code(v)
+    begin
+        table = begin
+            last = 0
+            table = Hash.new
+            table[:SUCCESS] = last
+            last = last + 1
+
+            table[:FAIL] = last
+            last = last + 1
+
+            table[:TRANSACTION_RESPONSE] = last
+            last = last + 1
+
+            table[:LOGON_RESPONSE] = last
+            last = last + 1
+
+            table[:STATS_RESPONSE] = last
+            last = last + 1
+
+            table
+        end
+        pack_enum(table, v)
+    end
+
+end
+
+def unpack_response_code(txt)
+    unpacker = begin
+        table = Array.new
+        last = 0
+        table << EnumDetail.new(last, :SUCCESS)
+        last = last + 1
+        table << EnumDetail.new(last, :FAIL)
+        last = last + 1
+        table << EnumDetail.new(last, :TRANSACTION_RESPONSE)
+        last = last + 1
+        table << EnumDetail.new(last, :LOGON_RESPONSE)
+        last = last + 1
+        table << EnumDetail.new(last, :STATS_RESPONSE)
+        last = last + 1
+        unpack_enum_fn(table)
+    end
+    unpacker.call(txt)
+end
+
+
+def pack_response(v)
+    [
+        pack_response_code((v.discriminator)),
+        case (v.discriminator)
+        when :SUCCESS
+            ''
+        when :FAIL
+            pack_string((v.reason))
+        when :TRANSACTION_RESPONSE
+            pack_hyper((v.transaction_id))
+        when :LOGON_RESPONSE
+            pack_logon_response((v.logon))
+        when :STATS_RESPONSE
+            pack_stats_summary((v.stats))
+        end
+    ].join
+end
+
+def unpack_response(txt)
+    unpacker = unpack_union_fn(
+        FieldDetail.new(
+            lambda {|txt| unpack_response_code(txt)},
+            :discriminator),
+        [
+            CaseDetail.new(
+                :SUCCESS,
+                unpack_void_fn(),
+                nil),
+            CaseDetail.new(
+                :FAIL,
+                lambda {|txt| unpack_string(txt)},
+                :reason),
+            CaseDetail.new(
+                :TRANSACTION_RESPONSE,
+                lambda {|txt| unpack_hyper(txt)},
+                :transaction_id),
+            CaseDetail.new(
+                :LOGON_RESPONSE,
+                lambda {|txt| unpack_logon_response(txt)},
+                :logon),
+            CaseDetail.new(
+                :STATS_RESPONSE,
+                lambda {|txt| unpack_stats_summary(txt)},
+                :stats)
+        ],
+        nil)
+    unpacker.call(txt)
+end
+
+
@@ -231,10 +231,11 @@ end
 
 # These methods construct protocol message
 module Builders
-  def mk_logon(major, minor, patch)
+  def mk_logon(major, minor, patch, codecs = [])
     cmd = Message.new(:discriminator => :LOGON,
-                      :logon => Message.new(:major => major,
-                                            :minor => minor,
-                                            :patch => patch))
+                      :logon => Message.new(:v => Message.new(:major => major,
+                                                              :minor => minor,
+                                                              :patch => patch),
+                                            :codecs => codecs))
   end
 end
@@ -13,7 +13,7 @@ class TestLogon < Test::Unit::TestCase
     @replicator = Replicator.new('127.0.0.1', 6776)
     req_id = @replicator.put_request(mk_logon(major, minor, patch))
     resp = @replicator.get_response(req_id)
-    assert_equal(expect_success ? :SUCCESS : :FAIL, resp.discriminator)
+    assert_equal(expect_success ? :LOGON_RESPONSE : :FAIL, resp.discriminator)
 
     STDERR.puts "logon passed, now shutting down"
     @replicator.shutdown
@@ -0,0 +1 @@
+../../src/compress/src/compress.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/csp/src/channel.h
\ No newline at end of file
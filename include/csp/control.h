@@ -0,0 +1 @@
+../../src/csp/src/control.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/csp/src/io.h
\ No newline at end of file
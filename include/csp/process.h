@@ -0,0 +1 @@
+../../src/csp/src/process.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/datastruct/src/list.h
\ No newline at end of file
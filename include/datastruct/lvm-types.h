@@ -0,0 +1 @@
+../../src/datastruct/src/lvm-types.h
\ No newline at end of file
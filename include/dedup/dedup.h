@@ -0,0 +1 @@
+../../src/dedup/src/dedup.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/journal/src/extent_index.h
\ No newline at end of file
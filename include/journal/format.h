@@ -0,0 +1 @@
+../../src/journal/src/format.h
\ No newline at end of file
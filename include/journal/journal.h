@@ -0,0 +1 @@
+../../src/journal/src/journal.h
\ No newline at end of file
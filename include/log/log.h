@@ -0,0 +1 @@
+../../src/log/src/log.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/log/src/lvm-logging.h
\ No newline at end of file
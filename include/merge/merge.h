@@ -0,0 +1 @@
+../../src/merge/src/merge.h
\ No newline at end of file
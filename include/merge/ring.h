@@ -0,0 +1 @@
+../../src/merge/src/ring.h
\ No newline at end of file
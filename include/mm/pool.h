@@ -0,0 +1 @@
+../../src/mm/src/pool.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/stats/src/histogram.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/utility/src/crc32c.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/utility/src/dynamic_buffer.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/utility/src/thunk.h
\ No newline at end of file
@@ -0,0 +1 @@
+../../src/xdr/src/xdr.h
\ No newline at end of file
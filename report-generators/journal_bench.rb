@@ -0,0 +1,33 @@
+# Reads the journal benchmark results given on the command line, as
+# written by workload_b --output, and charts them.
+
+require 'bench_results'
+require 'pathname'
+require 'reports'
+require 'erb'
+require 'report_templates'
+
+include ReportTemplates
+
+results = ARGV.map do |f|
+  Pathname.new(f).open {|io| BenchResults.read(io)}
+end
+
+series = BenchResults.new(results.map(&:results).flatten).series
+
+def describe(s)
+  range = lambda {|min, max| min == max ? min.to_s : "#{min}-#{max}"}
+
+  "#{s[:mode]}, #{s[:lanes]} lanes, #{s[:devices]} devices, " +
+    "#{range.call(s[:ios_min], s[:ios_max])} ios of " +
+    "#{range.call(s[:io_size_min], s[:io_size_max])} bytes per commit, " +
+    "#{s[:pattern]}, depth #{s[:depth]}"
+end
+
+# A bar as wide as |value| is, as a percentage of |max|
+def bar(value, max, klass)
+  width = max > 0 ? (100.0 * value / max).round : 0
+  "<div class=\"#{klass}\" style=\"width: #{width}%\">&nbsp;</div>"
+end
+
+generate_report(:journal_bench, binding)
@@ -0,0 +1,75 @@
+# Parses the csv results written by the benchmarks, eg, workload_b
+# --output.  The first line names the columns; files may be
+# concatenated, so a line that repeats them is skipped.
+
+BenchResult = Struct.new(:fields)
+
+class BenchResult
+  def [](key)
+    fields[key]
+  end
+
+  # Runs with the same settings, varying only the client count, are a
+  # series.
+  def series_key
+    fields.reject {|k, _| BenchResults::RESULT_COLUMNS.member?(k)}
+  end
+end
+
+class BenchResults
+  attr_reader :results
+
+  # Measured, rather than set, along with the client count
+  RESULT_COLUMNS = [:clients, :seconds, :commits_per_sec, :ios_per_sec, :mb_per_sec,
+                    :syncs_per_sec, :commits_per_sync, :p50_us, :p90_us, :p99_us,
+                    :p999_us, :max_us]
+
+  def initialize(results)
+    @results = results
+  end
+
+  # Returns [settings, results] pairs, in the order each series first
+  # appears, with the results sorted by client count.
+  def series
+    groups = Hash.new {|h, k| h[k] = Array.new}
+    @results.each {|r| groups[r.series_key] << r}
+    groups.map {|k, rs| [k, rs.sort_by {|r| r[:clients]}]}
+  end
+
+  def self.read(io)
+    columns = nil
+    results = Array.new
+
+    io.readlines.each do |line|
+      values = line.strip.split(',')
+
+      if values.empty?
+        next
+
+      elsif columns.nil? || values == columns.map(&:to_s)
+        columns = values.map(&:to_sym)
+
+      elsif values.size != columns.size
+        raise RuntimeError, "badly formatted results line"
+
+      else
+        results << BenchResult.new(Hash[columns.zip(values.map {|v| convert(v)})])
+      end
+    end
+
+    BenchResults.new(results)
+  end
+
+  def self.convert(v)
+    case v
+    when /^\d+$/
+      v.to_i
+
+    when /^\d*\.\d+$/
+      v.to_f
+
+    else
+      v
+    end
+  end
+end
@@ -29,6 +29,12 @@ module Reports
                  Pathname.new("reports/memcheck.html"),
                  Pathname.new("memcheck.rhtml"))
 
+      add_report(:journal_bench,
+                 "Journal Benchmarks",
+                 "journal throughput and commit latency, from workload_b",
+                 Pathname.new("reports/journal_bench.html"),
+                 Pathname.new("journal_bench.rhtml"))
+
       add_report(:unit_detail,
                  "Unit Test Detail",
                  "unit test detail",
@@ -0,0 +1,37 @@
+require 'test/unit'
+require 'pathname'
+require 'stringio'
+require 'bench_results'
+
+class TestBenchResults < Test::Unit::TestCase
+  def read
+    Pathname.new("report-generators/test/example.results").open do |f|
+      BenchResults.read(f)
+    end
+  end
+
+  def test_reading
+    r = read
+
+    assert_equal(3, r.results.size)
+    assert_equal("mixed", r.results[0][:label])
+    assert_equal(4, r.results[0][:clients])
+    assert_equal(6061.1, r.results[0][:commits_per_sec])
+    assert_equal("4k sync", r.results[2][:label])
+  end
+
+  def test_series
+    s = read.series
+
+    assert_equal(2, s.size)
+    assert_equal("mixed", s[0][0][:label])
+    assert_equal([1, 4], s[0][1].map {|r| r[:clients]})
+    assert_equal(1, s[1][1].size)
+  end
+
+  def test_bad_line
+    assert_raise(RuntimeError) do
+      BenchResults.read(StringIO.new("clients,commits_per_sec\n1,2,3\n"))
+    end
+  end
+end
@@ -1,3 +1,4 @@
 require 'tc_log'
 require 'tc_string_store'
 require 'tc_schedule_file'
+require 'tc_bench_results'
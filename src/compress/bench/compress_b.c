@@ -0,0 +1,225 @@
+#include "compress/compress.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+/*
+ * Measures what each compiled in codec costs on a few representative
+ * kinds of block data (or a file of your own), and what that means for
+ * the throughput of links of various speeds.  Compression runs in
+ * parallel with sending, so a link is limited either by how fast we can
+ * compress, or by how fast it can carry the compressed data.
+ */
+
+enum {
+        DEFAULT_BLOCK_SIZE = 64 * 1024,
+        DEFAULT_TOTAL = 64 * 1024 * 1024
+};
+
+struct data_set {
+        const char *name;
+        void (*fill)(unsigned char *data, size_t len);
+};
+
+static void fill_zeroes(unsigned char *data, size_t len)
+{
+        memset(data, 0, len);
+}
+
+static void fill_random(unsigned char *data, size_t len)
+{
+        size_t i;
+        for (i = 0; i < len; i++)
+                data[i] = rand() & 0xff;
+}
+
+/* 8k pages with a header, sparse rows and free space at the end */
+static void fill_db_pages(unsigned char *data, size_t len)
+{
+        size_t i;
+
+        memset(data, 0, len);
+        for (i = 0; i < len; i++) {
+                size_t offset = i % 8192;
+                if (offset < 24)
+                        data[i] = (i / 8192) & 0xff;
+                else if (offset < 6144 && (offset % 64) < 20)
+                        data[i] = rand() & 0xff;
+        }
+}
+
+static void fill_text(unsigned char *data, size_t len)
+{
+        static const char *words[] = {
+                "journal", "replicator", "transaction", "commit ", "sector",
+                "device", "merge", "the ", "a ", "of ", "and ", "\n"
+        };
+
+        size_t i = 0;
+        while (i < len) {
+                const char *w = words[rand() % (sizeof(words) / sizeof(*words))];
+                size_t n = strlen(w);
+                if (n > len - i)
+                        n = len - i;
+                memcpy(data + i, w, n);
+                i += n;
+        }
+}
+
+static struct data_set data_sets_[] = {
+        { "zeroes", fill_zeroes },
+        { "db-pages", fill_db_pages },
+        { "text", fill_text },
+        { "random", fill_random },
+        { NULL, NULL }
+};
+
+static double now()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return ts.tv_sec + ts.tv_nsec / 1000000000.0;
+}
+
+static const double link_mbits_[] = { 100, 1000, 10000 };
+enum { NR_LINKS = sizeof(link_mbits_) / sizeof(*link_mbits_) };
+
+static void bench(const char *set, enum compress_codec codec, int level,
+                  unsigned char *data, size_t total, size_t block_size)
+{
+        size_t offset, in = 0, out = 0, bound = compress_bound(codec, block_size);
+        unsigned char *cbuf = malloc(bound), *dbuf = malloc(block_size);
+        double t, ctime = 0.0, dtime = 0.0, cmb, dmb, mb = total / (1024.0 * 1024.0);
+        int i;
+
+        if (!cbuf || !dbuf) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+        }
+
+        for (offset = 0; offset + block_size <= total; offset += block_size) {
+                size_t clen = bound, dlen = block_size;
+
+                t = now();
+                if (!compress_block(codec, level, data + offset, block_size, cbuf, &clen)) {
+                        fprintf(stderr, "%s compression failed\n", compress_name(codec));
+                        exit(1);
+                }
+                ctime += now() - t;
+
+                t = now();
+                if (!decompress_block(codec, cbuf, clen, dbuf, &dlen) || dlen != block_size) {
+                        fprintf(stderr, "%s decompression failed\n", compress_name(codec));
+                        exit(1);
+                }
+                dtime += now() - t;
+
+                in += block_size;
+                out += clen;
+        }
+
+        cmb = mb / ctime;
+        dmb = mb / dtime;
+        printf("%-10s %-6s %7.3f %10.1f %10.1f", set, compress_name(codec),
+               (double) out / in, cmb, dmb);
+
+        for (i = 0; i < NR_LINKS; i++) {
+                double link = link_mbits_[i] / 8.0 * ((double) in / out);
+                printf(" %10.1f", link < cmb ? link : cmb);
+        }
+        printf("\n");
+
+        free(cbuf);
+        free(dbuf);
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--block-size <bytes>] [--total <bytes>] [--level <n>] [--file <path>]\n", prog);
+        exit(1);
+}
+
+static unsigned char *read_file(const char *path, size_t *len)
+{
+        FILE *fp = fopen(path, "r");
+        unsigned char *data;
+
+        if (!fp)
+                return NULL;
+
+        data = malloc(*len);
+        if (data)
+                *len = fread(data, 1, *len, fp);
+
+        fclose(fp);
+        return data;
+}
+
+int main(int argc, char **argv)
+{
+        int i, level = 0;
+        size_t block_size = DEFAULT_BLOCK_SIZE, total = DEFAULT_TOTAL;
+        const char *file = NULL;
+        unsigned char *data;
+        struct data_set *ds;
+
+        for (i = 1; i < argc; i++) {
+                if (i + 1 == argc)
+                        usage(argv[0]);
+
+                if (!strcmp(argv[i], "--block-size"))
+                        block_size = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--total"))
+                        total = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--level"))
+                        level = atoi(argv[++i]);
+                else if (!strcmp(argv[i], "--file"))
+                        file = argv[++i];
+                else
+                        usage(argv[0]);
+        }
+
+        if (!block_size || total < block_size)
+                usage(argv[0]);
+
+        printf("%-10s %-6s %7s %10s %10s", "data", "codec", "ratio", "comp MB/s", "dcmp MB/s");
+        for (i = 0; i < NR_LINKS; i++) {
+                char label[32];
+                snprintf(label, sizeof(label), "%gMb link", link_mbits_[i]);
+                printf(" %10s", label);
+        }
+        printf("\n");
+
+        if (file) {
+                data = read_file(file, &total);
+                if (!data || total < block_size) {
+                        fprintf(stderr, "couldn't read enough data from '%s'\n", file);
+                        return 1;
+                }
+
+                for (i = 0; i < CODEC_COUNT; i++)
+                        if (compress_available(i))
+                                bench(file, i, level, data, total, block_size);
+                free(data);
+                return 0;
+        }
+
+        data = malloc(total);
+        if (!data) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+        }
+
+        for (ds = data_sets_; ds->name; ds++) {
+                srand(1);
+                ds->fill(data, total);
+                for (i = 0; i < CODEC_COUNT; i++)
+                        if (compress_available(i))
+                                bench(ds->name, i, level, data, total, block_size);
+        }
+
+        free(data);
+        return 0;
+}
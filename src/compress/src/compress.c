@@ -0,0 +1,166 @@
+#include "compress.h"
+
+#include <string.h>
+
+#ifdef HAVE_LZ4
+#include <lz4.h>
+#endif
+
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+/*----------------------------------------------------------------*/
+
+/* none */
+static size_t none_bound(size_t len)
+{
+        return len;
+}
+
+static int none_copy(int level, const void *src, size_t len, void *dest, size_t *dest_len)
+{
+        if (len > *dest_len)
+                return 0;
+
+        memcpy(dest, src, len);
+        *dest_len = len;
+        return 1;
+}
+
+static int none_decompress(const void *src, size_t len, void *dest, size_t *dest_len)
+{
+        return none_copy(0, src, len, dest, dest_len);
+}
+
+/*--------------------------------*/
+
+#ifdef HAVE_LZ4
+static size_t lz4_bound(size_t len)
+{
+        return LZ4_compressBound(len);
+}
+
+static int lz4_compress(int level, const void *src, size_t len, void *dest, size_t *dest_len)
+{
+        int r = LZ4_compress_default(src, dest, len, *dest_len);
+        if (r <= 0)
+                return 0;
+
+        *dest_len = r;
+        return 1;
+}
+
+static int lz4_decompress(const void *src, size_t len, void *dest, size_t *dest_len)
+{
+        int r = LZ4_decompress_safe(src, dest, len, *dest_len);
+        if (r < 0)
+                return 0;
+
+        *dest_len = r;
+        return 1;
+}
+#endif
+
+/*--------------------------------*/
+
+#ifdef HAVE_ZSTD
+static size_t zstd_bound(size_t len)
+{
+        return ZSTD_compressBound(len);
+}
+
+static int zstd_compress(int level, const void *src, size_t len, void *dest, size_t *dest_len)
+{
+        size_t r = ZSTD_compress(dest, *dest_len, src, len, level);
+        if (ZSTD_isError(r))
+                return 0;
+
+        *dest_len = r;
+        return 1;
+}
+
+static int zstd_decompress(const void *src, size_t len, void *dest, size_t *dest_len)
+{
+        size_t r = ZSTD_decompress(dest, *dest_len, src, len);
+        if (ZSTD_isError(r))
+                return 0;
+
+        *dest_len = r;
+        return 1;
+}
+#endif
+
+/*----------------------------------------------------------------*/
+
+struct codec {
+        const char *name;
+        size_t (*bound)(size_t len);
+        int (*compress)(int level, const void *src, size_t len, void *dest, size_t *dest_len);
+        int (*decompress)(const void *src, size_t len, void *dest, size_t *dest_len);
+};
+
+static struct codec codecs_[CODEC_COUNT] = {
+        { "none", none_bound, none_copy, none_decompress },
+#ifdef HAVE_LZ4
+        { "lz4", lz4_bound, lz4_compress, lz4_decompress },
+#else
+        { "lz4", NULL, NULL, NULL },
+#endif
+#ifdef HAVE_ZSTD
+        { "zstd", zstd_bound, zstd_compress, zstd_decompress }
+#else
+        { "zstd", NULL, NULL, NULL }
+#endif
+};
+
+int compress_available(enum compress_codec codec)
+{
+        return codec < CODEC_COUNT && codecs_[codec].compress;
+}
+
+const char *compress_name(enum compress_codec codec)
+{
+        return codec < CODEC_COUNT ? codecs_[codec].name : "unknown";
+}
+
+int compress_lookup(const char *name, enum compress_codec *codec)
+{
+        int i;
+
+        for (i = 0; i < CODEC_COUNT; i++) {
+                if (!strcmp(codecs_[i].name, name)) {
+                        *codec = i;
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+size_t compress_bound(enum compress_codec codec, size_t len)
+{
+        return compress_available(codec) ? codecs_[codec].bound(len) : 0;
+}
+
+int compress_block(enum compress_codec codec, int level,
+                   const void *src, size_t len,
+                   void *dest, size_t *dest_len)
+{
+        if (!compress_available(codec))
+                return 0;
+
+        return codecs_[codec].compress(level, src, len, dest, dest_len);
+}
+
+int decompress_block(enum compress_codec codec,
+                     const void *src, size_t len,
+                     void *dest, size_t *dest_len)
+{
+        if (!compress_available(codec))
+                return 0;
+
+        return codecs_[codec].decompress(src, len, dest, dest_len);
+}
+
+/*----------------------------------------------------------------*/
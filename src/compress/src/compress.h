@@ -0,0 +1,51 @@
+#ifndef COMPRESS_COMPRESS_H
+#define COMPRESS_COMPRESS_H
+
+#include <stdlib.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * A thin layer over the block compression libraries.  Which codecs are
+ * available depends on what was built in (WITH_LZ4, WITH_ZSTD), so check
+ * with compress_available() before negotiating one with a client.
+ *
+ * These values go over the wire, so they must match the compression enum
+ * in protocol.xdr.
+ */
+enum compress_codec {
+        CODEC_NONE,
+        CODEC_LZ4,
+        CODEC_ZSTD,
+
+        CODEC_COUNT
+};
+
+int compress_available(enum compress_codec codec);
+const char *compress_name(enum compress_codec codec);
+int compress_lookup(const char *name, enum compress_codec *codec);
+
+/*
+ * The largest output compress_block() can produce for |len| bytes of
+ * input.
+ */
+size_t compress_bound(enum compress_codec codec, size_t len);
+
+/*
+ * |level| is only used by zstd, 0 selects the library default.
+ *
+ * |*dest_len| is the space available at |dest| on entry, and the size of
+ * the output on return.  Both return 0 on failure, including when the
+ * output doesn't fit.
+ */
+int compress_block(enum compress_codec codec, int level,
+                   const void *src, size_t len,
+                   void *dest, size_t *dest_len);
+
+int decompress_block(enum compress_codec codec,
+                     const void *src, size_t len,
+                     void *dest, size_t *dest_len);
+
+/*----------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,104 @@
+#include "compress/compress.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+        BLOCK_SIZE = 64 * 1024
+};
+
+static void fill_pattern(unsigned char *data, size_t len)
+{
+        size_t i;
+        for (i = 0; i < len; i++)
+                data[i] = (i / 512) & 0xff;
+}
+
+static void fill_random(unsigned char *data, size_t len)
+{
+        size_t i;
+        srand(1);
+        for (i = 0; i < len; i++)
+                data[i] = rand() & 0xff;
+}
+
+static void check_round_trip(enum compress_codec codec, unsigned char *data, size_t len)
+{
+        size_t clen = compress_bound(codec, len), dlen = len;
+        unsigned char *cbuf = malloc(clen), *dbuf = malloc(len);
+
+        assert(cbuf && dbuf);
+        assert(compress_block(codec, 0, data, len, cbuf, &clen));
+        assert(decompress_block(codec, cbuf, clen, dbuf, &dlen));
+        assert(dlen == len);
+        assert(!memcmp(data, dbuf, len));
+
+        free(cbuf);
+        free(dbuf);
+}
+
+void test_names()
+{
+        int i;
+        enum compress_codec codec;
+
+        for (i = 0; i < CODEC_COUNT; i++) {
+                assert(compress_lookup(compress_name(i), &codec));
+                assert(codec == i);
+        }
+
+        assert(!compress_lookup("bogus", &codec));
+        assert(compress_available(CODEC_NONE));
+        assert(!compress_available(CODEC_COUNT));
+}
+
+void test_round_trip()
+{
+        int i;
+        unsigned char *data = malloc(BLOCK_SIZE);
+
+        assert(data);
+        for (i = 0; i < CODEC_COUNT; i++) {
+                if (!compress_available(i))
+                        continue;
+
+                memset(data, 0, BLOCK_SIZE);
+                check_round_trip(i, data, BLOCK_SIZE);
+
+                fill_pattern(data, BLOCK_SIZE);
+                check_round_trip(i, data, BLOCK_SIZE);
+
+                fill_random(data, BLOCK_SIZE);
+                check_round_trip(i, data, BLOCK_SIZE);
+
+                check_round_trip(i, data, 1);
+        }
+
+        free(data);
+}
+
+void test_short_output()
+{
+        int i;
+        unsigned char *data = malloc(BLOCK_SIZE), out[16];
+
+        assert(data);
+        fill_random(data, BLOCK_SIZE);
+        for (i = 0; i < CODEC_COUNT; i++) {
+                size_t len = sizeof(out);
+                if (compress_available(i))
+                        assert(!compress_block(i, 0, data, BLOCK_SIZE, out, &len));
+        }
+
+        free(data);
+}
+
+int main(int argc, char **argv)
+{
+        test_names();
+        test_round_trip();
+        test_short_output();
+        return 0;
+}
@@ -4,19 +4,29 @@
 
 /*----------------------------------------------------------------*/
 
+/*
+ * Hitting end of file before |count| bytes have been read is an error.
+ */
 ssize_t csp_read_exact(int fd, void *buf, size_t count)
 {
         ssize_t total = 0;
 
-        do {
-                ssize_t n = csp_read(fd, buf, count);
-                if (n < 0 && errno != EINTR)
+        while (count) {
+                ssize_t n = csp_read(fd, buf + total, count);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
                         return n;
+                }
+
+                if (!n) {
+                        errno = EPIPE;
+                        return -1;
+                }
 
                 count -= n;
                 total += n;
-
-        } while (count);
+        }
 
         return total;
 }
@@ -25,18 +35,19 @@ ssize_t csp_write_exact(int fd, const void *buf, size_t count)
 {
         ssize_t total = 0;
 
-        do {
-                ssize_t n = csp_write(fd, buf, count);
-                if (n < 0 && errno != EINTR)
+        while (count) {
+                ssize_t n = csp_write(fd, buf + total, count);
+                if (n < 0) {
+                        if (errno == EINTR)
+                                continue;
                         return n;
+                }
 
                 count -= n;
                 total += n;
-
-        } while (count);
+        }
 
         return total;
-
 }
 
 /*----------------------------------------------------------------*/
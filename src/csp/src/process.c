@@ -170,7 +170,12 @@ static int io_wait(process_t p, int fd, enum io_type direction)
                 perror("epoll_ctl failed");
                 return 0;
         }
+        /*
+         * io_check() moves us back onto the schedulable list, so leave
+         * the list entry in a state where it can be deleted again.
+         */
         list_del(&p->list);
+        list_init(&p->list);
         io_count++;
         swapcontext(&p->cpu_state, &scheduler_);
         io_count--;
@@ -247,6 +252,10 @@ int csp_accept(int sockfd, struct sockaddr *addr, socklen_t *addrlen)
                         if (!io_wait(csp_self(), sockfd, READ))
                                 return -1;
                 } else {
+                        /* accepted sockets don't inherit O_NONBLOCK */
+                        if (fd >= 0)
+                                csp_set_non_blocking(fd);
+
                         csp_yield();
                         return fd;
                 }
@@ -0,0 +1,298 @@
+#include "dedup.h"
+
+#include <string.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/*----------------------------------------------------------------*/
+
+static int bytes_zero(const unsigned char *data, size_t len)
+{
+        while (len--)
+                if (*data++)
+                        return 0;
+
+        return 1;
+}
+
+#ifdef __SSE2__
+/*
+ * OR 64 bytes at a time together and test once per iteration; most non
+ * zero blocks fail in the first cache line.
+ */
+int dedup_is_zero(const void *data, size_t len)
+{
+        const unsigned char *b = data;
+        size_t head = (16 - ((uintptr_t) b & 15)) & 15;
+        __m128i zero = _mm_setzero_si128();
+
+        if (len < 64)
+                return bytes_zero(b, len);
+
+        if (!bytes_zero(b, head))
+                return 0;
+        b += head;
+        len -= head;
+
+        while (len >= 64) {
+                const __m128i *v = (const __m128i *) b;
+                __m128i acc = _mm_or_si128(_mm_or_si128(_mm_load_si128(v), _mm_load_si128(v + 1)),
+                                           _mm_or_si128(_mm_load_si128(v + 2), _mm_load_si128(v + 3)));
+                if (_mm_movemask_epi8(_mm_cmpeq_epi8(acc, zero)) != 0xffff)
+                        return 0;
+
+                b += 64;
+                len -= 64;
+        }
+
+        return bytes_zero(b, len);
+}
+#else
+int dedup_is_zero(const void *data, size_t len)
+{
+        const unsigned char *b = data;
+        uint64_t w;
+
+        while (len >= sizeof(w)) {
+                memcpy(&w, b, sizeof(w));
+                if (w)
+                        return 0;
+                b += sizeof(w);
+                len -= sizeof(w);
+        }
+
+        return bytes_zero(b, len);
+}
+#endif
+
+/*----------------------------------------------------------------*/
+
+static const uint64_t PRIME1 = 11400714785074694791ULL;
+static const uint64_t PRIME2 = 14029467366897019727ULL;
+static const uint64_t PRIME3 = 1609587929392839161ULL;
+static const uint64_t PRIME4 = 9650029242287828579ULL;
+static const uint64_t PRIME5 = 2870177450012600261ULL;
+
+static uint64_t rotl(uint64_t x, int r)
+{
+        return (x << r) | (x >> (64 - r));
+}
+
+static uint64_t read64(const unsigned char *b)
+{
+        uint64_t v;
+        memcpy(&v, b, sizeof(v));
+        return v;
+}
+
+static uint64_t round64(uint64_t acc, uint64_t input)
+{
+        acc += input * PRIME2;
+        acc = rotl(acc, 31);
+        return acc * PRIME1;
+}
+
+static uint64_t merge64(uint64_t acc, uint64_t v)
+{
+        acc ^= round64(0, v);
+        return acc * PRIME1 + PRIME4;
+}
+
+/* four independent lanes keep the multipliers busy */
+uint64_t dedup_hash(const void *data, size_t len, uint64_t seed)
+{
+        const unsigned char *b = data, *end = b + len;
+        uint64_t h;
+
+        if (len >= 32) {
+                uint64_t v1 = seed + PRIME1 + PRIME2;
+                uint64_t v2 = seed + PRIME2;
+                uint64_t v3 = seed;
+                uint64_t v4 = seed - PRIME1;
+
+                while (b + 32 <= end) {
+                        v1 = round64(v1, read64(b));
+                        v2 = round64(v2, read64(b + 8));
+                        v3 = round64(v3, read64(b + 16));
+                        v4 = round64(v4, read64(b + 24));
+                        b += 32;
+                }
+
+                h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+                h = merge64(h, v1);
+                h = merge64(h, v2);
+                h = merge64(h, v3);
+                h = merge64(h, v4);
+        } else
+                h = seed + PRIME5;
+
+        h += len;
+
+        while (b + 8 <= end) {
+                h ^= round64(0, read64(b));
+                h = rotl(h, 27) * PRIME1 + PRIME4;
+                b += 8;
+        }
+
+        while (b < end) {
+                h ^= *b++ * PRIME5;
+                h = rotl(h, 11) * PRIME1;
+        }
+
+        h ^= h >> 33;
+        h *= PRIME2;
+        h ^= h >> 29;
+        h *= PRIME3;
+        h ^= h >> 32;
+
+        return h;
+}
+
+/*----------------------------------------------------------------*/
+
+void dedup_stats_add(struct dedup_stats *total, struct dedup_stats *s)
+{
+        total->ios += s->ios;
+        total->bytes += s->bytes;
+        total->zero_ios += s->zero_ios;
+        total->zero_bytes += s->zero_bytes;
+        total->dup_ios += s->dup_ios;
+        total->dup_bytes += s->dup_bytes;
+        total->ref_ios += s->ref_ios;
+        total->ref_bytes += s->ref_bytes;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Block copies are appended to a ring, positions are absolute byte
+ * offsets so we can tell when the ring has lapped an entry.  The index
+ * is direct mapped on the hash; a newer block simply evicts an older one
+ * from its slot, which is all the LRU a window like this needs.
+ */
+enum {
+        AVERAGE_BLOCK = 4096,
+        MIN_SLOTS = 64
+};
+
+struct dedup_entry {
+        uint64_t hash;
+        uint64_t key;
+        uint64_t pos;
+        uint64_t id;
+        uint32_t len;
+        int used;
+};
+
+struct dedup_window {
+        unsigned char *ring;
+        uint64_t size;
+        uint64_t head;
+
+        struct dedup_entry *slots;
+        uint64_t mask;
+};
+
+struct dedup_window *dedup_window_create(size_t size)
+{
+        uint64_t nr_slots = MIN_SLOTS;
+        struct dedup_window *w = malloc(sizeof(*w));
+
+        if (!w)
+                return NULL;
+
+        memset(w, 0, sizeof(*w));
+        if (!size)
+                return w;
+
+        while (nr_slots < size / AVERAGE_BLOCK * 2)
+                nr_slots <<= 1;
+
+        w->ring = malloc(size);
+        w->slots = malloc(sizeof(*w->slots) * nr_slots);
+        if (!w->ring || !w->slots) {
+                dedup_window_destroy(w);
+                return NULL;
+        }
+
+        w->size = size;
+        w->mask = nr_slots - 1;
+        dedup_window_reset(w);
+        return w;
+}
+
+void dedup_window_destroy(struct dedup_window *w)
+{
+        free(w->ring);
+        free(w->slots);
+        free(w);
+}
+
+void dedup_window_reset(struct dedup_window *w)
+{
+        w->head = 0;
+        if (w->slots)
+                memset(w->slots, 0, sizeof(*w->slots) * (w->mask + 1));
+}
+
+static int entry_live(struct dedup_window *w, struct dedup_entry *e)
+{
+        return e->used && e->pos + w->size >= w->head;
+}
+
+static void insert(struct dedup_window *w, struct dedup_entry *e,
+                   const void *data, uint32_t len, uint64_t hash, uint64_t key, uint64_t id)
+{
+        uint64_t offset = w->head % w->size;
+
+        /* blocks are stored contiguously, skip the tail if it won't fit */
+        if (offset + len > w->size)
+                w->head += w->size - offset;
+
+        memcpy(w->ring + w->head % w->size, data, len);
+        e->hash = hash;
+        e->key = key;
+        e->pos = w->head;
+        e->id = id;
+        e->len = len;
+        e->used = 1;
+
+        w->head += len;
+}
+
+enum dedup_class dedup_classify(struct dedup_window *w, struct dedup_stats *stats,
+                                const void *data, uint32_t len, uint64_t key,
+                                enum dedup_zero zero, uint64_t id, uint64_t *match)
+{
+        uint64_t hash;
+        struct dedup_entry *e;
+
+        stats->ios++;
+        stats->bytes += len;
+
+        if (zero == ZERO_YES || (zero == ZERO_SCAN && dedup_is_zero(data, len))) {
+                stats->zero_ios++;
+                stats->zero_bytes += len;
+                return BLOCK_ZERO;
+        }
+
+        if (!w->size || !len || len > w->size)
+                return BLOCK_DATA;
+
+        hash = dedup_hash(data, len, key);
+        e = w->slots + (hash & w->mask);
+        if (entry_live(w, e) && e->hash == hash && e->key == key && e->len == len &&
+            !memcmp(w->ring + e->pos % w->size, data, len)) {
+                *match = e->id;
+                stats->dup_ios++;
+                stats->dup_bytes += len;
+                return BLOCK_DUPLICATE;
+        }
+
+        insert(w, e, data, len, hash, key, id);
+        return BLOCK_DATA;
+}
+
+/*----------------------------------------------------------------*/
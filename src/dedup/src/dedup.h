@@ -0,0 +1,81 @@
+#ifndef DEDUP_DEDUP_H
+#define DEDUP_DEDUP_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Spotting writes that needn't carry their data: all zero blocks, and
+ * blocks that repeat one written recently.
+ */
+
+/* Vectorised where the cpu allows */
+int dedup_is_zero(const void *data, size_t len);
+
+/* A fast, non cryptographic 64 bit hash, in the style of xxhash */
+uint64_t dedup_hash(const void *data, size_t len, uint64_t seed);
+
+/*----------------------------------------------------------------*/
+
+struct dedup_stats {
+        uint64_t ios;
+        uint64_t bytes;
+
+        uint64_t zero_ios;
+        uint64_t zero_bytes;
+
+        uint64_t dup_ios;
+        uint64_t dup_bytes;
+
+        /* repeats the caller stored as references, rather than again */
+        uint64_t ref_ios;
+        uint64_t ref_bytes;
+};
+
+void dedup_stats_add(struct dedup_stats *total, struct dedup_stats *s);
+
+/*
+ * The window keeps copies of the most recent distinct blocks, up to
+ * |size| bytes of them, so a hash match can be confirmed with a memcmp
+ * before we trust it.  A zero sized window disables duplicate detection.
+ */
+struct dedup_window;
+
+struct dedup_window *dedup_window_create(size_t size);
+void dedup_window_destroy(struct dedup_window *w);
+
+/* forget everything, eg, when a transaction is rolled back */
+void dedup_window_reset(struct dedup_window *w);
+
+enum dedup_class {
+        BLOCK_DATA,
+        BLOCK_ZERO,
+        BLOCK_DUPLICATE
+};
+
+/*
+ * The zero scan only means something for raw data.  Callers holding
+ * compressed blocks can check them themselves and say what they found.
+ */
+enum dedup_zero {
+        ZERO_SCAN,
+        ZERO_NO,
+        ZERO_YES
+};
+
+/*
+ * Classifies a block and updates the stats.  |key| distinguishes blocks
+ * whose bytes are the same but mean different things (eg, compressed
+ * with different codecs).  |id| names this block; if it's a duplicate
+ * |*match| is set to the id of the earlier block.  Blocks classed as
+ * data are added to the window.
+ */
+enum dedup_class dedup_classify(struct dedup_window *w, struct dedup_stats *stats,
+                                const void *data, uint32_t len, uint64_t key,
+                                enum dedup_zero zero, uint64_t id, uint64_t *match);
+
+/*----------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,146 @@
+#include "dedup/dedup.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+enum {
+        BLOCK_SIZE = 4096
+};
+
+static void fill_block(unsigned char *data, size_t len, unsigned seed)
+{
+        size_t i;
+        srand(seed);
+        for (i = 0; i < len; i++)
+                data[i] = rand() & 0xff;
+}
+
+void test_zero_scan()
+{
+        unsigned char *buf = malloc(BLOCK_SIZE + 64);
+        size_t offset, len, i;
+
+        assert(buf);
+        memset(buf, 0, BLOCK_SIZE + 64);
+
+        /* every alignment and a spread of lengths, with a single set byte */
+        for (offset = 0; offset < 16; offset++) {
+                for (len = 0; len < 200; len++) {
+                        assert(dedup_is_zero(buf + offset, len));
+                        for (i = 0; i < len; i++) {
+                                buf[offset + i] = 1;
+                                assert(!dedup_is_zero(buf + offset, len));
+                                buf[offset + i] = 0;
+                        }
+                }
+
+                assert(dedup_is_zero(buf + offset, BLOCK_SIZE));
+                buf[offset + BLOCK_SIZE - 1] = 0x80;
+                assert(!dedup_is_zero(buf + offset, BLOCK_SIZE));
+                buf[offset + BLOCK_SIZE - 1] = 0;
+        }
+
+        free(buf);
+}
+
+void test_hash()
+{
+        unsigned char a[BLOCK_SIZE], b[BLOCK_SIZE];
+
+        fill_block(a, sizeof(a), 1);
+        memcpy(b, a, sizeof(b));
+        assert(dedup_hash(a, sizeof(a), 0) == dedup_hash(b, sizeof(b), 0));
+        assert(dedup_hash(a, sizeof(a), 0) != dedup_hash(a, sizeof(a), 1));
+        assert(dedup_hash(a, sizeof(a), 0) != dedup_hash(a, sizeof(a) - 1, 0));
+
+        b[BLOCK_SIZE / 2] ^= 1;
+        assert(dedup_hash(a, sizeof(a), 0) != dedup_hash(b, sizeof(b), 0));
+}
+
+void test_classify()
+{
+        unsigned char a[BLOCK_SIZE], b[BLOCK_SIZE], zero[BLOCK_SIZE];
+        struct dedup_window *w = dedup_window_create(64 * BLOCK_SIZE);
+        struct dedup_stats stats;
+        uint64_t match = 0;
+
+        assert(w);
+        memset(&stats, 0, sizeof(stats));
+        memset(zero, 0, sizeof(zero));
+        fill_block(a, sizeof(a), 1);
+        fill_block(b, sizeof(b), 2);
+
+        assert(dedup_classify(w, &stats, zero, sizeof(zero), 0, ZERO_SCAN, 0, &match) == BLOCK_ZERO);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 1, &match) == BLOCK_DATA);
+        assert(dedup_classify(w, &stats, b, sizeof(b), 0, ZERO_SCAN, 2, &match) == BLOCK_DATA);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 3, &match) == BLOCK_DUPLICATE);
+        assert(match == 1);
+
+        /* same bytes, different key */
+        assert(dedup_classify(w, &stats, a, sizeof(a), 1, ZERO_SCAN, 4, &match) == BLOCK_DATA);
+
+        /* the caller knows best */
+        assert(dedup_classify(w, &stats, a, sizeof(a), 2, ZERO_YES, 5, &match) == BLOCK_ZERO);
+        assert(dedup_classify(w, &stats, zero, sizeof(zero), 2, ZERO_NO, 6, &match) == BLOCK_DATA);
+
+        assert(stats.ios == 7);
+        assert(stats.bytes == 7 * BLOCK_SIZE);
+        assert(stats.zero_ios == 2);
+        assert(stats.dup_ios == 1);
+        assert(stats.dup_bytes == BLOCK_SIZE);
+
+        dedup_window_reset(w);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 7, &match) == BLOCK_DATA);
+
+        dedup_window_destroy(w);
+}
+
+void test_window_expiry()
+{
+        unsigned char a[BLOCK_SIZE], b[BLOCK_SIZE];
+        struct dedup_window *w = dedup_window_create(4 * BLOCK_SIZE);
+        struct dedup_stats stats;
+        uint64_t match;
+        unsigned i;
+
+        assert(w);
+        memset(&stats, 0, sizeof(stats));
+        fill_block(a, sizeof(a), 1);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 0, &match) == BLOCK_DATA);
+
+        /* push it out of the window */
+        for (i = 0; i < 8; i++) {
+                fill_block(b, sizeof(b), 100 + i);
+                assert(dedup_classify(w, &stats, b, sizeof(b), 0, ZERO_SCAN, 1 + i, &match) == BLOCK_DATA);
+        }
+
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 9, &match) == BLOCK_DATA);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 10, &match) == BLOCK_DUPLICATE);
+        assert(match == 9);
+
+        /* too big to keep */
+        dedup_window_destroy(w);
+        w = dedup_window_create(BLOCK_SIZE / 2);
+        assert(w);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 0, &match) == BLOCK_DATA);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 1, &match) == BLOCK_DATA);
+        dedup_window_destroy(w);
+
+        /* disabled */
+        w = dedup_window_create(0);
+        assert(w);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 0, &match) == BLOCK_DATA);
+        assert(dedup_classify(w, &stats, a, sizeof(a), 0, ZERO_SCAN, 1, &match) == BLOCK_DATA);
+        dedup_window_destroy(w);
+}
+
+int main(int argc, char **argv)
+{
+        test_zero_scan();
+        test_hash();
+        test_classify();
+        test_window_expiry();
+        return 0;
+}
@@ -0,0 +1,135 @@
+#include "journal/extent_index.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <time.h>
+
+/*
+ * Times the journal's sector index with millions of extents: random 4k
+ * and 64k writes spread over a few devices, then point and 1M range
+ * lookups, then dropping the transactions oldest first as merging
+ * would.
+ */
+
+enum {
+        DEFAULT_EXTENTS = 4 * 1024 * 1024,
+        DEVS = 4,
+        LOOKUPS = 1024 * 1024,
+        RANGE_LOOKUPS = 64 * 1024,
+        RANGE_SECTORS = 2048,
+        DROP_STEP = 64
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static uint64_t seed_ = 88172645463325252ULL;
+
+static uint64_t next_random()
+{
+        seed_ ^= seed_ << 13;
+        seed_ ^= seed_ >> 7;
+        seed_ ^= seed_ << 17;
+        return seed_;
+}
+
+static void count_extent(void *context, struct extent_mapping *m)
+{
+        (*((uint64_t *) context)) += m->end - m->begin;
+}
+
+static void report(const char *what, uint64_t ops, uint64_t ns, const char *extra)
+{
+        printf("%-16s %12llu %12.0f %10.1f  %s\n", what, (unsigned long long) ops,
+               ops / (ns / 1e9), (double) ns / ops, extra);
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--extents <count>]\n", prog);
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        uint64_t i, start, visited, sectors, txn, extents = DEFAULT_EXTENTS;
+        uint64_t space;
+        char extra[128];
+        struct extent_index *idx;
+        struct extent_mapping m;
+        struct rusage usage_;
+
+        if (argc == 3 && !strcmp(argv[1], "--extents"))
+                extents = strtoull(argv[2], NULL, 10);
+        else if (argc != 1)
+                usage(argv[0]);
+
+        if (!extents)
+                usage(argv[0]);
+
+        idx = extent_index_create();
+        if (!idx) {
+                fprintf(stderr, "couldn't create index\n");
+                return 1;
+        }
+
+        /* enough room that most writes land on their own */
+        space = extents * 64 / DEVS;
+
+        printf("%-16s %12s %12s %10s\n", "", "ops", "ops/s", "ns/op");
+
+        start = now_ns();
+        for (txn = 1; txn <= extents; txn++) {
+                m.dev = next_random() % DEVS;
+                m.begin = (next_random() % space) & ~7ULL;
+                m.end = m.begin + ((next_random() % 4) ? 8 : 128);
+                m.txn = txn;
+                m.io = 0;
+                m.origin = m.begin;
+                if (!extent_index_insert(idx, &m)) {
+                        fprintf(stderr, "out of memory after %llu extents\n",
+                                (unsigned long long) txn);
+                        return 1;
+                }
+        }
+        getrusage(RUSAGE_SELF, &usage_);
+        snprintf(extra, sizeof(extra), "%llu extents, %llu sectors superseded, %ld MB rss",
+                 (unsigned long long) extent_index_count(idx),
+                 (unsigned long long) extent_index_superseded(idx), usage_.ru_maxrss / 1024);
+        report("insert", extents, now_ns() - start, extra);
+
+        visited = sectors = 0;
+        start = now_ns();
+        for (i = 0; i < LOOKUPS; i++) {
+                m.begin = (next_random() % space) & ~7ULL;
+                visited += extent_index_lookup(idx, next_random() % DEVS, m.begin, m.begin + 8,
+                                               count_extent, &sectors);
+        }
+        snprintf(extra, sizeof(extra), "%.1f%% of sectors found",
+                 100.0 * sectors / (LOOKUPS * 8.0));
+        report("lookup 4k", LOOKUPS, now_ns() - start, extra);
+
+        visited = sectors = 0;
+        start = now_ns();
+        for (i = 0; i < RANGE_LOOKUPS; i++) {
+                m.begin = next_random() % space;
+                visited += extent_index_lookup(idx, next_random() % DEVS, m.begin,
+                                               m.begin + RANGE_SECTORS, count_extent, &sectors);
+        }
+        snprintf(extra, sizeof(extra), "%.1f extents per lookup", (double) visited / RANGE_LOOKUPS);
+        report("lookup 1m", RANGE_LOOKUPS, now_ns() - start, extra);
+
+        start = now_ns();
+        for (txn = DROP_STEP; txn < extents + DROP_STEP; txn += DROP_STEP)
+                extent_index_drop(idx, txn);
+        snprintf(extra, sizeof(extra), "%llu extents left", (unsigned long long) extent_index_count(idx));
+        report("drop", extents, now_ns() - start, extra);
+
+        extent_index_destroy(idx);
+        return 0;
+}
@@ -0,0 +1,311 @@
+#include "journal/journal.h"
+#include "log/log.h"
+#include "stats/histogram.h"
+#include "utility/crc32c.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Measures group commit: commits per second, and what each one costs,
+ * as the number of clients committing at once goes up.  Each client is
+ * a thread that writes a small transaction and waits for it to be
+ * durable before starting the next, like a database doing synchronous
+ * writes.  With one client every commit waits for its own sync; with
+ * more, commits that arrive during a sync share the next one.
+ *
+ * Point --dir at the disk you care about, /tmp is often tmpfs where a
+ * sync costs nothing.  --mode picks direct or buffered segment writes,
+ * by default both are run so they can be compared on the same disk.
+ * Each --lane adds a directory, on another disk, for the journal to be
+ * striped across.
+ */
+
+enum {
+        DEFAULT_IO_SIZE = 4096,
+        DEFAULT_IOS = 1,
+        DEFAULT_MAX_CLIENTS = 64,
+        DEFAULT_SECONDS = 2,
+        MAX_LANES = 16
+};
+
+struct bench {
+        struct journal *j;
+        struct journal_device *dev;
+        size_t io_size;
+        unsigned ios;
+        uint64_t deadline;
+};
+
+struct client {
+        pthread_t thread;
+        struct bench *b;
+        unsigned index;
+        sem_t durable;
+
+        uint64_t commits;
+        int failed;
+        struct histogram latency;
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void wake(void *context)
+{
+        sem_post(context);
+}
+
+static void *client_loop(void *context)
+{
+        unsigned i;
+        uint64_t id, start, sector = 0;
+        struct client *c = context;
+        struct bench *b = c->b;
+        unsigned char *data = malloc(b->io_size);
+        struct thunk t = { wake, &c->durable };
+        struct journal_io io;
+
+        if (!data) {
+                c->failed = 1;
+                return NULL;
+        }
+        memset(data, c->index, b->io_size);
+
+        io.dev = b->dev;
+        io.codec = 0;
+        io.len = b->io_size;
+        io.data = data;
+
+        while ((start = now_ns()) < b->deadline) {
+                struct journal_transaction *txn = journal_begin(b->j);
+                if (!txn)
+                        break;
+
+                for (i = 0; i < b->ios; i++) {
+                        io.start_sector = ((uint64_t) c->index << 32) + sector;
+                        io.end_sector = io.start_sector + (b->io_size >> JOURNAL_SECTOR_SHIFT);
+                        sector = io.end_sector - ((uint64_t) c->index << 32);
+                        if (!journal_record_io(txn, &io)) {
+                                journal_rollback(txn);
+                                c->failed = 1;
+                                goto out;
+                        }
+                }
+
+                if (!journal_commit(txn, &t, &id)) {
+                        c->failed = 1;
+                        break;
+                }
+
+                sem_wait(&c->durable);
+                histogram_record(&c->latency, now_ns() - start);
+                c->commits++;
+        }
+
+out:
+        free(data);
+        return NULL;
+}
+
+static void remove_journal(const char *dir)
+{
+        DIR *d;
+        struct dirent *de;
+        char path[PATH_MAX];
+
+        d = opendir(dir);
+        if (!d)
+                return;
+
+        while ((de = readdir(d))) {
+                if (!strncmp(de->d_name, "segment.", 8) || !strncmp(de->d_name, "checkpoint", 10) ||
+                    !strncmp(de->d_name, "index.", 6)) {
+                        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+                        unlink(path);
+                }
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+static void remove_lanes(const char **lanes, unsigned nr_lanes)
+{
+        unsigned i;
+
+        for (i = 0; i < nr_lanes; i++)
+                remove_journal(lanes[i]);
+}
+
+static int run(const char *dir, const char **lanes, unsigned nr_lanes, enum journal_mode mode,
+               unsigned nr_clients, size_t io_size, unsigned ios, unsigned seconds)
+{
+        unsigned i;
+        int r = 1;
+        uint64_t commits = 0, start;
+        double elapsed;
+        struct bench b;
+        struct client *clients;
+        struct journal_stats stats;
+        struct histogram *latency;
+        struct journal_options opts;
+
+        journal_options_init(&opts);
+        opts.mode = mode;
+        opts.nr_lanes = nr_lanes;
+        opts.lanes = lanes;
+
+        remove_journal(dir);
+        remove_lanes(lanes, nr_lanes);
+        b.j = journal_create(dir, &opts);
+        if (!b.j)
+                return 0;
+
+        b.dev = journal_register_device(b.j, "bench");
+        b.io_size = io_size;
+        b.ios = ios;
+
+        clients = calloc(nr_clients, sizeof(*clients));
+        latency = malloc(sizeof(*latency));
+        if (!b.dev || !clients || !latency) {
+                journal_destroy(b.j);
+                free(clients);
+                free(latency);
+                return 0;
+        }
+
+        histogram_init(latency);
+        start = now_ns();
+        b.deadline = start + (uint64_t) seconds * 1000000000ULL;
+        for (i = 0; i < nr_clients; i++) {
+                struct client *c = clients + i;
+
+                c->b = &b;
+                c->index = i;
+                sem_init(&c->durable, 0, 0);
+                histogram_init(&c->latency);
+                if (pthread_create(&c->thread, NULL, client_loop, c)) {
+                        nr_clients = i;
+                        r = 0;
+                        break;
+                }
+        }
+
+        for (i = 0; i < nr_clients; i++) {
+                struct client *c = clients + i;
+
+                pthread_join(c->thread, NULL);
+                sem_destroy(&c->durable);
+                if (c->failed)
+                        r = 0;
+                commits += c->commits;
+                histogram_merge(latency, &c->latency);
+        }
+        elapsed = (now_ns() - start) / 1e9;
+
+        journal_get_stats(b.j, &stats);
+        journal_destroy(b.j);
+        remove_journal(dir);
+        remove_lanes(lanes, nr_lanes);
+
+        if (r)
+                printf("%7u %12.0f %10.1f %10.0f %12.1f %10.1f %10.1f %10.1f\n",
+                       nr_clients, commits / elapsed,
+                       commits * ios * io_size / elapsed / (1024.0 * 1024.0),
+                       stats.syncs / elapsed,
+                       stats.syncs ? (double) stats.commits / stats.syncs : 0.0,
+                       histogram_percentile(latency, 50) / 1000.0,
+                       histogram_percentile(latency, 99) / 1000.0,
+                       latency->max / 1000.0);
+
+        free(latency);
+        free(clients);
+        return r;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--dir <path>] [--lane <path>]... [--mode direct|buffered|both] "
+                "[--clients <max>] [--io-size <bytes>] [--ios <per commit>] [--seconds <per run>]\n",
+                prog);
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        int i;
+        enum journal_mode mode, first = JOURNAL_DIRECT, last = JOURNAL_BUFFERED;
+        unsigned n, max_clients = DEFAULT_MAX_CLIENTS, ios = DEFAULT_IOS, seconds = DEFAULT_SECONDS;
+        unsigned nr_lanes = 0;
+        size_t io_size = DEFAULT_IO_SIZE;
+        const char *dir = "journal_b.journal", *lanes[MAX_LANES];
+
+        for (i = 1; i < argc; i++) {
+                if (i + 1 == argc)
+                        usage(argv[0]);
+
+                if (!strcmp(argv[i], "--dir"))
+                        dir = argv[++i];
+                else if (!strcmp(argv[i], "--lane")) {
+                        if (nr_lanes == MAX_LANES)
+                                usage(argv[0]);
+                        lanes[nr_lanes++] = argv[++i];
+
+                } else if (!strcmp(argv[i], "--mode")) {
+                        i++;
+                        if (!strcmp(argv[i], "direct"))
+                                first = last = JOURNAL_DIRECT;
+                        else if (!strcmp(argv[i], "buffered"))
+                                first = last = JOURNAL_BUFFERED;
+                        else if (strcmp(argv[i], "both"))
+                                usage(argv[0]);
+
+                } else if (!strcmp(argv[i], "--clients"))
+                        max_clients = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--io-size"))
+                        io_size = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--ios"))
+                        ios = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--seconds"))
+                        seconds = strtoul(argv[++i], NULL, 10);
+                else
+                        usage(argv[0]);
+        }
+
+        if (!max_clients || !ios || !seconds || !io_size ||
+            io_size % (1 << JOURNAL_SECTOR_SHIFT))
+                usage(argv[0]);
+
+        /* the journal logs recovery and errors */
+        log_init(".", INFO, ERROR);
+
+        printf("crc32c using %s, %u lanes\n\n", crc32c_hardware() ? "cpu instructions" : "tables",
+               nr_lanes + 1);
+
+        for (mode = first; mode <= last; mode++) {
+                printf("%s%s\n", (mode == first) ? "" : "\n", journal_mode_name(mode));
+                printf("%7s %12s %10s %10s %12s %10s %10s %10s\n", "clients", "commits/s", "MB/s",
+                       "syncs/s", "commits/sync", "p50 us", "p99 us", "max us");
+
+                for (n = 1; n <= max_clients; n *= 2)
+                        if (!run(dir, lanes, nr_lanes, mode, n, io_size, ios, seconds)) {
+                                fprintf(stderr, "benchmark failed with %u clients, see log.log\n", n);
+                                log_exit();
+                                return 1;
+                        }
+        }
+
+        log_exit();
+        return 0;
+}
@@ -0,0 +1,280 @@
+#include "journal/journal.h"
+#include "log/log.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Measures how long reopening a journal takes as it grows, with and
+ * without checkpoints.  For each size a child process fills a fresh
+ * journal, checkpointing as the replicator would, and then exits
+ * without closing it, as if it had crashed.  The journal is then opened
+ * twice: once with checkpoints turned off, so every segment is read,
+ * and once loading the checkpoint and reading only what came after it.
+ *
+ * The full scan goes first, so both opens find the segments equally
+ * warm in the page cache.  Then the whole journal is replayed, as it
+ * would be after a long outage, to see how fast the backlog can be
+ * read.  Point --dir at the disk you care about.
+ */
+
+enum {
+        DEFAULT_IO_SIZE = 4096,
+        DEFAULT_IOS = 8,
+        DEFAULT_MIN_MB = 16,
+        DEFAULT_MAX_MB = 1024,
+        DEFAULT_CHECKPOINT_MB = 64
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void wake(void *context)
+{
+        sem_post(context);
+}
+
+static void remove_journal(const char *dir)
+{
+        DIR *d;
+        struct dirent *de;
+        char path[PATH_MAX];
+
+        d = opendir(dir);
+        if (!d)
+                return;
+
+        while ((de = readdir(d))) {
+                if (!strncmp(de->d_name, "segment.", 8) || !strncmp(de->d_name, "checkpoint", 10) ||
+                    !strncmp(de->d_name, "index.", 6)) {
+                        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+                        unlink(path);
+                }
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+/*
+ * Runs in the child.  Transactions are committed without waiting, only
+ * the last is waited for, so everything is durable when it exits.
+ */
+static int fill(const char *dir, uint64_t bytes, size_t io_size, uint64_t checkpoint_interval)
+{
+        unsigned i;
+        uint64_t id, sector = 0, written = 0;
+        unsigned char *data = malloc(io_size);
+        struct journal *j;
+        struct journal_device *dev;
+        struct journal_options opts;
+        struct journal_io io;
+        sem_t durable;
+        struct thunk t = { wake, &durable };
+
+        journal_options_init(&opts);
+        opts.checkpoint_interval = checkpoint_interval;
+
+        j = journal_create(dir, &opts);
+        if (!j || !data)
+                return 0;
+
+        dev = journal_register_device(j, "bench");
+        if (!dev)
+                return 0;
+
+        memset(data, 0xa5, io_size);
+        io.dev = dev;
+        io.codec = 0;
+        io.len = io_size;
+        io.data = data;
+
+        sem_init(&durable, 0, 0);
+        while (written < bytes) {
+                struct journal_transaction *txn = journal_begin(j);
+                if (!txn)
+                        return 0;
+
+                for (i = 0; i < DEFAULT_IOS; i++) {
+                        /* wraps round 1G of sectors, so some get overwritten */
+                        io.start_sector = sector;
+                        io.end_sector = sector + (io_size >> JOURNAL_SECTOR_SHIFT);
+                        sector = (io.end_sector >= (1 << 21)) ? 0 : io.end_sector;
+                        if (!journal_record_io(txn, &io)) {
+                                journal_rollback(txn);
+                                return 0;
+                        }
+                }
+                written += DEFAULT_IOS * io_size;
+
+                if (!journal_commit(txn, (written < bytes) ? NULL : &t, &id))
+                        return 0;
+        }
+        sem_wait(&durable);
+
+        return !journal_failed(j);
+}
+
+static int crash_after_filling(const char *dir, uint64_t bytes, size_t io_size,
+                               uint64_t checkpoint_interval)
+{
+        int status;
+        pid_t pid = fork();
+
+        if (pid < 0)
+                return 0;
+
+        if (!pid)
+                _exit(fill(dir, bytes, io_size, checkpoint_interval) ? 0 : 1);
+
+        return waitpid(pid, &status, 0) == pid && WIFEXITED(status) && !WEXITSTATUS(status);
+}
+
+struct replay_bytes {
+        uint64_t bytes;
+        unsigned char sum;
+};
+
+static void replay_begin(void *context, uint64_t id)
+{
+}
+
+/* touches the data, as sending it on would */
+static void replay_io(void *context, struct journal_io *io)
+{
+        uint32_t i;
+        struct replay_bytes *rb = context;
+        unsigned char *data = io->data;
+
+        for (i = 0; i < io->len; i += 512)
+                rb->sum += data[i];
+        rb->bytes += (io->end_sector - io->start_sector) << JOURNAL_SECTOR_SHIFT;
+}
+
+static void replay_commit(void *context)
+{
+}
+
+static int time_replay(struct journal *j, uint64_t *ns, uint64_t *bytes)
+{
+        unsigned i, count = journal_transaction_count(j);
+        uint64_t start = now_ns();
+        struct replay_bytes rb = { 0, 0 };
+        struct journal_replayer r = { &rb, replay_begin, replay_io, replay_commit };
+
+        for (i = 0; i < count; i++)
+                if (!journal_transaction_replay_front(j, i, &r))
+                        return 0;
+
+        *ns = now_ns() - start;
+        *bytes = rb.bytes;
+        return 1;
+}
+
+/* |replay_ns| may be NULL if there's no need to replay */
+static int time_open(const char *dir, uint64_t checkpoint_interval, uint64_t *ns, unsigned *count,
+                     uint64_t *replay_ns, uint64_t *replay_bytes)
+{
+        uint64_t start;
+        struct journal *j;
+        struct journal_options opts;
+
+        journal_options_init(&opts);
+        opts.checkpoint_interval = checkpoint_interval;
+
+        start = now_ns();
+        j = journal_create(dir, &opts);
+        *ns = now_ns() - start;
+        if (!j)
+                return 0;
+
+        *count = journal_transaction_count(j);
+        if (replay_ns && !time_replay(j, replay_ns, replay_bytes)) {
+                journal_destroy(j);
+                return 0;
+        }
+
+        journal_destroy(j);
+        return 1;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--dir <path>] [--min-mb <size>] [--max-mb <size>] "
+                "[--io-size <bytes>] [--checkpoint-mb <interval>]\n", prog);
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        int i;
+        unsigned full_count, cp_count;
+        uint64_t mb, full_ns, cp_ns, replay_ns, replay_bytes;
+        uint64_t min_mb = DEFAULT_MIN_MB, max_mb = DEFAULT_MAX_MB, checkpoint_mb = DEFAULT_CHECKPOINT_MB;
+        size_t io_size = DEFAULT_IO_SIZE;
+        const char *dir = "recovery_b.journal";
+
+        for (i = 1; i < argc; i++) {
+                if (i + 1 == argc)
+                        usage(argv[0]);
+
+                if (!strcmp(argv[i], "--dir"))
+                        dir = argv[++i];
+                else if (!strcmp(argv[i], "--min-mb"))
+                        min_mb = strtoull(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--max-mb"))
+                        max_mb = strtoull(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--io-size"))
+                        io_size = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--checkpoint-mb"))
+                        checkpoint_mb = strtoull(argv[++i], NULL, 10);
+                else
+                        usage(argv[0]);
+        }
+
+        if (!min_mb || min_mb > max_mb || !checkpoint_mb || !io_size ||
+            io_size % (1 << JOURNAL_SECTOR_SHIFT))
+                usage(argv[0]);
+
+        /* the journal logs recovery and errors */
+        log_init(".", INFO, ERROR);
+
+        printf("checkpoint every %llu MB\n\n", (unsigned long long) checkpoint_mb);
+        printf("%8s %12s %14s %14s %10s %12s\n", "MB", "transactions", "full scan ms",
+               "checkpoint ms", "speedup", "replay MB/s");
+
+        for (mb = min_mb; mb <= max_mb; mb *= 2) {
+                remove_journal(dir);
+                if (!crash_after_filling(dir, mb << 20, io_size, checkpoint_mb << 20) ||
+                    !time_open(dir, 0, &full_ns, &full_count, NULL, NULL) ||
+                    !time_open(dir, checkpoint_mb << 20, &cp_ns, &cp_count,
+                               &replay_ns, &replay_bytes) ||
+                    full_count != cp_count) {
+                        fprintf(stderr, "benchmark failed at %llu MB, see log.log\n",
+                                (unsigned long long) mb);
+                        remove_journal(dir);
+                        log_exit();
+                        return 1;
+                }
+
+                printf("%8llu %12u %14.1f %14.1f %9.1fx %12.1f\n", (unsigned long long) mb,
+                       full_count, full_ns / 1e6, cp_ns / 1e6,
+                       cp_ns ? (double) full_ns / cp_ns : 0.0,
+                       replay_bytes / (replay_ns / 1e9) / (1024.0 * 1024.0));
+                fflush(stdout);
+        }
+
+        remove_journal(dir);
+        log_exit();
+        return 0;
+}
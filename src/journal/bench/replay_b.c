@@ -0,0 +1,261 @@
+#include "journal/journal.h"
+#include "log/log.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Compares replaying a journal that covers many devices one transaction
+ * at a time against replaying the devices in parallel.  Each io
+ * replayed waits --latency-us, standing in for the write to the
+ * destination volume, which is what replay spends its time on.  Every
+ * --multi'th transaction touches every device, and the rest one each.
+ */
+
+enum {
+        DEFAULT_DEVICES = 32,
+        DEFAULT_TRANSACTIONS = 4096,
+        DEFAULT_LATENCY_US = 100,
+        DEFAULT_MULTI = 64,
+        IO_SIZE = 4096
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void wake(void *context)
+{
+        sem_post(context);
+}
+
+static void remove_journal(const char *dir)
+{
+        DIR *d;
+        struct dirent *de;
+        char path[PATH_MAX];
+
+        d = opendir(dir);
+        if (!d)
+                return;
+
+        while ((de = readdir(d))) {
+                if (!strncmp(de->d_name, "segment.", 8) || !strncmp(de->d_name, "checkpoint", 10) ||
+                    !strncmp(de->d_name, "index.", 6)) {
+                        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+                        unlink(path);
+                }
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+static int fill(struct journal *j, unsigned nr_devices, unsigned transactions, unsigned multi)
+{
+        unsigned i, d;
+        uint64_t id;
+        char name[32];
+        unsigned char data[IO_SIZE];
+        struct journal_device **devs = calloc(nr_devices, sizeof(*devs));
+        struct journal_transaction *txn;
+        struct journal_io io;
+        sem_t durable;
+        struct thunk t = { wake, &durable };
+
+        if (!devs)
+                return 0;
+
+        for (d = 0; d < nr_devices; d++) {
+                snprintf(name, sizeof(name), "volume%u", d);
+                devs[d] = journal_register_device(j, name);
+                if (!devs[d]) {
+                        free(devs);
+                        return 0;
+                }
+        }
+
+        memset(data, 0x5a, sizeof(data));
+        io.codec = 0;
+        io.len = IO_SIZE;
+        io.data = data;
+
+        sem_init(&durable, 0, 0);
+        for (i = 0; i < transactions; i++) {
+                txn = journal_begin(j);
+                if (!txn)
+                        break;
+
+                /* each transaction writes fresh sectors, so nothing's coalesced */
+                io.start_sector = (uint64_t) i * (IO_SIZE >> JOURNAL_SECTOR_SHIFT);
+                io.end_sector = io.start_sector + (IO_SIZE >> JOURNAL_SECTOR_SHIFT);
+                for (d = 0; d < nr_devices; d++) {
+                        if ((i + 1) % multi && d != i % nr_devices)
+                                continue;
+
+                        io.dev = devs[d];
+                        if (!journal_record_io(txn, &io)) {
+                                journal_rollback(txn);
+                                goto out;
+                        }
+                }
+
+                if (!journal_commit(txn, (i + 1 == transactions) ? &t : NULL, &id))
+                        break;
+        }
+
+        if (i == transactions)
+                sem_wait(&durable);
+out:
+        sem_destroy(&durable);
+        free(devs);
+        return i == transactions && !journal_failed(j);
+}
+
+struct slow_device {
+        struct journal_replayer replayer;
+        unsigned latency_us;
+        uint64_t bytes;
+};
+
+static void slow_begin(void *context, uint64_t id)
+{
+}
+
+static void slow_io(void *context, struct journal_io *io)
+{
+        struct slow_device *sd = context;
+
+        usleep(sd->latency_us);
+        sd->bytes += (io->end_sector - io->start_sector) << JOURNAL_SECTOR_SHIFT;
+}
+
+static void slow_commit(void *context)
+{
+}
+
+static void init_slow(struct slow_device *sd, unsigned latency_us)
+{
+        sd->replayer.context = sd;
+        sd->replayer.begin = slow_begin;
+        sd->replayer.io = slow_io;
+        sd->replayer.commit = slow_commit;
+        sd->latency_us = latency_us;
+        sd->bytes = 0;
+}
+
+/* |context| is an array of slow_devices, one per volume */
+static struct journal_replayer *slow_device(void *context, struct journal_device *dev)
+{
+        struct slow_device *devs = context;
+        unsigned index = strtoul(journal_device_name(dev) + 6, NULL, 10);
+
+        return &devs[index].replayer;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--dir <path>] [--devices <count>] [--transactions <count>] "
+                "[--latency-us <per io>] [--multi <every n>]\n", prog);
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        int i;
+        unsigned n, count;
+        unsigned nr_devices = DEFAULT_DEVICES, transactions = DEFAULT_TRANSACTIONS;
+        unsigned latency_us = DEFAULT_LATENCY_US, multi = DEFAULT_MULTI;
+        uint64_t start, serial_ns, parallel_ns, bytes;
+        const char *dir = "replay_b.journal";
+        struct journal *j = NULL;
+        struct slow_device serial, *devs = NULL;
+        struct journal_parallel_replayer target = { NULL, 0, 1, slow_device };
+
+        for (i = 1; i < argc; i++) {
+                if (i + 1 == argc)
+                        usage(argv[0]);
+
+                if (!strcmp(argv[i], "--dir"))
+                        dir = argv[++i];
+                else if (!strcmp(argv[i], "--devices"))
+                        nr_devices = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--transactions"))
+                        transactions = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--latency-us"))
+                        latency_us = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--multi"))
+                        multi = strtoul(argv[++i], NULL, 10);
+                else
+                        usage(argv[0]);
+        }
+
+        if (!nr_devices || !transactions || !multi)
+                usage(argv[0]);
+
+        /* the journal logs recovery and errors */
+        log_init(".", INFO, ERROR);
+
+        remove_journal(dir);
+        devs = calloc(nr_devices, sizeof(*devs));
+        j = journal_create(dir, NULL);
+        if (!devs || !j || !fill(j, nr_devices, transactions, multi)) {
+                fprintf(stderr, "couldn't fill the journal, see log.log\n");
+                goto bad;
+        }
+
+        init_slow(&serial, latency_us);
+        start = now_ns();
+        count = journal_transaction_count(j);
+        for (n = 0; n < count; n++)
+                if (!journal_transaction_replay_front(j, n, &serial.replayer))
+                        goto bad;
+        serial_ns = now_ns() - start;
+
+        for (n = 0; n < nr_devices; n++)
+                init_slow(devs + n, latency_us);
+        target.context = devs;
+
+        start = now_ns();
+        if (journal_replay_parallel(j, count, &target) != count)
+                goto bad;
+        parallel_ns = now_ns() - start;
+
+        for (n = 0, bytes = 0; n < nr_devices; n++)
+                bytes += devs[n].bytes;
+        if (bytes != serial.bytes) {
+                fprintf(stderr, "parallel replay replayed %llu bytes, not %llu\n",
+                        (unsigned long long) bytes, (unsigned long long) serial.bytes);
+                goto bad;
+        }
+
+        printf("%u devices, %u transactions, one in %u on every device, %u us per io\n\n",
+               nr_devices, count, multi, latency_us);
+        printf("%-10s %12s %10s\n", "replay", "ms", "MB/s");
+        printf("%-10s %12.1f %10.1f\n", "serial", serial_ns / 1e6,
+               bytes / (serial_ns / 1e9) / (1024.0 * 1024.0));
+        printf("%-10s %12.1f %10.1f\n", "parallel", parallel_ns / 1e6,
+               bytes / (parallel_ns / 1e9) / (1024.0 * 1024.0));
+
+        journal_destroy(j);
+        remove_journal(dir);
+        free(devs);
+        log_exit();
+        return 0;
+
+bad:
+        if (j)
+                journal_destroy(j);
+        remove_journal(dir);
+        free(devs);
+        log_exit();
+        return 1;
+}
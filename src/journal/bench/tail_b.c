@@ -0,0 +1,361 @@
+#include "journal/journal.h"
+#include "log/log.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Measures tail streaming: whether a subscriber shipping transactions
+ * keeps up with clients committing them.  Clients commit as in
+ * journal_b, while a shipper thread subscribes from the start and
+ * writes everything it's handed to --sink, standing in for the socket
+ * to the other site.  Each run is repeated with the tail cache turned
+ * off, so every transaction is read back from its segment.
+ */
+
+enum {
+        DEFAULT_IO_SIZE = 4096,
+        DEFAULT_CLIENTS = 8,
+        DEFAULT_SECONDS = 2,
+        DEFAULT_TAIL_CACHE_MB = 64,
+        SHIP_BATCH = 64,
+        WAIT_MS = 100
+};
+
+struct bench {
+        struct journal *j;
+        struct journal_device *dev;
+        size_t io_size;
+        uint64_t deadline;
+        volatile int committing;
+};
+
+struct client {
+        pthread_t thread;
+        struct bench *b;
+        unsigned index;
+        sem_t durable;
+        uint64_t commits;
+        int failed;
+};
+
+struct shipper {
+        pthread_t thread;
+        struct bench *b;
+        int sink;
+        uint64_t shipped;
+        uint64_t bytes;
+        uint64_t max_lag;
+        uint64_t last_ns;               /* when it last shipped anything */
+        int failed;
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void wake(void *context)
+{
+        sem_post(context);
+}
+
+static void *client_loop(void *context)
+{
+        uint64_t id, sector = 0;
+        struct client *c = context;
+        struct bench *b = c->b;
+        unsigned char *data = malloc(b->io_size);
+        struct thunk t = { wake, &c->durable };
+        struct journal_io io;
+
+        if (!data) {
+                c->failed = 1;
+                return NULL;
+        }
+        memset(data, c->index, b->io_size);
+
+        io.dev = b->dev;
+        io.codec = 0;
+        io.len = b->io_size;
+        io.data = data;
+
+        while (now_ns() < b->deadline) {
+                struct journal_transaction *txn = journal_begin(b->j);
+                if (!txn)
+                        break;
+
+                io.start_sector = ((uint64_t) c->index << 32) + sector;
+                io.end_sector = io.start_sector + (b->io_size >> JOURNAL_SECTOR_SHIFT);
+                sector = io.end_sector - ((uint64_t) c->index << 32);
+                if (!journal_record_io(txn, &io)) {
+                        journal_rollback(txn);
+                        c->failed = 1;
+                        break;
+                }
+
+                if (!journal_commit(txn, &t, &id)) {
+                        c->failed = 1;
+                        break;
+                }
+
+                sem_wait(&c->durable);
+                c->commits++;
+        }
+
+        free(data);
+        return NULL;
+}
+
+static void ship_begin(void *context, uint64_t id)
+{
+}
+
+static void ship_io(void *context, struct journal_io *io)
+{
+        struct shipper *s = context;
+
+        if (io->len && write(s->sink, io->data, io->len) != (ssize_t) io->len)
+                s->failed = 1;
+        s->bytes += io->len;
+}
+
+static void ship_commit(void *context)
+{
+        ((struct shipper *) context)->shipped++;
+}
+
+static void *ship_loop(void *context)
+{
+        unsigned count;
+        uint64_t newest, lag;
+        struct shipper *s = context;
+        struct bench *b = s->b;
+        struct journal_replayer r = { s, ship_begin, ship_io, ship_commit };
+        struct journal_subscriber *sub = journal_subscribe(b->j, 1, NULL);
+
+        if (!sub) {
+                s->failed = 1;
+                return NULL;
+        }
+
+        for (;;) {
+                if (!journal_subscriber_ship(sub, SHIP_BATCH, &r)) {
+                        if (!b->committing)
+                                break;
+                        journal_subscriber_wait(sub, WAIT_MS);
+                        continue;
+                }
+                s->last_ns = now_ns();
+
+                /* how far behind the newest durable transaction */
+                count = journal_transaction_count(b->j);
+                if (count && journal_transaction_front(b->j, count - 1, &newest)) {
+                        lag = newest + 1 - journal_subscriber_position(sub);
+                        if (lag > s->max_lag)
+                                s->max_lag = lag;
+                }
+
+                /* once it's been shipped it can go */
+                journal_drop(b->j, journal_subscriber_position(sub) - 1);
+        }
+
+        journal_unsubscribe(sub);
+        return NULL;
+}
+
+static void remove_journal(const char *dir)
+{
+        DIR *d;
+        struct dirent *de;
+        char path[PATH_MAX];
+
+        d = opendir(dir);
+        if (!d)
+                return;
+
+        while ((de = readdir(d))) {
+                if (!strncmp(de->d_name, "segment.", 8) || !strncmp(de->d_name, "checkpoint", 10) ||
+                    !strncmp(de->d_name, "free.", 5) || !strncmp(de->d_name, "index.", 6)) {
+                        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+                        unlink(path);
+                }
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+static int run(const char *dir, const char *sink, enum journal_mode mode, unsigned nr_clients,
+               size_t io_size, unsigned seconds, uint64_t tail_cache)
+{
+        unsigned i;
+        int r = 1;
+        uint64_t commits = 0, start;
+        double elapsed, shipping;
+        struct bench b;
+        struct client *clients;
+        struct shipper s;
+        struct journal_stats stats;
+        struct journal_options opts;
+
+        journal_options_init(&opts);
+        opts.mode = mode;
+        opts.tail_cache = tail_cache;
+
+        memset(&s, 0, sizeof(s));
+        s.b = &b;
+        s.sink = open(sink, O_WRONLY);
+        if (s.sink < 0)
+                return 0;
+
+        remove_journal(dir);
+        b.j = journal_create(dir, &opts);
+        if (!b.j) {
+                close(s.sink);
+                return 0;
+        }
+
+        b.dev = journal_register_device(b.j, "bench");
+        b.io_size = io_size;
+        b.committing = 1;
+
+        clients = calloc(nr_clients, sizeof(*clients));
+        if (!b.dev || !clients) {
+                journal_destroy(b.j);
+                close(s.sink);
+                free(clients);
+                return 0;
+        }
+
+        start = now_ns();
+        b.deadline = start + (uint64_t) seconds * 1000000000ULL;
+        if (pthread_create(&s.thread, NULL, ship_loop, &s)) {
+                journal_destroy(b.j);
+                close(s.sink);
+                free(clients);
+                return 0;
+        }
+
+        for (i = 0; i < nr_clients; i++) {
+                struct client *c = clients + i;
+
+                c->b = &b;
+                c->index = i;
+                sem_init(&c->durable, 0, 0);
+                if (pthread_create(&c->thread, NULL, client_loop, c)) {
+                        nr_clients = i;
+                        r = 0;
+                        break;
+                }
+        }
+
+        for (i = 0; i < nr_clients; i++) {
+                struct client *c = clients + i;
+
+                pthread_join(c->thread, NULL);
+                sem_destroy(&c->durable);
+                if (c->failed)
+                        r = 0;
+                commits += c->commits;
+        }
+        elapsed = (now_ns() - start) / 1e9;
+
+        /* the shipper finishes off whatever it's behind by */
+        b.committing = 0;
+        pthread_join(s.thread, NULL);
+        shipping = (s.last_ns - start) / 1e9;
+        if (s.failed || s.shipped != commits)
+                r = 0;
+
+        journal_get_stats(b.j, &stats);
+        journal_destroy(b.j);
+        remove_journal(dir);
+        close(s.sink);
+
+        if (r)
+                printf("%-10s %12.0f %12.0f %10.1f %10llu %10.1f%%\n",
+                       tail_cache ? "cached" : "read back", commits / elapsed, s.shipped / shipping,
+                       s.bytes / shipping / (1024.0 * 1024.0), (unsigned long long) s.max_lag,
+                       stats.shipped ? 100.0 * stats.shipped_from_disk / stats.shipped : 0.0);
+
+        free(clients);
+        return r;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--dir <path>] [--sink <path>] [--mode direct|buffered] "
+                "[--clients <count>] [--io-size <bytes>] [--seconds <per run>] "
+                "[--tail-cache-mb <size>]\n", prog);
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        int i;
+        enum journal_mode mode = JOURNAL_DIRECT;
+        unsigned nr_clients = DEFAULT_CLIENTS, seconds = DEFAULT_SECONDS;
+        uint64_t tail_cache_mb = DEFAULT_TAIL_CACHE_MB;
+        size_t io_size = DEFAULT_IO_SIZE;
+        const char *dir = "tail_b.journal", *sink = "/dev/null";
+
+        for (i = 1; i < argc; i++) {
+                if (i + 1 == argc)
+                        usage(argv[0]);
+
+                if (!strcmp(argv[i], "--dir"))
+                        dir = argv[++i];
+                else if (!strcmp(argv[i], "--sink"))
+                        sink = argv[++i];
+                else if (!strcmp(argv[i], "--mode")) {
+                        i++;
+                        if (!strcmp(argv[i], "direct"))
+                                mode = JOURNAL_DIRECT;
+                        else if (!strcmp(argv[i], "buffered"))
+                                mode = JOURNAL_BUFFERED;
+                        else
+                                usage(argv[0]);
+
+                } else if (!strcmp(argv[i], "--clients"))
+                        nr_clients = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--io-size"))
+                        io_size = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--seconds"))
+                        seconds = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--tail-cache-mb"))
+                        tail_cache_mb = strtoull(argv[++i], NULL, 10);
+                else
+                        usage(argv[0]);
+        }
+
+        if (!nr_clients || !seconds || !tail_cache_mb || !io_size ||
+            io_size % (1 << JOURNAL_SECTOR_SHIFT))
+                usage(argv[0]);
+
+        /* the journal logs recovery and errors */
+        log_init(".", INFO, ERROR);
+
+        printf("%s, %u clients, %zu byte ios\n\n", journal_mode_name(mode), nr_clients, io_size);
+        printf("%-10s %12s %12s %10s %10s %11s\n", "tail", "commits/s", "shipped/s", "MB/s",
+               "max lag", "from disk");
+
+        if (!run(dir, sink, mode, nr_clients, io_size, seconds, tail_cache_mb << 20) ||
+            !run(dir, sink, mode, nr_clients, io_size, seconds, 0)) {
+                fprintf(stderr, "benchmark failed, see log.log\n");
+                log_exit();
+                return 1;
+        }
+
+        log_exit();
+        return 0;
+}
@@ -0,0 +1,569 @@
+#include "journal/journal.h"
+#include "log/log.h"
+#include "stats/histogram.h"
+
+#include <dirent.h>
+#include <limits.h>
+#include <pthread.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * A workload generator for the journal, in the spirit of fio.  Each
+ * client is a thread that keeps up to --depth transactions in flight,
+ * each of --ios ios to devices picked at random, of --io-size bytes,
+ * written sequentially through each device or at random sectors.
+ * Sizes may be given as a range, <min>-<max>, picked from uniformly.
+ * --clients takes a list, eg, 1,4,16, for a run at each.
+ *
+ * Latency is from journal_commit() to the notify that the transaction
+ * is durable.  Results go to stdout as a table, and with --output are
+ * appended to a CSV file, tagged with --label, for
+ * report-generators/journal_bench.rb to chart.
+ */
+
+enum {
+        DEFAULT_IO_SIZE = 4096,
+        DEFAULT_IOS = 1,
+        DEFAULT_DEVICES = 1,
+        DEFAULT_DEPTH = 1,
+        DEFAULT_SECONDS = 5,
+        DEVICE_SECTORS = 1 << 30,       /* 512G of address space */
+        MAX_LANES = 16,
+        MAX_RUNS = 32,
+        MAX_DEPTH = 1024
+};
+
+struct range {
+        unsigned min;
+        unsigned max;
+};
+
+struct workload {
+        const char *dir;
+        const char **lanes;
+        unsigned nr_lanes;
+        enum journal_mode mode;
+
+        unsigned devices;
+        unsigned depth;
+        struct range io_size;
+        struct range ios;
+        int random;
+        unsigned seconds;
+};
+
+struct bench {
+        struct workload *w;
+        struct journal *j;
+        struct journal_device **devs;
+        uint64_t deadline;
+};
+
+struct client;
+
+struct slot {
+        struct client *c;
+        uint64_t start;
+        int busy;
+};
+
+struct client {
+        pthread_t thread;
+        struct bench *b;
+        unsigned index;
+        unsigned seed;
+        uint64_t *next_sector;  /* per device, for sequential writes */
+
+        sem_t free_slots;
+        struct slot slots[MAX_DEPTH];
+
+        /* notifies come from the writer threads */
+        pthread_mutex_t lock;
+        struct histogram latency;
+
+        uint64_t commits;
+        uint64_t ios;
+        uint64_t bytes;
+        int failed;
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static unsigned pick(struct client *c, struct range *r)
+{
+        return r->min + ((r->max > r->min) ? rand_r(&c->seed) % (r->max - r->min + 1) : 0);
+}
+
+static void durable(void *context)
+{
+        struct slot *s = context;
+        struct client *c = s->c;
+        uint64_t latency = now_ns() - s->start;
+
+        pthread_mutex_lock(&c->lock);
+        histogram_record(&c->latency, latency);
+        s->busy = 0;
+        pthread_mutex_unlock(&c->lock);
+
+        sem_post(&c->free_slots);
+}
+
+static struct slot *get_slot(struct client *c)
+{
+        unsigned i;
+        struct slot *s = NULL;
+
+        sem_wait(&c->free_slots);
+        pthread_mutex_lock(&c->lock);
+        for (i = 0; i < c->b->w->depth; i++)
+                if (!c->slots[i].busy) {
+                        s = c->slots + i;
+                        s->busy = 1;
+                        break;
+                }
+        pthread_mutex_unlock(&c->lock);
+
+        return s;
+}
+
+static int record_ios(struct client *c, struct journal_transaction *txn, unsigned char *data)
+{
+        unsigned i, n = pick(c, &c->b->w->ios), d;
+        uint64_t sectors;
+        struct workload *w = c->b->w;
+        struct journal_io io;
+
+        io.codec = 0;
+        io.data = data;
+        for (i = 0; i < n; i++) {
+                d = rand_r(&c->seed) % w->devices;
+                sectors = pick(c, &w->io_size);
+                io.len = sectors << JOURNAL_SECTOR_SHIFT;
+
+                if (w->random)
+                        io.start_sector = ((uint64_t) rand_r(&c->seed) % (DEVICE_SECTORS / sectors)) * sectors;
+                else {
+                        io.start_sector = c->next_sector[d];
+                        c->next_sector[d] = (io.start_sector + 2 * sectors > DEVICE_SECTORS) ?
+                                0 : io.start_sector + sectors;
+                }
+
+                /* each client has its own part of each device */
+                io.dev = c->b->devs[d];
+                io.start_sector += (uint64_t) c->index * DEVICE_SECTORS;
+                io.end_sector = io.start_sector + sectors;
+                if (!journal_record_io(txn, &io))
+                        return 0;
+
+                c->ios++;
+                c->bytes += io.len;
+        }
+
+        return 1;
+}
+
+static void *client_loop(void *context)
+{
+        unsigned i;
+        uint64_t id;
+        struct client *c = context;
+        struct bench *b = c->b;
+        struct workload *w = b->w;
+        size_t len = (size_t) w->io_size.max << JOURNAL_SECTOR_SHIFT;
+        unsigned char *data = malloc(len);
+        struct journal_transaction *txn;
+        struct slot *s;
+        struct thunk t;
+
+        if (!data) {
+                c->failed = 1;
+                return NULL;
+        }
+
+        for (i = 0; i < len; i++)
+                data[i] = rand_r(&c->seed);
+
+        while (now_ns() < b->deadline) {
+                s = get_slot(c);
+                txn = journal_begin(b->j);
+                if (!s || !txn || !record_ios(c, txn, data)) {
+                        if (txn)
+                                journal_rollback(txn);
+                        c->failed = 1;
+                        break;
+                }
+
+                t.fn = durable;
+                t.context = s;
+                s->start = now_ns();
+                if (!journal_commit(txn, &t, &id)) {
+                        c->failed = 1;
+                        break;
+                }
+                c->commits++;
+        }
+
+        /* wait for everything in flight */
+        for (i = 0; i < w->depth; i++)
+                sem_wait(&c->free_slots);
+
+        free(data);
+        return NULL;
+}
+
+static void remove_journal(const char *dir)
+{
+        DIR *d;
+        struct dirent *de;
+        char path[PATH_MAX];
+
+        d = opendir(dir);
+        if (!d)
+                return;
+
+        while ((de = readdir(d))) {
+                if (!strncmp(de->d_name, "segment.", 8) || !strncmp(de->d_name, "checkpoint", 10) ||
+                    !strncmp(de->d_name, "free.", 5) || !strncmp(de->d_name, "index.", 6)) {
+                        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+                        unlink(path);
+                }
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+static void remove_lanes(struct workload *w)
+{
+        unsigned i;
+
+        for (i = 0; i < w->nr_lanes; i++)
+                remove_journal(w->lanes[i]);
+}
+
+struct result {
+        unsigned clients;
+        double seconds;
+        uint64_t commits;
+        uint64_t ios;
+        uint64_t bytes;
+        uint64_t syncs;
+        struct histogram latency;
+};
+
+static int init_client(struct client *c, struct bench *b, unsigned index)
+{
+        unsigned i;
+
+        c->b = b;
+        c->index = index;
+        c->seed = index * 7919 + 1;
+        c->next_sector = calloc(b->w->devices, sizeof(*c->next_sector));
+        if (!c->next_sector)
+                return 0;
+
+        for (i = 0; i < b->w->depth; i++)
+                c->slots[i].c = c;
+        sem_init(&c->free_slots, 0, b->w->depth);
+        pthread_mutex_init(&c->lock, NULL);
+        histogram_init(&c->latency);
+        return 1;
+}
+
+static void exit_client(struct client *c)
+{
+        pthread_mutex_destroy(&c->lock);
+        sem_destroy(&c->free_slots);
+        free(c->next_sector);
+}
+
+static int run(struct workload *w, unsigned nr_clients, struct result *res)
+{
+        unsigned i, started = 0;
+        int r = 1;
+        char name[32];
+        uint64_t start;
+        struct bench b;
+        struct client *clients = NULL;
+        struct journal_stats stats;
+        struct journal_options opts;
+
+        journal_options_init(&opts);
+        opts.mode = w->mode;
+        opts.nr_lanes = w->nr_lanes;
+        opts.lanes = w->lanes;
+
+        remove_journal(w->dir);
+        remove_lanes(w);
+        b.w = w;
+        b.j = journal_create(w->dir, &opts);
+        b.devs = calloc(w->devices, sizeof(*b.devs));
+        clients = calloc(nr_clients, sizeof(*clients));
+        if (!b.j || !b.devs || !clients) {
+                r = 0;
+                goto out;
+        }
+
+        for (i = 0; i < w->devices; i++) {
+                snprintf(name, sizeof(name), "volume%u", i);
+                b.devs[i] = journal_register_device(b.j, name);
+                if (!b.devs[i]) {
+                        r = 0;
+                        goto out;
+                }
+        }
+
+        start = now_ns();
+        b.deadline = start + (uint64_t) w->seconds * 1000000000ULL;
+        for (started = 0; started < nr_clients; started++) {
+                struct client *c = clients + started;
+
+                if (!init_client(c, &b, started))
+                        break;
+
+                if (pthread_create(&c->thread, NULL, client_loop, c)) {
+                        exit_client(c);
+                        break;
+                }
+        }
+        if (started < nr_clients)
+                r = 0;
+
+        memset(res, 0, sizeof(*res));
+        histogram_init(&res->latency);
+        for (i = 0; i < started; i++) {
+                struct client *c = clients + i;
+
+                pthread_join(c->thread, NULL);
+                if (c->failed)
+                        r = 0;
+                res->commits += c->commits;
+                res->ios += c->ios;
+                res->bytes += c->bytes;
+                histogram_merge(&res->latency, &c->latency);
+                exit_client(c);
+        }
+        res->clients = nr_clients;
+        res->seconds = (now_ns() - start) / 1e9;
+
+        journal_get_stats(b.j, &stats);
+        res->syncs = stats.syncs;
+        if (journal_failed(b.j))
+                r = 0;
+
+out:
+        if (b.j)
+                journal_destroy(b.j);
+        remove_journal(w->dir);
+        remove_lanes(w);
+        free(b.devs);
+        free(clients);
+        return r;
+}
+
+static double us(uint64_t ns)
+{
+        return ns / 1000.0;
+}
+
+static void print_header()
+{
+        printf("%7s %10s %10s %10s %10s %8s %9s %9s %9s %9s %9s\n", "clients", "commits/s",
+               "ios/s", "MB/s", "syncs/s", "per sync", "p50 us", "p90 us", "p99 us",
+               "p99.9 us", "max us");
+}
+
+static void print_result(struct result *r)
+{
+        printf("%7u %10.0f %10.0f %10.1f %10.0f %8.1f %9.1f %9.1f %9.1f %9.1f %9.1f\n",
+               r->clients, r->commits / r->seconds, r->ios / r->seconds,
+               r->bytes / r->seconds / (1024.0 * 1024.0), r->syncs / r->seconds,
+               r->syncs ? (double) r->commits / r->syncs : 0.0,
+               us(histogram_percentile(&r->latency, 50)),
+               us(histogram_percentile(&r->latency, 90)),
+               us(histogram_percentile(&r->latency, 99)),
+               us(histogram_percentile(&r->latency, 99.9)),
+               us(r->latency.max));
+}
+
+static const char *csv_header =
+        "label,mode,lanes,devices,depth,io_size_min,io_size_max,ios_min,ios_max,pattern,"
+        "clients,seconds,commits_per_sec,ios_per_sec,mb_per_sec,syncs_per_sec,"
+        "commits_per_sync,p50_us,p90_us,p99_us,p999_us,max_us\n";
+
+/* Appends a row, with a header if the file's new */
+static int write_csv(const char *path, const char *label, struct workload *w, struct result *r)
+{
+        FILE *f;
+        struct stat info;
+        int fresh = stat(path, &info) < 0 || !info.st_size;
+
+        f = fopen(path, "a");
+        if (!f)
+                return 0;
+
+        if (fresh)
+                fputs(csv_header, f);
+
+        fprintf(f, "%s,%s,%u,%u,%u,%u,%u,%u,%u,%s,%u,%.3f,%.1f,%.1f,%.2f,%.1f,%.2f,%.1f,%.1f,%.1f,%.1f,%.1f\n",
+                label, journal_mode_name(w->mode), w->nr_lanes + 1, w->devices, w->depth,
+                w->io_size.min << JOURNAL_SECTOR_SHIFT, w->io_size.max << JOURNAL_SECTOR_SHIFT, w->ios.min, w->ios.max,
+                w->random ? "random" : "sequential", r->clients, r->seconds,
+                r->commits / r->seconds, r->ios / r->seconds,
+                r->bytes / r->seconds / (1024.0 * 1024.0), r->syncs / r->seconds,
+                r->syncs ? (double) r->commits / r->syncs : 0.0,
+                us(histogram_percentile(&r->latency, 50)),
+                us(histogram_percentile(&r->latency, 90)),
+                us(histogram_percentile(&r->latency, 99)),
+                us(histogram_percentile(&r->latency, 99.9)),
+                us(r->latency.max));
+
+        return !fclose(f);
+}
+
+/* <n> or <min>-<max> */
+static int parse_range(const char *str, struct range *r)
+{
+        char *end;
+
+        r->min = r->max = strtoul(str, &end, 10);
+        if (*end == '-')
+                r->max = strtoul(end + 1, &end, 10);
+
+        return !*end && r->min && r->min <= r->max;
+}
+
+static int parse_list(const char *str, unsigned *values, unsigned *count)
+{
+        char *end;
+
+        for (*count = 0; *count < MAX_RUNS; str = end + 1) {
+                values[(*count)++] = strtoul(str, &end, 10);
+                if (!values[*count - 1] || (*end && *end != ','))
+                        return 0;
+                if (!*end)
+                        return 1;
+        }
+
+        return 0;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--dir <path>] [--lane <path>]... [--mode direct|buffered] "
+                "[--clients <n>[,<n>...]] [--depth <in flight per client>] [--devices <count>] "
+                "[--io-size <bytes>[-<bytes>]] [--ios <per commit>[-<per commit>]] "
+                "[--pattern sequential|random] [--seconds <per run>] "
+                "[--output <csv>] [--label <text>]\n", prog);
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        int i;
+        unsigned n, clients[MAX_RUNS] = { 1 }, nr_runs = 1;
+        const char *lanes[MAX_LANES], *output = NULL, *label = "journal";
+        struct result res;
+        struct workload w = {
+                "workload_b.journal", lanes, 0, JOURNAL_DIRECT, DEFAULT_DEVICES, DEFAULT_DEPTH,
+                { DEFAULT_IO_SIZE, DEFAULT_IO_SIZE }, { DEFAULT_IOS, DEFAULT_IOS }, 0, DEFAULT_SECONDS
+        };
+
+        for (i = 1; i < argc; i++) {
+                if (i + 1 == argc)
+                        usage(argv[0]);
+
+                if (!strcmp(argv[i], "--dir"))
+                        w.dir = argv[++i];
+                else if (!strcmp(argv[i], "--lane")) {
+                        if (w.nr_lanes == MAX_LANES)
+                                usage(argv[0]);
+                        lanes[w.nr_lanes++] = argv[++i];
+
+                } else if (!strcmp(argv[i], "--mode")) {
+                        i++;
+                        if (!strcmp(argv[i], "direct"))
+                                w.mode = JOURNAL_DIRECT;
+                        else if (!strcmp(argv[i], "buffered"))
+                                w.mode = JOURNAL_BUFFERED;
+                        else
+                                usage(argv[0]);
+
+                } else if (!strcmp(argv[i], "--pattern")) {
+                        i++;
+                        if (!strcmp(argv[i], "random"))
+                                w.random = 1;
+                        else if (strcmp(argv[i], "sequential"))
+                                usage(argv[0]);
+
+                } else if (!strcmp(argv[i], "--clients")) {
+                        if (!parse_list(argv[++i], clients, &nr_runs))
+                                usage(argv[0]);
+
+                } else if (!strcmp(argv[i], "--depth"))
+                        w.depth = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--devices"))
+                        w.devices = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--io-size")) {
+                        if (!parse_range(argv[++i], &w.io_size))
+                                usage(argv[0]);
+
+                } else if (!strcmp(argv[i], "--ios")) {
+                        if (!parse_range(argv[++i], &w.ios))
+                                usage(argv[0]);
+
+                } else if (!strcmp(argv[i], "--seconds"))
+                        w.seconds = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--output"))
+                        output = argv[++i];
+                else if (!strcmp(argv[i], "--label"))
+                        label = argv[++i];
+                else
+                        usage(argv[0]);
+        }
+
+        /* sizes are whole sectors, picked in steps of a sector */
+        w.io_size.min >>= JOURNAL_SECTOR_SHIFT;
+        w.io_size.max >>= JOURNAL_SECTOR_SHIFT;
+        if (!w.depth || w.depth > MAX_DEPTH || !w.devices || !w.seconds || !w.io_size.min ||
+            strchr(label, ','))
+                usage(argv[0]);
+
+        /* the journal logs recovery and errors */
+        log_init(".", INFO, ERROR);
+
+        printf("%s, %u lanes, %u devices, %u-%u ios of %u-%u bytes per commit, %s, depth %u\n\n",
+               journal_mode_name(w.mode), w.nr_lanes + 1, w.devices, w.ios.min, w.ios.max,
+               w.io_size.min << JOURNAL_SECTOR_SHIFT, w.io_size.max << JOURNAL_SECTOR_SHIFT,
+               w.random ? "random" : "sequential", w.depth);
+        print_header();
+
+        for (n = 0; n < nr_runs; n++) {
+                if (!run(&w, clients[n], &res)) {
+                        fprintf(stderr, "benchmark failed with %u clients, see log.log\n", clients[n]);
+                        log_exit();
+                        return 1;
+                }
+
+                print_result(&res);
+                fflush(stdout);
+                if (output && !write_csv(output, label, &w, &res)) {
+                        fprintf(stderr, "couldn't write %s\n", output);
+                        log_exit();
+                        return 1;
+                }
+        }
+
+        log_exit();
+        return 0;
+}
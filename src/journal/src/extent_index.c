@@ -0,0 +1,360 @@
+#include "extent_index.h"
+
+#include "datastruct/list.h"
+
+#include <string.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * A treap: a binary search tree on (dev, begin) that's also a heap on a
+ * random priority, which keeps it balanced in expectation.  Splitting
+ * and joining whole subtrees makes the range operations simple; a
+ * range is split out, dealt with, and the pieces joined back.
+ *
+ * Every extent is also on a fifo in insertion, and so transaction,
+ * order for extent_index_drop().  Pieces split off an extent go next to
+ * it, which keeps the fifo in order.
+ */
+
+enum {
+        CHUNK_EXTENTS = 1024
+};
+
+struct extent {
+        struct extent *left, *right;
+        uint32_t priority;
+        struct list fifo;
+        struct extent_mapping m;
+};
+
+struct chunk {
+        struct chunk *next;
+        struct extent extents[CHUNK_EXTENTS];
+};
+
+struct extent_index {
+        struct extent *root;
+        struct list fifo;
+
+        uint64_t count;
+        uint64_t superseded;
+        uint32_t seed;
+
+        struct chunk *chunks;
+        struct extent *free;    /* chained through |right| */
+};
+
+struct extent_index *extent_index_create()
+{
+        struct extent_index *idx = malloc(sizeof(*idx));
+
+        if (!idx)
+                return NULL;
+
+        memset(idx, 0, sizeof(*idx));
+        list_init(&idx->fifo);
+        idx->seed = 2463534242U;
+        return idx;
+}
+
+void extent_index_destroy(struct extent_index *idx)
+{
+        struct chunk *c, *next;
+
+        for (c = idx->chunks; c; c = next) {
+                next = c->next;
+                free(c);
+        }
+        free(idx);
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Extents come from chunks, a few million small mallocs would cost
+ * more than the tree operations.
+ */
+static int reserve(struct extent_index *idx, unsigned n)
+{
+        unsigned i;
+        struct chunk *c;
+        struct extent *e;
+
+        for (e = idx->free; e && n; e = e->right)
+                n--;
+
+        if (!n)
+                return 1;
+
+        c = malloc(sizeof(*c));
+        if (!c)
+                return 0;
+
+        c->next = idx->chunks;
+        idx->chunks = c;
+        for (i = 0; i < CHUNK_EXTENTS; i++) {
+                c->extents[i].right = idx->free;
+                idx->free = c->extents + i;
+        }
+
+        return 1;
+}
+
+/* xorshift */
+static uint32_t next_priority(struct extent_index *idx)
+{
+        uint32_t x = idx->seed;
+
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        return idx->seed = x;
+}
+
+/* Call reserve() first */
+static struct extent *alloc_extent(struct extent_index *idx, struct extent_mapping *m)
+{
+        struct extent *e = idx->free;
+
+        idx->free = e->right;
+        e->left = e->right = NULL;
+        e->priority = next_priority(idx);
+        e->m = *m;
+        idx->count++;
+        return e;
+}
+
+static void free_extent(struct extent_index *idx, struct extent *e)
+{
+        list_del(&e->fifo);
+        e->right = idx->free;
+        idx->free = e;
+        idx->count--;
+}
+
+/*----------------------------------------------------------------*/
+
+/* Does |e| start before (dev, sector)? */
+static int before(struct extent *e, uint32_t dev, uint64_t sector)
+{
+        return e->m.dev < dev || (e->m.dev == dev && e->m.begin < sector);
+}
+
+/* |l| gets the extents starting before (dev, sector), |r| the rest */
+static void split(struct extent *t, uint32_t dev, uint64_t sector,
+                  struct extent **l, struct extent **r)
+{
+        if (!t) {
+                *l = *r = NULL;
+
+        } else if (before(t, dev, sector)) {
+                split(t->right, dev, sector, &t->right, r);
+                *l = t;
+
+        } else {
+                split(t->left, dev, sector, l, &t->left);
+                *r = t;
+        }
+}
+
+/* Everything in |l| must start before everything in |r| */
+static struct extent *join(struct extent *l, struct extent *r)
+{
+        if (!l)
+                return r;
+
+        if (!r)
+                return l;
+
+        if (l->priority > r->priority) {
+                l->right = join(l->right, r);
+                return l;
+        }
+
+        r->left = join(l, r->left);
+        return r;
+}
+
+static struct extent *rightmost(struct extent *t)
+{
+        while (t && t->right)
+                t = t->right;
+        return t;
+}
+
+/*
+ * Frees the extents in |t|, except one that runs past |end|, which is
+ * trimmed to start there and returned.
+ */
+static struct extent *free_range(struct extent_index *idx, struct extent *t,
+                                 uint64_t end, uint64_t *sectors)
+{
+        struct extent *keep, *l, *r;
+
+        if (!t)
+                return NULL;
+
+        l = free_range(idx, t->left, end, sectors);
+        r = free_range(idx, t->right, end, sectors);
+        keep = l ? l : r;
+
+        if (t->m.end > end) {
+                *sectors += end - t->m.begin;
+                t->m.begin = end;
+                t->left = t->right = NULL;
+                return t;
+        }
+
+        *sectors += t->m.end - t->m.begin;
+        free_extent(idx, t);
+        return keep;
+}
+
+/*
+ * Cuts [begin, end) of |dev| out of the tree, leaving |l| and |r| to be
+ * joined back around the hole.  Needs one extent reserved.
+ */
+static uint64_t punch(struct extent_index *idx, uint32_t dev, uint64_t begin, uint64_t end,
+                      struct extent **l, struct extent **r)
+{
+        uint64_t sectors = 0;
+        struct extent *mid, *last, *tail;
+        struct extent_mapping m;
+
+        split(idx->root, dev, begin, l, &mid);
+        split(mid, dev, end, &mid, r);
+        idx->root = NULL;
+
+        /* the last extent before the range may run into it, or right across it */
+        last = rightmost(*l);
+        if (last && last->m.dev == dev && last->m.end > begin) {
+                if (last->m.end > end) {
+                        m = last->m;
+                        m.begin = end;
+                        tail = alloc_extent(idx, &m);
+                        list_add_h(&last->fifo, &tail->fifo);
+                        *r = join(tail, *r);
+                        sectors += end - begin;
+                } else
+                        sectors += last->m.end - begin;
+
+                last->m.end = begin;
+        }
+
+        *r = join(free_range(idx, mid, end, &sectors), *r);
+        return sectors;
+}
+
+/*----------------------------------------------------------------*/
+
+int extent_index_insert(struct extent_index *idx, struct extent_mapping *m)
+{
+        struct extent *l, *r, *e;
+
+        if (m->end <= m->begin)
+                return 0;
+
+        if (!reserve(idx, 2))
+                return 0;
+
+        idx->superseded += punch(idx, m->dev, m->begin, m->end, &l, &r);
+
+        e = alloc_extent(idx, m);
+        list_add(&idx->fifo, &e->fifo);
+        idx->root = join(join(l, e), r);
+        return 1;
+}
+
+static unsigned visit(struct extent *t, uint32_t dev, uint64_t begin, uint64_t end,
+                      extent_fn fn, void *context)
+{
+        unsigned n = 0;
+        struct extent_mapping m;
+
+        if (!t)
+                return 0;
+
+        /* everything to the left ends before |t| starts */
+        if (!before(t, dev, begin + 1))
+                n += visit(t->left, dev, begin, end, fn, context);
+
+        if (t->m.dev == dev && t->m.begin < end && t->m.end > begin) {
+                m = t->m;
+                if (m.begin < begin)
+                        m.begin = begin;
+                if (m.end > end)
+                        m.end = end;
+                fn(context, &m);
+                n++;
+        }
+
+        if (before(t, dev, end))
+                n += visit(t->right, dev, begin, end, fn, context);
+
+        return n;
+}
+
+unsigned extent_index_lookup(struct extent_index *idx, uint32_t dev,
+                             uint64_t begin, uint64_t end,
+                             extent_fn fn, void *context)
+{
+        if (end <= begin)
+                return 0;
+
+        return visit(idx->root, dev, begin, end, fn, context);
+}
+
+int extent_index_remove(struct extent_index *idx, uint32_t dev, uint64_t begin, uint64_t end)
+{
+        struct extent *l, *r;
+
+        if (end <= begin)
+                return 1;
+
+        if (!reserve(idx, 1))
+                return 0;
+
+        punch(idx, dev, begin, end, &l, &r);
+        idx->root = join(l, r);
+        return 1;
+}
+
+static struct extent *delete(struct extent *t, struct extent *e)
+{
+        if (t == e)
+                return join(t->left, t->right);
+
+        if (before(e, t->m.dev, t->m.begin))
+                t->left = delete(t->left, e);
+        else
+                t->right = delete(t->right, e);
+
+        return t;
+}
+
+void extent_index_drop(struct extent_index *idx, uint64_t txn)
+{
+        struct extent *e;
+
+        while (!list_empty(&idx->fifo)) {
+                e = list_struct_base(list_first(&idx->fifo), struct extent, fifo);
+                if (e->m.txn > txn)
+                        break;
+
+                idx->root = delete(idx->root, e);
+                free_extent(idx, e);
+        }
+}
+
+uint64_t extent_index_count(struct extent_index *idx)
+{
+        return idx->count;
+}
+
+uint64_t extent_index_superseded(struct extent_index *idx)
+{
+        return idx->superseded;
+}
+
+/*----------------------------------------------------------------*/
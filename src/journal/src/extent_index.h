@@ -0,0 +1,63 @@
+#ifndef JOURNAL_EXTENT_INDEX_H
+#define JOURNAL_EXTENT_INDEX_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Maps the sectors of each device to the newest transaction that wrote
+ * them.  The index holds non overlapping extents, keyed by device and
+ * start sector; inserting an extent splits or removes whatever it
+ * overlaps, so what's left for a sector is always the newest write.
+ *
+ * Extents must be inserted in transaction order, which lets
+ * extent_index_drop() throw away old transactions without searching.
+ *
+ * Lookups, inserts and removals are O(log n), plus the number of
+ * extents visited or removed.  The index does no locking.
+ */
+
+struct extent_index;
+
+struct extent_mapping {
+        uint32_t dev;
+        uint64_t begin;         /* sectors, end is exclusive */
+        uint64_t end;
+
+        uint64_t txn;
+        uint32_t io;            /* which io of the transaction */
+        uint64_t origin;        /* start sector of that io */
+};
+
+typedef void (*extent_fn)(void *context, struct extent_mapping *m);
+
+struct extent_index *extent_index_create();
+void extent_index_destroy(struct extent_index *idx);
+
+/* Only fails if out of memory, when the index is unchanged. */
+int extent_index_insert(struct extent_index *idx, struct extent_mapping *m);
+
+/*
+ * Calls |fn| for each extent overlapping [begin, end) in sector order,
+ * clipped to the range.  Returns the number of extents visited.
+ */
+unsigned extent_index_lookup(struct extent_index *idx, uint32_t dev,
+                             uint64_t begin, uint64_t end,
+                             extent_fn fn, void *context);
+
+/* Forgets [begin, end), splitting extents that straddle the ends. */
+int extent_index_remove(struct extent_index *idx, uint32_t dev, uint64_t begin, uint64_t end);
+
+/* Forgets everything written by transactions up to and including |txn|. */
+void extent_index_drop(struct extent_index *idx, uint64_t txn);
+
+uint64_t extent_index_count(struct extent_index *idx);
+
+/* Sectors written, and later overwritten, since the index was created. */
+uint64_t extent_index_superseded(struct extent_index *idx);
+
+/*----------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,291 @@
+#ifndef JOURNAL_FORMAT_H
+#define JOURNAL_FORMAT_H
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * On disk layout of the journal.  The journal directory holds segment
+ * files named segment.<n>, numbered from 1.  Each starts with a
+ * segment_header padded out to SEGMENT_HEADER_SIZE, followed by records
+ * appended back to back.  A segment is closed once the next record
+ * won't fit in segment_size; a record bigger than that gets a segment
+ * to itself.
+ *
+ * A transaction record is a record_header, then its ios' metadata as
+ * arrays of |count|, see io_columns, then the data for each io in
+ * order, each padded to RECORD_ALIGN.  Every record ends with a
+ * record_commit.
+ *
+ * A record's crc is the CRC32C of everything between its header and
+ * its commit marker, carried on over the header with |crc| holding the
+ * low 32 bits of the segment number.  The marker repeats the crc and
+ * id, so recovery can check that a record got to the end of its write
+ * by reading the two ends of it; only the newest segment, which may
+ * have been torn by a crash, has its crcs checked in full.  Replay
+ * checks the crc of each record it reads.
+ *
+ * In direct mode every write is a whole number of DIRECT_ALIGN blocks,
+ * so a batch of records is padded out to the next block with a
+ * RECORD_PAD.  Segments are preallocated, so the records end at the
+ * first header whose magic is zero.  A segment is ended with a zeroed
+ * block when it's closed, or by recovery if it was torn.
+ *
+ * Segments whose transactions have all been dropped are deleted, or
+ * renamed free.<n> to be reused for a later segment.  So a segment can
+ * hold old records after its own, which the segment number in the crc,
+ * and the zeroed block, stop from being taken for new ones.  Every
+ * segment starts with a RECORD_DEVICE for each device registered before
+ * it was opened, so it doesn't depend on earlier segments for them.
+ *
+ * A journal may be striped across several lanes, each a directory of
+ * its own, normally on its own disk, with its own segments numbered
+ * from 1.  The journal's directory is lane 0.  Transaction ids are
+ * global, and a lane's records are in id order, but the lanes are
+ * written independently so a crash can leave a later transaction in one
+ * lane without an earlier one from another; recovery merges the lanes
+ * by id.  Device and drop records are written to every lane.  Each
+ * segment header says which lane it belongs to, and how many there are.
+ *
+ * A big transaction spills its data to the journal before it's
+ * committed, as RECORD_SPILLs holding the data of its next |count| ios,
+ * all in one lane, and identified by |id|, a handle rather than a
+ * transaction id.  Committing it writes a RECORD_SPILLED: a transaction
+ * record holding every io's metadata, the data that wasn't spilled, and
+ * then a spill_ref for each spill, in order, and a spill_table, before
+ * the commit marker.  The spills' data comes before the record's own.
+ * Rolling it back writes a RECORD_ABORT with the handle, and nothing
+ * else; spills that no RECORD_SPILLED refers to are just ignored.
+ *
+ * An io whose codec is IO_REFERENCE has no data of its own: it repeats
+ * the data of an io of an earlier transaction, which can't be dropped
+ * before it is.  Its length is 0, and an io_ref saying which io it
+ * repeats comes after the record's data, one for each such io in order,
+ * before any spill refs.
+ *
+ * Everything is in host byte order.
+ */
+enum {
+        JOURNAL_MAGIC = 0x4c4e524a,     /* "JRNL" */
+        RECORD_MAGIC = 0x4443524a,      /* "JRCD" */
+        COMMIT_MAGIC = 0x4d43524a,      /* "JRCM" */
+        JOURNAL_VERSION = 7,
+
+        SEGMENT_HEADER_SIZE = 4096,
+        RECORD_ALIGN = 8,
+        DIRECT_ALIGN = 4096
+};
+
+struct segment_header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t nr;
+        uint32_t lane;
+        uint32_t nr_lanes;
+};
+
+enum record_type {
+        RECORD_TRANSACTION = 1,
+        RECORD_DEVICE,          /* |count| bytes of name follow the header */
+        RECORD_DROP,            /* everything up to transaction |id| has gone */
+        RECORD_PAD,             /* fills out the rest of a block */
+        RECORD_SPILL,           /* data of a transaction still being built */
+        RECORD_SPILLED,         /* a transaction, with some data in spills */
+        RECORD_ABORT            /* the transaction with spill handle |id| was rolled back */
+};
+
+struct record_header {
+        uint32_t magic;
+        uint32_t type;
+        uint64_t len;           /* the whole record, including this header */
+        uint64_t id;            /* transaction or device id */
+        uint32_t count;
+        uint32_t crc;
+};
+
+struct record_commit {
+        uint32_t magic;
+        uint32_t crc;
+        uint64_t id;
+};
+
+enum {
+        IO_REFERENCE = 0xffffffff
+};
+
+/* Io |io| of transaction |id| */
+struct io_ref {
+        uint64_t id;
+        uint32_t io;
+        uint32_t pad;
+};
+
+/* Where a RECORD_SPILL is, in the same lane as the RECORD_SPILLED */
+struct spill_ref {
+        uint64_t segment;
+        uint64_t offset;
+        uint64_t len;
+        uint32_t count;         /* ios whose data it holds */
+        uint32_t pad;
+};
+
+struct spill_table {
+        uint64_t handle;
+        uint32_t nr_spills;
+        uint32_t ios;           /* whose data was spilled, the first ones */
+};
+
+/*
+ * A checkpoint is the state recovery would otherwise rebuild by reading
+ * every segment, as of a position in each lane.  It's kept in lane 0's
+ * directory, in the file "checkpoint", replaced atomically with
+ * rename(2).  The header is followed by |nr_lanes| checkpoint_lanes,
+ * then |nr_devices| checkpoint_devices, each followed by its name padded
+ * to RECORD_ALIGN, then the ids of the transactions as |nr_runs| runs,
+ * oldest first.  |crc| covers the whole file, computed as for records.
+ * It stays small however big the journal gets: where each transaction
+ * is, and the sector index, come from the segments' indexes.
+ *
+ * A lane's position is before any of its transactions that were durable
+ * but still waiting on an earlier one from another lane, so they're
+ * read again.  A segment of 0 means the lane had no segment yet.
+ */
+enum {
+        CHECKPOINT_MAGIC = 0x4b43524a,  /* "JRCK" */
+        CHECKPOINT_VERSION = 5
+};
+
+struct checkpoint_header {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t len;
+        uint32_t crc;
+        uint32_t nr_devices;
+        uint32_t nr_lanes;
+        uint32_t pad;
+
+        uint64_t next_id;
+        uint64_t dropped;
+
+        uint64_t nr_runs;
+};
+
+struct checkpoint_lane {
+        uint64_t segment;
+        uint64_t offset;
+};
+
+struct checkpoint_device {
+        uint32_t id;
+        uint32_t name_len;
+        uint64_t journalled;
+        uint64_t replayed;
+        uint64_t coalesced;
+};
+
+/* Consecutive transaction ids, |first| to |last| */
+struct checkpoint_run {
+        uint64_t first;
+        uint64_t last;
+};
+
+/*
+ * While checkpoints are on, each segment is indexed once it's closed,
+ * in the file index.<n> beside it: a segment_index, then |nr_marks|
+ * index_marks in id order, then |nr_pins| index_pins, then an index_txn
+ * for each of its |nr_txns| transactions, in id order, each followed by
+ * the start, end and device columns of its ios, see io_index_len().  A
+ * mark says where one of the segment's transactions is, the first and
+ * then every so many, so a transaction can be found by reading forward
+ * from the last mark before it.  A pin is a RECORD_SPILLED whose spills
+ * started in an earlier segment, and so holds on to the segments in
+ * between.  The transactions are what the sector index is rebuilt
+ * from, and say which is the oldest any of their ios refer to.  |crc| covers the whole file, computed as for records.
+ *
+ * An index only saves reading the segment: one that's missing, or
+ * bad, just means the segment is read instead.
+ */
+enum {
+        INDEX_MAGIC = 0x5849524a,       /* "JRIX" */
+        INDEX_VERSION = 3
+};
+
+struct segment_index {
+        uint32_t magic;
+        uint32_t version;
+        uint64_t len;
+        uint32_t crc;
+        uint32_t lane;
+        uint64_t nr;
+        uint64_t last_id;       /* the segment's newest transaction, 0 for none */
+        uint64_t nr_marks;
+        uint64_t nr_pins;
+        uint64_t nr_txns;
+};
+
+struct index_mark {
+        uint64_t id;
+        uint64_t offset;
+};
+
+struct index_pin {
+        uint64_t id;
+        uint64_t first_segment;
+};
+
+struct index_txn {
+        uint64_t id;
+        uint64_t refers;        /* 0 for none */
+        uint32_t count;
+        uint32_t pad;
+};
+
+static inline uint64_t record_pad(uint64_t len)
+{
+        return (len + RECORD_ALIGN - 1) & ~((uint64_t) RECORD_ALIGN - 1);
+}
+
+/*
+ * A transaction's io metadata is a column per field rather than a
+ * struct per io: every start sector, then every end sector, then the
+ * devices, codecs and data lengths, the whole padded to RECORD_ALIGN.
+ * The columns the sector index is built from come first, so recovery
+ * reads just those.
+ */
+struct io_columns {
+        uint64_t *start_sector;
+        uint64_t *end_sector;
+        uint32_t *dev;
+        uint32_t *codec;
+        uint32_t *len;          /* bytes of data, 0 for zeroes */
+};
+
+enum {
+        IO_INDEX_BYTES = 2 * sizeof(uint64_t) + sizeof(uint32_t),
+        IO_BYTES = IO_INDEX_BYTES + 2 * sizeof(uint32_t)
+};
+
+static inline uint64_t io_columns_len(uint64_t count)
+{
+        return record_pad(count * IO_BYTES);
+}
+
+/* The start, end and device columns */
+static inline uint64_t io_index_len(uint64_t count)
+{
+        return record_pad(count * IO_INDEX_BYTES);
+}
+
+static inline void io_columns_init(struct io_columns *c, void *base, uint64_t count)
+{
+        c->start_sector = base;
+        c->end_sector = c->start_sector + count;
+        c->dev = (uint32_t *) (c->end_sector + count);
+        c->codec = c->dev + count;
+        c->len = c->codec + count;
+}
+
+/*----------------------------------------------------------------*/
+
+#endif
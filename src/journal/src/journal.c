@@ -0,0 +1,5091 @@
+#define _GNU_SOURCE             /* O_DIRECT, fallocate */
+
+#include "journal.h"
+#include "extent_index.h"
+#include "format.h"
+
+#include "utility/crc32c.h"
+
+#include "datastruct/list.h"
+#include "log/log.h"
+
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/uio.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------*/
+
+enum {
+        DEFAULT_SEGMENT_SIZE = 64 * 1024 * 1024,
+        DEFAULT_CHECKPOINT_INTERVAL = 256 * 1024 * 1024,
+        DEFAULT_RECYCLE_SEGMENTS = 4,
+        DEFAULT_LOW_WATERMARK = 60,
+        DEFAULT_HIGH_WATERMARK = 90,
+        DEFAULT_TAIL_CACHE = 64 * 1024 * 1024,
+        DEFAULT_SPILL_THRESHOLD = 8 * 1024 * 1024,
+        MIN_BUFFER = 256,
+        MIN_IOS = 16,
+
+        /* the longest a commit is held back, see journal_throttle() */
+        MAX_THROTTLE_US = 10000,
+
+        /* the reclaim rate is measured over windows of this many seconds */
+        RATE_WINDOW = 10,
+
+        /* a batch is written out once it gets this big */
+        STAGING_SIZE = 4 * 1024 * 1024,
+        MIN_GATHER = 64,
+        PAD_RESERVE = 2 * DIRECT_ALIGN,
+
+        MIN_RECORD = sizeof(struct record_header) + sizeof(struct record_commit),
+
+        /* how far replay asks for a mapped segment to be read ahead */
+        REPLAY_READAHEAD = 8 * 1024 * 1024,
+
+        /* a lane's transactions between seek marks, see locate() */
+        SEEK_INTERVAL = 256
+};
+
+/* A growable byte buffer */
+struct buffer {
+        void *data;
+        size_t len;
+        size_t size;
+};
+
+static int buffer_reserve(struct buffer *b, size_t extra)
+{
+        void *data;
+        size_t size = b->size ? b->size : MIN_BUFFER;
+
+        if (b->len + extra <= b->size)
+                return 1;
+
+        while (size < b->len + extra)
+                size *= 2;
+
+        data = realloc(b->data, size);
+        if (!data)
+                return 0;
+
+        b->data = data;
+        b->size = size;
+        return 1;
+}
+
+/* Appends |len| bytes padded to RECORD_ALIGN */
+static int buffer_append(struct buffer *b, const void *data, size_t len)
+{
+        size_t padded = record_pad(len);
+
+        if (!buffer_reserve(b, padded))
+                return 0;
+
+        memcpy(b->data + b->len, data, len);
+        memset(b->data + b->len + len, 0, padded - len);
+        b->len += padded;
+        return 1;
+}
+
+/*
+ * Appends the pieces of |iov| as one, padded to RECORD_ALIGN, and
+ * returns their length.  The space must have been reserved.
+ */
+static size_t buffer_gather(struct buffer *b, const struct iovec *iov, unsigned nr_iov)
+{
+        unsigned i;
+        size_t len = 0, padded;
+
+        for (i = 0; i < nr_iov; i++) {
+                memcpy(b->data + b->len + len, iov[i].iov_base, iov[i].iov_len);
+                len += iov[i].iov_len;
+        }
+
+        padded = record_pad(len);
+        memset(b->data + b->len + len, 0, padded - len);
+        b->len += padded;
+        return len;
+}
+
+/*----------------------------------------------------------------*/
+
+struct journal_device {
+        uint32_t id;
+        char *name;
+        struct journal_device_stats stats;
+};
+
+/*
+ * A read-only mapping of a segment, for replay.  |ahead| is how far
+ * readahead has been asked for.  |users| counts the parallel replay
+ * work still pointing into it.
+ */
+struct segment_map {
+        unsigned lane;
+        uint64_t nr;
+        void *data;
+        size_t len;
+        size_t ahead;
+        unsigned users;
+};
+
+/* Where a durable transaction lives */
+struct txn_entry {
+        uint64_t id;
+        uint64_t segment;
+        uint64_t offset;
+        uint64_t len;
+        uint64_t first_segment;         /* holding its oldest spill, or |segment| */
+        uint32_t lane;
+};
+
+/*
+ * Where one of a lane's transactions is.  Each lane keeps a mark for
+ * the first transaction in each of its segments, and every
+ * SEEK_INTERVAL'th after that, which is all the memory finding a
+ * transaction takes.
+ */
+struct seek_mark {
+        uint64_t id;
+        uint64_t segment;
+        uint64_t offset;
+};
+
+/*
+ * How far a reader has got through a lane: the transaction record at
+ * |segment| and |offset|, or nowhere if |id| is 0.
+ */
+struct lane_cursor {
+        uint64_t id;
+        uint64_t segment;
+        uint64_t offset;
+        uint64_t len;
+};
+
+/*
+ * What a reader, replay or a subscriber, needs to find transactions: a
+ * mapping and a cursor for each lane.
+ */
+struct seeker {
+        struct segment_map *maps;
+        struct lane_cursor *cursors;
+};
+
+/* Consecutive ids */
+struct id_run {
+        uint64_t first;
+        uint64_t last;
+};
+
+/* Transaction |id| has ios repeating data in |refers|, and maybe later */
+struct referrer {
+        uint64_t id;
+        uint64_t refers;
+};
+
+/*
+ * Device registrations and drops are written through the same queues
+ * as transactions, so everything reaches each lane in the order it
+ * happened.
+ */
+struct journal_transaction {
+        struct list list;
+        struct journal *j;
+
+        struct record_header header;
+        struct buffer ios;      /* io_columns, with room for |max_ios| until sealed */
+        uint32_t max_ios;
+        struct buffer data;
+        struct buffer refs;     /* an io_ref for each IO_REFERENCE io */
+        uint64_t refers;        /* the oldest they refer to, held, 0 for none */
+        uint32_t body_crc;
+
+        int has_notify;
+        struct thunk notify;
+        uint64_t committed;     /* when journal_commit() was called */
+
+        struct txn_entry entry; /* filled in by the writer */
+
+        /*
+         * Once a transaction has spilled, the rest of it goes to the same
+         * lane.  |abort| is made ready for journal_rollback() up front, so
+         * rolling back can't fail.  |table| is filled in by the writer.
+         */
+        struct lane *spill_lane;
+        uint64_t spill_handle;
+        uint32_t nr_spills;
+        uint32_t spilled_ios;
+        struct journal_transaction *abort;
+        struct buffer table;
+        int has_spill_notify;
+        struct thunk spill_notify;      /* copied to each spill */
+
+        /* kept in the tail cache for subscribers, see journal_subscribe() */
+        int cached;
+        struct list tail;
+        unsigned users;
+};
+
+/*
+ * A transaction that's spilled to a lane, but hasn't been committed or
+ * rolled back.  Its spills hold on to the segments from |first_segment|
+ * on, and |refs| says where they are, for the commit record.
+ */
+struct open_spill {
+        uint64_t handle;
+        uint64_t first_segment;
+        struct buffer refs;
+};
+
+/*
+ * A directory of segments with a writer thread of its own.
+ */
+struct lane {
+        struct journal *j;
+        unsigned nr;
+        char *dir;
+        int dir_fd;
+        enum journal_mode mode;
+
+        pthread_t writer;
+        pthread_cond_t work;
+
+        /* committed, waiting for the writer; under the journal's lock */
+        struct list pending;
+        uint64_t backlog;               /* bytes queued or being written */
+
+        /*
+         * The segment being appended to, and the batch to be written at
+         * |segment_offset|.  The batch is |gather|, a list of pieces
+         * that are either records' own buffers or, where data is NULL,
+         * the next bytes copied into |staging|.  Only touched by the
+         * writer.
+         */
+        uint64_t segment_nr;
+        int segment_fd;
+        uint64_t segment_offset;
+        uint64_t segment_size;          /* the current segment's file */
+        size_t batch_len;
+        void *staging;
+        size_t staging_len;
+        size_t staging_size;
+        struct iovec *gather;
+        unsigned nr_gather;
+        unsigned gather_size;
+
+        /*
+         * Space, also only touched by the writer.  |last_ids| holds the
+         * newest transaction in each segment from |oldest_segment| on,
+         * 0 for none, so a segment can go once that's been dropped.
+         * Segments kept for reuse are renamed free.<n>, with the n's in
+         * |free_segments|.
+         */
+        uint64_t oldest_segment;        /* there may be no older segment file */
+        uint64_t *last_ids;
+        size_t nr_last_ids;
+        size_t last_ids_size;
+        uint64_t *free_segments;
+        unsigned nr_free;
+        uint64_t next_free;
+        struct open_spill *spills;
+        unsigned nr_spills;
+        unsigned spills_size;
+
+        /*
+         * The current segment's index, built up as its transactions are
+         * staged and written out when it's closed, also only touched by
+         * the writer; and, before the writer starts, by recovery, which
+         * works out where the marks go the same way.
+         */
+        struct buffer index_marks;
+        struct buffer index_pins;
+        struct buffer index_txns;
+        uint64_t index_nr_txns;
+        uint64_t index_last_id;
+        uint64_t mark_segment;
+        unsigned since_mark;
+
+        /* under the journal's lock */
+        struct seek_mark *marks;        /* oldest first */
+        size_t nr_marks;
+        size_t marks_size;
+        uint64_t durable_segment;       /* where the last sync got to */
+        uint64_t durable_offset;
+        uint64_t checkpoint_segment;    /* where the last checkpoint started from */
+        uint64_t dropped_durable;       /* by a drop record written to this lane */
+        uint64_t closed_bytes;          /* in segments other than the current one */
+        uint64_t current_bytes;         /* written to the current segment */
+};
+
+struct journal {
+        char *dir;
+        struct journal_options opts;
+
+        pthread_mutex_t lock;
+        int stopping;
+        int failed;
+
+        struct lane *lanes;
+        unsigned nr_lanes;
+
+        uint64_t next_id;
+        uint64_t written;       /* the newest transaction durable along with all before it */
+        uint64_t next_spill;    /* handle */
+
+        /*
+         * Transactions that are durable in their lane, oldest first,
+         * waiting for an earlier one in another lane to be.
+         */
+        struct list durable;
+
+        /* indexed by device id */
+        struct journal_device **devices;
+        unsigned nr_devices;
+
+        /*
+         * The ids of the durable transactions that haven't been dropped.
+         * Every committed transaction is written, in id order, so
+         * there's just the one run unless a crash has left gaps; where
+         * each transaction is is found through the lanes' marks.
+         */
+        struct id_run *runs;
+        size_t nr_runs;
+        size_t runs_size;
+        uint64_t dropped;       /* the last transaction dropped */
+        struct extent_index *index;
+
+        /*
+         * Data that ios refer to has to outlive them.  |referrers| holds
+         * the durable transactions that refer to earlier ones, in id
+         * order, and |holds| the oldest id each transaction being built
+         * refers to, neither of which can be dropped.
+         */
+        struct buffer referrers;
+        struct buffer holds;
+
+        /* bytes appended, or recovered, since the last checkpoint */
+        uint64_t since_checkpoint;
+        pthread_t checkpointer;
+        pthread_cond_t checkpoint_due;
+        int checkpoint_wanted;
+
+        uint64_t rate_start;            /* when the reclaim rate window opened */
+        uint64_t rate_bytes;
+
+        /*
+         * Replay reads records straight out of a mapping of the segment
+         * they're in, kept until replay moves on to another segment.
+         * There's one for each lane.
+         */
+        pthread_mutex_t replay_lock;
+        struct seeker replay;
+
+        /*
+         * Tail streaming.  While there are subscribers |tail| caches the
+         * newest durable transactions, oldest first, so they can be
+         * shipped without reading them back.  A drop that would take
+         * transactions a subscriber hasn't shipped yet waits in
+         * |drop_wanted|.
+         */
+        struct list subscribers;
+        struct list tail;
+        uint64_t tail_bytes;
+        uint64_t drop_wanted;
+        pthread_cond_t shippable;       /* more transactions are durable */
+
+        struct journal_stats stats;
+};
+
+struct journal_subscriber {
+        struct list list;
+        struct journal *j;
+        uint64_t next;                  /* the oldest id not shipped yet */
+
+        int has_wake;
+        struct thunk wake;
+
+        struct seeker seeker;           /* for what's fallen out of the cache */
+};
+
+void journal_options_init(struct journal_options *opts)
+{
+        opts->segment_size = DEFAULT_SEGMENT_SIZE;
+        opts->mode = JOURNAL_DIRECT;
+        opts->checkpoint_interval = DEFAULT_CHECKPOINT_INTERVAL;
+        opts->recycle_segments = DEFAULT_RECYCLE_SEGMENTS;
+        opts->capacity = 0;
+        opts->low_watermark = DEFAULT_LOW_WATERMARK;
+        opts->high_watermark = DEFAULT_HIGH_WATERMARK;
+        opts->nr_lanes = 0;
+        opts->lanes = NULL;
+        opts->tail_cache = DEFAULT_TAIL_CACHE;
+        opts->spill_threshold = DEFAULT_SPILL_THRESHOLD;
+}
+
+const char *journal_mode_name(enum journal_mode mode)
+{
+        return (mode == JOURNAL_DIRECT) ? "direct" : "buffered";
+}
+
+static void segment_path(struct lane *l, uint64_t nr, char *path, size_t len)
+{
+        snprintf(path, len, "%s/segment.%llu", l->dir, (unsigned long long) nr);
+}
+
+static void free_path(struct lane *l, uint64_t nr, char *path, size_t len)
+{
+        snprintf(path, len, "%s/free.%llu", l->dir, (unsigned long long) nr);
+}
+
+static void index_path(struct lane *l, uint64_t nr, char *path, size_t len)
+{
+        snprintf(path, len, "%s/index.%llu", l->dir, (unsigned long long) nr);
+}
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * The ids of the durable transactions.  Call with the lock held.
+ */
+static int push_run(struct journal *j, uint64_t first, uint64_t last)
+{
+        struct id_run *runs;
+        size_t size;
+
+        if (j->nr_runs && j->runs[j->nr_runs - 1].last + 1 == first) {
+                j->runs[j->nr_runs - 1].last = last;
+                return 1;
+        }
+
+        if (j->nr_runs == j->runs_size) {
+                size = j->runs_size ? j->runs_size * 2 : 4;
+                runs = realloc(j->runs, sizeof(*runs) * size);
+                if (!runs)
+                        return 0;
+
+                j->runs = runs;
+                j->runs_size = size;
+        }
+
+        j->runs[j->nr_runs].first = first;
+        j->runs[j->nr_runs].last = last;
+        j->nr_runs++;
+        return 1;
+}
+
+static int push_id(struct journal *j, uint64_t id)
+{
+        return push_run(j, id, id);
+}
+
+static void drop_ids(struct journal *j, uint64_t id)
+{
+        size_t n = 0, count = j->referrers.len / sizeof(struct referrer);
+        struct referrer *rs = (struct referrer *) j->referrers.data;
+
+        while (n < j->nr_runs && j->runs[n].last <= id)
+                j->dropped = j->runs[n++].last;
+
+        memmove(j->runs, j->runs + n, sizeof(*j->runs) * (j->nr_runs - n));
+        j->nr_runs -= n;
+
+        if (j->nr_runs && j->runs[0].first <= id) {
+                j->runs[0].first = id + 1;
+                j->dropped = id;
+        }
+
+        for (n = 0; n < count && rs[n].id <= j->dropped; n++)
+                ;
+        memmove(rs, rs + n, sizeof(*rs) * (count - n));
+        j->referrers.len -= sizeof(*rs) * n;
+
+        extent_index_drop(j->index, j->dropped);
+}
+
+static uint64_t count_ids(struct journal *j)
+{
+        size_t i;
+        uint64_t n = 0;
+
+        for (i = 0; i < j->nr_runs; i++)
+                n += j->runs[i].last - j->runs[i].first + 1;
+
+        return n;
+}
+
+/* Finds the id |index| places from the oldest */
+static int id_at(struct journal *j, uint64_t index, uint64_t *id)
+{
+        size_t i;
+        uint64_t len;
+
+        for (i = 0; i < j->nr_runs; i++) {
+                len = j->runs[i].last - j->runs[i].first + 1;
+                if (index < len) {
+                        *id = j->runs[i].first + index;
+                        return 1;
+                }
+                index -= len;
+        }
+
+        return 0;
+}
+
+/* Finds the oldest id that's at least |id|, and its index */
+static int seek_id(struct journal *j, uint64_t id, uint64_t *found, uint64_t *index)
+{
+        size_t i;
+        uint64_t n = 0;
+
+        for (i = 0; i < j->nr_runs; i++) {
+                if (j->runs[i].last >= id) {
+                        *found = (id > j->runs[i].first) ? id : j->runs[i].first;
+                        *index = n + *found - j->runs[i].first;
+                        return 1;
+                }
+                n += j->runs[i].last - j->runs[i].first + 1;
+        }
+
+        return 0;
+}
+
+/*
+ * What ios refer to.  Call with the lock held, or before the writers
+ * have started.
+ */
+static int push_referrer(struct journal *j, uint64_t id, uint64_t refers)
+{
+        struct referrer r = { id, refers };
+
+        return buffer_append(&j->referrers, &r, sizeof(r));
+}
+
+/* Keeps |id| from being dropped while |t| is built, and committed */
+static int hold_ref(struct journal *j, struct journal_transaction *t, uint64_t id)
+{
+        size_t i, count = j->holds.len / sizeof(uint64_t);
+        uint64_t *holds = (uint64_t *) j->holds.data;
+
+        if (!t->refers) {
+                if (!buffer_append(&j->holds, &id, sizeof(id)))
+                        return 0;
+
+        } else if (id < t->refers) {
+                for (i = 0; i < count; i++)
+                        if (holds[i] == t->refers) {
+                                holds[i] = id;
+                                break;
+                        }
+
+        } else
+                return 1;
+
+        t->refers = id;
+        return 1;
+}
+
+static void release_ref(struct journal *j, struct journal_transaction *t)
+{
+        size_t i, count = j->holds.len / sizeof(uint64_t);
+        uint64_t *holds = (uint64_t *) j->holds.data;
+
+        for (i = 0; t->refers && i < count; i++)
+                if (holds[i] == t->refers) {
+                        holds[i] = holds[count - 1];
+                        j->holds.len -= sizeof(*holds);
+                        break;
+                }
+}
+
+/*
+ * The newest id, up to |id|, that can be dropped without taking data
+ * that's referred to.  Dropping a referrer lets go of what it refers
+ * to, so they're gone through newest first.
+ */
+static uint64_t unreferred(struct journal *j, uint64_t id)
+{
+        size_t i;
+        uint64_t *holds = (uint64_t *) j->holds.data;
+        struct referrer *rs = (struct referrer *) j->referrers.data;
+
+        for (i = 0; i < j->holds.len / sizeof(*holds); i++)
+                if (holds[i] <= id)
+                        id = holds[i] - 1;
+
+        for (i = j->referrers.len / sizeof(*rs); i-- && rs[i].id > id; )
+                if (rs[i].refers <= id)
+                        id = rs[i].refers - 1;
+
+        return id;
+}
+
+/*
+ * A lane's seek marks.  Call with the lock held, or before the writers
+ * have started.
+ */
+static int push_mark(struct lane *l, uint64_t id, uint64_t segment, uint64_t offset)
+{
+        struct seek_mark *marks;
+        size_t size;
+
+        if (l->nr_marks == l->marks_size) {
+                size = l->marks_size ? l->marks_size * 2 : 64;
+                marks = realloc(l->marks, sizeof(*marks) * size);
+                if (!marks)
+                        return 0;
+
+                l->marks = marks;
+                l->marks_size = size;
+        }
+
+        l->marks[l->nr_marks].id = id;
+        l->marks[l->nr_marks].segment = segment;
+        l->marks[l->nr_marks].offset = offset;
+        l->nr_marks++;
+        return 1;
+}
+
+/* Forgets the marks in segments before |nr|, which have gone */
+static void trim_marks(struct lane *l, uint64_t nr)
+{
+        size_t n = 0;
+
+        while (n < l->nr_marks && l->marks[n].segment < nr)
+                n++;
+
+        memmove(l->marks, l->marks + n, sizeof(*l->marks) * (l->nr_marks - n));
+        l->nr_marks -= n;
+}
+
+/* Returns the newest mark at or before |id|, or NULL */
+static struct seek_mark *find_mark(struct lane *l, uint64_t id)
+{
+        size_t low = 0, high = l->nr_marks, mid;
+
+        while (low < high) {
+                mid = low + (high - low) / 2;
+                if (l->marks[mid].id <= id)
+                        low = mid + 1;
+                else
+                        high = mid;
+        }
+
+        return low ? l->marks + low - 1 : NULL;
+}
+
+/* Is the lane's next transaction, in |segment|, due a mark? */
+static int mark_due(struct lane *l, uint64_t segment)
+{
+        if (segment == l->mark_segment && ++l->since_mark < SEEK_INTERVAL)
+                return 0;
+
+        l->mark_segment = segment;
+        l->since_mark = 0;
+        return 1;
+}
+
+/*
+ * Adds a durable transaction's ios to the index.  Only the start, end
+ * and device columns of |c| are used.
+ */
+static int index_ios(struct journal *j, uint64_t id, struct io_columns *c, unsigned count)
+{
+        unsigned i;
+        struct extent_mapping m;
+
+        for (i = 0; i < count; i++) {
+                m.dev = c->dev[i];
+                m.begin = c->start_sector[i];
+                m.end = c->end_sector[i];
+                m.txn = id;
+                m.io = i;
+                m.origin = m.begin;
+                if (!extent_index_insert(j->index, &m))
+                        return 0;
+        }
+
+        return 1;
+}
+
+/*
+ * Once for each transaction, unlike index_ios(), which recovery also
+ * does for those the checkpoint counted.
+ */
+static void count_journalled(struct journal *j, struct io_columns *c, unsigned count)
+{
+        unsigned i;
+
+        for (i = 0; i < count; i++)
+                if (c->dev[i] < j->nr_devices)
+                        j->devices[c->dev[i]]->stats.journalled +=
+                                (c->end_sector[i] - c->start_sector[i]) << JOURNAL_SECTOR_SHIFT;
+}
+
+static struct journal_device *add_device(struct journal *j, uint32_t id, const char *name, size_t len)
+{
+        struct journal_device *dev, **devices;
+
+        if (id != j->nr_devices)
+                return NULL;
+
+        devices = realloc(j->devices, sizeof(*devices) * (j->nr_devices + 1));
+        if (!devices)
+                return NULL;
+        j->devices = devices;
+
+        dev = malloc(sizeof(*dev));
+        if (!dev)
+                return NULL;
+
+        memset(dev, 0, sizeof(*dev));
+        dev->id = id;
+        dev->name = strndup(name, len);
+        if (!dev->name) {
+                free(dev);
+                return NULL;
+        }
+
+        j->devices[j->nr_devices++] = dev;
+        return dev;
+}
+
+/*----------------------------------------------------------------*/
+
+static struct journal_transaction *new_record(struct journal *j, enum record_type type)
+{
+        struct journal_transaction *t = malloc(sizeof(*t));
+
+        if (!t)
+                return NULL;
+
+        memset(t, 0, sizeof(*t));
+        t->j = j;
+        t->header.magic = RECORD_MAGIC;
+        t->header.type = type;
+        return t;
+}
+
+static void free_record(struct journal_transaction *t)
+{
+        if (t->abort)
+                free_record(t->abort);
+        free(t->ios.data);
+        free(t->data.data);
+        free(t->refs.data);
+        free(t->table.data);
+        free(t);
+}
+
+static void free_records(struct list *records)
+{
+        struct journal_transaction *t, *tmp;
+
+        list_iterate_items_safe (t, tmp, records) {
+                list_del(&t->list);
+                free_record(t);
+        }
+}
+
+static int is_transaction(uint32_t type)
+{
+        return type == RECORD_TRANSACTION || type == RECORD_SPILLED;
+}
+
+static size_t spill_table_len(uint32_t nr_spills)
+{
+        return nr_spills ? nr_spills * sizeof(struct spill_ref) + sizeof(struct spill_table) : 0;
+}
+
+/*
+ * A transaction's io metadata is built up as the columns it's written
+ * out as, with room left at the end of each for more ios.  Growing
+ * moves the columns apart, and sealing closes the gaps, in place.
+ */
+static void move_columns(struct io_columns *to, struct io_columns *from, uint32_t count)
+{
+        memmove(to->start_sector, from->start_sector, count * sizeof(*to->start_sector));
+        memmove(to->end_sector, from->end_sector, count * sizeof(*to->end_sector));
+        memmove(to->dev, from->dev, count * sizeof(*to->dev));
+        memmove(to->codec, from->codec, count * sizeof(*to->codec));
+        memmove(to->len, from->len, count * sizeof(*to->len));
+}
+
+static int reserve_ios(struct journal_transaction *t, unsigned count)
+{
+        uint64_t max = t->max_ios ? t->max_ios : MIN_IOS;
+        void *data;
+        struct io_columns from, to;
+
+        if ((uint64_t) t->header.count + count <= t->max_ios)
+                return 1;
+
+        while (max < (uint64_t) t->header.count + count)
+                max *= 2;
+        if (max > UINT32_MAX)
+                return 0;
+
+        data = malloc(io_columns_len(max));
+        if (!data)
+                return 0;
+
+        if (t->header.count) {
+                io_columns_init(&from, t->ios.data, t->max_ios);
+                io_columns_init(&to, data, max);
+                move_columns(&to, &from, t->header.count);
+        }
+
+        free(t->ios.data);
+        t->ios.data = data;
+        t->ios.size = io_columns_len(max);
+        t->max_ios = max;
+        return 1;
+}
+
+static void pack_ios(struct journal_transaction *t)
+{
+        struct io_columns from, to;
+
+        if (t->max_ios != t->header.count) {
+                io_columns_init(&from, t->ios.data, t->max_ios);
+                io_columns_init(&to, t->ios.data, t->header.count);
+                move_columns(&to, &from, t->header.count);
+                t->max_ios = t->header.count;
+        }
+        t->ios.len = t->max_ios ? io_columns_len(t->max_ios) : 0;
+}
+
+/*
+ * The crc of the body is taken when the record is sealed, by whoever
+ * built it, leaving just the header for the writer.  A spill table is
+ * added to the crc by the writer once it knows where the spills went.
+ */
+static void seal_record(struct journal_transaction *t)
+{
+        if (is_transaction(t->header.type))
+                pack_ios(t);
+
+        t->header.len = MIN_RECORD + t->ios.len + t->data.len + t->refs.len +
+                spill_table_len(t->nr_spills);
+        t->body_crc = crc32c(crc32c(crc32c(0, t->ios.data, t->ios.len),
+                                    t->data.data, t->data.len), t->refs.data, t->refs.len);
+}
+
+/*
+ * The segment number goes in the crc, so a record left over from the
+ * segment file's last use can't pass for a new one.
+ */
+static uint32_t record_crc(struct record_header *h, uint32_t body_crc, uint64_t segment)
+{
+        struct record_header copy = *h;
+
+        copy.crc = (uint32_t) segment;
+        return crc32c(body_crc, &copy, sizeof(copy));
+}
+
+static void set_commit(struct record_commit *c, struct record_header *h)
+{
+        c->magic = COMMIT_MAGIC;
+        c->crc = h->crc;
+        c->id = h->id;
+}
+
+/* Call with the lock held, |t| must be sealed */
+static void queue_record(struct lane *l, struct journal_transaction *t)
+{
+        list_add(&l->pending, &t->list);
+        l->backlog += t->header.len;
+        pthread_cond_signal(&l->work);
+}
+
+/*
+ * Transactions go to the lane with the least waiting to be written.
+ * Ties go to the first, so a lone client sticks to one lane rather than
+ * paying for a sync of each in turn; the others take over as it backs
+ * up.  Call with the lock held.
+ */
+static struct lane *pick_lane(struct journal *j)
+{
+        unsigned i;
+        struct lane *best = j->lanes;
+
+        for (i = 1; i < j->nr_lanes && best->backlog; i++)
+                if (j->lanes[i].backlog < best->backlog)
+                        best = j->lanes + i;
+
+        return best;
+}
+
+/*
+ * Device and drop records go to every lane, so each lane can be
+ * recovered and reclaimed on its own.  A copy for each is sealed into
+ * |records|.
+ */
+static int lane_records(struct journal *j, enum record_type type, uint64_t id,
+                        const void *data, uint32_t len, struct list *records)
+{
+        unsigned i;
+        struct journal_transaction *t;
+
+        for (i = 0; i < j->nr_lanes; i++) {
+                t = new_record(j, type);
+                if (!t || (len && !buffer_append(&t->data, data, len))) {
+                        if (t)
+                                free_record(t);
+                        return 0;
+                }
+
+                t->header.id = id;
+                t->header.count = len;
+                seal_record(t);
+                list_add(records, &t->list);
+        }
+
+        return 1;
+}
+
+/* Call with the lock held */
+static void queue_lane_records(struct journal *j, struct list *records)
+{
+        unsigned i = 0;
+        struct journal_transaction *t, *tmp;
+
+        list_iterate_items_safe (t, tmp, records) {
+                list_del(&t->list);
+                queue_record(j->lanes + i++, t);
+        }
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * The writer threads, one per lane.
+ */
+static int sync_dir(struct lane *l)
+{
+        return !fsync(l->dir_fd);
+}
+
+static int direct(struct lane *l)
+{
+        return l->mode == JOURNAL_DIRECT;
+}
+
+static uint64_t align_up(uint64_t n)
+{
+        return (n + DIRECT_ALIGN - 1) & ~((uint64_t) DIRECT_ALIGN - 1);
+}
+
+/*
+ * Records are gathered into a batch, written with a single pwritev.
+ * Buffered, a transaction's ios and data are written from where they
+ * already are, and only the header and commit around them are copied,
+ * into the staging buffer.  Direct io needs aligned buffers, so
+ * everything is copied into the aligned staging buffer instead, each
+ * write is padded out to a whole block, and the next batch starts in a
+ * fresh block rather than rewriting the tail of one that's already
+ * durable.
+ *
+ * Makes room for |len| more bytes of staging and |pieces| more pieces.
+ */
+static int reserve_batch(struct lane *l, size_t len, unsigned pieces)
+{
+        void *staging;
+        struct iovec *gather;
+        size_t size = l->staging_size ? l->staging_size : STAGING_SIZE;
+        unsigned nr = l->gather_size ? l->gather_size : MIN_GATHER;
+
+        if (l->nr_gather + pieces > l->gather_size) {
+                while (nr < l->nr_gather + pieces)
+                        nr *= 2;
+
+                gather = realloc(l->gather, nr * sizeof(*gather));
+                if (!gather)
+                        return 0;
+
+                l->gather = gather;
+                l->gather_size = nr;
+        }
+
+        if (l->staging_len + len <= l->staging_size)
+                return 1;
+
+        while (size < l->staging_len + len)
+                size *= 2;
+
+        if (posix_memalign(&staging, DIRECT_ALIGN, size))
+                return 0;
+
+        memcpy(staging, l->staging, l->staging_len);
+        free(l->staging);
+        l->staging = staging;
+        l->staging_size = size;
+        return 1;
+}
+
+/* Adds the |len| bytes just written to the end of the staging buffer */
+static void staged(struct lane *l, size_t len)
+{
+        struct iovec *last = l->nr_gather ? l->gather + l->nr_gather - 1 : NULL;
+
+        if (last && !last->iov_base)
+                last->iov_len += len;
+        else {
+                last = l->gather + l->nr_gather++;
+                last->iov_base = NULL;
+                last->iov_len = len;
+        }
+
+        l->staging_len += len;
+        l->batch_len += len;
+}
+
+static void stage(struct lane *l, const void *data, size_t len)
+{
+        memcpy(l->staging + l->staging_len, data, len);
+        staged(l, len);
+}
+
+/* |data| mustn't move or change until the batch has been written */
+static void stage_ref(struct lane *l, void *data, size_t len)
+{
+        struct iovec *piece;
+
+        if (direct(l)) {
+                stage(l, data, len);
+                return;
+        }
+
+        if (!len)
+                return;
+
+        piece = l->gather + l->nr_gather++;
+        piece->iov_base = data;
+        piece->iov_len = len;
+        l->batch_len += len;
+}
+
+static void discard_batch(struct lane *l)
+{
+        l->batch_len = 0;
+        l->staging_len = 0;
+        l->nr_gather = 0;
+}
+
+static void stage_padding(struct lane *l)
+{
+        struct record_header pad;
+        struct record_commit commit;
+        size_t body, len = align_up(l->staging_len) - l->staging_len;
+
+        if (!len)
+                return;
+
+        if (len < MIN_RECORD)
+                len += DIRECT_ALIGN;
+        body = len - MIN_RECORD;
+
+        memset(&pad, 0, sizeof(pad));
+        pad.magic = RECORD_MAGIC;
+        pad.type = RECORD_PAD;
+        pad.len = len;
+
+        memset(l->staging + l->staging_len + sizeof(pad), 0, body);
+        pad.crc = record_crc(&pad, crc32c(0, l->staging + l->staging_len + sizeof(pad), body),
+                             l->segment_nr);
+        set_commit(&commit, &pad);
+
+        stage(l, &pad, sizeof(pad));
+        staged(l, body);
+        stage(l, &commit, sizeof(commit));
+}
+
+static int flush_staging(struct lane *l)
+{
+        ssize_t r;
+        unsigned i, n;
+        uint64_t offset = l->segment_offset;
+        void *staging = l->staging;
+        struct iovec *iov = l->gather;
+
+        if (direct(l))
+                stage_padding(l);
+
+        /* the staging buffer won't move now, so the staged pieces can point into it */
+        for (i = 0; i < l->nr_gather; i++)
+                if (!iov[i].iov_base) {
+                        iov[i].iov_base = staging;
+                        staging += iov[i].iov_len;
+                }
+
+        i = 0;
+        while (i < l->nr_gather) {
+                n = l->nr_gather - i;
+                r = pwritev(l->segment_fd, iov + i, (n > IOV_MAX) ? IOV_MAX : n, offset);
+                if (r < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return 0;
+                }
+
+                /* a short write can stop part way through a piece */
+                offset += r;
+                for (; i < l->nr_gather && (size_t) r >= iov[i].iov_len; i++)
+                        r -= iov[i].iov_len;
+
+                if (i < l->nr_gather) {
+                        iov[i].iov_base += r;
+                        iov[i].iov_len -= r;
+                }
+        }
+
+        l->segment_offset += l->batch_len;
+        discard_batch(l);
+        return 1;
+}
+
+/*
+ * Zeroes the block after the last record, so whatever the file held
+ * before, if it was recycled, isn't read as part of this segment.
+ */
+static int end_segment(struct lane *l)
+{
+        uint64_t len = l->segment_size - l->segment_offset;
+
+        if (len > DIRECT_ALIGN)
+                len = DIRECT_ALIGN;
+
+        if (!len)
+                return 1;
+
+        if (!reserve_batch(l, len, 1))
+                return 0;
+
+        memset(l->staging + l->staging_len, 0, len);
+        staged(l, len);
+        if (!flush_staging(l))
+                return 0;
+
+        l->segment_offset -= len;
+        return 1;
+}
+
+static int write_exact(int fd, const void *data, size_t len)
+{
+        ssize_t r;
+        const char *p = data;
+
+        while (len) {
+                r = write(fd, p, len);
+                if (r < 0) {
+                        if (errno == EINTR)
+                                continue;
+                        return 0;
+                }
+                p += r;
+                len -= r;
+        }
+
+        return 1;
+}
+
+/*
+ * Writes out the index of the segment just closed.  It isn't synced,
+ * recovery checks it, and one that didn't get to disk just means
+ * reading the segment.
+ */
+static void write_segment_index(struct lane *l)
+{
+        int fd, r;
+        char path[PATH_MAX];
+        struct segment_index si;
+
+        memset(&si, 0, sizeof(si));
+        si.magic = INDEX_MAGIC;
+        si.version = INDEX_VERSION;
+        si.len = sizeof(si) + l->index_marks.len + l->index_pins.len + l->index_txns.len;
+        si.lane = l->nr;
+        si.nr = l->segment_nr;
+        si.last_id = l->index_last_id;
+        si.nr_marks = l->index_marks.len / sizeof(struct index_mark);
+        si.nr_pins = l->index_pins.len / sizeof(struct index_pin);
+        si.nr_txns = l->index_nr_txns;
+        si.crc = crc32c(crc32c(crc32c(crc32c(0, l->index_marks.data, l->index_marks.len),
+                                      l->index_pins.data, l->index_pins.len),
+                               l->index_txns.data, l->index_txns.len), &si, sizeof(si));
+
+        index_path(l, l->segment_nr, path, sizeof(path));
+        fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        r = fd >= 0 && write_exact(fd, &si, sizeof(si)) &&
+                write_exact(fd, l->index_marks.data, l->index_marks.len) &&
+                write_exact(fd, l->index_pins.data, l->index_pins.len) &&
+                write_exact(fd, l->index_txns.data, l->index_txns.len);
+        if (fd >= 0)
+                close(fd);
+
+        if (!r) {
+                warn("couldn't write journal index %s: %s", path, strerror(errno));
+                unlink(path);
+        }
+}
+
+static int close_segment(struct lane *l)
+{
+        struct journal *j = l->j;
+        int r = flush_staging(l) && end_segment(l) && !fdatasync(l->segment_fd);
+
+        close(l->segment_fd);
+        l->segment_fd = -1;
+
+        if (r && j->opts.checkpoint_interval)
+                write_segment_index(l);
+        l->index_marks.len = 0;
+        l->index_pins.len = 0;
+        l->index_txns.len = 0;
+        l->index_nr_txns = 0;
+        l->index_last_id = 0;
+
+        pthread_mutex_lock(&j->lock);
+        l->closed_bytes += l->segment_size;
+        l->current_bytes = 0;
+        pthread_mutex_unlock(&j->lock);
+
+        return r;
+}
+
+static int create_segment_file(struct lane *l, const char *path)
+{
+        int fd, flags = O_WRONLY | O_CREAT | O_EXCL;
+
+        if (!direct(l))
+                return open(path, flags, 0644);
+
+        fd = open(path, flags | O_DIRECT, 0644);
+        if (fd < 0 && errno == EINVAL) {
+                /* the file may have been created before O_DIRECT was refused */
+                warn("%s doesn't support direct io, the journal will be buffered", l->dir);
+                l->mode = JOURNAL_BUFFERED;
+                fd = open(path, O_WRONLY | O_CREAT, 0644);
+        }
+
+        return fd;
+}
+
+static int open_segment_file(struct lane *l, const char *path)
+{
+        int fd;
+
+        if (!direct(l))
+                return open(path, O_WRONLY);
+
+        fd = open(path, O_WRONLY | O_DIRECT);
+        if (fd < 0 && errno == EINVAL) {
+                warn("%s doesn't support direct io, the journal will be buffered", l->dir);
+                l->mode = JOURNAL_BUFFERED;
+                fd = open(path, O_WRONLY);
+        }
+
+        return fd;
+}
+
+/* Renames a free segment to |path|, returning the fd or -1 if there isn't one */
+static int recycle_segment(struct lane *l, const char *path)
+{
+        int fd;
+        char old[PATH_MAX];
+
+        while (l->nr_free) {
+                free_path(l, l->free_segments[--l->nr_free], old, sizeof(old));
+                if (rename(old, path) < 0) {
+                        warn("couldn't reuse journal segment %s: %s", old, strerror(errno));
+                        continue;
+                }
+
+                fd = open_segment_file(l, path);
+                if (fd >= 0)
+                        return fd;
+
+                warn("couldn't reuse journal segment %s: %s", path, strerror(errno));
+                unlink(path);
+        }
+
+        return -1;
+}
+
+/*
+ * Device registrations, sealed and ready to stage at the start of a
+ * segment.  They're built before the segment is opened so it can be
+ * made big enough.
+ */
+static int device_records(struct journal *j, struct list *records, uint64_t *len)
+{
+        unsigned i;
+        size_t name_len;
+        struct journal_transaction *t;
+
+        *len = 0;
+        pthread_mutex_lock(&j->lock);
+        for (i = 0; i < j->nr_devices; i++) {
+                name_len = strlen(j->devices[i]->name);
+                t = new_record(j, RECORD_DEVICE);
+                if (!t || !buffer_append(&t->data, j->devices[i]->name, name_len)) {
+                        if (t)
+                                free_record(t);
+                        pthread_mutex_unlock(&j->lock);
+                        return 0;
+                }
+
+                t->header.id = i;
+                t->header.count = name_len;
+                seal_record(t);
+                list_add(records, &t->list);
+                *len += t->header.len;
+        }
+        pthread_mutex_unlock(&j->lock);
+
+        return 1;
+}
+
+/* Makes room for segment |nr| in last_ids */
+static int track_segment(struct lane *l, uint64_t nr)
+{
+        uint64_t *ids;
+        size_t size, needed = nr - l->oldest_segment + 1;
+
+        if (needed > l->last_ids_size) {
+                size = l->last_ids_size ? l->last_ids_size : 16;
+                while (size < needed)
+                        size *= 2;
+
+                ids = realloc(l->last_ids, sizeof(*ids) * size);
+                if (!ids)
+                        return 0;
+
+                l->last_ids = ids;
+                l->last_ids_size = size;
+        }
+
+        while (l->nr_last_ids < needed)
+                l->last_ids[l->nr_last_ids++] = 0;
+
+        return 1;
+}
+
+/*
+ * Transactions that have spilled to the lane.  There are only ever a
+ * few at once, so they're kept in an array.
+ */
+static struct open_spill *find_spill(struct lane *l, uint64_t handle)
+{
+        unsigned i;
+
+        for (i = 0; i < l->nr_spills; i++)
+                if (l->spills[i].handle == handle)
+                        return l->spills + i;
+
+        return NULL;
+}
+
+static struct open_spill *add_spill(struct lane *l, uint64_t handle)
+{
+        unsigned size;
+        struct open_spill *spills, *os;
+
+        if (l->nr_spills == l->spills_size) {
+                size = l->spills_size ? l->spills_size * 2 : 4;
+                spills = realloc(l->spills, sizeof(*spills) * size);
+                if (!spills)
+                        return NULL;
+
+                l->spills = spills;
+                l->spills_size = size;
+        }
+
+        os = l->spills + l->nr_spills++;
+        memset(os, 0, sizeof(*os));
+        os->handle = handle;
+        os->first_segment = l->segment_nr;
+        return os;
+}
+
+static void remove_spill(struct lane *l, struct open_spill *os)
+{
+        free(os->refs.data);
+        *os = l->spills[--l->nr_spills];
+}
+
+/* Segments from here on can't be reclaimed */
+static uint64_t pinned_segment(struct lane *l)
+{
+        unsigned i;
+        uint64_t nr = l->segment_nr;
+
+        for (i = 0; i < l->nr_spills; i++)
+                if (l->spills[i].first_segment < nr)
+                        nr = l->spills[i].first_segment;
+
+        return nr;
+}
+
+/*
+ * Keeps track of the spills as they're staged, and fills in the spill
+ * table of the record that commits them.  Call just before |t| is
+ * staged.
+ */
+static int track_spills(struct lane *l, struct journal_transaction *t)
+{
+        struct open_spill *os;
+        struct spill_ref ref;
+        struct spill_table table;
+
+        switch (t->header.type) {
+        case RECORD_SPILL:
+                os = find_spill(l, t->header.id);
+                if (!os && !(os = add_spill(l, t->header.id)))
+                        return 0;
+
+                memset(&ref, 0, sizeof(ref));
+                ref.segment = l->segment_nr;
+                ref.offset = l->segment_offset + l->batch_len;
+                ref.len = t->header.len;
+                ref.count = t->header.count;
+                return buffer_append(&os->refs, &ref, sizeof(ref));
+
+        case RECORD_SPILLED:
+                os = find_spill(l, t->spill_handle);
+                if (!os || os->refs.len != t->nr_spills * sizeof(ref))
+                        return 0;
+
+                table.handle = t->spill_handle;
+                table.nr_spills = t->nr_spills;
+                table.ios = t->spilled_ios;
+
+                /* the space was reserved when it was committed */
+                t->table.len = 0;
+                buffer_append(&t->table, os->refs.data, os->refs.len);
+                buffer_append(&t->table, &table, sizeof(table));
+                t->body_crc = crc32c(t->body_crc, t->table.data, t->table.len);
+                t->entry.first_segment = os->first_segment;
+                remove_spill(l, os);
+                break;
+
+        case RECORD_ABORT:
+                os = find_spill(l, t->header.id);
+                if (os)
+                        remove_spill(l, os);
+                break;
+        }
+
+        return 1;
+}
+
+/*
+ * Unless |copy| is set the record's ios and data are written from the
+ * record itself, so it has to stay around until the batch is written.
+ */
+static void stage_sealed(struct lane *l, struct journal_transaction *t, int copy)
+{
+        uint64_t nr;
+        struct record_commit commit;
+
+        t->entry.id = t->header.id;
+        t->entry.segment = l->segment_nr;
+        t->entry.offset = l->segment_offset + l->batch_len;
+        t->entry.len = t->header.len;
+        t->entry.lane = l->nr;
+        if (t->header.type != RECORD_SPILLED)
+                t->entry.first_segment = l->segment_nr;
+
+        t->header.crc = record_crc(&t->header, t->body_crc, l->segment_nr);
+        set_commit(&commit, &t->header);
+
+        stage(l, &t->header, sizeof(t->header));
+        if (copy) {
+                stage(l, t->ios.data, t->ios.len);
+                stage(l, t->data.data, t->data.len);
+                stage(l, t->refs.data, t->refs.len);
+                stage(l, t->table.data, t->table.len);
+        } else {
+                stage_ref(l, t->ios.data, t->ios.len);
+                stage_ref(l, t->data.data, t->data.len);
+                stage_ref(l, t->refs.data, t->refs.len);
+                stage_ref(l, t->table.data, t->table.len);
+        }
+        stage(l, &commit, sizeof(commit));
+
+        /* a spilled transaction holds on to every segment its spills are in */
+        if (is_transaction(t->header.type))
+                for (nr = t->entry.first_segment; nr <= l->segment_nr; nr++)
+                        if (nr >= l->oldest_segment)
+                                l->last_ids[nr - l->oldest_segment] = t->header.id;
+}
+
+/*
+ * Adds a transaction that's just been staged to the segment's index,
+ * and marks it if it's due one.  The mark can be found before the
+ * transaction is durable, but nothing looks for a transaction until it
+ * is, and a reader never goes past the lane's durable end.
+ */
+static int index_transaction(struct lane *l, struct journal_transaction *t)
+{
+        int r;
+        struct journal *j = l->j;
+        struct txn_entry *e = &t->entry;
+        struct index_mark im;
+        struct index_pin ip;
+        struct index_txn it;
+
+        memset(&it, 0, sizeof(it));
+        it.id = e->id;
+        it.refers = t->refers;
+        it.count = t->header.count;
+        if (!buffer_append(&l->index_txns, &it, sizeof(it)) ||
+            !buffer_append(&l->index_txns, t->ios.data, io_index_len(it.count)))
+                return 0;
+
+        l->index_nr_txns++;
+        l->index_last_id = e->id;
+        if (e->first_segment < e->segment) {
+                ip.id = e->id;
+                ip.first_segment = e->first_segment;
+                if (!buffer_append(&l->index_pins, &ip, sizeof(ip)))
+                        return 0;
+        }
+
+        if (!mark_due(l, e->segment))
+                return 1;
+
+        im.id = e->id;
+        im.offset = e->offset;
+        pthread_mutex_lock(&j->lock);
+        r = push_mark(l, e->id, e->segment, e->offset);
+        pthread_mutex_unlock(&j->lock);
+
+        return r && buffer_append(&l->index_marks, &im, sizeof(im));
+}
+
+/*
+ * Segments are preallocated, so appending to one doesn't need the
+ * filesystem to allocate blocks and sync its metadata each time.  A
+ * segment for a record bigger than segment_size is made big enough, and
+ * isn't reused.
+ */
+static int open_segment(struct lane *l, uint64_t nr, uint64_t needed)
+{
+        int fd = -1, recycled = 0;
+        char path[PATH_MAX];
+        struct journal *j = l->j;
+        struct segment_header *h;
+        struct journal_transaction *t;
+        uint64_t size, devices_len;
+        LIST_INIT(devices);
+
+        if (!track_segment(l, nr) || !device_records(j, &devices, &devices_len)) {
+                free_records(&devices);
+                return 0;
+        }
+
+        size = align_up(SEGMENT_HEADER_SIZE + devices_len + needed + PAD_RESERVE);
+        if (size < j->opts.segment_size)
+                size = j->opts.segment_size;
+
+        segment_path(l, nr, path, sizeof(path));
+        if (size == j->opts.segment_size) {
+                fd = recycle_segment(l, path);
+                recycled = fd >= 0;
+        }
+
+        if (fd < 0) {
+                fd = create_segment_file(l, path);
+                if (fd < 0) {
+                        error("couldn't create journal segment %s: %s", path, strerror(errno));
+                        free_records(&devices);
+                        return 0;
+                }
+
+                if (fallocate(fd, 0, 0, size) < 0 && errno != EOPNOTSUPP) {
+                        error("couldn't allocate journal segment %s: %s", path, strerror(errno));
+                        close(fd);
+                        unlink(path);
+                        free_records(&devices);
+                        return 0;
+                }
+        }
+
+        /* the segment must still be there after a crash */
+        if (!sync_dir(l)) {
+                error("couldn't sync journal directory %s", l->dir);
+                close(fd);
+                free_records(&devices);
+                return 0;
+        }
+
+        l->segment_nr = nr;
+        l->segment_fd = fd;
+        l->segment_offset = 0;
+        l->segment_size = size;
+
+        pthread_mutex_lock(&j->lock);
+        if (recycled)
+                j->stats.recycled++;
+        pthread_mutex_unlock(&j->lock);
+
+        /* the header and devices go out with the first batch */
+        if (!reserve_batch(l, SEGMENT_HEADER_SIZE + devices_len, 1)) {
+                free_records(&devices);
+                return 0;
+        }
+
+        h = l->staging + l->staging_len;
+        memset(h, 0, SEGMENT_HEADER_SIZE);
+        h->magic = JOURNAL_MAGIC;
+        h->version = JOURNAL_VERSION;
+        h->nr = nr;
+        h->lane = l->nr;
+        h->nr_lanes = j->nr_lanes;
+        staged(l, SEGMENT_HEADER_SIZE);
+
+        list_iterate_items (t, &devices)
+                stage_sealed(l, t, 1);
+        free_records(&devices);
+
+        return 1;
+}
+
+static int stage_record(struct lane *l, struct journal_transaction *t)
+{
+        uint64_t len = t->header.len, end = l->segment_offset + l->batch_len;
+
+        /* a record never spans segments */
+        if (l->segment_fd < 0 ||
+            (end + len > l->j->opts.segment_size && end > SEGMENT_HEADER_SIZE)) {
+                if (l->segment_fd >= 0 && !close_segment(l))
+                        return 0;
+
+                if (!open_segment(l, l->segment_nr + 1, len))
+                        return 0;
+        }
+
+        if (l->batch_len && l->batch_len + len > STAGING_SIZE && !flush_staging(l))
+                return 0;
+
+        /* the header and commit, and the ios, data and spill table unless they're copied */
+        if (!reserve_batch(l, direct(l) ? len + PAD_RESERVE : MIN_RECORD, 5) ||
+            !track_spills(l, t))
+                return 0;
+
+        stage_sealed(l, t, 0);
+        return !is_transaction(t->header.type) || index_transaction(l, t);
+}
+
+/* Call with the lock held */
+static void fail_journal(struct journal *j)
+{
+        if (!j->failed) {
+                error("journal write failed: %s", strerror(errno));
+                j->failed = 1;
+        }
+}
+
+/*
+ * Queues a transaction that's durable in its lane to be completed in
+ * id order.  It's usually the newest, so the search starts from the
+ * back.  Call with the lock held.
+ */
+static void add_durable(struct journal *j, struct journal_transaction *t)
+{
+        struct list *pos;
+
+        for (pos = j->durable.p; pos != &j->durable; pos = pos->p)
+                if (list_item(pos, struct journal_transaction)->header.id < t->header.id)
+                        break;
+
+        list_add_h(pos, &t->list);
+}
+
+/*
+ * Tail cache.  A transaction is held by the writer until it's been
+ * notified, and by each subscriber shipping it.  The oldest are let go
+ * once nobody's holding them, and either the cache is over size or
+ * every subscriber has shipped them.  Call with the lock held.
+ */
+static int tail_wanted(struct journal *j, struct journal_transaction *t)
+{
+        struct journal_subscriber *s;
+
+        if (j->tail_bytes > j->opts.tail_cache)
+                return 0;
+
+        list_iterate_items (s, &j->subscribers)
+                if (s->next <= t->header.id)
+                        return 1;
+
+        return 0;
+}
+
+static void trim_tail(struct journal *j, struct list *unused)
+{
+        struct journal_transaction *t;
+
+        while (!list_empty(&j->tail)) {
+                t = list_struct_base(j->tail.n, struct journal_transaction, tail);
+                if (t->users || tail_wanted(j, t))
+                        break;
+
+                list_del(&t->tail);
+                j->tail_bytes -= t->header.len;
+                list_add(unused, &t->list);
+        }
+}
+
+/* A spilled transaction doesn't have all its data in memory */
+static void cache_record(struct journal *j, struct journal_transaction *t)
+{
+        if (list_empty(&j->subscribers) || !j->opts.tail_cache ||
+            t->header.type == RECORD_SPILLED)
+                return;
+
+        t->cached = 1;
+        t->users = 1;
+        list_add(&j->tail, &t->tail);
+        j->tail_bytes += t->header.len;
+}
+
+/* Returns the cached transaction |id|, or NULL.  Call with the lock held. */
+static struct journal_transaction *cached_record(struct journal *j, uint64_t id)
+{
+        struct journal_transaction *t;
+
+        if (list_empty(&j->tail) ||
+            list_struct_base(j->tail.n, struct journal_transaction, tail)->header.id > id)
+                return NULL;
+
+        /* subscribers that keep up want the newest */
+        list_iterate_back_items_gen (t, &j->tail, tail)
+                if (t->header.id <= id)
+                        return (t->header.id == id) ? t : NULL;
+
+        return NULL;
+}
+
+/*
+ * Frees records that are finished with, apart from those the cache is
+ * holding on to.  Nothing else touches |cached| once it's set.
+ */
+static void release_records(struct journal *j, struct list *records)
+{
+        struct journal_transaction *t, *tmp;
+        LIST_INIT(unused);
+
+        list_iterate_items_safe (t, tmp, records)
+                if (!t->cached) {
+                        list_del(&t->list);
+                        free_record(t);
+                }
+
+        if (list_empty(records))
+                return;
+
+        pthread_mutex_lock(&j->lock);
+        list_iterate_items_safe (t, tmp, records) {
+                list_del(&t->list);
+                t->users--;
+        }
+        trim_tail(j, &unused);
+        pthread_mutex_unlock(&j->lock);
+
+        free_records(&unused);
+}
+
+/* Call with the lock held */
+static int shippable(struct journal_subscriber *s)
+{
+        struct journal *j = s->j;
+        return j->nr_runs && j->runs[j->nr_runs - 1].last >= s->next;
+}
+
+/* Call with the lock held */
+static void wake_subscribers(struct journal *j)
+{
+        struct journal_subscriber *s;
+
+        pthread_cond_broadcast(&j->shippable);
+        list_iterate_items (s, &j->subscribers)
+                if (s->has_wake && shippable(s))
+                        execute(&s->wake);
+}
+
+/*
+ * Moves the transactions that are now durable along with everything
+ * before them into the index, and onto |done| to be notified.  Once the
+ * journal has failed everything waiting is let go.  Call with the lock
+ * held.
+ */
+static void complete_durable(struct journal *j, struct list *done)
+{
+        uint64_t written = j->written, now = now_ns();
+        struct journal_transaction *t;
+        struct io_columns c;
+
+        while (!list_empty(&j->durable)) {
+                t = list_item(j->durable.n, struct journal_transaction);
+                if (!j->failed && t->header.id != j->written + 1)
+                        break;
+
+                list_del(&t->list);
+                release_ref(j, t);
+                if (!j->failed) {
+                        io_columns_init(&c, t->ios.data, t->header.count);
+                        if (push_id(j, t->header.id) &&
+                            (!t->refers || push_referrer(j, t->header.id, t->refers)) &&
+                            index_ios(j, t->header.id, &c, t->header.count)) {
+                                count_journalled(j, &c, t->header.count);
+                                j->written = t->header.id;
+                                j->stats.commits++;
+                                j->stats.commit_ns += now - t->committed;
+                                cache_record(j, t);
+                        } else
+                                fail_journal(j);
+                }
+                list_add(done, &t->list);
+        }
+
+        if (j->written != written && !list_empty(&j->subscribers))
+                wake_subscribers(j);
+}
+
+static void write_batch(struct lane *l, struct list *batch)
+{
+        int ok = 1;
+        uint64_t bytes = 0, queued = 0;
+        struct journal *j = l->j;
+        struct journal_transaction *t, *tmp;
+        LIST_INIT(done);
+
+        list_iterate_items (t, batch)
+                queued += t->header.len;
+
+        list_iterate_items (t, batch) {
+                if (!stage_record(l, t)) {
+                        ok = 0;
+                        break;
+                }
+
+                bytes += t->header.len;
+        }
+
+        /* one write and one sync for the whole batch */
+        if (ok && (!flush_staging(l) || fdatasync(l->segment_fd)))
+                ok = 0;
+
+        if (!ok)
+                discard_batch(l);
+
+        pthread_mutex_lock(&j->lock);
+        if (ok) {
+                j->stats.syncs++;
+                j->stats.bytes += bytes;
+                j->since_checkpoint += bytes;
+                l->current_bytes = l->segment_offset;
+                l->durable_segment = l->segment_nr;
+                l->durable_offset = l->segment_offset;
+        } else
+                fail_journal(j);
+
+        list_iterate_items_safe (t, tmp, batch)
+                if (is_transaction(t->header.type)) {
+                        list_del(&t->list);
+                        if (ok)
+                                add_durable(j, t);
+                        else {
+                                release_ref(j, t);
+                                list_add(&done, &t->list);
+                        }
+
+                } else if (ok && t->header.type == RECORD_DROP)
+                        l->dropped_durable = t->header.id;
+
+        complete_durable(j, &done);
+        l->backlog -= queued;
+        pthread_mutex_unlock(&j->lock);
+
+        list_iterate_items (t, batch)
+                if (t->header.type == RECORD_SPILL && t->has_notify)
+                        execute(&t->notify);
+        free_records(batch);
+        list_iterate_items (t, &done)
+                if (t->has_notify)
+                        execute(&t->notify);
+        release_records(j, &done);
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Checkpoints.  They're written by a thread of their own, asked for by
+ * the writers, and once the writers have all stopped.  A checkpoint is
+ * only the journal's counters, the lanes' positions, the devices and
+ * the runs of ids, so the lock is only held for a copy of those; each
+ * segment's share of the rest went into its index when it was closed.
+ */
+static void journal_path(struct journal *j, const char *name, char *path, size_t len)
+{
+        snprintf(path, len, "%s/%s", j->dir, name);
+}
+
+/*
+ * A lane is checkpointed from where its last sync got to, or from its
+ * oldest transaction that's still waiting on another lane, since that
+ * hasn't been counted yet.  Call with the lock held.
+ */
+static void lane_position(struct journal *j, struct lane *l, struct checkpoint_lane *cl)
+{
+        struct journal_transaction *t;
+
+        cl->segment = l->durable_segment;
+        cl->offset = l->durable_offset;
+
+        list_iterate_items (t, &j->durable)
+                if (t->entry.lane == l->nr) {
+                        cl->segment = t->entry.segment;
+                        cl->offset = t->entry.offset;
+                        break;
+                }
+}
+
+/* Call with the lock held */
+static int build_checkpoint(struct journal *j, struct buffer *b)
+{
+        size_t i;
+        struct checkpoint_header h, *hp;
+        struct checkpoint_lane cl;
+        struct checkpoint_device cd;
+        struct checkpoint_run cr;
+
+        memset(&h, 0, sizeof(h));
+        h.magic = CHECKPOINT_MAGIC;
+        h.version = CHECKPOINT_VERSION;
+        h.nr_devices = j->nr_devices;
+        h.nr_lanes = j->nr_lanes;
+        h.next_id = j->written + 1;
+        h.dropped = j->dropped;
+        h.nr_runs = j->nr_runs;
+
+        if (!buffer_append(b, &h, sizeof(h)))
+                return 0;
+
+        for (i = 0; i < j->nr_lanes; i++) {
+                lane_position(j, j->lanes + i, &cl);
+                if (!buffer_append(b, &cl, sizeof(cl)))
+                        return 0;
+        }
+
+        for (i = 0; i < j->nr_devices; i++) {
+                struct journal_device *dev = j->devices[i];
+
+                cd.id = dev->id;
+                cd.name_len = strlen(dev->name);
+                cd.journalled = dev->stats.journalled;
+                cd.replayed = dev->stats.replayed;
+                cd.coalesced = dev->stats.coalesced;
+                if (!buffer_append(b, &cd, sizeof(cd)) ||
+                    !buffer_append(b, dev->name, cd.name_len))
+                        return 0;
+        }
+
+        for (i = 0; i < j->nr_runs; i++) {
+                cr.first = j->runs[i].first;
+                cr.last = j->runs[i].last;
+                if (!buffer_append(b, &cr, sizeof(cr)))
+                        return 0;
+        }
+
+        hp = b->data;
+        hp->len = b->len;
+        hp->crc = crc32c(crc32c(0, hp + 1, b->len - sizeof(*hp)), hp, sizeof(*hp));
+        return 1;
+}
+
+/*
+ * A checkpoint that can't be written isn't fatal, recovery just has
+ * further to read.
+ */
+static int write_checkpoint(struct journal *j)
+{
+        int fd, r;
+        unsigned i;
+        uint64_t since;
+        char tmp[PATH_MAX], path[PATH_MAX];
+        struct checkpoint_lane *cl;
+        struct buffer b;
+
+        memset(&b, 0, sizeof(b));
+        pthread_mutex_lock(&j->lock);
+        since = j->since_checkpoint;
+        r = build_checkpoint(j, &b);
+        pthread_mutex_unlock(&j->lock);
+
+        journal_path(j, "checkpoint.tmp", tmp, sizeof(tmp));
+        journal_path(j, "checkpoint", path, sizeof(path));
+
+        if (r) {
+                fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                r = fd >= 0 && write_exact(fd, b.data, b.len) && !fdatasync(fd);
+                if (fd >= 0)
+                        close(fd);
+
+                r = r && !rename(tmp, path) && sync_dir(j->lanes);
+        }
+
+        if (r) {
+                cl = (struct checkpoint_lane *) (((struct checkpoint_header *) b.data) + 1);
+                pthread_mutex_lock(&j->lock);
+                j->since_checkpoint -= since;
+                for (i = 0; i < j->nr_lanes; i++)
+                        j->lanes[i].checkpoint_segment = cl[i].segment;
+                pthread_mutex_unlock(&j->lock);
+        } else
+                warn("couldn't write journal checkpoint %s: %s", path, strerror(errno));
+
+        free(b.data);
+        return r;
+}
+
+/*
+ * Wakes the checkpoint thread if a checkpoint's due.  The writers carry
+ * on while it's written.  Call with the lock held.
+ */
+static void maybe_checkpoint(struct journal *j)
+{
+        if (j->opts.checkpoint_interval && !j->failed && !j->checkpoint_wanted &&
+            j->since_checkpoint >= j->opts.checkpoint_interval) {
+                j->checkpoint_wanted = 1;
+                pthread_cond_signal(&j->checkpoint_due);
+        }
+}
+
+/*
+ * A checkpoint that fails is tried again when the next batch asks for
+ * one, rather than straight away.
+ */
+static void *checkpoint_loop(void *context)
+{
+        struct journal *j = context;
+
+        pthread_mutex_lock(&j->lock);
+        for (;;) {
+                while (!j->checkpoint_wanted && !j->stopping)
+                        pthread_cond_wait(&j->checkpoint_due, &j->lock);
+
+                if (j->stopping)
+                        break;
+
+                pthread_mutex_unlock(&j->lock);
+                write_checkpoint(j);
+                pthread_mutex_lock(&j->lock);
+                j->checkpoint_wanted = 0;
+        }
+        pthread_mutex_unlock(&j->lock);
+
+        return NULL;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Space.  A segment whose newest transaction has been dropped holds
+ * only dropped transactions, and device registrations that every later
+ * segment repeats, so it can go, unless a transaction that's still
+ * being built has spilled to it.  The drop record that freed it has to
+ * be durable in the same lane first, or a crash could bring the
+ * transactions back without their data.
+ */
+
+/* Call with the lock held */
+static void roll_reclaim_rate(struct journal *j)
+{
+        uint64_t now = now_ns(), elapsed = now - j->rate_start;
+
+        if (elapsed < RATE_WINDOW * 1000000000ULL)
+                return;
+
+        j->stats.reclaim_rate = j->rate_bytes * 1000000000ULL / elapsed;
+        j->rate_start = now;
+        j->rate_bytes = 0;
+}
+
+/* Returns the bytes freed */
+static uint64_t reclaim_segment(struct lane *l, uint64_t nr)
+{
+        struct stat info;
+        char path[PATH_MAX], spare[PATH_MAX];
+
+        /* first, so an index is never left without its segment */
+        index_path(l, nr, path, sizeof(path));
+        unlink(path);
+
+        segment_path(l, nr, path, sizeof(path));
+        if (stat(path, &info) < 0)
+                return 0;
+
+        if (l->nr_free < l->j->opts.recycle_segments &&
+            (uint64_t) info.st_size == l->j->opts.segment_size) {
+                free_path(l, l->next_free, spare, sizeof(spare));
+                if (!rename(path, spare)) {
+                        l->free_segments[l->nr_free++] = l->next_free++;
+                        return info.st_size;
+                }
+        }
+
+        if (unlink(path) < 0) {
+                warn("couldn't remove journal segment %s: %s", path, strerror(errno));
+                return 0;
+        }
+
+        return info.st_size;
+}
+
+static void reclaim_segments(struct lane *l)
+{
+        size_t i, n;
+        uint64_t dropped, bytes = 0, pinned = pinned_segment(l);
+        struct journal *j = l->j;
+
+        pthread_mutex_lock(&j->lock);
+        dropped = l->dropped_durable;
+        pthread_mutex_unlock(&j->lock);
+
+        /* never the segment being written, or one with spills that may yet be committed */
+        for (n = 0; l->oldest_segment + n < pinned && l->last_ids[n] <= dropped; n++)
+                ;
+
+        if (!n)
+                return;
+
+        for (i = 0; i < n; i++)
+                bytes += reclaim_segment(l, l->oldest_segment + i);
+
+        memmove(l->last_ids, l->last_ids + n, sizeof(*l->last_ids) * (l->nr_last_ids - n));
+        l->nr_last_ids -= n;
+        l->oldest_segment += n;
+
+        pthread_mutex_lock(&j->lock);
+        trim_marks(l, l->oldest_segment);
+        l->closed_bytes -= (bytes < l->closed_bytes) ? bytes : l->closed_bytes;
+        j->stats.reclaimed += bytes;
+        j->rate_bytes += bytes;
+        roll_reclaim_rate(j);
+
+        /* recovery can't use a checkpoint whose segment has gone */
+        if (l->checkpoint_segment && l->checkpoint_segment < l->oldest_segment &&
+            j->opts.checkpoint_interval)
+                j->since_checkpoint = j->opts.checkpoint_interval;
+        pthread_mutex_unlock(&j->lock);
+}
+
+/*----------------------------------------------------------------*/
+
+static void *writer_loop(void *context)
+{
+        struct lane *l = context;
+        struct journal *j = l->j;
+        struct list batch;
+
+        for (;;) {
+                pthread_mutex_lock(&j->lock);
+                maybe_checkpoint(j);
+                while (list_empty(&l->pending) && !j->stopping)
+                        pthread_cond_wait(&l->work, &j->lock);
+
+                if (list_empty(&l->pending)) {
+                        pthread_mutex_unlock(&j->lock);
+                        break;
+                }
+
+                list_init(&batch);
+                list_splice(&batch, &l->pending);
+                pthread_mutex_unlock(&j->lock);
+
+                write_batch(l, &batch);
+                reclaim_segments(l);
+        }
+
+        return NULL;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Recovery.  Each lane is read in turn, gathering its transactions to
+ * be merged into id order once they all have been.
+ */
+static int read_exact(int fd, void *data, size_t len, uint64_t offset)
+{
+        ssize_t r = pread(fd, data, len, offset);
+        return r >= 0 && (size_t) r == len;
+}
+
+static int record_valid(struct record_header *h, uint64_t space)
+{
+        if (h->magic != RECORD_MAGIC || h->len < MIN_RECORD || h->len > space ||
+            h->len != record_pad(h->len))
+                return 0;
+
+        switch (h->type) {
+        case RECORD_TRANSACTION:
+                return MIN_RECORD + io_columns_len(h->count) <= h->len;
+
+        case RECORD_SPILLED:
+                return MIN_RECORD + io_columns_len(h->count) + sizeof(struct spill_table) <= h->len;
+
+        case RECORD_DEVICE:
+                return MIN_RECORD + h->count <= h->len;
+
+        case RECORD_DROP:
+        case RECORD_PAD:
+        case RECORD_SPILL:
+        case RECORD_ABORT:
+                return 1;
+        }
+
+        return 0;
+}
+
+static int commit_valid(struct record_header *h, struct record_commit *c)
+{
+        return c->magic == COMMIT_MAGIC && c->crc == h->crc && c->id == h->id;
+}
+
+/* |h| is the whole record, from segment |nr| */
+static int record_intact(struct record_header *h, uint64_t nr)
+{
+        struct record_commit *c = (struct record_commit *) (((char *) h) + h->len - sizeof(*c));
+
+        return commit_valid(h, c) &&
+                record_crc(h, crc32c(0, h + 1, h->len - MIN_RECORD), nr) == h->crc;
+}
+
+/*
+ * Reads just the header and commit marker of each record, unless
+ * |verify| is set when the whole record is read and its crc checked.
+ */
+static int read_record(int fd, uint64_t nr, uint64_t offset, struct record_header *h,
+                       struct buffer *b, int verify)
+{
+        struct record_commit c;
+
+        if (!verify)
+                return read_exact(fd, &c, sizeof(c), offset + h->len - sizeof(c)) &&
+                        commit_valid(h, &c);
+
+        b->len = 0;
+        return buffer_reserve(b, h->len) &&
+                read_exact(fd, b->data, h->len, offset) &&
+                !memcmp(b->data, h, sizeof(*h)) &&
+                record_intact(b->data, nr);
+}
+
+/*
+ * The lanes are merged a segment at a time, so recovery only ever holds
+ * one segment's transactions from each: in |txns|, as the segment's
+ * index has them, an index_txn followed by the io columns the sector
+ * index needs for each.  They come from the index, or from reading the
+ * segment.
+ */
+struct lane_recovery {
+        struct lane *l;
+        uint64_t *segments;
+        size_t count;
+        size_t next;                    /* the next segment to read */
+        uint64_t checkpoint_segment;    /* 0 without a checkpoint */
+        uint64_t checkpoint_offset;
+        struct buffer txns;
+        size_t pos;                     /* the next transaction in |txns| */
+};
+
+struct recovery {
+        uint64_t checkpointed;          /* the checkpoint has every transaction before this */
+        uint64_t dropped;
+        unsigned scanned;
+        int failed;
+};
+
+/*
+ * Finds the oldest transaction that the ios of |h| refer to, from the
+ * io_refs at the end of the record, before any spill table.
+ */
+static int read_refers(int fd, uint64_t offset, struct record_header *h, uint64_t *refers)
+{
+        int r = 0;
+        uint32_t i, nr = 0, *codecs = malloc(sizeof(*codecs) * (h->count ? h->count : 1));
+        uint64_t end = offset + h->len - sizeof(struct record_commit), len;
+        struct spill_table table;
+        struct io_ref *refs = NULL;
+
+        *refers = 0;
+        if (!codecs || !read_exact(fd, codecs, sizeof(*codecs) * h->count,
+                                   offset + sizeof(*h) + (uint64_t) h->count * IO_INDEX_BYTES))
+                goto out;
+
+        for (i = 0; i < h->count; i++)
+                nr += codecs[i] == IO_REFERENCE;
+        if (!nr) {
+                r = 1;
+                goto out;
+        }
+
+        len = MIN_RECORD + io_columns_len(h->count) + nr * sizeof(*refs);
+        if (h->type == RECORD_SPILLED) {
+                if (!read_exact(fd, &table, sizeof(table), end - sizeof(table)))
+                        goto out;
+                end -= spill_table_len(table.nr_spills);
+                len += spill_table_len(table.nr_spills);
+        }
+
+        refs = malloc(sizeof(*refs) * nr);
+        if (len > h->len || !refs ||
+            !read_exact(fd, refs, sizeof(*refs) * nr, end - sizeof(*refs) * nr))
+                goto out;
+
+        for (i = 0; i < nr; i++)
+                if (!*refers || refs[i].id < *refers)
+                        *refers = refs[i].id;
+        r = 1;
+
+out:
+        free(codecs);
+        free(refs);
+        return r;
+}
+
+/* Adds transaction |h|, reading its io columns */
+static int found_txn(struct buffer *txns, int fd, uint64_t offset, struct record_header *h)
+{
+        struct index_txn it;
+        size_t ios = io_index_len(h->count);
+
+        memset(&it, 0, sizeof(it));
+        it.id = h->id;
+        it.count = h->count;
+        if (!read_refers(fd, offset, h, &it.refers) ||
+            !buffer_append(txns, &it, sizeof(it)) || !buffer_reserve(txns, ios) ||
+            !read_exact(fd, txns->data + txns->len, ios, offset + sizeof(*h)))
+                return 0;
+
+        txns->len += ios;
+        return 1;
+}
+
+/*
+ * Reads the spill table at the end of RECORD_SPILLED |h|, to find the
+ * segment its oldest spill is in.
+ */
+static int first_spill(int fd, uint64_t nr, uint64_t offset, struct record_header *h,
+                       uint64_t *segment)
+{
+        uint64_t end = offset + h->len - sizeof(struct record_commit) - sizeof(struct spill_table);
+        struct spill_table table;
+        struct spill_ref ref;
+
+        if (!read_exact(fd, &table, sizeof(table), end) || !table.nr_spills ||
+            MIN_RECORD + io_columns_len(h->count) + spill_table_len(table.nr_spills) > h->len ||
+            !read_exact(fd, &ref, sizeof(ref), end - table.nr_spills * sizeof(ref)) ||
+            ref.segment > nr)
+                return 0;
+
+        *segment = ref.segment;
+        return 1;
+}
+
+/* Transaction |id| holds on to segments |first| to |last| */
+static void hold_segments(struct lane *l, uint64_t id, uint64_t first, uint64_t last)
+{
+        uint64_t nr;
+
+        for (nr = (first > l->oldest_segment) ? first : l->oldest_segment;
+             nr <= last && nr - l->oldest_segment < l->nr_last_ids; nr++)
+                if (l->last_ids[nr - l->oldest_segment] < id)
+                        l->last_ids[nr - l->oldest_segment] = id;
+}
+
+/*
+ * Notes a transaction in the lane, in the lane's order: the segments it
+ * holds on to, and a mark if it's due one.
+ */
+static int recovered_transaction(struct lane *l, struct txn_entry *e)
+{
+        hold_segments(l, e->id, e->first_segment, e->segment);
+        return !mark_due(l, e->segment) || push_mark(l, e->id, e->segment, e->offset);
+}
+
+/* |covered| if the record is before the checkpoint's position */
+static int recover_record(struct lane_recovery *lr, int fd, uint64_t nr, uint64_t offset,
+                          struct record_header *h, int covered, struct recovery *r)
+{
+        struct lane *l = lr->l;
+        struct journal *j = l->j;
+        char name[NAME_MAX + 1];
+        struct txn_entry e;
+
+        switch (h->type) {
+        case RECORD_TRANSACTION:
+        case RECORD_SPILLED:
+                e.id = h->id;
+                e.segment = nr;
+                e.offset = offset;
+                e.len = h->len;
+                e.first_segment = nr;
+                e.lane = l->nr;
+                if ((h->type == RECORD_SPILLED && !first_spill(fd, nr, offset, h, &e.first_segment)) ||
+                    !recovered_transaction(l, &e) ||
+                    (!covered && h->id < r->checkpointed))
+                        return 0;
+
+                if (h->id > j->dropped && !found_txn(&lr->txns, fd, offset, h))
+                        return 0;
+                break;
+
+        case RECORD_DEVICE:
+                if (h->count > NAME_MAX ||
+                    !read_exact(fd, name, h->count, offset + sizeof(*h)))
+                        return 0;
+
+                /* the checkpoint, or another lane, may have had it already */
+                if (h->id < j->nr_devices &&
+                    strlen(j->devices[h->id]->name) == h->count &&
+                    !memcmp(j->devices[h->id]->name, name, h->count))
+                        break;
+
+                if (!add_device(j, h->id, name, h->count))
+                        return 0;
+                break;
+
+        case RECORD_DROP:
+                if (h->id > r->dropped)
+                        r->dropped = h->id;
+                break;
+        }
+
+        /*
+         * RECORD_PAD has nothing to recover, and nor have spills: they're
+         * found through the record that commits them, if there is one.
+         */
+        return 1;
+}
+
+static int zero_tail(const char *path, uint64_t offset, uint64_t len)
+{
+        int fd, r;
+        char zeroes[DIRECT_ALIGN];
+
+        if (len > sizeof(zeroes))
+                len = sizeof(zeroes);
+
+        fd = open(path, O_WRONLY);
+        if (fd < 0)
+                return 0;
+
+        memset(zeroes, 0, len);
+        r = pwrite(fd, zeroes, len, offset) == (ssize_t) len && !fdatasync(fd);
+        close(fd);
+
+        return r;
+}
+
+/*
+ * Recovers the records of segment |nr|, setting |end| to where they
+ * stop.  Those before |covered| are in the checkpoint, so they're only
+ * read for where the transactions are.
+ */
+static int recover_segment(struct lane_recovery *lr, uint64_t nr, uint64_t covered,
+                           int verify, uint64_t *end, struct recovery *r)
+{
+        int fd, clean = 0;
+        uint64_t offset = SEGMENT_HEADER_SIZE;
+        char path[PATH_MAX];
+        struct lane *l = lr->l;
+        struct journal *j = l->j;
+        struct stat info;
+        struct segment_header sh;
+        struct record_header h;
+        struct buffer b;
+
+        *end = offset;
+
+        memset(&b, 0, sizeof(b));
+        segment_path(l, nr, path, sizeof(path));
+        fd = open(path, O_RDONLY);
+        if (fd < 0 || fstat(fd, &info) < 0) {
+                error("couldn't open journal segment %s", path);
+                if (fd >= 0)
+                        close(fd);
+                return 0;
+        }
+
+        if (!read_exact(fd, &sh, sizeof(sh), 0) ||
+            sh.magic != JOURNAL_MAGIC || sh.version != JOURNAL_VERSION || sh.nr != nr) {
+                /* a crash while the segment was being created */
+                warn("ignoring journal segment %s, bad header", path);
+                close(fd);
+                return 1;
+        }
+
+        if (sh.lane != l->nr || sh.nr_lanes != j->nr_lanes) {
+                error("journal segment %s is from lane %u of %u, not lane %u of %u",
+                      path, sh.lane, sh.nr_lanes, l->nr, j->nr_lanes);
+                close(fd);
+                return 0;
+        }
+
+        while (offset + sizeof(h) <= (uint64_t) info.st_size) {
+                if (!read_exact(fd, &h, sizeof(h), offset))
+                        break;
+
+                if (!record_valid(&h, info.st_size - offset)) {
+                        /* the unwritten part of a preallocated segment */
+                        clean = !h.magic;
+                        break;
+                }
+
+                if (!read_record(fd, nr, offset, &h, &b, verify && offset >= covered))
+                        break;
+
+                if (!recover_record(lr, fd, nr, offset, &h, offset < covered, r)) {
+                        error("couldn't recover journal record at %s:%llu",
+                              path, (unsigned long long) offset);
+                        free(b.data);
+                        close(fd);
+                        return 0;
+                }
+
+                if (offset >= covered)
+                        j->since_checkpoint += h.len;
+                offset += h.len;
+        }
+
+        *end = offset;
+        free(b.data);
+        close(fd);
+
+        if (!clean && offset < (uint64_t) info.st_size) {
+                warn("journal segment %s torn at %llu, ignoring the last %llu bytes",
+                     path, (unsigned long long) offset,
+                     (unsigned long long) (info.st_size - offset));
+
+                /* so it stays ignored once this is no longer the newest segment */
+                if (!zero_tail(path, offset, info.st_size - offset)) {
+                        error("couldn't end journal segment %s: %s", path, strerror(errno));
+                        return 0;
+                }
+        }
+
+        return 1;
+}
+
+/*
+ * Checks a checkpoint over before anything is taken from it, so a bad
+ * one just means a full scan.
+ */
+static int checkpoint_valid(struct checkpoint_header *h, uint64_t len)
+{
+        uint32_t i;
+        uint64_t used = sizeof(*h);
+        struct checkpoint_header copy;
+        struct checkpoint_device *cd;
+
+        if (len < sizeof(*h) || h->magic != CHECKPOINT_MAGIC ||
+            h->version != CHECKPOINT_VERSION || h->len != len)
+                return 0;
+
+        copy = *h;
+        copy.crc = 0;
+        if (crc32c(crc32c(0, h + 1, len - sizeof(*h)), &copy, sizeof(copy)) != h->crc)
+                return 0;
+
+        used += (uint64_t) h->nr_lanes * sizeof(struct checkpoint_lane);
+        for (i = 0; i < h->nr_devices; i++) {
+                if (used + sizeof(*cd) > len)
+                        return 0;
+
+                cd = (struct checkpoint_device *) (((char *) h) + used);
+                if (cd->id != i || cd->name_len > NAME_MAX)
+                        return 0;
+                used += sizeof(*cd) + record_pad(cd->name_len);
+        }
+
+        return used + h->nr_runs * sizeof(struct checkpoint_run) == len;
+}
+
+static int apply_checkpoint(struct journal *j, struct checkpoint_header *h)
+{
+        uint64_t i;
+        struct checkpoint_lane *cl = (struct checkpoint_lane *) (h + 1);
+        char *p = (char *) (cl + h->nr_lanes);
+        struct journal_device *dev;
+        struct checkpoint_device *cd;
+        struct checkpoint_run *cr;
+        uint64_t last = 0;
+
+        for (i = 0; i < h->nr_devices; i++) {
+                cd = (struct checkpoint_device *) p;
+                dev = add_device(j, cd->id, (char *) (cd + 1), cd->name_len);
+                if (!dev)
+                        return 0;
+
+                dev->stats.journalled = cd->journalled;
+                dev->stats.replayed = cd->replayed;
+                dev->stats.coalesced = cd->coalesced;
+                p += sizeof(*cd) + record_pad(cd->name_len);
+        }
+
+        cr = (struct checkpoint_run *) p;
+        for (i = 0; i < h->nr_runs; i++, cr++) {
+                if (cr->first > cr->last || cr->first <= last || cr->last >= h->next_id ||
+                    !push_run(j, cr->first, cr->last))
+                        return 0;
+                last = cr->last;
+        }
+
+        j->next_id = h->next_id;
+        j->dropped = h->dropped;
+        for (i = 0; i < j->nr_lanes; i++) {
+                j->lanes[i].segment_nr = cl[i].segment;
+                j->lanes[i].segment_offset = cl[i].offset;
+                j->lanes[i].checkpoint_segment = cl[i].segment;
+        }
+        return 1;
+}
+
+static int holds(uint64_t *segments, size_t count, uint64_t nr)
+{
+        size_t i;
+
+        for (i = 0; i < count; i++)
+                if (segments[i] == nr)
+                        return 1;
+
+        return 0;
+}
+
+/*
+ * Loads the checkpoint, if there's a usable one, setting |loaded|.
+ * It's only usable if it has the same lanes, and the segment each lane
+ * was checkpointed in is still there.
+ */
+static int load_checkpoint(struct journal *j, uint64_t **segments, size_t *counts, int *loaded)
+{
+        int fd, r = 1;
+        unsigned i;
+        char path[PATH_MAX];
+        struct stat info;
+        struct checkpoint_header *h;
+        struct checkpoint_lane *cl;
+
+        *loaded = 0;
+        journal_path(j, "checkpoint", path, sizeof(path));
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return 1;
+
+        if (fstat(fd, &info) < 0 || !(h = malloc(info.st_size ? info.st_size : 1))) {
+                close(fd);
+                return 0;
+        }
+
+        if (!read_exact(fd, h, info.st_size, 0) || !checkpoint_valid(h, info.st_size)) {
+                warn("ignoring bad journal checkpoint %s", path);
+                goto out;
+        }
+
+        if (h->nr_lanes != j->nr_lanes) {
+                warn("ignoring journal checkpoint %s, it has %u lanes", path, h->nr_lanes);
+                goto out;
+        }
+
+        cl = (struct checkpoint_lane *) (h + 1);
+        for (i = 0; i < j->nr_lanes; i++)
+                if (cl[i].segment && !holds(segments[i], counts[i], cl[i].segment)) {
+                        warn("ignoring journal checkpoint %s, segment %llu of %s has gone",
+                             path, (unsigned long long) cl[i].segment, j->lanes[i].dir);
+                        goto out;
+                }
+
+        r = apply_checkpoint(j, h);
+        *loaded = r;
+
+out:
+        free(h);
+        close(fd);
+        return r;
+}
+
+static int cmp_u64(const void *lhs, const void *rhs)
+{
+        uint64_t l = *((uint64_t *) lhs), r = *((uint64_t *) rhs);
+        return (l < r) ? -1 : (l > r);
+}
+
+/*
+ * Fills in |nrs| with the numbers of the files in the lane called
+ * <prefix><n>, in order.  The caller frees it.
+ */
+static int list_files(struct lane *l, const char *prefix, uint64_t **result, size_t *count)
+{
+        DIR *d;
+        struct dirent *de;
+        size_t size = 0, prefix_len = strlen(prefix);
+        uint64_t *nrs = NULL, *tmp;
+
+        *count = 0;
+        *result = NULL;
+        d = opendir(l->dir);
+        if (!d)
+                return 0;
+
+        while ((de = readdir(d))) {
+                char *end;
+                uint64_t nr;
+
+                if (strncmp(de->d_name, prefix, prefix_len))
+                        continue;
+
+                nr = strtoull(de->d_name + prefix_len, &end, 10);
+                if (*end || !nr)
+                        continue;
+
+                if (*count == size) {
+                        size = size ? size * 2 : 64;
+                        tmp = realloc(nrs, sizeof(*nrs) * size);
+                        if (!tmp) {
+                                free(nrs);
+                                closedir(d);
+                                return 0;
+                        }
+                        nrs = tmp;
+                }
+
+                nrs[(*count)++] = nr;
+        }
+
+        closedir(d);
+        qsort(nrs, *count, sizeof(*nrs), cmp_u64);
+        *result = nrs;
+        return 1;
+}
+
+static uint64_t file_size(const char *path)
+{
+        struct stat info;
+        return (stat(path, &info) < 0) ? 0 : info.st_size;
+}
+
+/*
+ * Picks up the free segments left by the last run, keeping as many as
+ * may be reused.
+ */
+static int recover_free_segments(struct lane *l)
+{
+        size_t i, count;
+        uint64_t *nrs;
+        char path[PATH_MAX];
+
+        if (!list_files(l, "free.", &nrs, &count))
+                return 0;
+
+        for (i = 0; i < count; i++) {
+                free_path(l, nrs[i], path, sizeof(path));
+                if (l->nr_free < l->j->opts.recycle_segments &&
+                    file_size(path) == l->j->opts.segment_size)
+                        l->free_segments[l->nr_free++] = nrs[i];
+                else
+                        unlink(path);
+        }
+
+        l->next_free = count ? nrs[count - 1] + 1 : 1;
+        free(nrs);
+        return 1;
+}
+
+/*
+ * Checks the transactions at the end of an index, |len| bytes of them,
+ * which should be |nr| index_txns in id order, each with its columns.
+ */
+static int index_txns_valid(void *base, uint64_t len, uint64_t nr)
+{
+        uint64_t n, used = 0, last = 0;
+        struct index_txn *it;
+
+        for (n = 0; n < nr; n++) {
+                if (len - used < sizeof(*it))
+                        return 0;
+
+                it = (struct index_txn *) (((char *) base) + used);
+                used += sizeof(*it);
+                if (it->id <= last || len - used < io_index_len(it->count))
+                        return 0;
+
+                used += io_index_len(it->count);
+                last = it->id;
+        }
+
+        return used == len;
+}
+
+/*
+ * Takes the marks, pins and transactions of segment |nr|, before the
+ * checkpoint, from its index rather than reading the segment, if the
+ * index is there and good.  The transactions go in |txns|.
+ */
+static int load_segment_index(struct lane *l, uint64_t nr, struct buffer *txns)
+{
+        int fd, r = 0;
+        uint64_t i, last, used;
+        size_t nr_marks = l->nr_marks;
+        char path[PATH_MAX];
+        struct stat info;
+        struct segment_index *si = NULL, copy;
+        struct index_mark *im;
+        struct index_pin *ip;
+
+        index_path(l, nr, path, sizeof(path));
+        fd = open(path, O_RDONLY);
+        if (fd < 0)
+                return 0;
+
+        if (fstat(fd, &info) < 0 || (uint64_t) info.st_size < sizeof(*si) ||
+            !(si = malloc(info.st_size)) || !read_exact(fd, si, info.st_size, 0))
+                goto out;
+
+        copy = *si;
+        copy.crc = 0;
+        if (si->magic != INDEX_MAGIC || si->version != INDEX_VERSION ||
+            si->len != (uint64_t) info.st_size || si->lane != l->nr || si->nr != nr ||
+            crc32c(crc32c(0, si + 1, si->len - sizeof(*si)), &copy, sizeof(copy)) != si->crc ||
+            si->nr_marks > si->len / sizeof(*im) || si->nr_pins > si->len / sizeof(*ip))
+                goto out;
+
+        used = sizeof(*si) + si->nr_marks * sizeof(*im) + si->nr_pins * sizeof(*ip);
+        if (used > si->len || !index_txns_valid(((char *) si) + used, si->len - used, si->nr_txns))
+                goto out;
+
+        /* the marks carry on from the lane's, and stay in the segment */
+        im = (struct index_mark *) (si + 1);
+        last = l->nr_marks ? l->marks[l->nr_marks - 1].id : 0;
+        for (i = 0; i < si->nr_marks; i++) {
+                if (im[i].id <= last || im[i].id > si->last_id || im[i].offset < SEGMENT_HEADER_SIZE ||
+                    !push_mark(l, im[i].id, nr, im[i].offset)) {
+                        l->nr_marks = nr_marks;
+                        goto out;
+                }
+                last = im[i].id;
+        }
+
+        if (!buffer_append(txns, ((char *) si) + used, si->len - used)) {
+                l->nr_marks = nr_marks;
+                goto out;
+        }
+
+        if (si->last_id)
+                hold_segments(l, si->last_id, nr, nr);
+
+        ip = (struct index_pin *) (im + si->nr_marks);
+        for (i = 0; i < si->nr_pins; i++)
+                hold_segments(l, ip[i].id, ip[i].first_segment, nr);
+
+        l->mark_segment = nr;
+        r = 1;
+
+out:
+        if (!r)
+                warn("ignoring journal index %s", path);
+        free(si);
+        close(fd);
+        return r;
+}
+
+/* An index whose segment has gone could otherwise be taken for a new one's */
+static int remove_stale_indexes(struct lane *l, uint64_t *segments, size_t count)
+{
+        size_t i, n = 0, nr_indexes;
+        uint64_t *indexes;
+        char path[PATH_MAX];
+
+        if (!list_files(l, "index.", &indexes, &nr_indexes))
+                return 0;
+
+        for (i = 0; i < nr_indexes; i++) {
+                while (n < count && segments[n] < indexes[i])
+                        n++;
+
+                if (n == count || segments[n] != indexes[i]) {
+                        index_path(l, indexes[i], path, sizeof(path));
+                        unlink(path);
+                }
+        }
+
+        free(indexes);
+        return 1;
+}
+
+static int start_lane(struct lane_recovery *lr, struct lane *l, uint64_t *segments,
+                      size_t count, int loaded)
+{
+        memset(lr, 0, sizeof(*lr));
+        lr->l = l;
+        lr->segments = segments;
+        lr->count = count;
+        lr->checkpoint_segment = loaded ? l->segment_nr : 0;
+        lr->checkpoint_offset = l->segment_offset;
+
+        /* nothing more is written to these */
+        l->oldest_segment = count ? segments[0] : 1;
+        return !count || track_segment(l, segments[count - 1]);
+}
+
+/*
+ * New records always go in a fresh segment, rather than after a tail
+ * that may be torn.  Segments are synced before the next one is
+ * opened, so only the newest in each lane can have been torn and has
+ * its records checked in full.  Segments the checkpoint covers are
+ * only read if they have no index.
+ */
+static int next_segment(struct lane_recovery *lr, struct recovery *r)
+{
+        uint64_t covered = 0, end, nr = lr->segments[lr->next++];
+        struct lane *l = lr->l;
+
+        lr->txns.len = 0;
+        lr->pos = 0;
+        if (nr < lr->checkpoint_segment) {
+                if (load_segment_index(l, nr, &lr->txns))
+                        return 1;
+                covered = UINT64_MAX;
+
+        } else if (nr == lr->checkpoint_segment)
+                covered = lr->checkpoint_offset;
+
+        if (!recover_segment(lr, nr, covered, lr->next == lr->count, &end, r))
+                return 0;
+
+        l->segment_nr = nr;
+        l->segment_offset = end;
+        r->scanned++;
+        return 1;
+}
+
+/* The lane's next transaction, or NULL once it has none, or on failure */
+static struct index_txn *peek_txn(struct lane_recovery *lr, struct recovery *r)
+{
+        while (lr->pos == lr->txns.len) {
+                if (lr->next == lr->count)
+                        return NULL;
+
+                if (!next_segment(lr, r)) {
+                        r->failed = 1;
+                        return NULL;
+                }
+        }
+
+        return (struct index_txn *) (lr->txns.data + lr->pos);
+}
+
+static int finish_lane(struct lane_recovery *lr)
+{
+        size_t i;
+        char path[PATH_MAX];
+        struct lane *l = lr->l;
+
+        if (!remove_stale_indexes(l, lr->segments, lr->count))
+                return 0;
+
+        for (i = 0; i < lr->count; i++) {
+                segment_path(l, lr->segments[i], path, sizeof(path));
+                l->closed_bytes += file_size(path);
+        }
+
+        l->durable_segment = l->segment_nr;
+        l->durable_offset = l->segment_offset;
+        return 1;
+}
+
+/*
+ * Adds what the lanes held to the ids and index in id order, taking the
+ * lowest id of those at the head of each lane.  The checkpoint has the
+ * ids and counts of those before |checkpointed| already.  A crash may
+ * have left gaps, where one lane didn't get an earlier transaction
+ * written that another got a later one down.  They weren't complete, so
+ * nobody was told they were durable, and they're kept.
+ */
+static int merge_lanes(struct journal *j, struct lane_recovery *lrs, struct recovery *r)
+{
+        unsigned i, lowest;
+        struct index_txn *t, *next;
+        struct io_columns c;
+
+        for (;;) {
+                next = NULL;
+                lowest = 0;
+                for (i = 0; i < j->nr_lanes; i++) {
+                        t = peek_txn(lrs + i, r);
+                        if (r->failed)
+                                return 0;
+
+                        if (t && (!next || t->id < next->id)) {
+                                next = t;
+                                lowest = i;
+                        }
+                }
+
+                if (!next)
+                        break;
+
+                lrs[lowest].pos += sizeof(*next) + io_index_len(next->count);
+                if (next->id <= j->dropped)
+                        continue;
+
+                if (next->refers && (next->refers >= next->id ||
+                                     !push_referrer(j, next->id, next->refers)))
+                        return 0;
+
+                io_columns_init(&c, next + 1, next->count);
+                if (next->id < r->checkpointed) {
+                        if (!index_ios(j, next->id, &c, next->count))
+                                return 0;
+                        continue;
+                }
+
+                if (next->id < j->next_id ||
+                    !index_ios(j, next->id, &c, next->count) ||
+                    !push_id(j, next->id))
+                        return 0;
+
+                count_journalled(j, &c, next->count);
+                j->next_id = next->id + 1;
+        }
+
+        if (r->dropped > j->dropped)
+                drop_ids(j, r->dropped);
+
+        return 1;
+}
+
+static int recover(struct journal *j)
+{
+        int loaded = 0, r = 0;
+        unsigned i;
+        size_t total = 0, *counts;
+        uint64_t **segments;
+        struct lane_recovery *lrs;
+        struct recovery rec;
+
+        memset(&rec, 0, sizeof(rec));
+        segments = calloc(j->nr_lanes, sizeof(*segments));
+        counts = calloc(j->nr_lanes, sizeof(*counts));
+        lrs = calloc(j->nr_lanes, sizeof(*lrs));
+        if (!segments || !counts || !lrs)
+                goto out;
+
+        for (i = 0; i < j->nr_lanes; i++) {
+                if (!recover_free_segments(j->lanes + i) ||
+                    !list_files(j->lanes + i, "segment.", segments + i, counts + i))
+                        goto out;
+                total += counts[i];
+        }
+
+        if (j->opts.checkpoint_interval && !load_checkpoint(j, segments, counts, &loaded))
+                goto out;
+        rec.checkpointed = j->next_id;
+
+        for (i = 0; i < j->nr_lanes; i++)
+                if (!start_lane(lrs + i, j->lanes + i, segments[i], counts[i], loaded))
+                        goto out;
+
+        if (!merge_lanes(j, lrs, &rec))
+                goto out;
+
+        for (i = 0; i < j->nr_lanes; i++)
+                if (!finish_lane(lrs + i))
+                        goto out;
+
+        j->written = j->next_id - 1;
+        for (i = 0; i < j->nr_lanes; i++)
+                j->lanes[i].dropped_durable = j->dropped;
+
+        if (total)
+                info("journal %s: %llu transactions in %u segments, %s%u scanned",
+                     j->dir, (unsigned long long) count_ids(j), (unsigned) total,
+                     loaded ? "checkpoint loaded, " : "", rec.scanned);
+        r = 1;
+
+out:
+        if (segments)
+                for (i = 0; i < j->nr_lanes; i++)
+                        free(segments[i]);
+        if (lrs)
+                for (i = 0; i < j->nr_lanes; i++)
+                        free(lrs[i].txns.data);
+        free(segments);
+        free(counts);
+        free(lrs);
+        return r;
+}
+
+/*----------------------------------------------------------------*/
+
+static int init_seeker(struct journal *j, struct seeker *s)
+{
+        s->maps = calloc(j->nr_lanes, sizeof(*s->maps));
+        s->cursors = calloc(j->nr_lanes, sizeof(*s->cursors));
+        return s->maps && s->cursors;
+}
+
+static void exit_seeker(struct journal *j, struct seeker *s)
+{
+        unsigned i;
+
+        for (i = 0; s->maps && i < j->nr_lanes; i++)
+                if (s->maps[i].data)
+                        munmap(s->maps[i].data, s->maps[i].len);
+        free(s->maps);
+        free(s->cursors);
+}
+
+static void free_lanes(struct journal *j)
+{
+        unsigned i;
+        struct lane *l;
+
+        for (i = 0; j->lanes && i < j->nr_lanes; i++) {
+                l = j->lanes + i;
+                if (l->dir_fd >= 0)
+                        close(l->dir_fd);
+                free(l->dir);
+                free(l->staging);
+                free(l->gather);
+                free(l->free_segments);
+                free(l->last_ids);
+                free(l->index_marks.data);
+                free(l->index_pins.data);
+                free(l->index_txns.data);
+                free(l->marks);
+                while (l->nr_spills)
+                        remove_spill(l, l->spills);
+                free(l->spills);
+        }
+        free(j->lanes);
+}
+
+static void free_journal(struct journal *j)
+{
+        unsigned i;
+        struct journal_transaction *t, *tmp;
+
+        list_iterate_items_gen_safe (t, tmp, &j->tail, tail)
+                free_record(t);
+
+        for (i = 0; i < j->nr_devices; i++) {
+                free(j->devices[i]->name);
+                free(j->devices[i]);
+        }
+        free(j->devices);
+        free(j->runs);
+        free(j->referrers.data);
+        free(j->holds.data);
+        exit_seeker(j, &j->replay);
+        if (j->index)
+                extent_index_destroy(j->index);
+
+        free_lanes(j);
+        free(j->dir);
+        free(j);
+}
+
+static int open_lane(struct journal *j, unsigned nr, const char *dir)
+{
+        struct lane *l = j->lanes + nr;
+
+        l->j = j;
+        l->nr = nr;
+        l->mode = j->opts.mode;
+        l->segment_fd = -1;
+        list_init(&l->pending);
+
+        l->dir = strdup(dir);
+        l->free_segments = malloc(sizeof(*l->free_segments) * (j->opts.recycle_segments + 1));
+        if (!l->dir || !l->free_segments)
+                return 0;
+
+        if (mkdir(dir, 0755) < 0 && errno != EEXIST) {
+                error("couldn't create journal directory %s: %s", dir, strerror(errno));
+                return 0;
+        }
+
+        l->dir_fd = open(dir, O_RDONLY | O_DIRECTORY);
+        return l->dir_fd >= 0;
+}
+
+static void stop_writers(struct journal *j, unsigned count)
+{
+        unsigned i;
+
+        pthread_mutex_lock(&j->lock);
+        j->stopping = 1;
+        for (i = 0; i < count; i++)
+                pthread_cond_signal(&j->lanes[i].work);
+        pthread_mutex_unlock(&j->lock);
+
+        for (i = 0; i < count; i++)
+                pthread_join(j->lanes[i].writer, NULL);
+}
+
+/* There's only a checkpoint thread while checkpoints are on */
+static void stop_checkpointer(struct journal *j)
+{
+        if (!j->opts.checkpoint_interval)
+                return;
+
+        pthread_mutex_lock(&j->lock);
+        j->stopping = 1;
+        pthread_cond_signal(&j->checkpoint_due);
+        pthread_mutex_unlock(&j->lock);
+
+        pthread_join(j->checkpointer, NULL);
+}
+
+static void destroy_locks(struct journal *j)
+{
+        unsigned i;
+
+        for (i = 0; i < j->nr_lanes; i++)
+                pthread_cond_destroy(&j->lanes[i].work);
+        pthread_cond_destroy(&j->shippable);
+        pthread_cond_destroy(&j->checkpoint_due);
+        pthread_mutex_destroy(&j->replay_lock);
+        pthread_mutex_destroy(&j->lock);
+}
+
+struct journal *journal_create(const char *directory, struct journal_options *opts)
+{
+        unsigned i;
+        struct journal *j = malloc(sizeof(*j));
+
+        if (!j)
+                return NULL;
+
+        memset(j, 0, sizeof(*j));
+        if (opts)
+                j->opts = *opts;
+        else
+                journal_options_init(&j->opts);
+        j->opts.segment_size = align_up(j->opts.segment_size);
+
+        j->next_id = 1;
+        j->next_spill = 1;
+        list_init(&j->durable);
+        list_init(&j->subscribers);
+        list_init(&j->tail);
+
+        if (j->opts.capacity && (j->opts.low_watermark >= j->opts.high_watermark ||
+                                 j->opts.high_watermark > 100)) {
+                error("bad journal watermarks %u%% and %u%%",
+                      j->opts.low_watermark, j->opts.high_watermark);
+                free(j);
+                return NULL;
+        }
+
+        j->dir = strdup(directory);
+        j->index = extent_index_create();
+        j->nr_lanes = j->opts.nr_lanes + 1;
+        j->lanes = calloc(j->nr_lanes, sizeof(*j->lanes));
+        for (i = 0; j->lanes && i < j->nr_lanes; i++)
+                j->lanes[i].dir_fd = -1;
+
+        if (!j->dir || !j->index || !j->lanes || !init_seeker(j, &j->replay)) {
+                free_journal(j);
+                return NULL;
+        }
+        j->rate_start = now_ns();
+
+        /* the lanes' directories are copied, not kept */
+        for (i = 0; i < j->nr_lanes; i++)
+                if (!open_lane(j, i, i ? j->opts.lanes[i - 1] : directory)) {
+                        error("couldn't open journal lane %s", i ? j->opts.lanes[i - 1] : directory);
+                        free_journal(j);
+                        return NULL;
+                }
+        j->opts.lanes = NULL;
+
+        if (!recover(j)) {
+                error("couldn't open journal %s", directory);
+                free_journal(j);
+                return NULL;
+        }
+
+        pthread_mutex_init(&j->lock, NULL);
+        pthread_mutex_init(&j->replay_lock, NULL);
+        pthread_cond_init(&j->checkpoint_due, NULL);
+        pthread_cond_init(&j->shippable, NULL);
+        for (i = 0; i < j->nr_lanes; i++)
+                pthread_cond_init(&j->lanes[i].work, NULL);
+
+        for (i = 0; i < j->nr_lanes; i++)
+                if (pthread_create(&j->lanes[i].writer, NULL, writer_loop, j->lanes + i)) {
+                        stop_writers(j, i);
+                        destroy_locks(j);
+                        free_journal(j);
+                        return NULL;
+                }
+
+        if (j->opts.checkpoint_interval &&
+            pthread_create(&j->checkpointer, NULL, checkpoint_loop, j)) {
+                stop_writers(j, j->nr_lanes);
+                destroy_locks(j);
+                free_journal(j);
+                return NULL;
+        }
+
+        return j;
+}
+
+void journal_destroy(struct journal *j)
+{
+        unsigned i;
+        struct lane *l;
+
+        stop_writers(j, j->nr_lanes);
+        stop_checkpointer(j);
+        for (i = 0; i < j->nr_lanes; i++) {
+                l = j->lanes + i;
+                if (l->segment_fd >= 0 && !close_segment(l))
+                        j->failed = 1;
+        }
+
+        /* so the next start needn't scan anything */
+        if (j->opts.checkpoint_interval && !j->failed && j->since_checkpoint)
+                write_checkpoint(j);
+
+        destroy_locks(j);
+        free_journal(j);
+}
+
+struct journal_device *journal_register_device(struct journal *j, const char *name)
+{
+        unsigned i;
+        size_t len = strlen(name);
+        struct journal_device *dev = NULL;
+        LIST_INIT(records);
+
+        if (!len || len > NAME_MAX)
+                return NULL;
+
+        pthread_mutex_lock(&j->lock);
+        for (i = 0; i < j->nr_devices; i++)
+                if (!strcmp(j->devices[i]->name, name)) {
+                        dev = j->devices[i];
+                        goto out;
+                }
+
+        if (!lane_records(j, RECORD_DEVICE, j->nr_devices, name, len, &records) ||
+            !(dev = add_device(j, j->nr_devices, name, len))) {
+                free_records(&records);
+                goto out;
+        }
+
+        queue_lane_records(j, &records);
+
+out:
+        pthread_mutex_unlock(&j->lock);
+        return dev;
+}
+
+const char *journal_device_name(struct journal_device *dev)
+{
+        return dev->name;
+}
+
+unsigned journal_device_count(struct journal *j)
+{
+        unsigned n;
+
+        pthread_mutex_lock(&j->lock);
+        n = j->nr_devices;
+        pthread_mutex_unlock(&j->lock);
+
+        return n;
+}
+
+struct journal_device *journal_get_device(struct journal *j, unsigned index)
+{
+        struct journal_device *dev = NULL;
+
+        pthread_mutex_lock(&j->lock);
+        if (index < j->nr_devices)
+                dev = j->devices[index];
+        pthread_mutex_unlock(&j->lock);
+
+        return dev;
+}
+
+void journal_get_device_stats(struct journal *j, struct journal_device *dev,
+                              struct journal_device_stats *stats)
+{
+        pthread_mutex_lock(&j->lock);
+        *stats = dev->stats;
+        pthread_mutex_unlock(&j->lock);
+}
+
+/*
+ * Only durable transactions can be dropped, so the drop record always
+ * follows the transactions it covers.  Losing it in a crash just brings
+ * them back.
+ *
+ * Drops as much of what's been asked for as every subscriber has
+ * shipped, and nothing still referred to.  Call with the lock held.
+ */
+static void drop_shipped(struct journal *j)
+{
+        uint64_t id = j->drop_wanted, old = j->dropped;
+        struct journal_subscriber *s;
+        LIST_INIT(records);
+
+        list_iterate_items (s, &j->subscribers)
+                if (s->next <= id)
+                        id = s->next - 1;
+
+        drop_ids(j, unreferred(j, id));
+        if (j->dropped != old) {
+                if (lane_records(j, RECORD_DROP, j->dropped, NULL, 0, &records))
+                        queue_lane_records(j, &records);
+                else
+                        free_records(&records);
+        }
+}
+
+struct journal_transaction *journal_begin(struct journal *j)
+{
+        return new_record(j, RECORD_TRANSACTION);
+}
+
+int journal_record_io(struct journal_transaction *t, struct journal_io *io)
+{
+        struct iovec piece = { io->data, io->len };
+        struct journal_iov iov = {
+                io->dev, io->start_sector, io->end_sector, io->codec, &piece, io->len ? 1 : 0
+        };
+
+        return journal_record_iov(t, &iov, 1);
+}
+
+/* Returns 0 if |io| is bad, or its data is too long to record */
+static int io_len(struct journal_iov *io, size_t *len)
+{
+        unsigned i;
+
+        if (io->end_sector <= io->start_sector || (io->nr_iov && !io->iov))
+                return 0;
+
+        for (*len = 0, i = 0; i < io->nr_iov; i++) {
+                if (io->iov[i].iov_len && !io->iov[i].iov_base)
+                        return 0;
+                *len += io->iov[i].iov_len;
+        }
+
+        return *len <= UINT32_MAX;
+}
+
+/*
+ * Writes out the data recorded so far as a RECORD_SPILL, to the lane
+ * the transaction will be committed to, handing the buffer over rather
+ * than copying it.  Failing to spill isn't an error, the data just
+ * stays in memory.
+ */
+static void spill(struct journal_transaction *t)
+{
+        struct journal *j = t->j;
+        struct journal_transaction *s = new_record(j, RECORD_SPILL);
+
+        if (!s)
+                return;
+
+        if (!t->abort && !(t->abort = new_record(j, RECORD_ABORT))) {
+                free_record(s);
+                return;
+        }
+
+        s->data = t->data;
+        s->header.count = t->header.count - t->spilled_ios;
+        s->has_notify = t->has_spill_notify;
+        s->notify = t->spill_notify;
+        seal_record(s);
+
+        pthread_mutex_lock(&j->lock);
+        if (j->failed || j->stopping) {
+                pthread_mutex_unlock(&j->lock);
+                memset(&s->data, 0, sizeof(s->data));
+                free_record(s);
+                return;
+        }
+
+        if (!t->spill_lane) {
+                t->spill_lane = pick_lane(j);
+                t->spill_handle = j->next_spill++;
+        }
+        s->header.id = t->spill_handle;
+        j->stats.spilled += s->data.len;
+        queue_record(t->spill_lane, s);
+        pthread_mutex_unlock(&j->lock);
+
+        memset(&t->data, 0, sizeof(t->data));
+        t->nr_spills++;
+        t->spilled_ios = t->header.count;
+}
+
+/*
+ * Everything's checked and the space reserved up front, so nothing can
+ * fail part way through.
+ */
+int journal_record_iov(struct journal_transaction *t, struct journal_iov *ios, unsigned count)
+{
+        unsigned i, n;
+        size_t len, data_len = 0;
+        struct io_columns c;
+
+        for (i = 0; i < count; i++) {
+                if (!io_len(ios + i, &len))
+                        return 0;
+                data_len += record_pad(len);
+        }
+
+        if (!reserve_ios(t, count) || !buffer_reserve(&t->data, data_len))
+                return 0;
+
+        io_columns_init(&c, t->ios.data, t->max_ios);
+        for (i = 0, n = t->header.count; i < count; i++, n++) {
+                c.start_sector[n] = ios[i].start_sector;
+                c.end_sector[n] = ios[i].end_sector;
+                c.dev[n] = ios[i].dev->id;
+                c.codec[n] = ios[i].codec;
+                c.len[n] = buffer_gather(&t->data, ios[i].iov, ios[i].nr_iov);
+        }
+
+        t->header.count += count;
+        if (t->j->opts.spill_threshold && t->data.len >= t->j->opts.spill_threshold)
+                spill(t);
+
+        return 1;
+}
+
+/*
+ * The transaction referred to has to be durable and not dropped, and
+ * is held on to from here on.  Everything else is checked, and the
+ * space reserved, first, so the hold is the last thing that can fail.
+ */
+int journal_record_ref(struct journal_transaction *t, struct journal_io *io,
+                       uint64_t id, unsigned index)
+{
+        int r;
+        size_t len;
+        uint64_t found, pos;
+        struct journal *j = t->j;
+        struct journal_iov iov = { io->dev, io->start_sector, io->end_sector, IO_REFERENCE, NULL, 0 };
+        struct io_ref ref = { id, index, 0 };
+
+        if (!id || !io_len(&iov, &len) || !buffer_reserve(&t->refs, sizeof(ref)) ||
+            !reserve_ios(t, 1))
+                return 0;
+
+        pthread_mutex_lock(&j->lock);
+        r = id <= j->written && seek_id(j, id, &found, &pos) && found == id &&
+                hold_ref(j, t, id);
+        pthread_mutex_unlock(&j->lock);
+        if (!r)
+                return 0;
+
+        journal_record_iov(t, &iov, 1);
+        buffer_append(&t->refs, &ref, sizeof(ref));
+        return 1;
+}
+
+void journal_notify_spills(struct journal_transaction *t, struct thunk *notify_spilled)
+{
+        t->has_spill_notify = 1;
+        t->spill_notify = *notify_spilled;
+}
+
+unsigned journal_transaction_spills(struct journal_transaction *t, unsigned *ios)
+{
+        *ios = t->spilled_ios;
+        return t->nr_spills;
+}
+
+int journal_commit(struct journal_transaction *t, struct thunk *notify_complete, uint64_t *id)
+{
+        struct journal *j = t->j;
+
+        if (notify_complete) {
+                t->has_notify = 1;
+                t->notify = *notify_complete;
+        }
+
+        if (t->nr_spills) {
+                if (!buffer_reserve(&t->table, spill_table_len(t->nr_spills))) {
+                        journal_rollback(t);
+                        return 0;
+                }
+
+                t->header.type = RECORD_SPILLED;
+                free_record(t->abort);
+                t->abort = NULL;
+        }
+        seal_record(t);
+        t->committed = now_ns();
+
+        pthread_mutex_lock(&j->lock);
+        if (j->failed || j->stopping) {
+                release_ref(j, t);
+                pthread_mutex_unlock(&j->lock);
+                free_record(t);
+                return 0;
+        }
+
+        *id = t->header.id = j->next_id++;
+        queue_record(t->spill_lane ? t->spill_lane : pick_lane(j), t);
+        pthread_mutex_unlock(&j->lock);
+
+        return 1;
+}
+
+/*
+ * The abort record lets the writer stop holding on to the segments the
+ * spills are in; without it, after a crash say, they're just ignored.
+ */
+void journal_rollback(struct journal_transaction *t)
+{
+        struct journal *j = t->j;
+        struct lane *l = t->spill_lane;
+        struct journal_transaction *abort = t->abort;
+
+        if (t->refers) {
+                pthread_mutex_lock(&j->lock);
+                release_ref(j, t);
+                drop_shipped(j);
+                pthread_mutex_unlock(&j->lock);
+        }
+
+        if (!t->nr_spills) {
+                free_record(t);
+                return;
+        }
+
+        abort->header.id = t->spill_handle;
+        seal_record(abort);
+        t->abort = NULL;
+        free_record(t);
+
+        pthread_mutex_lock(&j->lock);
+        if (!j->stopping) {
+                j->stats.aborted++;
+                queue_record(l, abort);
+                abort = NULL;
+        }
+        pthread_mutex_unlock(&j->lock);
+
+        if (abort)
+                free_record(abort);
+}
+
+/* Call with the lock held */
+static uint64_t used_bytes(struct journal *j)
+{
+        unsigned i;
+        uint64_t used = 0;
+
+        for (i = 0; i < j->nr_lanes; i++)
+                used += j->lanes[i].closed_bytes + j->lanes[i].current_bytes;
+
+        return used;
+}
+
+int journal_throttle(struct journal *j, unsigned *delay_us)
+{
+        int r = 1;
+        uint64_t used, low, high;
+
+        *delay_us = 0;
+        if (!j->opts.capacity)
+                return 1;
+
+        low = j->opts.capacity / 100 * j->opts.low_watermark;
+        high = j->opts.capacity / 100 * j->opts.high_watermark;
+
+        pthread_mutex_lock(&j->lock);
+        used = used_bytes(j);
+        if (used >= high) {
+                *delay_us = MAX_THROTTLE_US;
+                j->stats.stalled++;
+                r = 0;
+
+        } else if (used > low) {
+                *delay_us = MAX_THROTTLE_US * (used - low) / (high - low);
+                j->stats.throttled++;
+        }
+        pthread_mutex_unlock(&j->lock);
+
+        return r;
+}
+
+int journal_failed(struct journal *j)
+{
+        int r;
+
+        pthread_mutex_lock(&j->lock);
+        r = j->failed;
+        pthread_mutex_unlock(&j->lock);
+
+        return r;
+}
+
+unsigned journal_transaction_count(struct journal *j)
+{
+        unsigned r;
+
+        pthread_mutex_lock(&j->lock);
+        r = count_ids(j);
+        pthread_mutex_unlock(&j->lock);
+
+        return r;
+}
+
+static int lookup_id(struct journal *j, unsigned index, uint64_t *id)
+{
+        int r;
+
+        pthread_mutex_lock(&j->lock);
+        r = id_at(j, index, id);
+        pthread_mutex_unlock(&j->lock);
+
+        return r;
+}
+
+int journal_transaction_front(struct journal *j, unsigned index, uint64_t *id)
+{
+        return lookup_id(j, index, id);
+}
+
+int journal_transaction_seek(struct journal *j, uint64_t id, unsigned *index)
+{
+        int r;
+        uint64_t found, pos;
+
+        pthread_mutex_lock(&j->lock);
+        r = seek_id(j, id, &found, &pos);
+        if (r)
+                *index = pos;
+        pthread_mutex_unlock(&j->lock);
+
+        return r;
+}
+
+/*
+ * Replay walks the journal oldest first, which is a sequential read of
+ * each segment in turn.  Rather than copying every record into a
+ * buffer, the segment is mapped and the ios handed out point straight
+ * into the mapping.  Segments are only ever appended to, and a record
+ * is only replayed once it's durable, so what's mapped doesn't change
+ * under us.
+ */
+static void unmap_segment(struct segment_map *m)
+{
+        if (m->data)
+                munmap(m->data, m->len);
+        memset(m, 0, sizeof(*m));
+}
+
+static int map_segment(struct journal *j, struct segment_map *m, unsigned lane, uint64_t nr)
+{
+        int fd;
+        void *data;
+        struct stat info;
+        char path[PATH_MAX];
+
+        unmap_segment(m);
+
+        segment_path(j->lanes + lane, nr, path, sizeof(path));
+        fd = open(path, O_RDONLY);
+        if (fd < 0) {
+                error("couldn't open journal segment %s: %s", path, strerror(errno));
+                return 0;
+        }
+
+        if (fstat(fd, &info) < 0 || !info.st_size) {
+                close(fd);
+                return 0;
+        }
+
+        data = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED) {
+                error("couldn't map journal segment %s: %s", path, strerror(errno));
+                return 0;
+        }
+
+        madvise(data, info.st_size, MADV_SEQUENTIAL);
+        m->lane = lane;
+        m->nr = nr;
+        m->data = data;
+        m->len = info.st_size;
+        return 1;
+}
+
+/*
+ * Keeps the disk busy REPLAY_READAHEAD in front of replay, rather than
+ * faulting each page in as it's reached.
+ */
+static void read_ahead(struct segment_map *m, uint64_t offset)
+{
+        size_t page = sysconf(_SC_PAGESIZE);
+        size_t begin = offset & ~(page - 1);
+        size_t end;
+
+        if (begin + REPLAY_READAHEAD / 2 < m->ahead)
+                return;
+
+        begin = (begin > m->ahead) ? begin : m->ahead;
+        end = begin + REPLAY_READAHEAD;
+        if (end > m->len)
+                end = m->len;
+
+        if (begin < end)
+                madvise(m->data + begin, end - begin, MADV_WILLNEED);
+        m->ahead = end;
+}
+
+static int map_holds(struct segment_map *m, struct txn_entry *e)
+{
+        return m->data && m->lane == e->lane && m->nr == e->segment &&
+                e->offset + e->len <= m->len;
+}
+
+/* Returns the record in the mapping, which has to be unused, or NULL. */
+static struct record_header *map_record(struct journal *j, struct segment_map *m,
+                                        struct txn_entry *e)
+{
+        if (!map_holds(m, e) && (!map_segment(j, m, e->lane, e->segment) || !map_holds(m, e)))
+                return NULL;
+
+        read_ahead(m, e->offset);
+        return (struct record_header *) (m->data + e->offset);
+}
+
+/* Checks the record |e| says is at |h| */
+static int replayable(struct record_header *h, struct txn_entry *e)
+{
+        return h && record_valid(h, e->len) && h->id == e->id && record_intact(h, e->segment);
+}
+
+/*
+ * Finding transactions.  Each lane's records are in id order, so a
+ * transaction is found by reading record headers forward from the
+ * lane's last mark before it.  A reader going through the transactions
+ * in order just carries on from its cursor in each lane, a record or
+ * two along.  Only what's durable is read, so it can't change.
+ */
+
+/*
+ * Returns the header of the record at |offset| in segment |nr| of the
+ * lane, mapping the segment, or mapping it again if it's grown, as need
+ * be.  NULL if there's no record there.
+ */
+static struct record_header *peek_record(struct journal *j, struct segment_map *m, unsigned lane,
+                                         uint64_t nr, uint64_t offset)
+{
+        struct segment_header *sh;
+        struct record_header *h;
+
+        if ((!m->data || m->lane != lane || m->nr != nr || offset + sizeof(*h) > m->len) &&
+            !map_segment(j, m, lane, nr))
+                return NULL;
+
+        /* a record in the segment being written may be past the end of the mapping */
+        h = (struct record_header *) (m->data + offset);
+        if (offset + sizeof(*h) <= m->len && h->magic == RECORD_MAGIC &&
+            h->len > m->len - offset && !map_segment(j, m, lane, nr))
+                return NULL;
+
+        sh = m->data;
+        h = (struct record_header *) (m->data + offset);
+        if (m->len < SEGMENT_HEADER_SIZE || sh->magic != JOURNAL_MAGIC || sh->nr != nr ||
+            sh->lane != lane || offset + sizeof(*h) > m->len)
+                return NULL;
+
+        return record_valid(h, m->len - offset) ? h : NULL;
+}
+
+/*
+ * Moves |c| on to the lane's next transaction before the lane's durable
+ * end, or returns 0 and leaves it be if there isn't one.
+ */
+static int next_transaction(struct journal *j, struct segment_map *m, unsigned lane,
+                            struct lane_cursor *c, uint64_t end_segment, uint64_t end_offset)
+{
+        uint64_t nr = c->segment, offset = c->offset + c->len;
+        struct record_header *h;
+
+        while (nr < end_segment || (nr == end_segment && offset < end_offset)) {
+                h = peek_record(j, m, lane, nr, offset);
+                if (!h) {
+                        /* the end of the segment */
+                        nr++;
+                        offset = SEGMENT_HEADER_SIZE;
+                        continue;
+                }
+
+                if (is_transaction(h->type)) {
+                        c->id = h->id;
+                        c->segment = nr;
+                        c->offset = offset;
+                        c->len = h->len;
+                        return 1;
+                }
+
+                offset += h->len;
+        }
+
+        return 0;
+}
+
+static int cursor_at(struct journal *j, struct segment_map *m, unsigned lane,
+                     struct lane_cursor *c, struct seek_mark *mark)
+{
+        struct record_header *h = peek_record(j, m, lane, mark->segment, mark->offset);
+
+        if (!h || !is_transaction(h->type) || h->id != mark->id)
+                return 0;
+
+        c->id = mark->id;
+        c->segment = mark->segment;
+        c->offset = mark->offset;
+        c->len = h->len;
+        return 1;
+}
+
+/*
+ * Finds durable transaction |id|, filling in |e|.  A lane's cursor is
+ * only moved back to a mark if it's past |id|, or the mark's nearer.
+ */
+static int locate(struct journal *j, struct seeker *s, uint64_t id, struct txn_entry *e)
+{
+        unsigned i;
+        int marked;
+        uint64_t end_segment, end_offset;
+        struct seek_mark mark;
+        struct segment_map *m;
+        struct lane_cursor *c;
+        struct lane *l;
+
+        for (i = 0; i < j->nr_lanes; i++) {
+                l = j->lanes + i;
+                m = s->maps + i;
+                c = s->cursors + i;
+
+                pthread_mutex_lock(&j->lock);
+                marked = find_mark(l, id) != NULL;
+                if (marked)
+                        mark = *find_mark(l, id);
+                end_segment = l->durable_segment;
+                end_offset = l->durable_offset;
+                pthread_mutex_unlock(&j->lock);
+
+                /* the lane has nothing that old */
+                if (!marked)
+                        continue;
+
+                if ((!c->id || c->id > id || c->id < mark.id) && !cursor_at(j, m, i, c, &mark)) {
+                        c->id = 0;
+                        continue;
+                }
+
+                while (c->id < id && next_transaction(j, m, i, c, end_segment, end_offset))
+                        ;
+
+                if (c->id == id) {
+                        e->id = id;
+                        e->segment = c->segment;
+                        e->offset = c->offset;
+                        e->len = c->len;
+                        e->first_segment = c->segment;
+                        e->lane = i;
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+/*
+ * Where each io's data is, in order, as replay and shipping come to it.
+ * A spilled transaction's data starts in its spills, each mapped as
+ * it's reached and kept until the transaction's done with.  Data an io
+ * refers to is copied out of the transaction it's in, found with a
+ * seeker of its own, and the copies kept as long.
+ */
+struct io_data {
+        struct journal *j;
+        unsigned lane;
+
+        struct spill_table *table;      /* NULL if it didn't spill */
+        struct spill_ref *refs;
+        unsigned next_ref;
+        struct segment_map *maps;
+        unsigned nr_maps;
+
+        uint32_t left;                  /* ios before the next piece */
+        unsigned char *data;
+        unsigned char *end;
+        unsigned char *own;             /* the record's own data */
+        unsigned char *own_end;
+
+        struct io_ref *io_refs;
+        uint32_t nr_io_refs;
+        uint32_t next_io_ref;
+        struct seeker *seeker;
+        struct buffer copies;           /* of pointers to each copy */
+};
+
+static void memory_io_data(struct io_data *d, unsigned char *data, size_t len)
+{
+        memset(d, 0, sizeof(*d));
+        d->left = UINT32_MAX;
+        d->data = data;
+        d->end = data + len;
+}
+
+static uint32_t count_io_refs(struct io_columns *c, uint32_t count)
+{
+        uint32_t i, n = 0;
+
+        for (i = 0; i < count; i++)
+                n += c->codec[i] == IO_REFERENCE;
+
+        return n;
+}
+
+static int init_io_data(struct journal *j, struct record_header *h, unsigned lane, struct io_data *d)
+{
+        uint32_t i, ios = 0;
+        unsigned char *data = ((unsigned char *) (h + 1)) + io_columns_len(h->count);
+        unsigned char *end = ((unsigned char *) h) + h->len - sizeof(struct record_commit);
+        struct io_columns c;
+
+        memory_io_data(d, data, end - data);
+        d->j = j;
+        d->lane = lane;
+        if (h->type == RECORD_SPILLED) {
+                d->table = (struct spill_table *) (end - sizeof(*d->table));
+                if (spill_table_len(d->table->nr_spills) > (size_t) (end - data))
+                        return 0;
+
+                d->refs = ((struct spill_ref *) d->table) - d->table->nr_spills;
+                for (i = 0; i < d->table->nr_spills; i++)
+                        ios += d->refs[i].count;
+                if (ios != d->table->ios || ios > h->count)
+                        return 0;
+
+                d->left = 0;
+                d->own = data;
+                end = (unsigned char *) d->refs;
+        }
+
+        io_columns_init(&c, h + 1, h->count);
+        d->nr_io_refs = count_io_refs(&c, h->count);
+        if ((uint64_t) d->nr_io_refs * sizeof(*d->io_refs) > (size_t) (end - data))
+                return 0;
+
+        d->io_refs = ((struct io_ref *) end) - d->nr_io_refs;
+        if (d->table)
+                d->own_end = (unsigned char *) d->io_refs;
+        else
+                d->end = (unsigned char *) d->io_refs;
+        return 1;
+}
+
+static void release_io_data(struct io_data *d)
+{
+        unsigned i;
+        void **copies = d->copies.data;
+
+        for (i = 0; i < d->nr_maps; i++)
+                unmap_segment(d->maps + i);
+        free(d->maps);
+
+        for (i = 0; i < d->copies.len / sizeof(*copies); i++)
+                free(copies[i]);
+        free(copies);
+
+        if (d->seeker) {
+                exit_seeker(d->j, d->seeker);
+                free(d->seeker);
+        }
+}
+
+static struct segment_map *spill_map(struct io_data *d, uint64_t segment)
+{
+        unsigned i;
+        struct segment_map *maps;
+
+        for (i = 0; i < d->nr_maps; i++)
+                if (d->maps[i].nr == segment)
+                        return d->maps + i;
+
+        maps = realloc(d->maps, sizeof(*maps) * (d->nr_maps + 1));
+        if (!maps)
+                return NULL;
+
+        d->maps = maps;
+        memset(maps + d->nr_maps, 0, sizeof(*maps));
+        if (!map_segment(d->j, maps + d->nr_maps, d->lane, segment))
+                return NULL;
+
+        return maps + d->nr_maps++;
+}
+
+/* Moves on to the next spill, or the record's own data after the last */
+static int next_piece(struct io_data *d)
+{
+        struct spill_ref *ref;
+        struct segment_map *m;
+        struct record_header *h;
+
+        if (d->next_ref == d->table->nr_spills) {
+                d->next_ref++;
+                d->left = UINT32_MAX;
+                d->data = d->own;
+                d->end = d->own_end;
+                return 1;
+        }
+
+        if (d->next_ref > d->table->nr_spills)
+                return 0;
+
+        ref = d->refs + d->next_ref++;
+        m = spill_map(d, ref->segment);
+        if (!m || ref->offset + ref->len > m->len)
+                return 0;
+
+        read_ahead(m, ref->offset);
+        h = (struct record_header *) (m->data + ref->offset);
+        if (!record_valid(h, ref->len) || h->type != RECORD_SPILL || h->len != ref->len ||
+            h->id != d->table->handle || h->count != ref->count || !record_intact(h, ref->segment))
+                return 0;
+
+        d->left = ref->count;
+        d->data = (unsigned char *) (h + 1);
+        d->end = ((unsigned char *) h) + h->len - sizeof(struct record_commit);
+        return 1;
+}
+
+/* Returns the data of the next io, |len| bytes, or NULL if it isn't there */
+static unsigned char *next_io_data(struct io_data *d, uint32_t len)
+{
+        unsigned char *data;
+
+        while (!d->left)
+                if (!next_piece(d))
+                        return NULL;
+
+        if (d->data + record_pad(len) > d->end)
+                return NULL;
+
+        data = d->data;
+        d->data += record_pad(len);
+        d->left--;
+        return data;
+}
+
+/*
+ * Sets |io| to the data that the next IO_REFERENCE io refers to, copied
+ * out of the transaction it's in, which can't have been dropped.  Only
+ * data is referred to, not zeroes or another reference.
+ */
+static int follow_ref(struct io_data *d, struct journal_io *io)
+{
+        int r = 0;
+        uint32_t i, len;
+        struct io_ref *ref;
+        struct txn_entry e;
+        struct record_header *h;
+        struct io_columns c;
+        struct io_data x;
+        unsigned char *data = NULL;
+        void *copy;
+
+        if (d->next_io_ref == d->nr_io_refs)
+                return 0;
+        ref = d->io_refs + d->next_io_ref++;
+
+        if (!d->seeker) {
+                d->seeker = malloc(sizeof(*d->seeker));
+                if (!d->seeker)
+                        return 0;
+
+                memset(d->seeker, 0, sizeof(*d->seeker));
+                if (!init_seeker(d->j, d->seeker))
+                        return 0;
+        }
+
+        h = locate(d->j, d->seeker, ref->id, &e) ? map_record(d->j, d->seeker->maps + e.lane, &e) : NULL;
+        if (!replayable(h, &e) || ref->io >= h->count || !init_io_data(d->j, h, e.lane, &x))
+                return 0;
+
+        io_columns_init(&c, h + 1, h->count);
+        for (i = 0; i <= ref->io; i++)
+                if (!(data = next_io_data(&x, c.len[i])))
+                        break;
+
+        len = c.len[ref->io];
+        if (data && len && c.codec[ref->io] != IO_REFERENCE && (copy = malloc(len))) {
+                memcpy(copy, data, len);
+                if (buffer_append(&d->copies, &copy, sizeof(copy))) {
+                        io->codec = c.codec[ref->io];
+                        io->len = len;
+                        io->data = copy;
+                        r = 1;
+                } else
+                        free(copy);
+        }
+        release_io_data(&x);
+
+        return r;
+}
+
+/*
+ * Write coalescing.  Replay only hands over the sectors of an io that no
+ * later transaction still in the journal has overwritten; the later
+ * write will be replayed in its turn.  An io that's partly overwritten
+ * is cut into its live pieces, unless it's compressed, when it has to
+ * go whole.
+ */
+struct piece {
+        uint64_t begin;
+        uint64_t end;
+};
+
+struct live {
+        uint64_t id;
+        uint32_t io;
+        struct buffer pieces;
+        uint64_t sectors;
+        int failed;
+};
+
+static void collect_live(void *context, struct extent_mapping *m)
+{
+        struct live *l = context;
+        struct piece p;
+
+        if (m->txn != l->id || m->io != l->io)
+                return;
+
+        p.begin = m->begin;
+        p.end = m->end;
+        if (!buffer_append(&l->pieces, &p, sizeof(p)))
+                l->failed = 1;
+        l->sectors += p.end - p.begin;
+}
+
+/*
+ * Finds the live pieces of io |index| of transaction |id|, whose
+ * metadata is in |c|, and adds them to the device's replay counters,
+ * however many times it's been replayed before.  Returns the device, or
+ * NULL if it's unknown.
+ */
+static struct journal_device *find_live(struct journal *j, uint64_t id, unsigned index,
+                                        struct io_columns *c, struct live *l)
+{
+        uint32_t dev_id = c->dev[index], len = c->len[index];
+        uint64_t sectors = c->end_sector[index] - c->start_sector[index];
+        int sliceable = !c->codec[index] && (!len || len == sectors << JOURNAL_SECTOR_SHIFT);
+        struct journal_device *dev = NULL;
+        struct piece whole = { c->start_sector[index], c->end_sector[index] };
+
+        l->id = id;
+        l->io = index;
+        l->pieces.len = 0;
+        l->sectors = 0;
+        l->failed = 0;
+
+        pthread_mutex_lock(&j->lock);
+        if (dev_id < j->nr_devices) {
+                dev = j->devices[dev_id];
+                extent_index_lookup(j->index, dev_id, whole.begin, whole.end, collect_live, l);
+
+                /* the whole io if we can't do better */
+                if (l->failed || (l->sectors && !sliceable)) {
+                        l->pieces.len = 0;
+                        l->sectors = sectors;
+                        l->failed = !buffer_append(&l->pieces, &whole, sizeof(whole));
+                }
+
+                if (l->failed)
+                        dev = NULL;
+                else {
+                        dev->stats.replayed += l->sectors << JOURNAL_SECTOR_SHIFT;
+                        dev->stats.coalesced += (sectors - l->sectors) << JOURNAL_SECTOR_SHIFT;
+                }
+        }
+        pthread_mutex_unlock(&j->lock);
+
+        return dev;
+}
+
+/*
+ * Calls |fn| for each live piece of each io in transaction record |h|.
+ * The data points into the record, or its spills, as found by |d|, or
+ * into a copy of what a reference refers to.  A reference is only
+ * followed if something of it is live.
+ */
+typedef void (*io_fn)(void *context, struct journal_io *io);
+
+static int live_ios(struct journal *j, struct record_header *h, struct io_data *d,
+                    io_fn fn, void *context)
+{
+        int r = 1;
+        unsigned i;
+        struct live l;
+        struct piece *p, *end_piece;
+        struct journal_io io, whole;
+        struct io_columns c;
+
+        io_columns_init(&c, h + 1, h->count);
+        memset(&l, 0, sizeof(l));
+        for (i = 0; i < h->count; i++) {
+                whole.codec = c.codec[i];
+                whole.len = c.len[i];
+                whole.data = next_io_data(d, c.len[i]);
+                if (!whole.data) {
+                        r = 0;
+                        break;
+                }
+
+                io.dev = find_live(j, h->id, i, &c, &l);
+                if (!io.dev) {
+                        r = 0;
+                        break;
+                }
+
+                if (whole.codec == IO_REFERENCE &&
+                    (l.pieces.len ? !follow_ref(d, &whole) : d->next_io_ref++ == d->nr_io_refs)) {
+                        r = 0;
+                        break;
+                }
+
+                p = l.pieces.data;
+                end_piece = p + l.pieces.len / sizeof(*p);
+                for (; p != end_piece; p++) {
+                        io.start_sector = p->begin;
+                        io.end_sector = p->end;
+                        io.codec = whole.codec;
+
+                        if (!whole.len) {
+                                io.len = 0;
+                                io.data = NULL;
+
+                        } else if (p->begin == c.start_sector[i] && p->end == c.end_sector[i]) {
+                                io.len = whole.len;
+                                io.data = whole.data;
+
+                        } else {
+                                io.len = (p->end - p->begin) << JOURNAL_SECTOR_SHIFT;
+                                io.data = whole.data + ((p->begin - c.start_sector[i]) << JOURNAL_SECTOR_SHIFT);
+                        }
+
+                        fn(context, &io);
+                }
+        }
+        free(l.pieces.data);
+
+        return r;
+}
+
+static int replay_record(struct journal *j, struct record_header *h, unsigned lane,
+                         struct journal_replayer *replay)
+{
+        int r;
+        struct io_data d;
+
+        if (!init_io_data(j, h, lane, &d))
+                return 0;
+
+        replay->begin(replay->context, h->id);
+        r = live_ios(j, h, &d, replay->io, replay->context);
+        if (r)
+                replay->commit(replay->context);
+        release_io_data(&d);
+
+        return r;
+}
+
+int journal_transaction_replay_front(struct journal *j, unsigned index, struct journal_replayer *replay)
+{
+        int r = 0;
+        uint64_t id;
+        struct txn_entry e;
+        struct record_header *h;
+
+        if (!lookup_id(j, index, &id))
+                return 0;
+
+        pthread_mutex_lock(&j->replay_lock);
+        h = locate(j, &j->replay, id, &e) ? map_record(j, j->replay.maps + e.lane, &e) : NULL;
+        if (replayable(h, &e))
+                r = replay_record(j, h, e.lane, replay);
+        pthread_mutex_unlock(&j->replay_lock);
+
+        if (!r)
+                error("couldn't replay journal transaction %llu", (unsigned long long) id);
+
+        return r;
+}
+
+/*
+ * Parallel replay.  The calling thread reads the records in order and
+ * splits each transaction's live ios up by device.  Each device's share
+ * becomes a piece of work, queued to the worker thread the device
+ * hashes to, which replays it with the device's own replayer.  So each
+ * device sees its transactions in order, without waiting on the others.
+ *
+ * Work points into the segment mapping it came from, so replay keeps two
+ * mappings, and only replaces one once all its work is done.
+ */
+enum {
+        MAX_REPLAY_WORK = 1024          /* queued but not yet replayed */
+};
+
+struct replay_work {
+        struct list list;
+        struct journal_device *dev;
+        struct journal_replayer *replayer;
+        struct segment_map *map;
+        uint64_t id;
+        struct buffer ios;              /* journal_ios */
+};
+
+struct parallel_replay;
+
+struct replay_worker {
+        pthread_t thread;
+        struct parallel_replay *pr;
+        struct list work;
+        pthread_cond_t wake;
+};
+
+struct parallel_replay {
+        struct journal *j;
+        struct journal_parallel_replayer *target;
+
+        /* protects the workers' queues, |queued| and the maps' users */
+        pthread_mutex_t lock;
+        pthread_cond_t done;            /* some work has been replayed */
+        int stopping;
+        unsigned queued;
+
+        struct replay_worker *workers;
+        unsigned nr_workers;
+
+        /* indexed by device id, filled in as the devices turn up */
+        struct journal_replayer **replayers;
+        unsigned nr_replayers;
+
+        struct segment_map *maps;       /* two for each lane */
+        struct seeker seeker;
+
+        /* the transaction being split up */
+        struct segment_map *map;
+        uint64_t id;
+        struct buffer split;            /* replay_work pointers */
+        int failed;
+};
+
+static void free_work(struct replay_work *rw)
+{
+        free(rw->ios.data);
+        free(rw);
+}
+
+static void *replay_worker_loop(void *context)
+{
+        struct replay_worker *w = context;
+        struct parallel_replay *pr = w->pr;
+        struct replay_work *rw;
+        struct journal_io *io, *end;
+
+        pthread_mutex_lock(&pr->lock);
+        for (;;) {
+                while (list_empty(&w->work) && !pr->stopping)
+                        pthread_cond_wait(&w->wake, &pr->lock);
+
+                if (list_empty(&w->work))
+                        break;
+
+                rw = list_item(list_first(&w->work), struct replay_work);
+                list_del(&rw->list);
+                pthread_mutex_unlock(&pr->lock);
+
+                io = rw->ios.data;
+                end = io + rw->ios.len / sizeof(*io);
+                rw->replayer->begin(rw->replayer->context, rw->id);
+                for (; io != end; io++)
+                        rw->replayer->io(rw->replayer->context, io);
+                rw->replayer->commit(rw->replayer->context);
+
+                pthread_mutex_lock(&pr->lock);
+                rw->map->users--;
+                pr->queued--;
+                pthread_cond_broadcast(&pr->done);
+                free_work(rw);
+        }
+        pthread_mutex_unlock(&pr->lock);
+
+        return NULL;
+}
+
+static struct journal_replayer *device_replayer(struct parallel_replay *pr, struct journal_device *dev)
+{
+        unsigned n;
+        struct journal_replayer **replayers;
+
+        if (dev->id >= pr->nr_replayers) {
+                n = dev->id + 1;
+                replayers = realloc(pr->replayers, n * sizeof(*replayers));
+                if (!replayers)
+                        return NULL;
+
+                memset(replayers + pr->nr_replayers, 0,
+                       (n - pr->nr_replayers) * sizeof(*replayers));
+                pr->replayers = replayers;
+                pr->nr_replayers = n;
+        }
+
+        if (!pr->replayers[dev->id])
+                pr->replayers[dev->id] = pr->target->device(pr->target->context, dev);
+
+        return pr->replayers[dev->id];
+}
+
+static struct replay_work *split_for(struct parallel_replay *pr, struct journal_device *dev)
+{
+        struct replay_work **rws = pr->split.data, *rw;
+        size_t i, count = pr->split.len / sizeof(*rws);
+
+        for (i = 0; i < count; i++)
+                if (rws[i]->dev == dev)
+                        return rws[i];
+
+        rw = malloc(sizeof(*rw));
+        if (!rw)
+                return NULL;
+
+        memset(rw, 0, sizeof(*rw));
+        rw->dev = dev;
+        rw->replayer = device_replayer(pr, dev);
+        rw->map = pr->map;
+        rw->id = pr->id;
+        if (!rw->replayer || !buffer_append(&pr->split, &rw, sizeof(rw))) {
+                free(rw);
+                return NULL;
+        }
+
+        return rw;
+}
+
+static void split_io(void *context, struct journal_io *io)
+{
+        struct parallel_replay *pr = context;
+        struct replay_work *rw = split_for(pr, io->dev);
+
+        if (!rw || !buffer_append(&rw->ios, io, sizeof(*io)))
+                pr->failed = 1;
+}
+
+static void wait_for_workers(struct parallel_replay *pr, unsigned limit)
+{
+        while (pr->queued > limit)
+                pthread_cond_wait(&pr->done, &pr->lock);
+}
+
+/*
+ * A spilled transaction's data is in mappings of its own, and data it
+ * refers to in copies, that only last until it's been split, so it's
+ * replayed there and then, once everything before it has been.
+ */
+static void replay_split_now(struct parallel_replay *pr, struct replay_work **rws, size_t count)
+{
+        size_t i;
+        struct journal_io *io, *end;
+
+        pthread_mutex_lock(&pr->lock);
+        wait_for_workers(pr, 0);
+        pthread_mutex_unlock(&pr->lock);
+
+        for (i = 0; i < count; i++) {
+                io = rws[i]->ios.data;
+                end = io + rws[i]->ios.len / sizeof(*io);
+                rws[i]->replayer->begin(rws[i]->replayer->context, rws[i]->id);
+                for (; io != end; io++)
+                        rws[i]->replayer->io(rws[i]->replayer->context, io);
+                rws[i]->replayer->commit(rws[i]->replayer->context);
+                free_work(rws[i]);
+        }
+}
+
+static int queue_split(struct parallel_replay *pr, struct record_header *h, unsigned lane)
+{
+        size_t i, count;
+        struct replay_work **rws;
+        struct replay_worker *w;
+        struct io_data d;
+        int barrier;
+
+        pr->split.len = 0;
+        pr->id = h->id;
+        pr->failed = 0;
+
+        if (!init_io_data(pr->j, h, lane, &d))
+                return 0;
+
+        if (!live_ios(pr->j, h, &d, split_io, pr) || pr->failed) {
+                rws = pr->split.data;
+                for (i = 0; i < pr->split.len / sizeof(*rws); i++)
+                        free_work(rws[i]);
+                release_io_data(&d);
+                return 0;
+        }
+
+        rws = pr->split.data;
+        count = pr->split.len / sizeof(*rws);
+        if (d.table || d.copies.len) {
+                replay_split_now(pr, rws, count);
+                release_io_data(&d);
+                return 1;
+        }
+
+        barrier = pr->target->atomic && count > 1;
+
+        pthread_mutex_lock(&pr->lock);
+        if (barrier)
+                wait_for_workers(pr, 0);
+
+        for (i = 0; i < count; i++) {
+                wait_for_workers(pr, MAX_REPLAY_WORK - 1);
+
+                w = pr->workers + (rws[i]->dev->id % pr->nr_workers);
+                rws[i]->map->users++;
+                pr->queued++;
+                list_add(&w->work, &rws[i]->list);
+                pthread_cond_signal(&w->wake);
+        }
+
+        if (barrier)
+                wait_for_workers(pr, 0);
+        pthread_mutex_unlock(&pr->lock);
+
+        return 1;
+}
+
+/*
+ * Maps the segment holding |e|, replacing whichever of its lane's
+ * mappings has no work pointing into it, and waiting for one to be free
+ * if need be.
+ */
+static struct record_header *parallel_map_record(struct parallel_replay *pr, struct txn_entry *e)
+{
+        unsigned i;
+        struct segment_map *m, *maps = pr->maps + 2 * e->lane;
+
+        for (i = 0; i < 2; i++)
+                if (map_holds(maps + i, e)) {
+                        pr->map = maps + i;
+                        read_ahead(pr->map, e->offset);
+                        return (struct record_header *) (pr->map->data + e->offset);
+                }
+
+        pthread_mutex_lock(&pr->lock);
+        while (maps[0].users && maps[1].users)
+                pthread_cond_wait(&pr->done, &pr->lock);
+
+        if (maps[0].users)
+                m = maps + 1;
+        else if (maps[1].users)
+                m = maps;
+        else
+                m = (maps[0].nr <= maps[1].nr) ? maps : maps + 1;
+        pthread_mutex_unlock(&pr->lock);
+
+        pr->map = m;
+        return map_record(pr->j, m, e);
+}
+
+static unsigned start_workers(struct parallel_replay *pr, unsigned nr)
+{
+        unsigned i;
+
+        pr->workers = calloc(nr, sizeof(*pr->workers));
+        if (!pr->workers)
+                return 0;
+
+        for (i = 0; i < nr; i++) {
+                struct replay_worker *w = pr->workers + i;
+
+                w->pr = pr;
+                list_init(&w->work);
+                pthread_cond_init(&w->wake, NULL);
+                if (pthread_create(&w->thread, NULL, replay_worker_loop, w)) {
+                        pthread_cond_destroy(&w->wake);
+                        break;
+                }
+        }
+
+        return i;
+}
+
+static void stop_workers(struct parallel_replay *pr)
+{
+        unsigned i;
+
+        pthread_mutex_lock(&pr->lock);
+        pr->stopping = 1;
+        for (i = 0; i < pr->nr_workers; i++)
+                pthread_cond_signal(&pr->workers[i].wake);
+        pthread_mutex_unlock(&pr->lock);
+
+        for (i = 0; i < pr->nr_workers; i++) {
+                pthread_join(pr->workers[i].thread, NULL);
+                pthread_cond_destroy(&pr->workers[i].wake);
+        }
+        free(pr->workers);
+}
+
+unsigned journal_replay_parallel(struct journal *j, unsigned count,
+                                 struct journal_parallel_replayer *target)
+{
+        unsigned i, n, nr_threads = target->nr_threads;
+        uint64_t id;
+        struct txn_entry e;
+        struct record_header *h;
+        struct parallel_replay pr;
+
+        if (!nr_threads)
+                nr_threads = journal_device_count(j);
+        if (!nr_threads)
+                nr_threads = 1;
+
+        memset(&pr, 0, sizeof(pr));
+        pr.j = j;
+        pr.target = target;
+        pthread_mutex_init(&pr.lock, NULL);
+        pthread_cond_init(&pr.done, NULL);
+
+        pr.maps = calloc(2 * j->nr_lanes, sizeof(*pr.maps));
+        pr.nr_workers = (pr.maps && init_seeker(j, &pr.seeker)) ? start_workers(&pr, nr_threads) : 0;
+        for (i = 0; pr.nr_workers && i < count; i++) {
+                if (!lookup_id(j, i, &id))
+                        break;
+
+                h = locate(j, &pr.seeker, id, &e) ? parallel_map_record(&pr, &e) : NULL;
+                if (!replayable(h, &e) || !queue_split(&pr, h, e.lane)) {
+                        error("couldn't replay journal transaction %llu", (unsigned long long) id);
+                        break;
+                }
+        }
+
+        if (!pr.nr_workers) {
+                error("couldn't start journal replay threads");
+                i = 0;
+        }
+
+        stop_workers(&pr);
+        for (n = 0; pr.maps && n < 2 * j->nr_lanes; n++)
+                unmap_segment(pr.maps + n);
+        free(pr.maps);
+        exit_seeker(j, &pr.seeker);
+        free(pr.replayers);
+        free(pr.split.data);
+        pthread_cond_destroy(&pr.done);
+        pthread_mutex_destroy(&pr.lock);
+
+        return i;
+}
+
+void journal_drop(struct journal *j, uint64_t id)
+{
+        pthread_mutex_lock(&j->lock);
+        if (id > j->drop_wanted)
+                j->drop_wanted = id;
+        drop_shipped(j);
+        pthread_mutex_unlock(&j->lock);
+}
+
+/*----------------------------------------------------------------*/
+
+struct journal_subscriber *journal_subscribe(struct journal *j, uint64_t from, struct thunk *wake)
+{
+        struct journal_subscriber *s = malloc(sizeof(*s));
+
+        if (!s)
+                return NULL;
+
+        memset(s, 0, sizeof(*s));
+        if (!init_seeker(j, &s->seeker)) {
+                exit_seeker(j, &s->seeker);
+                free(s);
+                return NULL;
+        }
+
+        s->j = j;
+        s->next = from ? from : 1;
+        if (wake) {
+                s->has_wake = 1;
+                s->wake = *wake;
+        }
+
+        pthread_mutex_lock(&j->lock);
+        if (s->next <= j->dropped) {
+                pthread_mutex_unlock(&j->lock);
+                warn("can't ship the journal from transaction %llu, it's been dropped",
+                     (unsigned long long) s->next);
+                exit_seeker(j, &s->seeker);
+                free(s);
+                return NULL;
+        }
+        list_add(&j->subscribers, &s->list);
+        pthread_mutex_unlock(&j->lock);
+
+        return s;
+}
+
+void journal_unsubscribe(struct journal_subscriber *s)
+{
+        struct journal *j = s->j;
+        LIST_INIT(unused);
+
+        pthread_mutex_lock(&j->lock);
+        list_del(&s->list);
+        drop_shipped(j);
+        trim_tail(j, &unused);
+        pthread_mutex_unlock(&j->lock);
+
+        free_records(&unused);
+        exit_seeker(j, &s->seeker);
+        free(s);
+}
+
+uint64_t journal_subscriber_position(struct journal_subscriber *s)
+{
+        return s->next;
+}
+
+int journal_subscriber_wait(struct journal_subscriber *s, unsigned timeout_ms)
+{
+        int r;
+        struct timespec deadline;
+        struct journal *j = s->j;
+
+        clock_gettime(CLOCK_REALTIME, &deadline);
+        deadline.tv_sec += timeout_ms / 1000;
+        deadline.tv_nsec += (timeout_ms % 1000) * 1000000;
+        if (deadline.tv_nsec >= 1000000000) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+        }
+
+        pthread_mutex_lock(&j->lock);
+        while (!(r = shippable(s)) && !j->failed)
+                if (pthread_cond_timedwait(&j->shippable, &j->lock, &deadline))
+                        break;
+        pthread_mutex_unlock(&j->lock);
+
+        return r;
+}
+
+/*
+ * Hands over a whole transaction, with nothing coalesced: |ios| is the
+ * metadata of its |count| ios, with the data where |d| finds it.
+ */
+static int ship_ios(struct journal *j, uint64_t id, void *ios, uint32_t count,
+                    struct io_data *d, struct journal_replayer *replay)
+{
+        uint32_t i;
+        unsigned char *data;
+        struct io_columns c;
+        struct journal_io io;
+
+        io_columns_init(&c, ios, count);
+        replay->begin(replay->context, id);
+        for (i = 0; i < count; i++) {
+                data = next_io_data(d, c.len[i]);
+                if (!data)
+                        return 0;
+
+                pthread_mutex_lock(&j->lock);
+                io.dev = (c.dev[i] < j->nr_devices) ? j->devices[c.dev[i]] : NULL;
+                pthread_mutex_unlock(&j->lock);
+                if (!io.dev)
+                        return 0;
+
+                io.start_sector = c.start_sector[i];
+                io.end_sector = c.end_sector[i];
+                io.codec = c.codec[i];
+                io.len = c.len[i];
+                io.data = c.len[i] ? data : NULL;
+                if (io.codec == IO_REFERENCE && !follow_ref(d, &io))
+                        return 0;
+                replay->io(replay->context, &io);
+        }
+        replay->commit(replay->context);
+
+        return 1;
+}
+
+static int ship_record(struct journal_subscriber *s, uint64_t id,
+                       struct journal_transaction *t, struct journal_replayer *replay)
+{
+        int r;
+        struct txn_entry e;
+        struct record_header *h;
+        struct io_data d;
+
+        /* one of only zeroes and references has no data buffer */
+        if (t) {
+                memory_io_data(&d, t->data.data ? t->data.data : (unsigned char *) &t->data,
+                               t->data.len);
+                d.j = s->j;
+                d.io_refs = (struct io_ref *) t->refs.data;
+                d.nr_io_refs = t->refs.len / sizeof(*d.io_refs);
+                r = ship_ios(s->j, id, t->ios.data, t->header.count, &d, replay);
+                release_io_data(&d);
+                return r;
+        }
+
+        h = locate(s->j, &s->seeker, id, &e) ? map_record(s->j, s->seeker.maps + e.lane, &e) : NULL;
+        if (!replayable(h, &e) || !init_io_data(s->j, h, e.lane, &d))
+                return 0;
+
+        r = ship_ios(s->j, id, h + 1, h->count, &d, replay);
+        release_io_data(&d);
+        return r;
+}
+
+/*
+ * What's shipped can't be dropped underneath us, since the drop waits
+ * for it, so the transaction is still there once the lock's dropped.
+ */
+unsigned journal_subscriber_ship(struct journal_subscriber *s, unsigned max,
+                                 struct journal_replayer *replay)
+{
+        int r = 1;
+        unsigned n;
+        uint64_t id, pos;
+        struct journal *j = s->j;
+        struct journal_transaction *t;
+        LIST_INIT(unused);
+
+        for (n = 0; r && n < max; n++) {
+                pthread_mutex_lock(&j->lock);
+                if (!seek_id(j, s->next, &id, &pos)) {
+                        pthread_mutex_unlock(&j->lock);
+                        break;
+                }
+
+                t = cached_record(j, id);
+                if (t)
+                        t->users++;
+                pthread_mutex_unlock(&j->lock);
+
+                r = ship_record(s, id, t, replay);
+                if (!r)
+                        error("couldn't ship journal transaction %llu", (unsigned long long) id);
+
+                pthread_mutex_lock(&j->lock);
+                if (t)
+                        t->users--;
+                if (r) {
+                        s->next = id + 1;
+                        j->stats.shipped++;
+                        if (!t)
+                                j->stats.shipped_from_disk++;
+                }
+                trim_tail(j, &unused);
+                pthread_mutex_unlock(&j->lock);
+        }
+
+        pthread_mutex_lock(&j->lock);
+        if (j->drop_wanted > j->dropped)
+                drop_shipped(j);
+        pthread_mutex_unlock(&j->lock);
+
+        free_records(&unused);
+        return r ? n : n - 1;
+}
+
+void journal_get_stats(struct journal *j, struct journal_stats *stats)
+{
+        pthread_mutex_lock(&j->lock);
+        *stats = j->stats;
+        stats->extents = extent_index_count(j->index);
+        stats->superseded = extent_index_superseded(j->index);
+
+        roll_reclaim_rate(j);
+        stats->reclaim_rate = j->stats.reclaim_rate;
+        stats->used = used_bytes(j);
+        stats->capacity = j->opts.capacity;
+        pthread_mutex_unlock(&j->lock);
+}
+
+struct lookup_context {
+        journal_extent_fn fn;
+        void *context;
+};
+
+static void lookup_extent(void *context, struct extent_mapping *m)
+{
+        struct lookup_context *lc = context;
+        struct journal_extent e;
+
+        e.start_sector = m->begin;
+        e.end_sector = m->end;
+        e.id = m->txn;
+        e.io = m->io;
+        e.io_start_sector = m->origin;
+        lc->fn(lc->context, &e);
+}
+
+unsigned journal_lookup(struct journal *j, struct journal_device *dev,
+                        journal_sector_t begin, journal_sector_t end,
+                        journal_extent_fn fn, void *context)
+{
+        unsigned n;
+        struct lookup_context lc = { fn, context };
+
+        pthread_mutex_lock(&j->lock);
+        n = extent_index_lookup(j->index, dev->id, begin, end, lookup_extent, &lc);
+        pthread_mutex_unlock(&j->lock);
+
+        return n;
+}
+
+/*----------------------------------------------------------------*/
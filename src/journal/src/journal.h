@@ -1,8 +1,25 @@
 #ifndef JOURNAL_JOURNAL_H
 #define JOURNAL_JOURNAL_H
 
+#include "utility/thunk.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <sys/uio.h>
+
 /*----------------------------------------------------------------*/
 
+/*
+ * The journal is an append only log of transactions, kept as a series
+ * of segment files in a directory.
+ *
+ * A transaction is built up in memory, then handed to the journal's
+ * writer thread by journal_commit().  The writer takes everything that
+ * has been committed since it last looked, appends it, and makes the
+ * lot durable with a single fdatasync (group commit).  So the more
+ * clients are committing, the fewer syncs each commit costs.
+ */
+
 struct journal;
 struct journal_device;
 struct journal_transaction;
@@ -10,35 +27,375 @@ struct journal_transaction;
 /* 512 byte sectors */
 typedef uint64_t journal_sector_t;
 
+enum {
+        JOURNAL_SECTOR_SHIFT = 9
+};
+
 struct journal_io {
-        struct journal_dev *dev;
+        struct journal_device *dev;
 
         journal_sector_t start_sector;
         journal_sector_t end_sector;
+
+        /*
+         * The data is carried through in the form it arrived in,
+         * compressed with |codec| (see compress.h).  A NULL |data| and
+         * zero |len| means the sectors are all zeroes.
+         */
+        unsigned codec;
+        uint32_t len;
         void *data;
 };
 
 struct journal_replayer {
         void *context;
 
-        void (*begin)(void *);
+        void (*begin)(void *, uint64_t id);
         void (*io)(void *, struct journal_io *);
         void (*commit)(void *);
 };
 
-struct journal *journal_create(const char *directory);
-void journal_destroy(const char *directory);
+/*
+ * The journal is written once and only read back to replay it, so by
+ * default it bypasses the page cache rather than evicting things that
+ * are useful.  Filesystems without O_DIRECT fall back to buffered.
+ */
+enum journal_mode {
+        JOURNAL_DIRECT,
+        JOURNAL_BUFFERED
+};
+
+/*
+ * A checkpoint of the journal's state is written every
+ * |checkpoint_interval| bytes appended, by a thread of its own, and when
+ * it's destroyed, so recovery only has to read what was written after
+ * the last one, and the small index each segment gets once it's closed.
+ * The checkpoint holds the ids and counters, not where each transaction
+ * is, so it stays small.  0 turns checkpoints off, and recovery always
+ * reads everything.
+ *
+ * A segment is reclaimed once every transaction in it has been dropped.
+ * Up to |recycle_segments| reclaimed segments are kept to be reused, so
+ * new segments needn't be allocated.
+ *
+ * If |capacity| is set, commits are slowed down as the segments in use
+ * fill it, see journal_throttle().  The watermarks are percentages of
+ * the capacity, which covers every lane.
+ *
+ * |lanes| are directories, ideally on separate disks, that the journal
+ * is striped across as well as its own, each with a writer thread and
+ * group commit of its own.  Commits go to whichever lane has the least
+ * waiting to be written.  A journal has to be opened with the same
+ * lanes, in the same order, each time.
+ *
+ * A transaction being built holds its data in memory until it has
+ * |spill_threshold| bytes, when it's written out ahead of the commit,
+ * see journal_rollback().  0 keeps everything in memory.
+ */
+struct journal_options {
+        size_t segment_size;    /* preallocated, rounded up to 4k */
+        enum journal_mode mode;
+        uint64_t checkpoint_interval;
+        unsigned recycle_segments;
+
+        uint64_t capacity;      /* bytes, 0 for no limit */
+        unsigned low_watermark;
+        unsigned high_watermark;
+
+        unsigned nr_lanes;      /* extra lanes, 0 for just the directory */
+        const char **lanes;
+
+        uint64_t tail_cache;    /* bytes, see journal_subscribe() */
+        uint64_t spill_threshold;
+};
+
+struct journal_stats {
+        uint64_t commits;       /* transactions made durable */
+        uint64_t commit_ns;     /* their total time from journal_commit() to durable */
+        uint64_t syncs;         /* group commits */
+        uint64_t bytes;         /* appended, including metadata */
+
+        uint64_t extents;       /* in the sector index, see journal_lookup() */
+        uint64_t superseded;    /* sectors overwritten by later transactions */
+
+        uint64_t used;          /* bytes of segments that can't be reclaimed yet */
+        uint64_t capacity;
+        uint64_t reclaimed;     /* bytes of segments reclaimed */
+        uint64_t reclaim_rate;  /* bytes a second, over the last few seconds */
+        uint64_t recycled;      /* segments reused rather than allocated */
+        uint64_t throttled;     /* commits slowed down */
+        uint64_t stalled;       /* commits held back above the high watermark */
 
-struct journal_device *journal_register_device(struct journal *j, const char *name, );
+        uint64_t shipped;       /* transactions handed to subscribers */
+        uint64_t shipped_from_disk;     /* read back, rather than from the tail cache */
 
-int journal_begin(struct journal *j);
-void journal_record_io(struct journal *j, struct journal_io *io);
-int journal_commit(struct journal *j, struct thunk *notify_complete);
+        uint64_t spilled;       /* bytes written before their transaction was committed */
+        uint64_t aborted;       /* spilled transactions rolled back */
+};
+
+void journal_options_init(struct journal_options *opts);
+const char *journal_mode_name(enum journal_mode mode);
+
+/*
+ * Opens the journal in |directory|, creating it if need be.  An
+ * existing journal is scanned to recover its transactions and devices;
+ * anything torn off the end of a segment by a crash is ignored.  |opts|
+ * may be NULL for the defaults.
+ */
+struct journal *journal_create(const char *directory, struct journal_options *opts);
+
+/*
+ * Waits for everything committed so far to be written.  Subscribers
+ * have to have gone first.
+ */
+void journal_destroy(struct journal *j);
+
+/*
+ * Devices are identified by name, registering a name the journal
+ * already knows returns the existing device.
+ */
+struct journal_device *journal_register_device(struct journal *j, const char *name);
+const char *journal_device_name(struct journal_device *dev);
+
+/* Devices are numbered from 0 in the order they were registered. */
+unsigned journal_device_count(struct journal *j);
+struct journal_device *journal_get_device(struct journal *j, unsigned index);
+
+/*
+ * Bytes are uncompressed sizes.  |replayed| and |coalesced| count
+ * replay traffic, so a transaction replayed twice, eg, again after a
+ * restart because it hadn't been dropped, is counted twice.
+ * |coalesced| is what replay skipped because a later transaction,
+ * still in the journal at the time, overwrote it.
+ */
+struct journal_device_stats {
+        uint64_t journalled;
+        uint64_t replayed;
+        uint64_t coalesced;
+};
+
+void journal_get_device_stats(struct journal *j, struct journal_device *dev,
+                              struct journal_device_stats *stats);
+
+/*
+ * Transactions may be built concurrently, eg, one per client.  The
+ * data is copied by journal_record_io(), so the caller's buffer can be
+ * reused as soon as it returns.
+ */
+struct journal_transaction *journal_begin(struct journal *j);
+int journal_record_io(struct journal_transaction *t, struct journal_io *io);
+
+/*
+ * As journal_record_io(), for |count| ios at once, each with its data in
+ * |nr_iov| pieces, eg, straight out of the buffers it was received into,
+ * rather than assembled into one first.  Again the pieces can be reused
+ * as soon as it returns.  Either every io is recorded, or none are.
+ */
+struct journal_iov {
+        struct journal_device *dev;
+
+        journal_sector_t start_sector;
+        journal_sector_t end_sector;
 
+        unsigned codec;
+        const struct iovec *iov;        /* no pieces for zeroes */
+        unsigned nr_iov;
+};
+
+int journal_record_iov(struct journal_transaction *t, struct journal_iov *ios, unsigned count);
+
+/*
+ * Records an io whose data is the same as that of io |index| of
+ * transaction |id|, eg, a block the client has written before, without
+ * keeping another copy; |io|'s codec, len and data are ignored.  Replay
+ * and shipping hand over the data referred to.  Transaction |id| has to
+ * be durable and not dropped, and it's kept, whatever journal_drop() is
+ * asked, until every transaction referring to it has been dropped or
+ * rolled back.  The io referred to must hold data, not zeroes or
+ * another reference.  Returns 0, recording nothing, if |id| isn't there
+ * any more, when the caller should record the data instead.
+ */
+int journal_record_ref(struct journal_transaction *t, struct journal_io *io,
+                       uint64_t id, unsigned index);
+
+/*
+ * A transaction that spills, see |spill_threshold|, holds on to the
+ * memory of each spill until it has been written.  |notify_spilled| is
+ * called from a writer thread once each one has been, or has failed to
+ * be.  Set it before recording any ios.
+ */
+void journal_notify_spills(struct journal_transaction *t, struct thunk *notify_spilled);
+
+/*
+ * How many times |t| has spilled, with |*ios| set to how many of its
+ * ios, the first ones recorded, had their data in the spills.
+ */
+unsigned journal_transaction_spills(struct journal_transaction *t, unsigned *ios);
+
+/*
+ * Queues the transaction for a writer, and gives it an id.  Ids
+ * increase in commit order.  |notify_complete|, if not NULL, is called
+ * from a writer thread once the transaction, and every one committed
+ * before it, is durable, or once it has failed to be written (see
+ * journal_failed()).  Either way the transaction is finished with once
+ * this has been called.
+ */
+int journal_commit(struct journal_transaction *t, struct thunk *notify_complete, uint64_t *id);
+
+/*
+ * Says how long to hold back a commit, so clients slow down smoothly as
+ * the journal fills rather than it running out of space.  Below the low
+ * watermark |delay_us| is 0; between the watermarks it grows with the
+ * amount used.  Returns 0 above the high watermark, when the caller
+ * should wait |delay_us| and ask again, until dropped transactions have
+ * been reclaimed.
+ *
+ * journal_commit() doesn't throttle itself, so it never blocks a caller
+ * that the transactions may be waiting on to be dropped.
+ */
+int journal_throttle(struct journal *j, unsigned *delay_us);
+
+/*
+ * Throws away a transaction that hasn't been committed.  Whatever it's
+ * spilled stays where it is, and a single marker is written after it,
+ * so rolling back costs the same however big the transaction is.  The
+ * space goes once the transactions around it have been dropped.
+ */
+void journal_rollback(struct journal_transaction *t);
+
+/* Set once a write or sync has failed, after which commits are refused. */
+int journal_failed(struct journal *j);
+
+/*
+ * Durable transactions, oldest first.  |index| counts from the oldest
+ * that hasn't been dropped.
+ *
+ * Replay skips sectors that a later transaction, still in the journal,
+ * has overwritten, so only the final version of each sector is
+ * replayed once the lot have been.  An io may be replayed as several
+ * smaller ones, or not at all; the transaction's ids are still begun
+ * and committed.
+ *
+ * The data of a replayed io points into a read-only mapping of the
+ * journal, rather than a copy, so it mustn't be written to, and is only
+ * valid until the io callback returns.  Replaying in order reads each
+ * segment sequentially, with readahead.  Any other transaction is found
+ * by reading forward from the nearest of a sparse set of marks, at most
+ * a few hundred record headers.
+ */
 unsigned journal_transaction_count(struct journal *j);
-int journal_transaction_front(struct journal *j, unsigned index);
+int journal_transaction_front(struct journal *j, unsigned index, uint64_t *id);
 int journal_transaction_replay_front(struct journal *j, unsigned index, struct journal_replayer *replay);
 
+/*
+ * Finds the |index| of the oldest durable transaction whose id is at
+ * least |id|, without reading the journal, eg, to resume replaying from
+ * a given transaction.  Ids increase with the index, but a crash can
+ * leave gaps, and the transaction itself may have been dropped, so
+ * check its id with journal_transaction_front().  Returns 0 if every
+ * transaction is older than |id|.
+ */
+int journal_transaction_seek(struct journal *j, uint64_t id, unsigned *index);
+
+/*
+ * Replays the oldest |count| transactions with the ios for each device
+ * handed to that device's own replayer, on a thread of its own, so
+ * devices are replayed side by side.  Each device sees the transactions
+ * that touch it in order, each begun and committed with the
+ * transaction's id and holding just that device's ios.  A transaction
+ * that touches no device it has live sectors on isn't seen at all.
+ *
+ * |device| is called, from the calling thread, the first time a device
+ * turns up; the replayer it returns is then only called from one thread
+ * at a time.  |nr_threads| caps the threads, 0 means one per device.
+ * If |atomic| is set, a transaction that touches several devices is
+ * replayed on its own, once everything before it has been, so no device
+ * gets ahead of the others across it.
+ *
+ * Returns the number of transactions, oldest first, replayed in full;
+ * they can be dropped once it returns.
+ */
+struct journal_parallel_replayer {
+        void *context;
+        unsigned nr_threads;
+        int atomic;
+
+        struct journal_replayer *(*device)(void *context, struct journal_device *dev);
+};
+
+unsigned journal_replay_parallel(struct journal *j, unsigned count,
+                                 struct journal_parallel_replayer *target);
+
+/*
+ * Drops every transaction up to and including |id|, once every
+ * subscriber has shipped them, and nothing later, or still being built,
+ * refers to them; see journal_record_ref().  What's held back is
+ * dropped once it can be.
+ */
+void journal_drop(struct journal *j, uint64_t id);
+
+/*
+ * Tail streaming, for shipping transactions to another site as they're
+ * committed.  A subscriber is handed every durable transaction from id
+ * |from| on, in order, and whole: nothing's coalesced, as the other end
+ * may apply them as they come.  Subscribing fails if |from| has already
+ * been dropped, since it can't be shipped.
+ *
+ * While there are subscribers the newest durable transactions are kept
+ * in memory, up to |tail_cache| bytes, so a subscriber that keeps up
+ * ships them without reading them back; one that falls behind reads
+ * them from a mapping of the segment, as replay does.  journal_drop()
+ * holds back from anything a subscriber hasn't shipped, so a slow one
+ * fills the journal and throttles commits rather than losing them.
+ *
+ * |wake|, if not NULL, is called from a writer thread when there's more
+ * to ship, eg, to wake a csp process; it's called with the journal
+ * locked, so mustn't call back into it.  A thread of its own can block
+ * in journal_subscriber_wait() instead, which returns 0 if nothing's
+ * turned up within |timeout_ms|.  A subscriber is only used from one
+ * thread at a time.
+ */
+struct journal_subscriber;
+
+struct journal_subscriber *journal_subscribe(struct journal *j, uint64_t from, struct thunk *wake);
+void journal_unsubscribe(struct journal_subscriber *s);
+int journal_subscriber_wait(struct journal_subscriber *s, unsigned timeout_ms);
+
+/*
+ * Ships up to |max| transactions to |replay|, returning how many.  As
+ * with replay, io data is read-only, and only valid until the io
+ * callback returns.  The subscriber's position is the next id it's
+ * looking for.
+ */
+unsigned journal_subscriber_ship(struct journal_subscriber *s, unsigned max,
+                                 struct journal_replayer *replay);
+uint64_t journal_subscriber_position(struct journal_subscriber *s);
+
+/*
+ * The journal indexes the sectors written by durable transactions that
+ * haven't been dropped, so the newest copy of a sector still in the
+ * journal can be found.  |fn| is called, in sector order, for each
+ * extent of [begin, end) that's in the journal; it's called with the
+ * journal locked, so mustn't call back into it.  Sectors the journal
+ * doesn't have are skipped.
+ */
+struct journal_extent {
+        journal_sector_t start_sector;
+        journal_sector_t end_sector;
+
+        uint64_t id;            /* the transaction */
+        unsigned io;            /* which io of the transaction */
+        journal_sector_t io_start_sector;
+};
+
+typedef void (*journal_extent_fn)(void *context, struct journal_extent *e);
+
+unsigned journal_lookup(struct journal *j, struct journal_device *dev,
+                        journal_sector_t begin, journal_sector_t end,
+                        journal_extent_fn fn, void *context);
+
+void journal_get_stats(struct journal *j, struct journal_stats *stats);
+
 /*----------------------------------------------------------------*/
 
 #endif
@@ -0,0 +1,199 @@
+#include "journal/extent_index.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------*/
+
+enum {
+        DEVS = 3,
+        SECTORS = 2048,
+        OPS = 20000
+};
+
+/* The obvious implementation, one entry per sector */
+struct model_sector {
+        uint64_t txn;           /* 0 if nothing's mapped */
+        uint32_t io;
+        uint64_t origin;
+};
+
+static struct model_sector model_[DEVS][SECTORS];
+
+static void model_insert(struct extent_mapping *m)
+{
+        uint64_t s;
+
+        for (s = m->begin; s < m->end; s++) {
+                model_[m->dev][s].txn = m->txn;
+                model_[m->dev][s].io = m->io;
+                model_[m->dev][s].origin = m->origin;
+        }
+}
+
+static void model_remove(uint32_t dev, uint64_t begin, uint64_t end)
+{
+        uint64_t s;
+
+        for (s = begin; s < end; s++)
+                model_[dev][s].txn = 0;
+}
+
+static void model_drop(uint64_t txn)
+{
+        unsigned d, s;
+
+        for (d = 0; d < DEVS; d++)
+                for (s = 0; s < SECTORS; s++)
+                        if (model_[d][s].txn <= txn)
+                                model_[d][s].txn = 0;
+}
+
+struct checker {
+        uint32_t dev;
+        uint64_t next;          /* where the last extent ended */
+        uint64_t sectors;
+};
+
+static void check_extent(void *context, struct extent_mapping *m)
+{
+        uint64_t s;
+        struct checker *c = context;
+
+        assert(m->dev == c->dev);
+        assert(m->begin >= c->next);
+        assert(m->end > m->begin);
+        c->next = m->end;
+
+        for (s = m->begin; s < m->end; s++) {
+                assert(model_[m->dev][s].txn == m->txn);
+                assert(model_[m->dev][s].io == m->io);
+                assert(model_[m->dev][s].origin == m->origin);
+                c->sectors++;
+        }
+}
+
+static void check_range(struct extent_index *idx, uint32_t dev, uint64_t begin, uint64_t end)
+{
+        uint64_t s, mapped = 0;
+        struct checker c = { dev, begin, 0 };
+
+        extent_index_lookup(idx, dev, begin, end, check_extent, &c);
+        for (s = begin; s < end; s++)
+                if (model_[dev][s].txn)
+                        mapped++;
+
+        assert(c.sectors == mapped);
+}
+
+static void check_all(struct extent_index *idx)
+{
+        unsigned d;
+
+        for (d = 0; d < DEVS; d++)
+                check_range(idx, d, 0, SECTORS);
+}
+
+/*----------------------------------------------------------------*/
+
+static void count_extent(void *context, struct extent_mapping *m)
+{
+        (*((unsigned *) context))++;
+}
+
+void test_splitting()
+{
+        unsigned n = 0;
+        struct extent_index *idx = extent_index_create();
+        struct extent_mapping m = { 0, 0, 100, 1, 0, 0 };
+
+        assert(idx);
+        assert(extent_index_insert(idx, &m));
+
+        /* write into the middle, leaving a piece either side */
+        m.begin = 40;
+        m.end = 60;
+        m.txn = 2;
+        m.origin = 40;
+        assert(extent_index_insert(idx, &m));
+        assert(extent_index_count(idx) == 3);
+        assert(extent_index_superseded(idx) == 20);
+
+        assert(extent_index_lookup(idx, 0, 50, 51, count_extent, &n) == 1);
+        assert(extent_index_lookup(idx, 0, 39, 61, count_extent, &n) == 3);
+        assert(!extent_index_lookup(idx, 1, 0, 100, count_extent, &n));
+        assert(!extent_index_lookup(idx, 0, 100, 200, count_extent, &n));
+
+        /* covering the lot replaces all three */
+        m.begin = 0;
+        m.end = 100;
+        m.txn = 3;
+        assert(extent_index_insert(idx, &m));
+        assert(extent_index_count(idx) == 1);
+        assert(extent_index_superseded(idx) == 120);
+
+        assert(extent_index_remove(idx, 0, 10, 20));
+        assert(extent_index_count(idx) == 2);
+
+        extent_index_drop(idx, 2);
+        assert(extent_index_count(idx) == 2);
+        extent_index_drop(idx, 3);
+        assert(!extent_index_count(idx));
+
+        extent_index_destroy(idx);
+}
+
+void test_random()
+{
+        unsigned i, op;
+        uint64_t txn = 0, dropped = 0;
+        struct extent_index *idx = extent_index_create();
+        struct extent_mapping m;
+
+        assert(idx);
+        memset(model_, 0, sizeof(model_));
+        srand(1);
+
+        for (i = 0; i < OPS; i++) {
+                op = rand() % 100;
+                m.dev = rand() % DEVS;
+                m.begin = rand() % SECTORS;
+                m.end = m.begin + 1 + rand() % 64;
+                if (m.end > SECTORS)
+                        m.end = SECTORS;
+
+                if (op < 90) {
+                        m.txn = ++txn;
+                        m.io = rand() % 4;
+                        m.origin = m.begin;
+                        assert(extent_index_insert(idx, &m));
+                        model_insert(&m);
+
+                } else if (op < 98) {
+                        assert(extent_index_remove(idx, m.dev, m.begin, m.end));
+                        model_remove(m.dev, m.begin, m.end);
+
+                } else if (txn > dropped) {
+                        dropped += 1 + rand() % (txn - dropped);
+                        extent_index_drop(idx, dropped);
+                        model_drop(dropped);
+                }
+
+                check_range(idx, m.dev, m.begin, m.end);
+                if (!(i % 1000))
+                        check_all(idx);
+        }
+
+        check_all(idx);
+        extent_index_drop(idx, txn);
+        assert(!extent_index_count(idx));
+        extent_index_destroy(idx);
+}
+
+int main(int argc, char **argv)
+{
+        test_splitting();
+        test_random();
+        return 0;
+}
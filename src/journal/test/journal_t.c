@@ -0,0 +1,1655 @@
+#include "journal/journal.h"
+#include "journal/format.h"
+#include "log/log.h"
+
+#include <assert.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------*/
+
+enum {
+        BLOCK_SIZE = 4096,
+        SECTORS = BLOCK_SIZE >> JOURNAL_SECTOR_SHIFT
+};
+
+static char dir_[] = "/tmp/journal_t.XXXXXX";
+static char journal_dir_[64];
+static enum journal_mode mode_;
+static int checkpoints_ = 1;
+static uint64_t checkpoint_interval_;   /* 0 for the default */
+static uint64_t capacity_;
+static uint64_t spill_threshold_;       /* 0 for the default */
+
+enum {
+        MAX_LANES = 2
+};
+
+static char lane_dirs_[MAX_LANES][64];
+static const char *lanes_[MAX_LANES];
+static unsigned nr_lanes_;
+
+static void remove_dir(const char *dir)
+{
+        DIR *d;
+        struct dirent *de;
+        char path[PATH_MAX];
+
+        d = opendir(dir);
+        if (!d)
+                return;
+
+        while ((de = readdir(d))) {
+                if (de->d_name[0] == '.')
+                        continue;
+                snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+                unlink(path);
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+static void remove_journal()
+{
+        unsigned i;
+
+        remove_dir(journal_dir_);
+        for (i = 0; i < MAX_LANES; i++)
+                remove_dir(lane_dirs_[i]);
+}
+
+static struct journal *open_journal(size_t segment_size)
+{
+        struct journal_options opts;
+        struct journal *j;
+
+        journal_options_init(&opts);
+        opts.mode = mode_;
+        if (checkpoint_interval_)
+                opts.checkpoint_interval = checkpoint_interval_;
+        if (!checkpoints_)
+                opts.checkpoint_interval = 0;
+        if (segment_size)
+                opts.segment_size = segment_size;
+        if (capacity_) {
+                opts.capacity = capacity_;
+                opts.low_watermark = 50;
+                opts.high_watermark = 80;
+        }
+        if (spill_threshold_)
+                opts.spill_threshold = spill_threshold_;
+        opts.nr_lanes = nr_lanes_;
+        opts.lanes = lanes_;
+
+        j = journal_create(journal_dir_, &opts);
+        assert(j);
+        return j;
+}
+
+static void fill_block(unsigned char *data, unsigned seed)
+{
+        unsigned i;
+        for (i = 0; i < BLOCK_SIZE; i++)
+                data[i] = (seed * 31 + i) & 0xff;
+}
+
+static void notify(void *context)
+{
+        (*((unsigned *) context))++;
+}
+
+/* Commits a transaction of |count| blocks starting at |sector| */
+static uint64_t commit_blocks(struct journal *j, struct journal_device *dev,
+                              uint64_t sector, unsigned count, unsigned *notified)
+{
+        unsigned i;
+        uint64_t id;
+        unsigned char data[BLOCK_SIZE];
+        struct journal_io io;
+        struct journal_transaction *t = journal_begin(j);
+        struct thunk th = { notify, notified };
+
+        assert(t);
+        for (i = 0; i < count; i++) {
+                fill_block(data, sector + i * SECTORS);
+                io.dev = dev;
+                io.start_sector = sector + i * SECTORS;
+                io.end_sector = io.start_sector + SECTORS;
+                io.codec = 0;
+                io.len = BLOCK_SIZE;
+                io.data = data;
+                assert(journal_record_io(t, &io));
+        }
+
+        assert(journal_commit(t, &th, &id));
+        return id;
+}
+
+/*----------------------------------------------------------------*/
+
+struct checker {
+        uint64_t id;
+        unsigned ios;
+        unsigned zero_ios;
+        int committed;
+        int bad;
+};
+
+static void check_begin(void *context, uint64_t id)
+{
+        struct checker *c = context;
+        c->id = id;
+        c->ios = c->zero_ios = c->committed = c->bad = 0;
+}
+
+static void check_io(void *context, struct journal_io *io)
+{
+        struct checker *c = context;
+        unsigned char expected[BLOCK_SIZE];
+
+        c->ios++;
+        if (!io->data) {
+                c->zero_ios++;
+                return;
+        }
+
+        fill_block(expected, io->start_sector);
+        if (io->len != BLOCK_SIZE || io->end_sector - io->start_sector != SECTORS ||
+            memcmp(expected, io->data, BLOCK_SIZE))
+                c->bad = 1;
+}
+
+static void check_commit(void *context)
+{
+        struct checker *c = context;
+        c->committed = 1;
+}
+
+static void check_replay(struct journal *j, unsigned index, uint64_t id, unsigned ios)
+{
+        struct checker c;
+        struct journal_replayer r = { &c, check_begin, check_io, check_commit };
+
+        assert(journal_transaction_replay_front(j, index, &r));
+        assert(c.id == id);
+        assert(c.ios == ios);
+        assert(c.committed);
+        assert(!c.bad);
+}
+
+/*----------------------------------------------------------------*/
+
+void test_commit_and_recover()
+{
+        unsigned notified = 0;
+        uint64_t id1, id2, id;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+        struct journal_transaction *t;
+        struct journal_io io;
+
+        assert(dev);
+        assert(journal_register_device(j, "dev0") == dev);
+        assert(!strcmp(journal_device_name(dev), "dev0"));
+
+        id1 = commit_blocks(j, dev, 0, 4, &notified);
+        id2 = commit_blocks(j, dev, 1024, 1, &notified);
+        assert(id2 > id1);
+
+        /* a zero block carries no data */
+        t = journal_begin(j);
+        io.dev = dev;
+        io.start_sector = 4096;
+        io.end_sector = 4096 + SECTORS;
+        io.codec = 0;
+        io.len = 0;
+        io.data = NULL;
+        assert(journal_record_io(t, &io));
+
+        /* an empty range is refused */
+        io.end_sector = io.start_sector;
+        assert(!journal_record_io(t, &io));
+        assert(journal_commit(t, NULL, &id));
+
+        /* rolled back transactions never appear */
+        t = journal_begin(j);
+        journal_rollback(t);
+
+        journal_destroy(j);
+        assert(notified == 2);
+
+        j = open_journal(0);
+        assert(journal_transaction_count(j) == 3);
+        assert(journal_transaction_front(j, 0, &id) && id == id1);
+        assert(journal_transaction_front(j, 2, &id) && id == id2 + 1);
+        assert(!journal_transaction_front(j, 3, &id));
+
+        check_replay(j, 0, id1, 4);
+        check_replay(j, 1, id2, 1);
+        check_replay(j, 2, id2 + 1, 1);
+
+        /* the device was recovered too */
+        dev = journal_register_device(j, "dev0");
+        assert(dev);
+        assert(journal_register_device(j, "dev1") != dev);
+
+        /* ids carry on from where they left off */
+        assert(commit_blocks(j, dev, 0, 1, &notified) == id2 + 2);
+        journal_destroy(j);
+        remove_journal();
+}
+
+void test_drop()
+{
+        unsigned i, index, notified = 0;
+        uint64_t ids[8], id;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        for (i = 0; i < 8; i++)
+                ids[i] = commit_blocks(j, dev, i * 64, 1, &notified);
+        journal_destroy(j);
+
+        j = open_journal(0);
+        journal_drop(j, ids[2]);
+        assert(journal_transaction_count(j) == 5);
+        assert(journal_transaction_front(j, 0, &id) && id == ids[3]);
+        check_replay(j, 0, ids[3], 1);
+
+        /* seeking to a dropped transaction finds the oldest left */
+        for (i = 0; i < 8; i++) {
+                assert(journal_transaction_seek(j, ids[i], &index));
+                assert(index == ((i < 3) ? 0 : i - 3));
+                assert(journal_transaction_front(j, index, &id));
+                assert(id == ((i < 3) ? ids[3] : ids[i]));
+        }
+        assert(!journal_transaction_seek(j, ids[7] + 1, &index));
+        journal_destroy(j);
+
+        /* drops are journalled */
+        j = open_journal(0);
+        assert(journal_transaction_count(j) == 5);
+        journal_drop(j, ids[7]);
+        assert(!journal_transaction_count(j));
+        journal_destroy(j);
+
+        j = open_journal(0);
+        assert(!journal_transaction_count(j));
+        journal_destroy(j);
+        remove_journal();
+}
+
+/* Segments are preallocated, so the end is the first zeroed header */
+static off_t segment_end(int fd)
+{
+        off_t offset = SEGMENT_HEADER_SIZE;
+        struct record_header h;
+
+        for (;;) {
+                assert(pread(fd, &h, sizeof(h), offset) == sizeof(h));
+                if (!h.magic)
+                        return offset;
+                offset += h.len;
+        }
+}
+
+struct extents {
+        unsigned count;
+        struct journal_extent e[8];
+};
+
+static void collect_extent(void *context, struct journal_extent *e)
+{
+        struct extents *es = context;
+
+        assert(es->count < 8);
+        es->e[es->count++] = *e;
+}
+
+static void check_extent(struct journal_extent *e, uint64_t begin, uint64_t id, unsigned io)
+{
+        assert(e->start_sector == begin);
+        assert(e->end_sector == begin + SECTORS);
+        assert(e->id == id);
+        assert(e->io == io);
+        assert(e->io_start_sector == begin);
+}
+
+/* The newest copy of each sector, whether written or recovered */
+static void check_lookup(struct journal *j, struct journal_device *dev, uint64_t id1, uint64_t id2)
+{
+        struct extents es;
+
+        es.count = 0;
+        assert(journal_lookup(j, dev, 0, 8 * SECTORS, collect_extent, &es) == 4);
+        check_extent(es.e + 0, 0, id1, 0);
+        check_extent(es.e + 1, SECTORS, id2, 0);
+        check_extent(es.e + 2, 2 * SECTORS, id1, 2);
+        check_extent(es.e + 3, 3 * SECTORS, id1, 3);
+}
+
+void test_lookup()
+{
+        unsigned notified = 0;
+        uint64_t id1, id2;
+        struct journal_stats stats;
+        struct extents es;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        id1 = commit_blocks(j, dev, 0, 4, &notified);
+        id2 = commit_blocks(j, dev, SECTORS, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 2)
+                usleep(1000);
+
+        check_lookup(j, dev, id1, id2);
+        journal_get_stats(j, &stats);
+        assert(stats.extents == 4);
+        assert(stats.superseded == SECTORS);
+        journal_destroy(j);
+
+        j = open_journal(0);
+        dev = journal_register_device(j, "dev0");
+        check_lookup(j, dev, id1, id2);
+
+        /* a dropped transaction leaves the index */
+        journal_drop(j, id1);
+        es.count = 0;
+        assert(journal_lookup(j, dev, 0, 8 * SECTORS, collect_extent, &es) == 1);
+        check_extent(es.e, SECTORS, id2, 0);
+
+        journal_destroy(j);
+        remove_journal();
+}
+
+/* Commits one io of [begin, end), with |len| bytes of data */
+static uint64_t commit_io(struct journal *j, struct journal_device *dev,
+                          uint64_t begin, uint64_t end, unsigned codec, uint32_t len)
+{
+        uint64_t id;
+        unsigned char data[BLOCK_SIZE];
+        struct journal_io io = { dev, begin, end, codec, len, data };
+        struct journal_transaction *t = journal_begin(j);
+
+        assert(t);
+        fill_block(data, begin);
+        assert(journal_record_io(t, &io));
+        assert(journal_commit(t, NULL, &id));
+        return id;
+}
+
+struct recorder {
+        unsigned count;
+        struct journal_io ios[8];
+        unsigned char first[8];
+};
+
+static void record_begin(void *context, uint64_t id)
+{
+        ((struct recorder *) context)->count = 0;
+}
+
+static void record_io(void *context, struct journal_io *io)
+{
+        struct recorder *r = context;
+
+        assert(r->count < 8);
+        r->first[r->count] = io->data ? *((unsigned char *) io->data) : 0;
+        r->ios[r->count++] = *io;
+}
+
+static void record_commit(void *context)
+{
+}
+
+static void check_piece(struct recorder *r, unsigned index, uint64_t begin, uint64_t end,
+                        uint32_t len, uint64_t origin)
+{
+        struct journal_io *io = r->ios + index;
+
+        assert(io->start_sector == begin);
+        assert(io->end_sector == end);
+        assert(io->len == len);
+
+        /* fill_block() repeats every 512 bytes, so a slice starts like the whole */
+        assert(r->first[index] == ((origin * 31) & 0xff));
+}
+
+void test_coalescing()
+{
+        unsigned notified = 0;
+        struct recorder rec;
+        struct journal_replayer r = { &rec, record_begin, record_io, record_commit };
+        struct journal_device_stats stats;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        /* the second block's overwritten, the third has a hole punched in it */
+        commit_blocks(j, dev, 0, 4, &notified);
+        commit_blocks(j, dev, SECTORS, 1, &notified);
+        commit_io(j, dev, 2 * SECTORS + 2, 2 * SECTORS + 4, 0, 1024);
+
+        /* compressed data can't be cut up */
+        commit_io(j, dev, 8 * SECTORS, 9 * SECTORS, 1, 100);
+        commit_io(j, dev, 8 * SECTORS + 2, 8 * SECTORS + 4, 0, 1024);
+
+        /* overwritten completely */
+        commit_io(j, dev, 16 * SECTORS, 17 * SECTORS, 1, 100);
+        commit_io(j, dev, 16 * SECTORS, 17 * SECTORS, 0, BLOCK_SIZE);
+        journal_destroy(j);
+
+        j = open_journal(0);
+        dev = journal_register_device(j, "dev0");
+        assert(journal_transaction_count(j) == 7);
+
+        assert(journal_transaction_replay_front(j, 0, &r));
+        assert(rec.count == 4);
+        check_piece(&rec, 0, 0, SECTORS, BLOCK_SIZE, 0);
+        check_piece(&rec, 1, 2 * SECTORS, 2 * SECTORS + 2, 1024, 2 * SECTORS);
+        check_piece(&rec, 2, 2 * SECTORS + 4, 3 * SECTORS, 2048, 2 * SECTORS);
+        check_piece(&rec, 3, 3 * SECTORS, 4 * SECTORS, BLOCK_SIZE, 3 * SECTORS);
+
+        assert(journal_transaction_replay_front(j, 1, &r));
+        assert(rec.count == 1);
+        assert(journal_transaction_replay_front(j, 3, &r));
+        assert(rec.count == 1);
+        check_piece(&rec, 0, 8 * SECTORS, 9 * SECTORS, 100, 8 * SECTORS);
+
+        assert(journal_transaction_replay_front(j, 5, &r));
+        assert(!rec.count);
+        assert(journal_transaction_replay_front(j, 6, &r));
+        assert(rec.count == 1);
+
+        journal_get_device_stats(j, dev, &stats);
+        assert(stats.coalesced == (SECTORS + 2 + SECTORS) << JOURNAL_SECTOR_SHIFT);
+        assert(stats.replayed == (6 * SECTORS - 2) << JOURNAL_SECTOR_SHIFT);
+        assert(stats.journalled == (8 * SECTORS + 4) << JOURNAL_SECTOR_SHIFT);
+
+        /* they count replay traffic, so replaying again counts again */
+        assert(journal_transaction_replay_front(j, 0, &r));
+        journal_get_device_stats(j, dev, &stats);
+        assert(stats.coalesced == (3 * SECTORS + 4) << JOURNAL_SECTOR_SHIFT);
+        assert(stats.replayed == (9 * SECTORS - 4) << JOURNAL_SECTOR_SHIFT);
+
+        assert(journal_device_count(j) == 1);
+        assert(journal_get_device(j, 0) == dev);
+        assert(!journal_get_device(j, 1));
+
+        journal_destroy(j);
+        remove_journal();
+}
+
+void test_torn_tail()
+{
+        int fd;
+        unsigned notified = 0;
+        char path[PATH_MAX], junk[100];
+        uint64_t id;
+        struct journal *j;
+        struct journal_device *dev;
+
+        /* a crash leaves no checkpoint behind */
+        checkpoints_ = 0;
+        j = open_journal(0);
+        dev = journal_register_device(j, "dev0");
+
+        commit_blocks(j, dev, 0, 2, &notified);
+        id = commit_blocks(j, dev, 64, 2, &notified);
+        journal_destroy(j);
+
+        /* half a record header on the end, as if we'd crashed mid write */
+        snprintf(path, sizeof(path), "%s/segment.1", journal_dir_);
+        fd = open(path, O_RDWR);
+        assert(fd >= 0);
+        memset(junk, 0xff, sizeof(junk));
+        assert(pwrite(fd, junk, 12, segment_end(fd)) == 12);
+        close(fd);
+
+        j = open_journal(0);
+        dev = journal_register_device(j, "dev0");
+        assert(journal_transaction_count(j) == 2);
+        check_replay(j, 1, id, 2);
+        assert(commit_blocks(j, dev, 128, 1, &notified) == id + 1);
+        journal_destroy(j);
+
+        j = open_journal(0);
+        assert(journal_transaction_count(j) == 3);
+        check_replay(j, 2, id + 1, 1);
+        journal_destroy(j);
+        remove_journal();
+        checkpoints_ = 1;
+}
+
+/*
+ * Flips a byte in the data of the last transaction in a segment,
+ * returning 0 if the segment isn't there or holds no transactions.
+ */
+static int corrupt_segment(unsigned nr)
+{
+        int fd;
+        off_t offset = SEGMENT_HEADER_SIZE, last = 0;
+        char path[PATH_MAX];
+        unsigned char byte;
+        struct record_header h;
+
+        snprintf(path, sizeof(path), "%s/segment.%u", journal_dir_, nr);
+        fd = open(path, O_RDWR);
+        if (fd < 0)
+                return 0;
+
+        while (pread(fd, &h, sizeof(h), offset) == sizeof(h) && h.magic) {
+                if (h.type == RECORD_TRANSACTION)
+                        last = offset;
+                offset += h.len;
+        }
+
+        if (!last) {
+                close(fd);
+                return 0;
+        }
+
+        assert(pread(fd, &h, sizeof(h), last) == sizeof(h));
+        offset = last + h.len - sizeof(struct record_commit) - 1;
+        assert(pread(fd, &byte, 1, offset) == 1);
+        byte ^= 0xff;
+        assert(pwrite(fd, &byte, 1, offset) == 1);
+        close(fd);
+        return 1;
+}
+
+/*
+ * Older segments only have their commit markers checked by recovery,
+ * so damage there is caught by replay.  The newest segment may have
+ * been torn, so it's checked in full.
+ */
+void test_checksums()
+{
+        unsigned i, notified = 0;
+        struct checker c;
+        struct journal_replayer r = { &c, check_begin, check_io, check_commit };
+        struct journal *j;
+        struct journal_device *dev;
+
+        checkpoints_ = 0;
+        j = open_journal(4 * BLOCK_SIZE);
+        dev = journal_register_device(j, "dev0");
+
+        for (i = 0; i < 4; i++)
+                commit_blocks(j, dev, i * 64, 2, &notified);
+        journal_destroy(j);
+
+        /*
+         * Each transaction gets a segment to itself, but the device may
+         * have had one first, which has been reclaimed.
+         */
+        for (i = 1; !corrupt_segment(i); i++)
+                assert(i < 2);
+        assert(corrupt_segment(i + 3));
+
+        j = open_journal(4 * BLOCK_SIZE);
+        dev = journal_register_device(j, "dev0");
+        assert(journal_transaction_count(j) == 3);
+        assert(!journal_transaction_replay_front(j, 0, &r));
+        check_replay(j, 1, 2, 2);
+        check_replay(j, 2, 3, 2);
+
+        /* ids carry on after the torn transaction */
+        assert(commit_blocks(j, dev, 0, 1, &notified) == 4);
+        journal_destroy(j);
+        remove_journal();
+        checkpoints_ = 1;
+}
+
+static void count_extent(void *context, struct journal_extent *e)
+{
+        (*((unsigned *) context))++;
+}
+
+static void check_recovered(unsigned first, unsigned count)
+{
+        unsigned i, extents = 0;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        assert(journal_transaction_count(j) == count);
+        for (i = 0; i < count; i++)
+                check_replay(j, i, first + i, 1);
+
+        journal_lookup(j, dev, 0, 1024 * SECTORS, count_extent, &extents);
+        assert(extents == count);
+        journal_destroy(j);
+}
+
+static void flip_byte(const char *name, off_t offset)
+{
+        int fd;
+        char path[PATH_MAX];
+        unsigned char byte;
+
+        snprintf(path, sizeof(path), "%s/%s", journal_dir_, name);
+        fd = open(path, O_RDWR);
+        assert(fd >= 0);
+        assert(pread(fd, &byte, 1, offset) == 1);
+        byte ^= 0xff;
+        assert(pwrite(fd, &byte, 1, offset) == 1);
+        close(fd);
+}
+
+/*
+ * A child commits transactions and dies without destroying the
+ * journal, leaving a checkpoint part way through and a tail after it.
+ */
+void test_checkpoint()
+{
+        int status;
+        unsigned i, notified = 0;
+        pid_t pid;
+        struct journal *j;
+        struct journal_device *dev;
+
+        pid = fork();
+        assert(pid >= 0);
+        if (!pid) {
+                checkpoint_interval_ = 16 * BLOCK_SIZE;
+                j = open_journal(0);
+                dev = journal_register_device(j, "dev0");
+                for (i = 0; i < 40; i++) {
+                        commit_blocks(j, dev, i * SECTORS, 1, &notified);
+                        while (*((volatile unsigned *) &notified) <= i)
+                                usleep(100);
+                }
+                _exit(0);
+        }
+
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFEXITED(status) && !WEXITSTATUS(status));
+
+        /* the checkpoint, then the tail */
+        check_recovered(1, 40);
+
+        /* and after a clean shutdown, just the checkpoint */
+        check_recovered(1, 40);
+
+        j = open_journal(0);
+        journal_drop(j, 10);
+        journal_destroy(j);
+        check_recovered(11, 30);
+
+        /* a damaged checkpoint means reading everything */
+        flip_byte("checkpoint", 60);
+        check_recovered(11, 30);
+
+        remove_journal();
+}
+
+void test_segments()
+{
+        unsigned i, notified = 0;
+        struct journal_stats stats;
+        struct journal *j = open_journal(4 * BLOCK_SIZE);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        /* each transaction needs a segment, the big one is oversized */
+        for (i = 0; i < 16; i++)
+                commit_blocks(j, dev, i * 64, (i == 7) ? 8 : 2, &notified);
+
+        journal_destroy(j);
+        assert(notified == 16);
+
+        j = open_journal(4 * BLOCK_SIZE);
+        assert(journal_transaction_count(j) == 16);
+        for (i = 0; i < 16; i++)
+                check_replay(j, i, i + 1, (i == 7) ? 8 : 2);
+
+        /* out of order, so each replay maps a different segment */
+        for (i = 16; i--; )
+                check_replay(j, i, i + 1, (i == 7) ? 8 : 2);
+
+        journal_get_stats(j, &stats);
+        assert(!stats.commits);
+        journal_destroy(j);
+        remove_journal();
+}
+
+/*
+ * Replay maps the segment being appended to, so records written after
+ * it's mapped must show up in the mapping.
+ */
+void test_replay_while_writing()
+{
+        unsigned i, notified = 0;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        for (i = 0; i < 8; i++) {
+                commit_blocks(j, dev, i * 64, 2, &notified);
+                while (*((volatile unsigned *) &notified) < i + 1)
+                        usleep(1000);
+
+                check_replay(j, i, i + 1, 2);
+                if (i)
+                        check_replay(j, i - 1, i, 2);
+        }
+
+        journal_destroy(j);
+        remove_journal();
+}
+
+/*
+ * Parallel replay, over four devices.  Every eighth transaction touches
+ * all of them, the rest one each.  The first transaction's block on dev0
+ * is overwritten later, so dev0 never sees it.
+ */
+enum {
+        PARALLEL_DEVS = 4,
+        PARALLEL_TXNS = 64,
+        OVERWRITER = 60
+};
+
+struct device_checker {
+        struct journal_replayer replayer;
+        struct parallel_checker *pc;
+        unsigned index;
+
+        uint64_t current;
+        uint64_t last;                  /* the newest committed */
+        unsigned ios;
+        int bad;
+};
+
+struct parallel_checker {
+        int atomic;
+        pthread_mutex_t lock;
+        struct device_checker devs[PARALLEL_DEVS];
+};
+
+static int multi_device(unsigned i)
+{
+        return i % 8 == 7;
+}
+
+static int touches(unsigned i, unsigned dev)
+{
+        if (!i && !dev)
+                return 0;
+
+        return multi_device(i) || i % PARALLEL_DEVS == dev;
+}
+
+/* The id of the newest transaction before |id| that |dev| replays */
+static uint64_t last_before(unsigned dev, uint64_t id)
+{
+        unsigned i;
+        uint64_t r = 0;
+
+        for (i = 0; i + 1 < id; i++)
+                if (touches(i, dev))
+                        r = i + 1;
+
+        return r;
+}
+
+static void parallel_begin(void *context, uint64_t id)
+{
+        unsigned d;
+        uint64_t bound;
+        struct device_checker *dc = context;
+        struct parallel_checker *pc = dc->pc;
+
+        if (id <= dc->last || !touches(id - 1, dc->index))
+                dc->bad = 1;
+        dc->current = id;
+
+        if (!pc->atomic)
+                return;
+
+        /*
+         * Nothing before a multi device transaction can still be in
+         * flight, and nothing after it can start till it's done.
+         */
+        bound = multi_device(id - 1) ? id : (id & ~7ULL) + 1;
+        pthread_mutex_lock(&pc->lock);
+        for (d = 0; d < PARALLEL_DEVS; d++)
+                if (pc->devs[d].last < last_before(d, bound))
+                        dc->bad = 1;
+        pthread_mutex_unlock(&pc->lock);
+}
+
+static void parallel_io(void *context, struct journal_io *io)
+{
+        struct device_checker *dc = context;
+        unsigned char expected[BLOCK_SIZE];
+
+        fill_block(expected, io->start_sector);
+        if (io->len != BLOCK_SIZE || io->end_sector - io->start_sector != SECTORS ||
+            memcmp(expected, io->data, BLOCK_SIZE))
+                dc->bad = 1;
+        dc->ios++;
+}
+
+static void parallel_commit(void *context)
+{
+        struct device_checker *dc = context;
+
+        pthread_mutex_lock(&dc->pc->lock);
+        dc->last = dc->current;
+        pthread_mutex_unlock(&dc->pc->lock);
+}
+
+static struct journal_replayer *parallel_device(void *context, struct journal_device *dev)
+{
+        struct parallel_checker *pc = context;
+        unsigned index = journal_device_name(dev)[3] - '0';
+
+        assert(index < PARALLEL_DEVS);
+        return &pc->devs[index].replayer;
+}
+
+static void check_parallel_replay(struct journal *j, unsigned nr_threads, int atomic)
+{
+        unsigned d, i, expected;
+        struct parallel_checker pc;
+        struct journal_parallel_replayer target = { &pc, nr_threads, atomic, parallel_device };
+
+        memset(&pc, 0, sizeof(pc));
+        pc.atomic = atomic;
+        pthread_mutex_init(&pc.lock, NULL);
+        for (d = 0; d < PARALLEL_DEVS; d++) {
+                struct device_checker *dc = pc.devs + d;
+
+                dc->replayer.context = dc;
+                dc->replayer.begin = parallel_begin;
+                dc->replayer.io = parallel_io;
+                dc->replayer.commit = parallel_commit;
+                dc->pc = &pc;
+                dc->index = d;
+        }
+
+        assert(journal_replay_parallel(j, PARALLEL_TXNS, &target) == PARALLEL_TXNS);
+
+        for (d = 0; d < PARALLEL_DEVS; d++) {
+                for (i = expected = 0; i < PARALLEL_TXNS; i++)
+                        expected += touches(i, d);
+
+                assert(!pc.devs[d].bad);
+                assert(pc.devs[d].ios == expected);
+                assert(pc.devs[d].last == last_before(d, PARALLEL_TXNS + 1));
+        }
+        pthread_mutex_destroy(&pc.lock);
+}
+
+void test_parallel_replay()
+{
+        unsigned d, i, notified = 0;
+        char name[16];
+        uint64_t id, sector;
+        unsigned char data[BLOCK_SIZE];
+        struct journal_io io;
+        struct journal_transaction *t;
+        struct journal_device *devs[PARALLEL_DEVS];
+        struct thunk th = { notify, &notified };
+        struct journal *j = open_journal(8 * BLOCK_SIZE);
+
+        for (d = 0; d < PARALLEL_DEVS; d++) {
+                snprintf(name, sizeof(name), "dev%u", d);
+                devs[d] = journal_register_device(j, name);
+        }
+
+        for (i = 0; i < PARALLEL_TXNS; i++) {
+                if (!multi_device(i)) {
+                        sector = (i == OVERWRITER) ? 0 : (i / PARALLEL_DEVS) * SECTORS;
+                        commit_blocks(j, devs[i % PARALLEL_DEVS], sector, 1, &notified);
+                        continue;
+                }
+
+                t = journal_begin(j);
+                assert(t);
+                sector = (1024 + i) * SECTORS;
+                fill_block(data, sector);
+                for (d = 0; d < PARALLEL_DEVS; d++) {
+                        io.dev = devs[d];
+                        io.start_sector = sector;
+                        io.end_sector = sector + SECTORS;
+                        io.codec = 0;
+                        io.len = BLOCK_SIZE;
+                        io.data = data;
+                        assert(journal_record_io(t, &io));
+                }
+                assert(journal_commit(t, &th, &id));
+        }
+
+        journal_destroy(j);
+        assert(notified == PARALLEL_TXNS);
+
+        j = open_journal(8 * BLOCK_SIZE);
+        check_parallel_replay(j, 0, 0);
+        check_parallel_replay(j, 0, 1);
+        check_parallel_replay(j, 3, 1);
+        check_parallel_replay(j, 1, 0);
+        journal_destroy(j);
+        remove_journal();
+}
+
+static unsigned count_files_in(const char *dir, const char *prefix)
+{
+        DIR *d;
+        struct dirent *de;
+        unsigned n = 0;
+
+        d = opendir(dir);
+        assert(d);
+        while ((de = readdir(d)))
+                if (!strncmp(de->d_name, prefix, strlen(prefix)))
+                        n++;
+        closedir(d);
+
+        return n;
+}
+
+static unsigned count_files(const char *prefix)
+{
+        return count_files_in(journal_dir_, prefix);
+}
+
+static void wait_for_reclaim(struct journal *j, uint64_t before)
+{
+        struct journal_stats stats;
+
+        do {
+                usleep(1000);
+                journal_get_stats(j, &stats);
+        } while (stats.reclaimed == before);
+}
+
+/*
+ * Dropped transactions' segments are reclaimed, and some kept to be
+ * reused.  A reused segment still holds the records it had before,
+ * after the new ones, which mustn't be recovered.
+ */
+void test_reclaim()
+{
+        int status;
+        unsigned i, segments, notified = 0;
+        pid_t pid;
+        struct journal_stats before, after;
+        struct journal *j = open_journal(8 * BLOCK_SIZE);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        for (i = 0; i < 64; i++)
+                commit_blocks(j, dev, i * SECTORS, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 64)
+                usleep(1000);
+
+        segments = count_files("segment.");
+        assert(segments > 6);
+        journal_get_stats(j, &before);
+
+        journal_drop(j, 62);
+        wait_for_reclaim(j, 0);
+
+        journal_get_stats(j, &after);
+        assert(after.used < before.used);
+        assert(after.reclaimed >= (segments - 2) * 8 * BLOCK_SIZE);
+        assert(count_files("segment.") < segments);
+        assert(count_files("free.") == 4);
+        journal_destroy(j);
+
+        /* the crash leaves old records after the new one */
+        pid = fork();
+        assert(pid >= 0);
+        if (!pid) {
+                notified = 0;
+                j = open_journal(8 * BLOCK_SIZE);
+                dev = journal_register_device(j, "dev0");
+                commit_blocks(j, dev, 64 * SECTORS, 1, &notified);
+                while (!*((volatile unsigned *) &notified))
+                        usleep(100);
+
+                journal_get_stats(j, &after);
+                _exit(after.recycled == 1 ? 0 : 1);
+        }
+
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFEXITED(status) && !WEXITSTATUS(status));
+        assert(count_files("free.") == 3);
+
+        check_recovered(63, 3);
+        check_recovered(63, 3);
+        remove_journal();
+}
+
+/*
+ * Transactions are found from the marks each lane keeps, the start of
+ * each segment and every 256th transaction, reading forward from there.
+ * Once there's a checkpoint, recovery takes the marks of the segments
+ * before it from their indexes.
+ */
+enum {
+        SEEK_TXNS = 1000
+};
+
+static void check_seeks(struct journal *j, unsigned first)
+{
+        unsigned i, n, index;
+
+        assert(journal_transaction_count(j) == SEEK_TXNS - first + 1);
+
+        /* all over the place, then in order, then backwards */
+        for (i = 0; i <= SEEK_TXNS - first; i++) {
+                n = (i * 397) % (SEEK_TXNS - first + 1);
+                check_replay(j, n, first + n, 1);
+        }
+        for (i = 0; i <= SEEK_TXNS - first; i++)
+                check_replay(j, i, first + i, 1);
+        for (i = SEEK_TXNS - first + 1; i--; )
+                check_replay(j, i, first + i, 1);
+
+        assert(journal_transaction_seek(j, first + 200, &index) && index == 200);
+        assert(journal_transaction_seek(j, 1, &index) && index == 0);
+        assert(!journal_transaction_seek(j, SEEK_TXNS + 1, &index));
+}
+
+static void flip_index_bytes()
+{
+        DIR *d;
+        struct dirent *de;
+        unsigned n = 0;
+
+        d = opendir(journal_dir_);
+        assert(d);
+        while ((de = readdir(d)))
+                if (!strncmp(de->d_name, "index.", 6) && n++ % 2)
+                        flip_byte(de->d_name, 40);
+        closedir(d);
+}
+
+void test_seek()
+{
+        int fd;
+        unsigned i, notified = 0;
+        char path[PATH_MAX];
+        struct journal *j = open_journal(512 * BLOCK_SIZE);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        for (i = 0; i < SEEK_TXNS; i++)
+                commit_blocks(j, dev, i * SECTORS, 1, &notified);
+        while (*((volatile unsigned *) &notified) < SEEK_TXNS)
+                usleep(1000);
+
+        check_seeks(j, 1);
+        journal_destroy(j);
+        assert(count_files("index.") > 1);
+
+        /* an index without its segment goes */
+        snprintf(path, sizeof(path), "%s/index.999", journal_dir_);
+        fd = open(path, O_WRONLY | O_CREAT, 0644);
+        assert(fd >= 0);
+        close(fd);
+
+        j = open_journal(512 * BLOCK_SIZE);
+        assert(!count_files("index.999"));
+        check_seeks(j, 1);
+        journal_drop(j, 700);
+        journal_destroy(j);
+        assert(!count_files("segment.1") && !count_files("index.1"));
+
+        /* bad indexes just mean reading their segments */
+        flip_index_bytes();
+        j = open_journal(512 * BLOCK_SIZE);
+        check_seeks(j, 701);
+        journal_destroy(j);
+
+        remove_journal();
+}
+
+/*
+ * Commits are slowed down more the fuller the journal is, and held
+ * back above the high watermark, until dropping makes space.
+ */
+void test_throttle()
+{
+        int ok;
+        unsigned i, delay, last_delay = 0, notified = 0;
+        uint64_t id = 0;
+        struct journal_stats stats;
+        struct journal *j;
+        struct journal_device *dev;
+
+        capacity_ = 80 * BLOCK_SIZE;
+        j = open_journal(8 * BLOCK_SIZE);
+        dev = journal_register_device(j, "dev0");
+
+        assert(journal_throttle(j, &delay) && !delay);
+        for (i = 0; i < 64; i++) {
+                ok = journal_throttle(j, &delay);
+                if (!ok)
+                        break;
+
+                assert(delay >= last_delay);
+                last_delay = delay;
+
+                id = commit_blocks(j, dev, i * SECTORS, 1, &notified);
+                while (*((volatile unsigned *) &notified) <= i)
+                        usleep(100);
+        }
+        assert(!ok);
+        assert(last_delay);
+
+        journal_get_stats(j, &stats);
+        assert(stats.throttled && stats.stalled == 1);
+        assert(stats.used >= capacity_ / 100 * 80);
+        assert(stats.capacity == capacity_);
+
+        journal_drop(j, id);
+        wait_for_reclaim(j, 0);
+        assert(journal_throttle(j, &delay) && !delay);
+
+        journal_destroy(j);
+        capacity_ = 0;
+        remove_journal();
+}
+
+/*
+ * Transactions are spread over the lanes, but come back in id order,
+ * after a clean shutdown or a crash.  Each lane's segments are
+ * reclaimed once its share has been dropped.
+ */
+void test_lanes()
+{
+        int status;
+        unsigned i, notified = 0;
+        pid_t pid;
+        struct journal *j;
+        struct journal_device *dev;
+        struct journal_options opts;
+
+        nr_lanes_ = MAX_LANES;
+        j = open_journal(8 * BLOCK_SIZE);
+        dev = journal_register_device(j, "dev0");
+
+        for (i = 0; i < 256; i++)
+                commit_blocks(j, dev, i * SECTORS, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 256)
+                usleep(1000);
+
+        assert(count_files("segment.") > 1);
+        for (i = 0; i < MAX_LANES; i++)
+                assert(count_files_in(lane_dirs_[i], "segment.") > 1);
+
+        assert(journal_transaction_count(j) == 256);
+        for (i = 0; i < 256; i++)
+                check_replay(j, i, i + 1, 1);
+        journal_destroy(j);
+        check_recovered(1, 256);
+
+        /* a crash leaves every lane's tail to be read */
+        pid = fork();
+        assert(pid >= 0);
+        if (!pid) {
+                notified = 0;
+                j = open_journal(8 * BLOCK_SIZE);
+                dev = journal_register_device(j, "dev0");
+                for (i = 0; i < 64; i++)
+                        commit_blocks(j, dev, (256 + i) * SECTORS, 1, &notified);
+                while (*((volatile unsigned *) &notified) < 64)
+                        usleep(100);
+                _exit(0);
+        }
+
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFEXITED(status) && !WEXITSTATUS(status));
+        check_recovered(1, 320);
+
+        j = open_journal(8 * BLOCK_SIZE);
+        journal_drop(j, 300);
+        wait_for_reclaim(j, 0);
+        journal_destroy(j);
+        check_recovered(301, 20);
+
+        /* the lanes have to be the same each time */
+        journal_options_init(&opts);
+        assert(!journal_create(journal_dir_, &opts));
+
+        nr_lanes_ = 0;
+        remove_journal();
+}
+
+/*
+ * Each block is recorded in uneven pieces, as if straight out of the
+ * buffers it arrived in.  Enough are committed at once for a batch to
+ * need more pieces than a single pwritev takes.
+ */
+void test_gathered_ios()
+{
+        unsigned i, notified = 0;
+        uint64_t id;
+        unsigned char data[3][BLOCK_SIZE];
+        struct iovec pieces[3][3];
+        struct journal_iov ios[3];
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+        struct journal_transaction *t;
+        struct thunk th = { notify, &notified };
+
+        assert(dev);
+        for (i = 0; i < 3; i++) {
+                pieces[i][0].iov_base = data[i];
+                pieces[i][0].iov_len = 1;
+                pieces[i][1].iov_base = data[i] + 1;
+                pieces[i][1].iov_len = 1000;
+                pieces[i][2].iov_base = data[i] + 1001;
+                pieces[i][2].iov_len = BLOCK_SIZE - 1001;
+
+                ios[i].dev = dev;
+                ios[i].codec = 0;
+                ios[i].iov = pieces[i];
+                ios[i].nr_iov = 3;
+        }
+
+        for (i = 0; i < 1024; i++) {
+                t = journal_begin(j);
+                assert(t);
+
+                ios[0].start_sector = (uint64_t) i * 3 * SECTORS;
+                ios[1].start_sector = ios[0].start_sector + SECTORS;
+                ios[2].start_sector = ios[1].start_sector + SECTORS;
+
+                /* a bad io and nothing's recorded */
+                ios[1].end_sector = ios[1].start_sector;
+                assert(!journal_record_iov(t, ios, 3));
+
+                ios[0].end_sector = ios[0].start_sector + SECTORS;
+                ios[1].end_sector = ios[1].start_sector + SECTORS;
+                ios[2].end_sector = ios[2].start_sector + SECTORS;
+                fill_block(data[0], ios[0].start_sector);
+                fill_block(data[2], ios[2].start_sector);
+
+                /* the middle io is zeroes */
+                ios[1].nr_iov = 0;
+                assert(journal_record_iov(t, ios, 3));
+                ios[1].nr_iov = 3;
+
+                assert(journal_commit(t, &th, &id));
+                assert(id == i + 1);
+        }
+
+        while (*((volatile unsigned *) &notified) < 1024)
+                usleep(1000);
+        journal_destroy(j);
+
+        j = open_journal(0);
+        assert(journal_transaction_count(j) == 1024);
+        for (i = 0; i < 1024; i++)
+                check_replay(j, i, i + 1, 3);
+
+        journal_destroy(j);
+        remove_journal();
+}
+
+static struct journal_replayer *single_device(void *context, struct journal_device *dev)
+{
+        return context;
+}
+
+/*
+ * Big transactions are written out as they're built.  Committing one
+ * only writes what's left, rolling one back writes a single marker, and
+ * spills that were never committed, or were rolled back, are ignored
+ * when the journal's reopened.
+ */
+void test_spill()
+{
+        int status;
+        unsigned i, ios, notified = 0, spills = 0;
+        uint64_t id1, id2, spilled;
+        pid_t pid;
+        unsigned char data[BLOCK_SIZE];
+        struct journal_io io;
+        struct journal_stats stats;
+        struct journal_transaction *t;
+        struct checker c;
+        struct journal_replayer r = { &c, check_begin, check_io, check_commit };
+        struct journal_parallel_replayer target = { &r, 2, 0, single_device };
+        struct thunk th = { notify, &spills };
+        struct journal *j;
+        struct journal_device *dev;
+
+        spill_threshold_ = 4 * BLOCK_SIZE;
+        j = open_journal(8 * BLOCK_SIZE);
+        dev = journal_register_device(j, "dev0");
+
+        id1 = commit_blocks(j, dev, 0, 32, &notified);
+        while (!*((volatile unsigned *) &notified))
+                usleep(1000);
+
+        journal_get_stats(j, &stats);
+        assert(stats.spilled >= 28 * BLOCK_SIZE);
+        check_replay(j, 0, id1, 32);
+
+        /* rolled back after spilling, once every spill has been written */
+        t = journal_begin(j);
+        assert(t);
+        journal_notify_spills(t, &th);
+        for (i = 0; i < 32; i++) {
+                fill_block(data, 1024 + i * SECTORS);
+                io.dev = dev;
+                io.start_sector = 1024 + i * SECTORS;
+                io.end_sector = io.start_sector + SECTORS;
+                io.codec = 0;
+                io.len = BLOCK_SIZE;
+                io.data = data;
+                assert(journal_record_io(t, &io));
+        }
+
+        assert(journal_transaction_spills(t, &ios) == 8 && ios == 32);
+        while (*((volatile unsigned *) &spills) < 8)
+                usleep(1000);
+        journal_rollback(t);
+
+        id2 = commit_blocks(j, dev, 2048, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 2)
+                usleep(1000);
+
+        journal_get_stats(j, &stats);
+        assert(stats.aborted == 1);
+        assert(journal_transaction_count(j) == 2);
+        assert(journal_replay_parallel(j, 2, &target) == 2);
+        assert(c.id == id2 && c.ios == 1 && c.committed && !c.bad);
+        journal_destroy(j);
+
+        /* spills from a transaction that never got committed */
+        pid = fork();
+        assert(pid >= 0);
+        if (!pid) {
+                j = open_journal(8 * BLOCK_SIZE);
+                dev = journal_register_device(j, "dev0");
+                t = journal_begin(j);
+                for (i = 0; i < 32; i++) {
+                        io.dev = dev;
+                        io.start_sector = 4096 + i * SECTORS;
+                        io.end_sector = io.start_sector + SECTORS;
+                        journal_record_io(t, &io);
+                }
+
+                do {
+                        usleep(1000);
+                        journal_get_stats(j, &stats);
+                } while (stats.spilled < 28 * BLOCK_SIZE);
+                _exit(0);
+        }
+        assert(waitpid(pid, &status, 0) == pid);
+        assert(WIFEXITED(status) && !WEXITSTATUS(status));
+
+        j = open_journal(8 * BLOCK_SIZE);
+        assert(journal_transaction_count(j) == 2);
+        check_replay(j, 0, id1, 32);
+        check_replay(j, 1, id2, 1);
+
+        /* the spills' segments go once the commit's dropped */
+        journal_get_stats(j, &stats);
+        spilled = stats.reclaimed;
+        journal_drop(j, id2);
+        wait_for_reclaim(j, spilled);
+        journal_get_stats(j, &stats);
+        assert(stats.reclaimed >= 32 * BLOCK_SIZE);
+
+        journal_destroy(j);
+        spill_threshold_ = 0;
+        remove_journal();
+}
+
+/* Ships one at a time, checking each is whole and next in line */
+static unsigned ship_all(struct journal_subscriber *s, uint64_t first)
+{
+        unsigned n = 0;
+        struct checker c;
+        struct journal_replayer r = { &c, check_begin, check_io, check_commit };
+
+        while (journal_subscriber_ship(s, 1, &r)) {
+                assert(c.id == first + n);
+                assert(c.ios == 1);
+                assert(c.committed);
+                assert(!c.bad);
+                n++;
+                assert(journal_subscriber_position(s) == first + n);
+        }
+
+        return n;
+}
+
+void test_tail_streaming()
+{
+        unsigned i, notified = 0, woken = 0;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+        struct journal_subscriber *s;
+        struct journal_stats stats;
+        struct thunk wake = { notify, &woken };
+
+        s = journal_subscribe(j, 1, &wake);
+        assert(s);
+        assert(!journal_subscriber_wait(s, 10));
+
+        for (i = 0; i < 16; i++)
+                commit_blocks(j, dev, i * SECTORS, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 16)
+                usleep(1000);
+
+        /* fresh from the tail cache */
+        assert(journal_subscriber_wait(s, 10));
+        assert(woken);
+        assert(ship_all(s, 1) == 16);
+        journal_get_stats(j, &stats);
+        assert(stats.shipped == 16);
+        assert(!stats.shipped_from_disk);
+
+        /* drops wait for the subscriber */
+        for (i = 16; i < 24; i++)
+                commit_blocks(j, dev, i * SECTORS, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 24)
+                usleep(1000);
+
+        journal_drop(j, 24);
+        assert(journal_transaction_count(j) == 8);
+        assert(ship_all(s, 17) == 8);
+        assert(!journal_transaction_count(j));
+        journal_unsubscribe(s);
+
+        /* nothing shipped, and then what's been dropped has gone */
+        for (i = 24; i < 32; i++)
+                commit_blocks(j, dev, i * SECTORS, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 32)
+                usleep(1000);
+        journal_destroy(j);
+
+        /* resuming after a restart reads them back */
+        j = open_journal(0);
+        assert(!journal_subscribe(j, 24, NULL));
+        s = journal_subscribe(j, 29, NULL);
+        assert(s);
+        journal_drop(j, 32);
+        assert(journal_transaction_count(j) == 4);
+
+        assert(ship_all(s, 29) == 4);
+        journal_get_stats(j, &stats);
+        assert(stats.shipped == 4);
+        assert(stats.shipped_from_disk == 4);
+        assert(!journal_transaction_count(j));
+        journal_unsubscribe(s);
+
+        journal_destroy(j);
+        remove_journal();
+}
+
+/*
+ * An io referring to an earlier one replays, and ships, with its data,
+ * and keeps the transaction it refers to from being dropped.
+ */
+void test_references()
+{
+        unsigned i, notified = 0;
+        uint64_t x, y, id;
+        unsigned char data[BLOCK_SIZE];
+        struct journal *j;
+        struct journal_device *dev;
+        struct journal_subscriber *s;
+        struct journal_transaction *t;
+        struct journal_io io;
+        struct checker c;
+        struct journal_replayer r = { &c, check_begin, check_io, check_commit };
+        struct journal_parallel_replayer target = { &r, 2, 0, single_device };
+
+        spill_threshold_ = 4 * BLOCK_SIZE;
+        j = open_journal(0);
+        dev = journal_register_device(j, "dev0");
+        s = journal_subscribe(j, 1, NULL);
+        assert(s);
+        memset(&io, 0, sizeof(io));
+        io.dev = dev;
+        x = commit_blocks(j, dev, 0, 2, &notified);
+        while (*((volatile unsigned *) &notified) < 1)
+                usleep(1000);
+
+        /* the same sectors, so all of x is overwritten */
+        t = journal_begin(j);
+        io.start_sector = SECTORS;
+        io.end_sector = 2 * SECTORS;
+        assert(journal_record_ref(t, &io, x, 1));
+        assert(!journal_record_ref(t, &io, x + 1, 0));
+        io.start_sector = 0;
+        io.end_sector = SECTORS;
+        assert(journal_record_ref(t, &io, x, 0));
+        assert(journal_commit(t, NULL, &y));
+        while (journal_transaction_count(j) < 2)
+                usleep(1000);
+
+        assert(journal_subscriber_ship(s, 2, &r) == 2);
+        assert(c.id == y && c.ios == 2 && c.committed && !c.bad);
+        journal_unsubscribe(s);
+
+        journal_drop(j, x);
+        assert(journal_transaction_count(j) == 2);
+        check_replay(j, 0, x, 0);
+        check_replay(j, 1, y, 2);
+        journal_destroy(j);
+
+        /* recovery knows what's referred to */
+        j = open_journal(0);
+        journal_drop(j, x);
+        assert(journal_transaction_count(j) == 2);
+        check_replay(j, 1, y, 2);
+        io.dev = journal_register_device(j, "dev0");
+
+        /* so does a transaction being built */
+        t = journal_begin(j);
+        assert(journal_record_ref(t, &io, x, 0));
+        journal_drop(j, y);
+        assert(journal_transaction_count(j) == 2);
+        journal_rollback(t);
+        assert(!journal_transaction_count(j));
+        assert(!journal_transaction_front(j, 0, &id));
+
+        /* after the data of a transaction that's spilled */
+        x = commit_blocks(j, io.dev, 0, 1, &notified);
+        while (*((volatile unsigned *) &notified) < 2)
+                usleep(1000);
+
+        t = journal_begin(j);
+        for (i = 1; i <= 8; i++) {
+                fill_block(data, i * SECTORS);
+                io.start_sector = i * SECTORS;
+                io.end_sector = io.start_sector + SECTORS;
+                io.len = BLOCK_SIZE;
+                io.data = data;
+                assert(journal_record_io(t, &io));
+        }
+        io.start_sector = 0;
+        io.end_sector = SECTORS;
+        assert(journal_record_ref(t, &io, x, 0));
+        assert(journal_transaction_spills(t, &i));
+        assert(journal_commit(t, NULL, &y));
+        while (journal_transaction_count(j) < 2)
+                usleep(1000);
+
+        check_replay(j, 1, y, 9);
+        assert(journal_replay_parallel(j, 2, &target) == 2);
+        assert(c.id == y && c.ios == 9 && c.committed && !c.bad);
+
+        journal_destroy(j);
+        spill_threshold_ = 0;
+        remove_journal();
+}
+
+/*
+ * Commits that arrive while the writer is busy should share a sync.
+ */
+void test_group_commit()
+{
+        unsigned i, notified = 0;
+        struct journal_stats stats;
+        struct journal *j = open_journal(0);
+        struct journal_device *dev = journal_register_device(j, "dev0");
+
+        for (i = 0; i < 256; i++)
+                commit_blocks(j, dev, i * SECTORS, 1, &notified);
+
+        /* everything's durable once the notifications have run */
+        while (*((volatile unsigned *) &notified) < 256)
+                usleep(1000);
+
+        journal_get_stats(j, &stats);
+        assert(stats.commits == 256);
+        assert(stats.syncs < 256);
+        assert(journal_transaction_count(j) == 256);
+
+        journal_destroy(j);
+        remove_journal();
+}
+
+int main(int argc, char **argv)
+{
+        unsigned i;
+
+        assert(mkdtemp(dir_));
+        snprintf(journal_dir_, sizeof(journal_dir_), "%s/journal", dir_);
+        for (i = 0; i < MAX_LANES; i++) {
+                snprintf(lane_dirs_[i], sizeof(lane_dirs_[i]), "%s/lane%u", dir_, i + 1);
+                lanes_[i] = lane_dirs_[i];
+        }
+        log_init(dir_, DEBUG, DEBUG);
+
+        for (mode_ = JOURNAL_DIRECT; mode_ <= JOURNAL_BUFFERED; mode_++) {
+                test_commit_and_recover();
+                test_drop();
+                test_lookup();
+                test_coalescing();
+                test_gathered_ios();
+                test_spill();
+                test_tail_streaming();
+                test_references();
+                test_torn_tail();
+                test_segments();
+                test_replay_while_writing();
+                test_parallel_replay();
+                test_reclaim();
+                test_seek();
+                test_throttle();
+                test_checksums();
+                test_checkpoint();
+                test_group_commit();
+                test_lanes();
+        }
+
+        log_exit();
+        snprintf(journal_dir_, sizeof(journal_dir_), "%s/log.log", dir_);
+        unlink(journal_dir_);
+        rmdir(dir_);
+        return 0;
+}
@@ -0,0 +1,1095 @@
+#include "compress/compress.h"
+#include "csp/control.h"
+#include "csp/io.h"
+#include "csp/process.h"
+#include "mm/pool.h"
+#include "protocol.h"
+#include "server_stats.h"
+#include "stats/histogram.h"
+#include "xdr/xdr.h"
+
+#include <arpa/inet.h>
+#include <getopt.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <time.h>
+
+/*
+ * Load generator.  Opens a number of connections to a replicator, and
+ * has each one pipeline a mix of JOURNAL_IO sizes, with a commit every
+ * so many ios, for a fixed time.  Reports throughput and latency
+ * percentiles, measured from a request being sent to its response
+ * arriving.
+ *
+ * Each connection is a single csp process that keeps sending until
+ * its pipeline or flow control window is full, then reads a response.
+ * Responses come back in order, so the outstanding requests are a
+ * simple ring.
+ */
+
+enum {
+        DEFAULT_PORT = 6776,
+        DEFAULT_CONNECTIONS = 1,
+        DEFAULT_DEPTH = 32,
+        DEFAULT_DURATION = 10,
+        DEFAULT_COMMIT_EVERY = 64,
+        DEFAULT_IO_SIZE = 4096,
+
+        MAX_SIZES = 16,
+
+        /* header, discriminator, dev, sector, codec, len, opaque length */
+        IO_FRAME_OVERHEAD = 8 + 5 * 4 + 8,
+
+        SECTOR_SHIFT = 9
+};
+
+struct size_weight {
+        uint32_t size;
+        unsigned weight;
+};
+
+enum data_kind {
+        DATA_RANDOM,
+        DATA_TEXT
+};
+
+struct options {
+        const char *server;
+        unsigned connections;
+        unsigned depth;
+        unsigned duration;
+        unsigned commit_every;
+        unsigned zero_percent;
+        unsigned dup_percent;
+        unsigned dev;
+        enum data_kind data;
+        enum compress_codec codec;
+        int server_stats;
+
+        struct size_weight sizes[MAX_SIZES];
+        unsigned nr_sizes;
+        unsigned total_weight;
+        uint32_t max_size;
+};
+
+struct totals {
+        uint64_t ios;
+        uint64_t io_bytes;      /* uncompressed payload */
+        uint64_t wire_bytes;
+        uint64_t commits;
+        uint64_t forced_commits;
+        unsigned failed;
+
+        struct histogram io_latency;
+        struct histogram commit_latency;
+};
+
+enum request_type {
+        REQ_IO,
+        REQ_COMMIT
+};
+
+struct outstanding {
+        enum request_type type;
+        uint32_t len;
+        uint64_t absorbs;       /* io bytes a commit returns to the window */
+        uint64_t sent;
+};
+
+struct connection {
+        struct options *opts;
+        struct totals *totals;
+        uint64_t deadline;
+
+        unsigned index;
+        int fd;
+        unsigned seed;
+
+        flow_control credit;
+        compression codec;
+        unsigned depth;
+
+        struct outstanding *queue;
+        unsigned head;
+        unsigned count;
+
+        uint64_t used_bytes;
+        uint64_t unabsorbed;
+        unsigned ios_since_commit;
+        int commit_pending;
+        uint32_t next_id;
+
+        unsigned next_size;
+        uint64_t sector;        /* each connection writes its own region */
+        uint64_t stamp;
+        uint64_t last_stamp[MAX_SIZES];
+
+        unsigned char *source;
+        unsigned char *zeroes;
+        unsigned char *msg;
+        unsigned char *commit_msg;
+        uint32_t commit_len;
+        unsigned char *response;
+        uint32_t response_len;
+        struct pool *mem;
+};
+
+/*----------------------------------------------------------------*/
+
+static uint64_t now()
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void put32(unsigned char *b, uint32_t n)
+{
+        n = htonl(n);
+        memcpy(b, &n, sizeof(n));
+}
+
+/* xdr_pack_uhyper() puts the low word first */
+static void put64(unsigned char *b, uint64_t n)
+{
+        put32(b, n & 0xffffffff);
+        put32(b + 4, n >> 32);
+}
+
+static uint32_t get32(unsigned char *b)
+{
+        uint32_t n;
+        memcpy(&n, b, sizeof(n));
+        return ntohl(n);
+}
+
+static uint32_t pad4(uint32_t n)
+{
+        return (n + 3) & ~3;
+}
+
+/*
+ * Flattens a command, preceded by its msg_header, into a malloced
+ * buffer using the xdrgen packers.
+ */
+static unsigned char *pack_message(command *cmd, uint32_t req_id, uint32_t *len)
+{
+        size_t size;
+        unsigned char *data = NULL;
+        struct xdr_buffer *buf = xdr_buffer_create(128);
+        struct xdr_cursor *c = NULL;
+
+        if (!buf)
+                return NULL;
+
+        if (!xdr_pack_command(buf, cmd))
+                goto out;
+
+        size = xdr_buffer_size(buf);
+        data = malloc(size + 8);
+        if (!data)
+                goto out;
+
+        c = xdr_cursor_create(buf);
+        if (!c || !xdr_cursor_read(c, data + 8, size)) {
+                free(data);
+                data = NULL;
+                goto out;
+        }
+
+        put32(data, size);
+        put32(data + 4, req_id);
+        *len = size + 8;
+
+out:
+        if (c)
+                xdr_cursor_destroy(c);
+        xdr_buffer_destroy(buf);
+        return data;
+}
+
+/*
+ * JOURNAL_IO frames are encoded by hand into a reusable buffer, so the
+ * send path doesn't allocate.  check_io_encoding() makes sure this
+ * agrees with the generated packer.
+ */
+static uint32_t encode_io(unsigned char *msg, uint32_t req_id, unsigned dev, uint64_t sector,
+                          compression codec, uint32_t len, const void *data, uint32_t data_len)
+{
+        uint32_t padded = pad4(data_len);
+
+        put32(msg, IO_FRAME_OVERHEAD - 8 + padded);
+        put32(msg + 4, req_id);
+        put32(msg + 8, JOURNAL_IO);
+        put32(msg + 12, dev);
+        put64(msg + 16, sector);
+        put32(msg + 24, codec);
+        put32(msg + 28, len);
+        put32(msg + 32, data_len);
+        if (data && data != msg + IO_FRAME_OVERHEAD)
+                memcpy(msg + IO_FRAME_OVERHEAD, data, data_len);
+        memset(msg + IO_FRAME_OVERHEAD + data_len, 0, padded - data_len);
+
+        return IO_FRAME_OVERHEAD + padded;
+}
+
+static int check_io_encoding()
+{
+        int r;
+        command cmd;
+        uint8_t payload[13] = "hello, world";
+        unsigned char mine[IO_FRAME_OVERHEAD + 16], *theirs;
+        uint32_t my_len, their_len;
+
+        cmd.discriminator = JOURNAL_IO;
+        cmd.u.io.dev = 7;
+        cmd.u.io.sector = 0x123456789ULL;
+        cmd.u.io.codec = COMPRESS_NONE;
+        cmd.u.io.len = sizeof(payload);
+        cmd.u.io.data.data = payload;
+        cmd.u.io.data.len = sizeof(payload);
+
+        theirs = pack_message(&cmd, 42, &their_len);
+        if (!theirs)
+                return 0;
+
+        my_len = encode_io(mine, 42, 7, 0x123456789ULL, COMPRESS_NONE, sizeof(payload),
+                           payload, sizeof(payload));
+        r = (my_len == their_len) && !memcmp(mine, theirs, my_len);
+        free(theirs);
+
+        return r;
+}
+
+/*----------------------------------------------------------------*/
+
+static int open_tcp(const char *spec)
+{
+        int fd = -1, flag = 1;
+        char *host, *port;
+        struct addrinfo hints, *addrs, *a;
+
+        host = strdup(spec);
+        if (!host)
+                return -1;
+
+        port = strrchr(host, ':');
+        if (port)
+                *port++ = '\0';
+
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+
+        if (getaddrinfo(host, port ? port : "6776", &hints, &addrs)) {
+                free(host);
+                return -1;
+        }
+
+        for (a = addrs; a; a = a->ai_next) {
+                fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (fd < 0)
+                        continue;
+
+                if (!connect(fd, a->ai_addr, a->ai_addrlen))
+                        break;
+
+                close(fd);
+                fd = -1;
+        }
+
+        if (fd >= 0)
+                setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &flag, sizeof(flag));
+
+        freeaddrinfo(addrs);
+        free(host);
+        return fd;
+}
+
+static int open_unix(const char *path)
+{
+        int fd;
+        struct sockaddr_un addr;
+
+        if (strlen(path) >= sizeof(addr.sun_path))
+                return -1;
+
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+                return -1;
+
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
+
+        if (connect(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+                close(fd);
+                return -1;
+        }
+
+        return fd;
+}
+
+/* tcp:host:port or unix:path, a bare host:port is taken as tcp */
+static int open_server(const char *spec)
+{
+        int fd;
+
+        if (!strncmp(spec, "unix:", 5))
+                fd = open_unix(spec + 5);
+        else
+                fd = open_tcp(strncmp(spec, "tcp:", 4) ? spec : spec + 4);
+
+        if (fd >= 0)
+                csp_set_non_blocking(fd);
+
+        return fd;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Reads one response into c->response, returning its discriminator, or
+ * -1 if the connection failed.
+ */
+static int read_response(struct connection *c, response **resp)
+{
+        unsigned char header[8];
+        uint32_t size;
+
+        if (csp_read_exact(c->fd, header, sizeof(header)) < 0)
+                return -1;
+
+        size = get32(header);
+        if (size > c->response_len) {
+                unsigned char *b = realloc(c->response, size);
+                if (!b)
+                        return -1;
+
+                c->response = b;
+                c->response_len = size;
+        }
+
+        if (csp_read_exact(c->fd, c->response, size) < 0)
+                return -1;
+
+        /* the common case needn't go through the unpacker */
+        if (size == 4 && get32(c->response) == SUCCESS) {
+                *resp = NULL;
+                return SUCCESS;
+        }
+
+        pool_empty(c->mem);
+        if (!xdr_unpack_using(response_alloc, c->response, size, c->mem, resp))
+                return -1;
+
+        if ((*resp)->discriminator == FAIL)
+                fprintf(stderr, "connection %u: request failed: %s\n", c->index, (*resp)->u.reason);
+
+        return (*resp)->discriminator;
+}
+
+static int send_message(struct connection *c, command *cmd, response **resp)
+{
+        int r;
+        uint32_t len;
+        unsigned char *msg = pack_message(cmd, c->next_id++, &len);
+
+        if (!msg)
+                return -1;
+
+        r = csp_write_exact(c->fd, msg, len);
+        free(msg);
+        if (r < 0)
+                return -1;
+
+        return read_response(c, resp);
+}
+
+static int logon(struct connection *c)
+{
+        command cmd;
+        response *resp;
+        compression codec = (compression) c->opts->codec;
+
+        cmd.discriminator = LOGON;
+        cmd.u.logon.v.major = 1;
+        cmd.u.logon.v.minor = 1;
+        cmd.u.logon.v.patch = 1;
+        cmd.u.logon.codecs.array = &codec;
+        cmd.u.logon.codecs.len = (codec == COMPRESS_NONE) ? 0 : 1;
+
+        if (send_message(c, &cmd, &resp) != LOGON_RESPONSE)
+                return 0;
+
+        c->credit = resp->u.logon.credit;
+        c->codec = resp->u.logon.codec;
+        if (c->codec != codec && !c->index)
+                fprintf(stderr, "server refused %s compression, sending uncompressed\n",
+                        compress_name(codec));
+
+        c->depth = c->opts->depth;
+        if (IO_FRAME_OVERHEAD + compress_bound(c->codec, c->opts->max_size) > c->credit.max_message) {
+                if (!c->index)
+                        fprintf(stderr, "the largest io won't fit in the server's %u byte messages\n",
+                                c->credit.max_message);
+                return 0;
+        }
+
+        return 1;
+}
+
+static int open_journal(struct connection *c)
+{
+        command cmd;
+        response *resp;
+        device_binding binding;
+
+        binding.shortname = c->opts->dev;
+        binding.logical_name = "loadgen";
+        binding.path = "";
+
+        cmd.discriminator = JOURNAL_OPEN;
+        cmd.u.devices.array = &binding;
+        cmd.u.devices.len = 1;
+
+        return send_message(c, &cmd, &resp) == SUCCESS;
+}
+
+/*----------------------------------------------------------------*/
+
+static unsigned pick_size(struct connection *c)
+{
+        unsigned i, r = rand_r(&c->seed) % c->opts->total_weight;
+
+        for (i = 0; i < c->opts->nr_sizes; i++) {
+                if (r < c->opts->sizes[i].weight)
+                        return i;
+                r -= c->opts->sizes[i].weight;
+        }
+
+        return c->opts->nr_sizes - 1;
+}
+
+static void fill_text(unsigned char *data, size_t len, unsigned *seed)
+{
+        static const char *words[] = {
+                "journal", "replicator", "transaction", "commit ", "sector",
+                "device", "merge", "the ", "a ", "of ", "and ", "\n"
+        };
+
+        size_t i = 0;
+        while (i < len) {
+                const char *w = words[rand_r(seed) % (sizeof(words) / sizeof(*words))];
+                size_t n = strlen(w);
+                if (n > len - i)
+                        n = len - i;
+                memcpy(data + i, w, n);
+                i += n;
+        }
+}
+
+static int prepare_connection(struct connection *c)
+{
+        size_t i, msg_size;
+        command cmd;
+
+        c->queue = malloc(sizeof(*c->queue) * c->depth);
+        c->source = malloc(c->opts->max_size);
+        c->zeroes = calloc(1, c->opts->max_size);
+        msg_size = IO_FRAME_OVERHEAD + compress_bound(c->codec, c->opts->max_size) + 4;
+        c->msg = malloc(msg_size);
+        if (!c->queue || !c->source || !c->zeroes || !c->msg)
+                return 0;
+
+        if (c->opts->data == DATA_TEXT)
+                fill_text(c->source, c->opts->max_size, &c->seed);
+        else
+                for (i = 0; i < c->opts->max_size; i++)
+                        c->source[i] = rand_r(&c->seed) & 0xff;
+
+        c->next_size = pick_size(c);
+
+        cmd.discriminator = JOURNAL_COMMIT;
+        c->commit_msg = pack_message(&cmd, 0, &c->commit_len);
+        return c->commit_msg != NULL;
+}
+
+static struct outstanding *push(struct connection *c, enum request_type type, uint32_t len)
+{
+        struct outstanding *o = c->queue + (c->head + c->count) % c->depth;
+
+        c->count++;
+        c->used_bytes += len;
+        o->type = type;
+        o->len = len;
+        o->absorbs = 0;
+        o->sent = now();
+
+        return o;
+}
+
+static int send_commit(struct connection *c, int forced)
+{
+        struct outstanding *o;
+
+        put32(c->commit_msg + 4, c->next_id++);
+        if (csp_write_exact(c->fd, c->commit_msg, c->commit_len) < 0)
+                return 0;
+
+        o = push(c, REQ_COMMIT, c->commit_len);
+        o->absorbs = c->unabsorbed;
+        c->unabsorbed = 0;
+        c->ios_since_commit = 0;
+        c->commit_pending = 1;
+
+        c->totals->commits++;
+        if (forced)
+                c->totals->forced_commits++;
+
+        return 1;
+}
+
+/*
+ * Builds the next io in c->msg.  Unique blocks get a counter stamped in
+ * their first bytes, so the server's dedup doesn't see them as repeats;
+ * duplicates reuse the last stamp for that size.
+ */
+static uint32_t io_bound(struct connection *c, uint32_t size)
+{
+        return IO_FRAME_OVERHEAD + pad4(compress_bound(c->codec, size));
+}
+
+static uint32_t build_io(struct connection *c, unsigned size_index)
+{
+        uint32_t size = c->opts->sizes[size_index].size, data_len;
+        unsigned r = rand_r(&c->seed) % 100;
+        unsigned char *data;
+        uint64_t sector = c->sector;
+
+        c->sector += size >> SECTOR_SHIFT;
+
+        if (r < c->opts->zero_percent)
+                data = c->zeroes;
+
+        else {
+                uint64_t stamp;
+
+                if (r < c->opts->zero_percent + c->opts->dup_percent && c->last_stamp[size_index])
+                        stamp = c->last_stamp[size_index];
+                else
+                        stamp = c->last_stamp[size_index] = ++c->stamp;
+
+                if (size >= sizeof(stamp))
+                        memcpy(c->source, &stamp, sizeof(stamp));
+                data = c->source;
+        }
+
+        if (c->codec == COMPRESS_NONE)
+                return encode_io(c->msg, c->next_id++, c->opts->dev, sector, COMPRESS_NONE,
+                                 size, data, size);
+
+        {
+                size_t clen = compress_bound(c->codec, size);
+                if (!compress_block(c->codec, 0, data, size, c->msg + IO_FRAME_OVERHEAD, &clen))
+                        return 0;
+
+                data_len = clen;
+        }
+
+        return encode_io(c->msg, c->next_id++, c->opts->dev, sector, c->codec, size,
+                         c->msg + IO_FRAME_OVERHEAD, data_len);
+}
+
+/*
+ * Sends as much as the pipeline depth and flow control window allow.
+ * Io bytes stay charged to the window until a commit sent after them
+ * has been answered, or the server says they've spilled.  So when the
+ * window's full of uncommitted data, and nothing in flight might give
+ * some back, we have to commit early.
+ */
+static int fill_pipeline(struct connection *c, int stopping)
+{
+        while (c->count < c->depth) {
+                uint32_t len, size;
+                unsigned size_index;
+
+                if (stopping) {
+                        if (c->unabsorbed)
+                                return send_commit(c, 0);
+                        return 1;
+                }
+
+                if (c->opts->commit_every && c->ios_since_commit >= c->opts->commit_every) {
+                        if (c->used_bytes + c->commit_len > c->credit.bytes)
+                                return 1;
+
+                        if (!send_commit(c, 0))
+                                return 0;
+                        continue;
+                }
+
+                /*
+                 * Keep room for a commit.  The size picked stands, so
+                 * the mix isn't skewed towards smaller ios.
+                 */
+                size_index = c->next_size;
+                size = c->opts->sizes[size_index].size;
+                if (c->used_bytes + io_bound(c, size) + c->commit_len > c->credit.bytes) {
+                        if (c->unabsorbed && !c->count)
+                                return send_commit(c, 1);
+                        return 1;
+                }
+
+                c->next_size = pick_size(c);
+                len = build_io(c, size_index);
+                if (!len)
+                        return 0;
+
+                if (csp_write_exact(c->fd, c->msg, len) < 0)
+                        return 0;
+
+                push(c, REQ_IO, len);
+                c->unabsorbed += len;
+                c->ios_since_commit++;
+                c->totals->ios++;
+                c->totals->io_bytes += size;
+                c->totals->wire_bytes += len;
+        }
+
+        return 1;
+}
+
+/*
+ * The server hands back a transaction's io bytes early once they've
+ * spilled.  They're the ios since the last commit before this one, so
+ * either the next commit in flight would have returned them, or none
+ * has been sent yet.
+ */
+static void release_spilled(struct connection *c, uint32_t released)
+{
+        unsigned i;
+
+        c->used_bytes -= released;
+        for (i = 0; i < c->count; i++) {
+                struct outstanding *o = c->queue + (c->head + i) % c->depth;
+
+                if (o->type == REQ_COMMIT) {
+                        o->absorbs -= released;
+                        return;
+                }
+        }
+
+        c->unabsorbed -= released;
+}
+
+static int complete_one(struct connection *c)
+{
+        response *resp;
+        struct outstanding *o = c->queue + c->head;
+        int r = read_response(c, &resp);
+
+        if (r < 0 || r == FAIL)
+                return 0;
+
+        c->head = (c->head + 1) % c->depth;
+        c->count--;
+
+        if (o->type == REQ_IO) {
+                histogram_record(&c->totals->io_latency, now() - o->sent);
+                if (r == IO_RESPONSE)
+                        release_spilled(c, resp->u.released);
+                return 1;
+        }
+
+        histogram_record(&c->totals->commit_latency, now() - o->sent);
+        c->used_bytes -= o->len + o->absorbs;
+        c->commit_pending = 0;
+        {
+                /* a later commit may still be in flight */
+                unsigned i;
+                for (i = 0; i < c->count; i++)
+                        if (c->queue[(c->head + i) % c->depth].type == REQ_COMMIT)
+                                c->commit_pending = 1;
+        }
+
+        return 1;
+}
+
+static void connection_loop(struct connection *c)
+{
+        int stopping = 0;
+
+        c->mem = pool_create("loadgen", 1024);
+        if (!c->mem || !logon(c) || !open_journal(c) || !prepare_connection(c))
+                goto fail;
+
+        for (;;) {
+                if (!stopping && now() >= c->deadline)
+                        stopping = 1;
+
+                if (!fill_pipeline(c, stopping))
+                        goto fail;
+
+                if (!c->count) {
+                        if (stopping)
+                                break;
+
+                        /* nothing in flight and nothing we can send */
+                        fprintf(stderr, "connection %u: flow control window too small\n", c->index);
+                        goto fail;
+                }
+
+                if (!complete_one(c))
+                        goto fail;
+        }
+
+        close(c->fd);
+        return;
+
+fail:
+        c->totals->failed++;
+        close(c->fd);
+}
+
+/*----------------------------------------------------------------*/
+
+static void print_latency(const char *name, struct histogram *h)
+{
+        if (!h->count)
+                return;
+
+        printf("%-16s %10.1f %10.1f %10.1f %10.1f\n", name,
+               histogram_percentile(h, 50.0) / 1000.0,
+               histogram_percentile(h, 99.0) / 1000.0,
+               histogram_percentile(h, 99.9) / 1000.0,
+               h->max / 1000.0);
+}
+
+static void report(struct options *opts, struct totals *t, double secs)
+{
+        double mb = 1024.0 * 1024.0;
+
+        printf("%u connections, depth %u, %.2f seconds\n", opts->connections, opts->depth, secs);
+        printf("ios       %12llu %12.1f/s %10.1f MB/s payload %10.1f MB/s sent\n",
+               (unsigned long long) t->ios, t->ios / secs,
+               t->io_bytes / mb / secs, t->wire_bytes / mb / secs);
+        printf("commits   %12llu %12.1f/s (%llu forced by flow control)\n",
+               (unsigned long long) t->commits, t->commits / secs,
+               (unsigned long long) t->forced_commits);
+
+        printf("\n%-16s %10s %10s %10s %10s\n", "latency", "p50 us", "p99 us", "p99.9 us", "max us");
+        print_latency("JOURNAL_IO", &t->io_latency);
+        print_latency("JOURNAL_COMMIT", &t->commit_latency);
+
+        if (t->failed)
+                printf("\n%u connections failed\n", t->failed);
+}
+
+static void print_server_stats(struct options *opts)
+{
+        struct connection c;
+        command cmd;
+        response *resp;
+
+        memset(&c, 0, sizeof(c));
+        c.opts = opts;
+        c.fd = open_server(opts->server);
+        c.mem = pool_create("stats", 1024);
+        if (c.fd < 0 || !c.mem)
+                goto out;
+
+        if (!logon(&c))
+                goto out;
+
+        cmd.discriminator = STATS;
+        if (send_message(&c, &cmd, &resp) != STATS_RESPONSE)
+                goto out;
+
+        printf("\nserver:\n");
+        server_stats_print(stdout, &resp->u.stats);
+
+out:
+        if (c.fd >= 0)
+                close(c.fd);
+        if (c.mem)
+                pool_destroy(c.mem);
+        free(c.response);
+}
+
+/*----------------------------------------------------------------*/
+
+static int parse_size(const char *str, uint32_t *result)
+{
+        char *end;
+        unsigned long long n = strtoull(str, &end, 10);
+
+        switch (*end) {
+        case 'k': case 'K': n <<= 10; end++; break;
+        case 'm': case 'M': n <<= 20; end++; break;
+        }
+
+        /* ios are whole sectors */
+        if (*end || !n || n > UINT32_MAX || (n & ((1 << SECTOR_SHIFT) - 1)))
+                return 0;
+
+        *result = n;
+        return 1;
+}
+
+/* eg, 4k:70,64k:25,1m:5 */
+static int parse_mix(struct options *opts, const char *str)
+{
+        char *copy = strdup(str), *item, *save;
+
+        opts->nr_sizes = 0;
+        opts->total_weight = 0;
+        opts->max_size = 0;
+
+        for (item = strtok_r(copy, ",", &save); item; item = strtok_r(NULL, ",", &save)) {
+                struct size_weight *sw = opts->sizes + opts->nr_sizes;
+                char *weight = strchr(item, ':');
+
+                if (opts->nr_sizes == MAX_SIZES)
+                        goto bad;
+
+                if (weight)
+                        *weight++ = '\0';
+
+                if (!parse_size(item, &sw->size))
+                        goto bad;
+
+                sw->weight = weight ? atoi(weight) : 1;
+                if (!sw->weight)
+                        goto bad;
+
+                opts->total_weight += sw->weight;
+                if (sw->size > opts->max_size)
+                        opts->max_size = sw->size;
+                opts->nr_sizes++;
+        }
+
+        free(copy);
+        return opts->nr_sizes > 0;
+
+bad:
+        free(copy);
+        return 0;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr,
+                "usage: %s [options]\n"
+                "  -s, --server <spec>       tcp:host:port or unix:path (default tcp:127.0.0.1:%u)\n"
+                "  -c, --connections <n>     connections to open (default %u)\n"
+                "  -q, --depth <n>           requests pipelined per connection (default %u)\n"
+                "  -t, --duration <secs>     how long to run (default %u)\n"
+                "  -m, --mix <sizes>         io sizes and weights, eg, 4k:70,64k:25,1m:5\n"
+                "  -C, --commit-every <n>    ios per transaction, 0 commits only when forced (default %u)\n"
+                "      --zero-percent <n>    percentage of all zero ios\n"
+                "      --dup-percent <n>     percentage of ios repeating an earlier block\n"
+                "      --data <kind>         random or text (default random)\n"
+                "      --codec <name>        ask for none, lz4 or zstd compression\n"
+                "      --dev <n>             device number to write to\n"
+                "      --server-stats        print the server's STATS afterwards\n",
+                prog, DEFAULT_PORT, DEFAULT_CONNECTIONS, DEFAULT_DEPTH, DEFAULT_DURATION,
+                DEFAULT_COMMIT_EVERY);
+}
+
+enum {
+        OPT_ZERO = 256,
+        OPT_DUP,
+        OPT_DATA,
+        OPT_CODEC,
+        OPT_DEV,
+        OPT_SERVER_STATS
+};
+
+static int parse_args(struct options *opts, int argc, char **argv)
+{
+        int c;
+        static struct option long_options[] = {
+                { "server", required_argument, NULL, 's' },
+                { "connections", required_argument, NULL, 'c' },
+                { "depth", required_argument, NULL, 'q' },
+                { "duration", required_argument, NULL, 't' },
+                { "mix", required_argument, NULL, 'm' },
+                { "commit-every", required_argument, NULL, 'C' },
+                { "zero-percent", required_argument, NULL, OPT_ZERO },
+                { "dup-percent", required_argument, NULL, OPT_DUP },
+                { "data", required_argument, NULL, OPT_DATA },
+                { "codec", required_argument, NULL, OPT_CODEC },
+                { "dev", required_argument, NULL, OPT_DEV },
+                { "server-stats", no_argument, NULL, OPT_SERVER_STATS },
+                { "help", no_argument, NULL, 'h' },
+                { NULL, 0, NULL, 0 }
+        };
+
+        memset(opts, 0, sizeof(*opts));
+        opts->server = "tcp:127.0.0.1:6776";
+        opts->connections = DEFAULT_CONNECTIONS;
+        opts->depth = DEFAULT_DEPTH;
+        opts->duration = DEFAULT_DURATION;
+        opts->commit_every = DEFAULT_COMMIT_EVERY;
+        opts->data = DATA_RANDOM;
+        opts->codec = CODEC_NONE;
+        opts->sizes[0].size = opts->max_size = DEFAULT_IO_SIZE;
+        opts->sizes[0].weight = opts->total_weight = 1;
+        opts->nr_sizes = 1;
+
+        while ((c = getopt_long(argc, argv, "s:c:q:t:m:C:h", long_options, NULL)) != -1) {
+                switch (c) {
+                case 's':
+                        opts->server = optarg;
+                        break;
+
+                case 'c':
+                        opts->connections = atoi(optarg);
+                        break;
+
+                case 'q':
+                        opts->depth = atoi(optarg);
+                        break;
+
+                case 't':
+                        opts->duration = atoi(optarg);
+                        break;
+
+                case 'm':
+                        if (!parse_mix(opts, optarg)) {
+                                fprintf(stderr, "bad io mix '%s'\n", optarg);
+                                return 0;
+                        }
+                        break;
+
+                case 'C':
+                        opts->commit_every = atoi(optarg);
+                        break;
+
+                case OPT_ZERO:
+                        opts->zero_percent = atoi(optarg);
+                        break;
+
+                case OPT_DUP:
+                        opts->dup_percent = atoi(optarg);
+                        break;
+
+                case OPT_DATA:
+                        if (!strcmp(optarg, "random"))
+                                opts->data = DATA_RANDOM;
+                        else if (!strcmp(optarg, "text"))
+                                opts->data = DATA_TEXT;
+                        else {
+                                fprintf(stderr, "unknown data kind '%s'\n", optarg);
+                                return 0;
+                        }
+                        break;
+
+                case OPT_CODEC:
+                        if (!compress_lookup(optarg, &opts->codec) || !compress_available(opts->codec)) {
+                                fprintf(stderr, "codec '%s' isn't available\n", optarg);
+                                return 0;
+                        }
+                        break;
+
+                case OPT_DEV:
+                        opts->dev = atoi(optarg);
+                        break;
+
+                case OPT_SERVER_STATS:
+                        opts->server_stats = 1;
+                        break;
+
+                default:
+                        usage(argv[0]);
+                        return 0;
+                }
+        }
+
+        if (!opts->connections || !opts->depth || !opts->duration ||
+            opts->zero_percent + opts->dup_percent > 100) {
+                usage(argv[0]);
+                return 0;
+        }
+
+        return 1;
+}
+
+int main(int argc, char **argv)
+{
+        unsigned i;
+        uint64_t start;
+        struct options opts;
+        struct totals totals;
+        struct connection *conns;
+
+        if (!parse_args(&opts, argc, argv))
+                return 1;
+
+        if (!check_io_encoding()) {
+                fprintf(stderr, "io encoding doesn't match protocol.xdr\n");
+                return 1;
+        }
+
+        memset(&totals, 0, sizeof(totals));
+        histogram_init(&totals.io_latency);
+        histogram_init(&totals.commit_latency);
+
+        conns = calloc(opts.connections, sizeof(*conns));
+        if (!conns) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+        }
+
+        csp_init();
+        start = now();
+        for (i = 0; i < opts.connections; i++) {
+                struct connection *c = conns + i;
+
+                c->opts = &opts;
+                c->totals = &totals;
+                c->deadline = start + opts.duration * 1000000000ULL;
+                c->index = i;
+                c->seed = i + 1;
+                c->sector = (uint64_t) i << 32;
+                c->fd = open_server(opts.server);
+                if (c->fd < 0) {
+                        fprintf(stderr, "couldn't connect to %s\n", opts.server);
+                        return 1;
+                }
+
+                csp_spawn((process_fn) connection_loop, c);
+        }
+        csp_start();
+
+        report(&opts, &totals, (now() - start) / 1000000000.0);
+        if (opts.server_stats) {
+                csp_spawn((process_fn) print_server_stats, &opts);
+                csp_start();
+        }
+
+        for (i = 0; i < opts.connections; i++) {
+                struct connection *c = conns + i;
+
+                free(c->queue);
+                free(c->source);
+                free(c->zeroes);
+                free(c->msg);
+                free(c->commit_msg);
+                free(c->response);
+                if (c->mem)
+                        pool_destroy(c->mem);
+        }
+        free(conns);
+        csp_exit();
+
+        return totals.failed ? 1 : 0;
+}
@@ -0,0 +1,341 @@
+#include "merge/merge.h"
+#include "journal/journal.h"
+#include "log/log.h"
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <semaphore.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+/*
+ * Compares writing a journal's replayed ios out one synchronous write
+ * each, as they come, against the merge engine, which sorts and joins
+ * them and keeps --queue-depth writes in flight, replaying from one
+ * thread, and then from a thread per device.  The journal is filled
+ * with --transactions writes of --io-size bytes, spread over --devices
+ * devices in turn, and scattered over the first --dev-mb of each, or
+ * one after another with --sequential.  Each run is followed by a sync,
+ * which is included in the time.
+ *
+ * --dev may be a block device, which will be overwritten, or a file,
+ * which is created if need be.  With more than one device they're
+ * --dev with .0, .1 and so on added.  Put the journal somewhere else.
+ */
+
+enum {
+        DEFAULT_TRANSACTIONS = 16384,
+        DEFAULT_IO_SIZE = 4096,
+        DEFAULT_DEV_MB = 256,
+        DEFAULT_QUEUE_DEPTH = 32,
+        MAX_DEVICES = 16
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void wake(void *context)
+{
+        sem_post(context);
+}
+
+static void remove_journal(const char *dir)
+{
+        DIR *d;
+        struct dirent *de;
+        char path[PATH_MAX];
+
+        d = opendir(dir);
+        if (!d)
+                return;
+
+        while ((de = readdir(d))) {
+                if (!strncmp(de->d_name, "segment.", 8) || !strncmp(de->d_name, "checkpoint", 10)) {
+                        snprintf(path, sizeof(path), "%s/%s", dir, de->d_name);
+                        unlink(path);
+                }
+        }
+        closedir(d);
+        rmdir(dir);
+}
+
+static int fill(struct journal *j, struct journal_device **devs, unsigned nr_devs,
+                unsigned transactions, size_t io_size, uint64_t dev_size, int sequential)
+{
+        unsigned i;
+        uint64_t id, slots = dev_size / io_size;
+        unsigned char *data = malloc(io_size);
+        struct journal_transaction *txn;
+        struct journal_io io;
+        sem_t durable;
+        struct thunk t = { wake, &durable };
+
+        if (!data || !slots)
+                return 0;
+
+        memset(data, 0x5a, io_size);
+        io.codec = 0;
+        io.len = io_size;
+        io.data = data;
+
+        srandom(1);
+        sem_init(&durable, 0, 0);
+        for (i = 0; i < transactions; i++) {
+                txn = journal_begin(j);
+                if (!txn)
+                        break;
+
+                io.dev = devs[i % nr_devs];
+                io.start_sector = (sequential ? i / nr_devs % slots : (uint64_t) random() % slots) *
+                        (io_size >> JOURNAL_SECTOR_SHIFT);
+                io.end_sector = io.start_sector + (io_size >> JOURNAL_SECTOR_SHIFT);
+                if (!journal_record_io(txn, &io)) {
+                        journal_rollback(txn);
+                        break;
+                }
+
+                if (!journal_commit(txn, (i + 1 == transactions) ? &t : NULL, &id))
+                        break;
+        }
+
+        if (i == transactions)
+                sem_wait(&durable);
+        sem_destroy(&durable);
+        free(data);
+        return i == transactions && !journal_failed(j);
+}
+
+struct direct_writer {
+        struct journal_device *devs[MAX_DEVICES];
+        int fds[MAX_DEVICES];
+        unsigned nr_devs;
+        uint64_t writes;
+        int failed;
+};
+
+static void direct_begin(void *context, uint64_t id)
+{
+}
+
+static void direct_io(void *context, struct journal_io *io)
+{
+        unsigned i;
+        struct direct_writer *dw = context;
+
+        for (i = 0; i < dw->nr_devs; i++)
+                if (dw->devs[i] == io->dev)
+                        break;
+
+        dw->writes++;
+        if (i == dw->nr_devs ||
+            pwrite(dw->fds[i], io->data, io->len, io->start_sector << JOURNAL_SECTOR_SHIFT) != io->len)
+                dw->failed = 1;
+}
+
+static void direct_commit(void *context)
+{
+}
+
+static int replay_all(struct journal *j, struct journal_replayer *r)
+{
+        unsigned i, count = journal_transaction_count(j);
+
+        for (i = 0; i < count; i++)
+                if (!journal_transaction_replay_front(j, i, r))
+                        return 0;
+
+        return 1;
+}
+
+static int sync_all(struct direct_writer *dw)
+{
+        unsigned i;
+
+        for (i = 0; i < dw->nr_devs; i++)
+                if (fdatasync(dw->fds[i]))
+                        return 0;
+
+        return 1;
+}
+
+/* Merges everything, one way or the other, and returns the time taken */
+static uint64_t run_merge(struct journal *j, struct direct_writer *dw, char paths[][PATH_MAX],
+                          struct merge_options *opts, int parallel, struct merge_stats *stats)
+{
+        unsigned i, count = journal_transaction_count(j);
+        uint64_t start, ns = 0;
+        struct merge *m = merge_create(j, opts);
+
+        for (i = 0; m && i < dw->nr_devs; i++)
+                if (!merge_bind_device(m, dw->devs[i], paths[i]))
+                        break;
+
+        if (!m || i < dw->nr_devs) {
+                fprintf(stderr, "couldn't set up the merge, see log.log\n");
+                goto out;
+        }
+
+        start = now_ns();
+        if (parallel ? journal_replay_parallel(j, count, merge_get_parallel_replayer(m)) != count :
+            !replay_all(j, merge_get_replayer(m))) {
+                fprintf(stderr, "merge replay failed, see log.log\n");
+                goto out;
+        }
+
+        if (!merge_flush(m)) {
+                fprintf(stderr, "merge failed, see log.log\n");
+                goto out;
+        }
+
+        ns = now_ns() - start;
+        merge_get_stats(m, stats);
+
+out:
+        if (m)
+                merge_destroy(m);
+        return ns;
+}
+
+static void usage(const char *prog)
+{
+        fprintf(stderr, "usage: %s [--dir <journal>] [--dev <path>] [--devices <count>] "
+                "[--dev-mb <size>] [--transactions <count>] [--io-size <bytes>] "
+                "[--queue-depth <writes>] [--sequential]\n", prog);
+        exit(1);
+}
+
+int main(int argc, char **argv)
+{
+        int i, sequential = 0;
+        unsigned n, nr_devs = 1, transactions = DEFAULT_TRANSACTIONS, queue_depth = DEFAULT_QUEUE_DEPTH;
+        size_t io_size = DEFAULT_IO_SIZE;
+        uint64_t dev_mb = DEFAULT_DEV_MB, start, direct_ns, merge_ns, parallel_ns, bytes;
+        const char *dir = "merge_b.journal", *dev_path = "merge_b.dev";
+        char paths[MAX_DEVICES][PATH_MAX], name[16];
+        struct journal *j = NULL;
+        struct merge_options opts;
+        struct merge_stats stats, parallel_stats;
+        struct direct_writer dw;
+        struct journal_replayer direct = { &dw, direct_begin, direct_io, direct_commit };
+
+        memset(&dw, 0, sizeof(dw));
+
+        for (i = 1; i < argc; i++) {
+                if (!strcmp(argv[i], "--sequential")) {
+                        sequential = 1;
+                        continue;
+                }
+
+                if (i + 1 == argc)
+                        usage(argv[0]);
+
+                if (!strcmp(argv[i], "--dir"))
+                        dir = argv[++i];
+                else if (!strcmp(argv[i], "--dev"))
+                        dev_path = argv[++i];
+                else if (!strcmp(argv[i], "--devices"))
+                        nr_devs = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--dev-mb"))
+                        dev_mb = strtoull(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--transactions"))
+                        transactions = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--io-size"))
+                        io_size = strtoul(argv[++i], NULL, 10);
+                else if (!strcmp(argv[i], "--queue-depth"))
+                        queue_depth = strtoul(argv[++i], NULL, 10);
+                else
+                        usage(argv[0]);
+        }
+
+        if (!transactions || !dev_mb || !queue_depth || !io_size || !nr_devs || nr_devs > MAX_DEVICES ||
+            io_size % (1 << JOURNAL_SECTOR_SHIFT))
+                usage(argv[0]);
+
+        /* the journal and merge engine log errors */
+        log_init(".", INFO, ERROR);
+
+        remove_journal(dir);
+        j = journal_create(dir, NULL);
+        if (!j) {
+                fprintf(stderr, "couldn't create the journal, see log.log\n");
+                goto bad;
+        }
+
+        for (n = 0; n < nr_devs; n++) {
+                if (nr_devs == 1)
+                        snprintf(paths[n], sizeof(paths[n]), "%s", dev_path);
+                else
+                        snprintf(paths[n], sizeof(paths[n]), "%s.%u", dev_path, n);
+                snprintf(name, sizeof(name), "bench%u", n);
+
+                dw.fds[n] = open(paths[n], O_WRONLY | O_CREAT, 0644);
+                if (dw.fds[n] < 0) {
+                        fprintf(stderr, "couldn't open %s\n", paths[n]);
+                        goto bad;
+                }
+                dw.nr_devs++;
+
+                dw.devs[n] = journal_register_device(j, name);
+                if (!dw.devs[n]) {
+                        fprintf(stderr, "couldn't register %s, see log.log\n", name);
+                        goto bad;
+                }
+        }
+
+        if (!fill(j, dw.devs, nr_devs, transactions, io_size, dev_mb << 20, sequential)) {
+                fprintf(stderr, "couldn't fill the journal, see log.log\n");
+                goto bad;
+        }
+
+        start = now_ns();
+        if (!replay_all(j, &direct) || dw.failed || !sync_all(&dw)) {
+                fprintf(stderr, "writing %s failed\n", dev_path);
+                goto bad;
+        }
+        direct_ns = now_ns() - start;
+
+        /* nothing else is using the disk, so the merge isn't held back */
+        merge_options_init(&opts);
+        opts.queue_depth = queue_depth;
+        opts.min_rate = opts.max_rate = 1ULL << 40;
+        merge_ns = run_merge(j, &dw, paths, &opts, 0, &stats);
+        parallel_ns = merge_ns ? run_merge(j, &dw, paths, &opts, 1, &parallel_stats) : 0;
+        if (!parallel_ns)
+                goto bad;
+        bytes = stats.bytes;
+
+        printf("%u %s writes of %zu bytes over %llu MB of %u device%s, queue depth %u\n\n",
+               transactions, sequential ? "sequential" : "random", io_size,
+               (unsigned long long) dev_mb, nr_devs, (nr_devs == 1) ? "" : "s", queue_depth);
+        printf("%-12s %10s %10s %12s\n", "write", "writes", "ms", "MB/s");
+        printf("%-12s %10llu %10.1f %12.1f\n", "per record", (unsigned long long) dw.writes,
+               direct_ns / 1e6, bytes / (direct_ns / 1e9) / (1024.0 * 1024.0));
+        printf("%-12s %10llu %10.1f %12.1f\n", "merged", (unsigned long long) stats.writes,
+               merge_ns / 1e6, bytes / (merge_ns / 1e9) / (1024.0 * 1024.0));
+        printf("%-12s %10llu %10.1f %12.1f\n", "per device", (unsigned long long) parallel_stats.writes,
+               parallel_ns / 1e6, bytes / (parallel_ns / 1e9) / (1024.0 * 1024.0));
+
+        journal_destroy(j);
+        remove_journal(dir);
+        for (n = 0; n < dw.nr_devs; n++)
+                close(dw.fds[n]);
+        log_exit();
+        return 0;
+
+bad:
+        if (j)
+                journal_destroy(j);
+        remove_journal(dir);
+        for (n = 0; n < dw.nr_devs; n++)
+                close(dw.fds[n]);
+        log_exit();
+        return 1;
+}
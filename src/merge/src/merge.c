@@ -0,0 +1,884 @@
+#define _GNU_SOURCE             /* O_DIRECT */
+
+#include "merge.h"
+#include "ring.h"
+
+#include "compress/compress.h"
+#include "journal/extent_index.h"
+#include "log/log.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <pthread.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------*/
+
+enum {
+        DEFAULT_QUEUE_DEPTH = 32,
+        DEFAULT_BATCH_SIZE = 64 * 1024 * 1024,
+        DEFAULT_MAX_WRITE = 1024 * 1024,
+        DEFAULT_MIN_RATE = 8 * 1024 * 1024,
+        DEFAULT_MAX_RATE = 1024 * 1024 * 1024,
+        DEFAULT_TARGET_COMMIT_US = 5000,
+        DEFAULT_TARGET_WRITE_US = 20000,
+        DEFAULT_LOW_FILL = 50,
+        DEFAULT_HIGH_FILL = 80,
+        DEFAULT_ADJUST_MS = 100,
+
+        /* how far ahead of the rate writes may get, in 1/n of a second */
+        BURST_FRACTION = 10,
+
+        /*
+         * Blocks are allocated aligned to this, and max_write is a
+         * multiple of it.  But a write may start part way into a block,
+         * so offsets, lengths and buffers are only sector aligned.
+         */
+        DATA_ALIGN = 4096,
+
+        MAX_IOVS = 64,
+        ZERO_CHUNK = 64 * 1024,
+        MIN_ARRAY = 256
+};
+
+/* A run of sectors in the batch, and where its data is */
+struct piece {
+        uint64_t begin;
+        uint64_t end;
+        uint64_t origin;        /* the sector the block's data starts at */
+        uint32_t block;
+};
+
+struct merge_write {
+        uint64_t offset;        /* bytes */
+        uint64_t len;
+        uint64_t issued;
+        uint64_t slept;         /* the binding's slept when this was issued */
+        unsigned nr_iov;
+        struct iovec iov[MAX_IOVS];
+};
+
+/*
+ * A bound device has a batch and a ring of its own, so the devices can
+ * be merged side by side, each from one thread at a time.
+ */
+struct binding {
+        struct merge *m;
+        struct journal_device *dev;
+        int fd;
+        struct journal_replayer replayer;
+
+        /*
+         * The batch.  Each replayed io's data is copied into a block of
+         * its own, NULL for zeroes, and its sectors put in the index
+         * under a sequence number of its own, so later ios replace the
+         * sectors of earlier ones.
+         */
+        struct extent_index *index;
+        void **blocks;
+        size_t nr_blocks;
+        size_t blocks_size;
+        uint64_t seq;
+        uint64_t pending;       /* bytes */
+        uint64_t superseded;    /* sectors, as the merge's stats have them */
+
+        struct piece *pieces;
+        size_t nr_pieces;
+        size_t pieces_size;
+        int pieces_failed;
+
+        struct ring *ring;
+        struct merge_write *writes;
+        struct merge_write **free_writes;
+        unsigned nr_free;
+        struct ring_completion *done;
+
+        uint64_t slept;         /* ns pace() has held this binding's thread back */
+        int failed;
+};
+
+struct merge {
+        struct journal *j;
+        struct merge_options opts;
+        struct journal_replayer replayer;
+        struct journal_parallel_replayer parallel;
+
+        struct binding **bindings;
+        unsigned nr_bindings;
+        unsigned last;          /* binding of the last io */
+        void *zeroes;
+
+        int failed;             /* an io for a device that wasn't bound */
+
+        pthread_mutex_t lock;   /* protects the rate controller and the stats */
+
+        /* the rate controller, and what it saw at its last decision */
+        uint64_t rate;
+        uint64_t tokens;        /* bytes that can be written without waiting */
+        uint64_t refilled;      /* ahead of now while writes are waiting */
+        uint64_t adjusted;
+        uint64_t last_commits;
+        uint64_t last_commit_ns;
+        uint64_t last_writes;
+        uint64_t last_write_ns;
+
+        struct merge_stats stats;
+};
+
+static uint64_t now_ns()
+{
+        struct timespec ts;
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*----------------------------------------------------------------*/
+
+static struct binding *find_binding(struct merge *m, struct journal_device *dev)
+{
+        unsigned i;
+
+        if (m->last < m->nr_bindings && m->bindings[m->last]->dev == dev)
+                return m->bindings[m->last];
+
+        for (i = 0; i < m->nr_bindings; i++)
+                if (m->bindings[i]->dev == dev)
+                        return m->bindings[m->last = i];
+
+        return NULL;
+}
+
+/* The data is decompressed, and aligned for O_DIRECT */
+static void *copy_data(struct journal_io *io, uint64_t len)
+{
+        void *data;
+        size_t out = len;
+
+        if (posix_memalign(&data, DATA_ALIGN, len))
+                return NULL;
+
+        if (io->codec == CODEC_NONE) {
+                if (io->len == len) {
+                        memcpy(data, io->data, len);
+                        return data;
+                }
+
+        } else if (decompress_block(io->codec, io->data, io->len, data, &out) && out == len)
+                return data;
+
+        error("merge: bad io, %u bytes for %llu sectors with codec %u", io->len,
+              (unsigned long long) (io->end_sector - io->start_sector), io->codec);
+        free(data);
+        return NULL;
+}
+
+static int add_block(struct binding *b, void *data)
+{
+        size_t size;
+        void **blocks;
+
+        if (b->nr_blocks == b->blocks_size) {
+                size = b->blocks_size ? b->blocks_size * 2 : MIN_ARRAY;
+                blocks = realloc(b->blocks, sizeof(*blocks) * size);
+                if (!blocks)
+                        return 0;
+
+                b->blocks = blocks;
+                b->blocks_size = size;
+        }
+
+        b->blocks[b->nr_blocks++] = data;
+        return 1;
+}
+
+static void collect_piece(void *context, struct extent_mapping *em)
+{
+        struct binding *b = context;
+        size_t size;
+        struct piece *pieces, *p;
+
+        if (b->nr_pieces == b->pieces_size) {
+                size = b->pieces_size ? b->pieces_size * 2 : MIN_ARRAY;
+                pieces = realloc(b->pieces, sizeof(*pieces) * size);
+                if (!pieces) {
+                        b->pieces_failed = 1;
+                        return;
+                }
+
+                b->pieces = pieces;
+                b->pieces_size = size;
+        }
+
+        p = b->pieces + b->nr_pieces++;
+        p->begin = em->begin;
+        p->end = em->end;
+        p->origin = em->origin;
+        p->block = em->io;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Rate control, see merge_options.  The rate is shared by every device,
+ * and adjusted, and writes held back to keep to it, in the replaying
+ * threads as they're issued.
+ */
+static uint64_t floor_rate(struct merge *m, unsigned fill)
+{
+        struct merge_options *o = &m->opts;
+
+        if (fill <= o->low_fill)
+                return o->min_rate;
+
+        if (fill >= o->high_fill)
+                return o->max_rate;
+
+        return o->min_rate + (o->max_rate - o->min_rate) * (fill - o->low_fill) /
+                (o->high_fill - o->low_fill);
+}
+
+static void adjust_rate(struct merge *m)
+{
+        int slow;
+        unsigned fill = 0;
+        uint64_t rate, commit_latency = 0, write_latency = 0;
+        struct journal_stats js;
+        struct merge_options *o = &m->opts;
+
+        memset(&js, 0, sizeof(js));
+        if (m->j)
+                journal_get_stats(m->j, &js);
+
+        pthread_mutex_lock(&m->lock);
+        if (m->j) {
+                if (js.capacity)
+                        fill = (js.used >= js.capacity) ? 100 : js.used * 100 / js.capacity;
+
+                if (js.commits > m->last_commits)
+                        commit_latency = (js.commit_ns - m->last_commit_ns) /
+                                (js.commits - m->last_commits);
+                m->last_commits = js.commits;
+                m->last_commit_ns = js.commit_ns;
+        }
+
+        if (m->stats.writes > m->last_writes)
+                write_latency = (m->stats.write_ns - m->last_write_ns) /
+                        (m->stats.writes - m->last_writes);
+        m->last_writes = m->stats.writes;
+        m->last_write_ns = m->stats.write_ns;
+
+        slow = (o->target_commit_us && commit_latency > o->target_commit_us * 1000ULL) ||
+                (o->target_write_us && write_latency > o->target_write_us * 1000ULL);
+
+        rate = m->rate;
+        if (fill >= o->high_fill) {
+                rate = o->max_rate;
+                m->stats.flat_out++;
+
+        } else if (slow) {
+                rate /= 2;
+                m->stats.backoffs++;
+
+        } else if (rate < o->max_rate) {
+                rate += o->max_rate / 16;
+                m->stats.speedups++;
+        }
+
+        if (rate < floor_rate(m, fill))
+                rate = floor_rate(m, fill);
+        if (rate > o->max_rate)
+                rate = o->max_rate;
+
+        m->rate = m->stats.rate = rate;
+        m->stats.fill = fill;
+        m->stats.commit_latency_ns = commit_latency;
+        m->stats.write_latency_ns = write_latency;
+        pthread_mutex_unlock(&m->lock);
+}
+
+/*
+ * Waits until |len| more bytes can be written without going over the
+ * rate.  Bytes that aren't there yet are taken from the future, by
+ * moving |refilled| on, so threads that are held back at the same time
+ * wait their turn.
+ */
+static void pace(struct binding *b, uint64_t len)
+{
+        int adjust;
+        struct merge *m = b->m;
+        uint64_t now = now_ns(), elapsed, burst, wait = 0;
+        struct timespec ts;
+
+        /* one thread makes each decision */
+        pthread_mutex_lock(&m->lock);
+        adjust = now - m->adjusted >= m->opts.adjust_ms * 1000000ULL;
+        if (adjust)
+                m->adjusted = now;
+        pthread_mutex_unlock(&m->lock);
+
+        if (adjust)
+                adjust_rate(m);
+
+        pthread_mutex_lock(&m->lock);
+        if (m->refilled < now) {
+                elapsed = now - m->refilled;
+                if (elapsed > 1000000000ULL)
+                        elapsed = 1000000000ULL;
+                m->tokens += (uint64_t) ((double) elapsed * m->rate / 1e9);
+                m->refilled = now;
+        }
+
+        burst = m->rate / BURST_FRACTION;
+        if (burst < m->opts.max_write)
+                burst = m->opts.max_write;
+        if (m->tokens > burst)
+                m->tokens = burst;
+
+        if (m->tokens < len) {
+                m->refilled += (len - m->tokens) * 1000000000ULL / m->rate;
+                m->tokens = 0;
+                wait = m->refilled - now;
+                m->stats.paced_ns += wait;
+        } else
+                m->tokens -= len;
+        pthread_mutex_unlock(&m->lock);
+
+        if (wait) {
+                ts.tv_sec = wait / 1000000000ULL;
+                ts.tv_nsec = wait % 1000000000ULL;
+                while (nanosleep(&ts, &ts) && errno == EINTR)
+                        ;
+
+                b->slept += now_ns() - now;
+        }
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Writing a device's batch.  Writes are taken from a pool of
+ * |queue_depth|, so running out of them means waiting for one to
+ * complete.
+ */
+static int reap_writes(struct binding *b, unsigned min)
+{
+        int i, n, r = 1;
+        uint64_t now;
+        struct merge *m = b->m;
+        struct merge_write *w;
+
+        n = ring_wait(b->ring, min, b->done, m->opts.queue_depth);
+        if (n < 0)
+                return 0;
+
+        now = now_ns();
+        pthread_mutex_lock(&m->lock);
+        for (i = 0; i < n; i++) {
+                w = b->done[i].context;
+                if (b->done[i].result < 0 || (uint64_t) b->done[i].result != w->len) {
+                        error("merge: write of %llu bytes at %llu to %s failed: %s",
+                              (unsigned long long) w->len, (unsigned long long) w->offset,
+                              journal_device_name(b->dev),
+                              (b->done[i].result < 0) ? strerror(-b->done[i].result) : "short write");
+                        r = 0;
+                }
+
+                m->stats.writes++;
+                m->stats.written += w->len;
+                m->stats.write_ns += now - w->issued - (b->slept - w->slept);
+                b->free_writes[b->nr_free++] = w;
+        }
+        pthread_mutex_unlock(&m->lock);
+
+        return r;
+}
+
+/*
+ * Completions are only seen once this thread gets round to reaping
+ * them, so time it spent pacing later writes doesn't count against the
+ * device; otherwise a slow rate would look like a slow device, and
+ * slow the rate further.
+ */
+static int issue_write(struct binding *b, struct merge_write *w)
+{
+        pace(b, w->len);
+        w->issued = now_ns();
+        w->slept = b->slept;
+        return ring_writev(b->ring, b->fd, w->iov, w->nr_iov, w->offset, w);
+}
+
+static struct merge_write *get_write(struct binding *b, uint64_t offset)
+{
+        struct merge_write *w;
+
+        if (!b->nr_free && !reap_writes(b, 1))
+                return NULL;
+
+        w = b->free_writes[--b->nr_free];
+        w->offset = offset;
+        w->len = 0;
+        w->nr_iov = 0;
+        return w;
+}
+
+/*
+ * Adds |len| bytes at |offset| to the write being built, |*w|, issuing
+ * it and starting another if they don't follow on, or won't fit.
+ * |data| is NULL for zeroes.
+ */
+static int add_range(struct binding *b, struct merge_write **w,
+                     uint64_t offset, unsigned char *data, uint64_t len)
+{
+        uint64_t n;
+        struct iovec *iov;
+        struct merge *m = b->m;
+
+        while (len) {
+                if (*w && ((*w)->offset + (*w)->len != offset || (*w)->nr_iov == MAX_IOVS ||
+                           (*w)->len == m->opts.max_write)) {
+                        if (!issue_write(b, *w))
+                                return 0;
+                        *w = NULL;
+                }
+
+                if (!*w && !(*w = get_write(b, offset)))
+                        return 0;
+
+                n = m->opts.max_write - (*w)->len;
+                if (n > len)
+                        n = len;
+                if (!data && n > ZERO_CHUNK)
+                        n = ZERO_CHUNK;
+
+                iov = (*w)->iov + (*w)->nr_iov++;
+                iov->iov_base = data ? data : m->zeroes;
+                iov->iov_len = n;
+                (*w)->len += n;
+
+                offset += n;
+                len -= n;
+                if (data)
+                        data += n;
+        }
+
+        return 1;
+}
+
+/* The index hands the pieces over in sector order */
+static int write_pieces(struct binding *b)
+{
+        size_t i;
+        unsigned char *data;
+        struct piece *p;
+        struct merge_write *w = NULL;
+
+        b->nr_pieces = 0;
+        b->pieces_failed = 0;
+        extent_index_lookup(b->index, 0, 0, UINT64_MAX, collect_piece, b);
+        if (b->pieces_failed)
+                return 0;
+
+        for (i = 0; i < b->nr_pieces; i++) {
+                p = b->pieces + i;
+                data = b->blocks[p->block];
+                if (data)
+                        data += (p->begin - p->origin) << JOURNAL_SECTOR_SHIFT;
+
+                if (!add_range(b, &w, p->begin << JOURNAL_SECTOR_SHIFT, data,
+                               (p->end - p->begin) << JOURNAL_SECTOR_SHIFT))
+                        return 0;
+        }
+
+        return !w || issue_write(b, w);
+}
+
+static void clear_batch(struct binding *b)
+{
+        size_t i;
+
+        for (i = 0; i < b->nr_blocks; i++)
+                free(b->blocks[i]);
+        b->nr_blocks = 0;
+        b->pending = 0;
+        extent_index_drop(b->index, b->seq);
+}
+
+static int write_batch(struct binding *b)
+{
+        int r;
+        uint64_t superseded;
+        struct merge *m = b->m;
+
+        if (!b->nr_blocks)
+                return !b->failed;
+
+        r = write_pieces(b);
+
+        /* the blocks can't go until the kernel's finished with them */
+        while (ring_outstanding(b->ring))
+                if (!reap_writes(b, ring_outstanding(b->ring)))
+                        r = 0;
+
+        superseded = extent_index_superseded(b->index);
+        pthread_mutex_lock(&m->lock);
+        m->stats.batches++;
+        m->stats.superseded += (superseded - b->superseded) << JOURNAL_SECTOR_SHIFT;
+        pthread_mutex_unlock(&m->lock);
+        b->superseded = superseded;
+
+        clear_batch(b);
+        if (!r)
+                b->failed = 1;
+
+        return !b->failed;
+}
+
+/*----------------------------------------------------------------*/
+
+static void merge_begin(void *context, uint64_t id)
+{
+}
+
+static void binding_io(void *context, struct journal_io *io)
+{
+        void *data = NULL;
+        uint64_t len = (io->end_sector - io->start_sector) << JOURNAL_SECTOR_SHIFT;
+        struct binding *b = context;
+        struct merge *m = b->m;
+        struct extent_mapping em;
+
+        if (b->failed)
+                return;
+
+        if (io->data && !(data = copy_data(io, len))) {
+                b->failed = 1;
+                return;
+        }
+
+        if (!add_block(b, data)) {
+                free(data);
+                b->failed = 1;
+                return;
+        }
+
+        em.dev = 0;
+        em.begin = io->start_sector;
+        em.end = io->end_sector;
+        em.txn = ++b->seq;
+        em.io = b->nr_blocks - 1;
+        em.origin = io->start_sector;
+        if (!extent_index_insert(b->index, &em)) {
+                b->failed = 1;
+                return;
+        }
+
+        b->pending += len;
+        pthread_mutex_lock(&m->lock);
+        m->stats.ios++;
+        m->stats.bytes += len;
+        pthread_mutex_unlock(&m->lock);
+
+        if (b->pending >= m->opts.batch_size)
+                write_batch(b);
+}
+
+/* The replayer for a single thread, which hands each io to its device's binding */
+static void merge_io(void *context, struct journal_io *io)
+{
+        struct merge *m = context;
+        struct binding *b;
+
+        if (m->failed)
+                return;
+
+        b = find_binding(m, io->dev);
+        if (!b) {
+                error("merge: no device bound for %s", journal_device_name(io->dev));
+                m->failed = 1;
+                return;
+        }
+
+        binding_io(b, io);
+}
+
+static void merge_commit(void *context)
+{
+}
+
+/* Called from journal_replay_parallel()'s own thread */
+static struct journal_replayer *device_replayer(void *context, struct journal_device *dev)
+{
+        struct merge *m = context;
+        struct binding *b = find_binding(m, dev);
+
+        if (!b) {
+                error("merge: no device bound for %s", journal_device_name(dev));
+                m->failed = 1;
+                return NULL;
+        }
+
+        return &b->replayer;
+}
+
+/*----------------------------------------------------------------*/
+
+void merge_options_init(struct merge_options *opts)
+{
+        opts->queue_depth = DEFAULT_QUEUE_DEPTH;
+        opts->batch_size = DEFAULT_BATCH_SIZE;
+        opts->max_write = DEFAULT_MAX_WRITE;
+
+        opts->min_rate = DEFAULT_MIN_RATE;
+        opts->max_rate = DEFAULT_MAX_RATE;
+        opts->target_commit_us = DEFAULT_TARGET_COMMIT_US;
+        opts->target_write_us = DEFAULT_TARGET_WRITE_US;
+        opts->low_fill = DEFAULT_LOW_FILL;
+        opts->high_fill = DEFAULT_HIGH_FILL;
+        opts->adjust_ms = DEFAULT_ADJUST_MS;
+}
+
+struct merge *merge_create(struct journal *j, struct merge_options *opts)
+{
+        struct merge *m = malloc(sizeof(*m));
+
+        if (!m)
+                return NULL;
+
+        memset(m, 0, sizeof(*m));
+        m->j = j;
+        if (opts)
+                m->opts = *opts;
+        else
+                merge_options_init(&m->opts);
+
+        if (!m->opts.queue_depth)
+                m->opts.queue_depth = 1;
+        m->opts.max_write &= ~((size_t) DATA_ALIGN - 1);
+        if (!m->opts.max_write)
+                m->opts.max_write = DATA_ALIGN;
+        if (!m->opts.min_rate)
+                m->opts.min_rate = 1;
+        if (m->opts.max_rate < m->opts.min_rate)
+                m->opts.max_rate = m->opts.min_rate;
+
+        /* start slow, and speed up if nothing suffers */
+        m->rate = m->stats.rate = m->opts.min_rate;
+        m->refilled = m->adjusted = now_ns();
+
+        /* the first decision only looks at commits made since now */
+        if (j) {
+                struct journal_stats js;
+
+                journal_get_stats(j, &js);
+                m->last_commits = js.commits;
+                m->last_commit_ns = js.commit_ns;
+        }
+
+        m->replayer.context = m;
+        m->replayer.begin = merge_begin;
+        m->replayer.io = merge_io;
+        m->replayer.commit = merge_commit;
+        m->parallel.context = m;
+        m->parallel.device = device_replayer;
+        pthread_mutex_init(&m->lock, NULL);
+
+        if (posix_memalign(&m->zeroes, DATA_ALIGN, ZERO_CHUNK)) {
+                pthread_mutex_destroy(&m->lock);
+                free(m);
+                return NULL;
+        }
+
+        memset(m->zeroes, 0, ZERO_CHUNK);
+        return m;
+}
+
+static void destroy_binding(struct binding *b)
+{
+        if (b->ring)
+                ring_destroy(b->ring);
+        if (b->index) {
+                clear_batch(b);
+                extent_index_destroy(b->index);
+        }
+
+        if (b->fd >= 0)
+                close(b->fd);
+
+        free(b->blocks);
+        free(b->pieces);
+        free(b->writes);
+        free(b->free_writes);
+        free(b->done);
+        free(b);
+}
+
+void merge_destroy(struct merge *m)
+{
+        unsigned i;
+
+        for (i = 0; i < m->nr_bindings; i++)
+                destroy_binding(m->bindings[i]);
+
+        pthread_mutex_destroy(&m->lock);
+        free(m->bindings);
+        free(m->zeroes);
+        free(m);
+}
+
+/*
+ * O_DIRECT wants writes aligned to the device's logical block size, or
+ * for a file, whatever its filesystem asks for.  Writes are only ever
+ * sector aligned, so anything coarser, or that can't be found out, is
+ * written buffered.
+ */
+static int direct_aligned(int fd)
+{
+        int block_size;
+        struct stat st;
+        struct statx stx;
+
+        if (fstat(fd, &st))
+                return 0;
+
+        if (S_ISBLK(st.st_mode))
+                return !ioctl(fd, BLKSSZGET, &block_size) &&
+                        block_size <= (1 << JOURNAL_SECTOR_SHIFT);
+
+        if (statx(fd, "", AT_EMPTY_PATH, STATX_DIOALIGN, &stx) || !(stx.stx_mask & STATX_DIOALIGN))
+                return 0;
+
+        return stx.stx_dio_offset_align && stx.stx_dio_offset_align <= (1 << JOURNAL_SECTOR_SHIFT) &&
+                stx.stx_dio_mem_align <= (1 << JOURNAL_SECTOR_SHIFT);
+}
+
+static struct binding *create_binding(struct merge *m, struct journal_device *dev, int fd)
+{
+        unsigned i;
+        struct binding *b = malloc(sizeof(*b));
+
+        if (!b)
+                return NULL;
+
+        memset(b, 0, sizeof(*b));
+        b->m = m;
+        b->dev = dev;
+        b->fd = fd;
+        b->replayer.context = b;
+        b->replayer.begin = merge_begin;
+        b->replayer.io = binding_io;
+        b->replayer.commit = merge_commit;
+
+        b->index = extent_index_create();
+        b->ring = ring_create(m->opts.queue_depth);
+        b->writes = malloc(sizeof(*b->writes) * m->opts.queue_depth);
+        b->free_writes = malloc(sizeof(*b->free_writes) * m->opts.queue_depth);
+        b->done = malloc(sizeof(*b->done) * m->opts.queue_depth);
+        if (!b->index || !b->ring || !b->writes || !b->free_writes || !b->done) {
+                b->fd = -1;
+                destroy_binding(b);
+                return NULL;
+        }
+
+        for (i = 0; i < m->opts.queue_depth; i++)
+                b->free_writes[b->nr_free++] = b->writes + i;
+
+        return b;
+}
+
+int merge_bind_device(struct merge *m, struct journal_device *dev, const char *dev_path)
+{
+        int fd;
+        struct binding **bindings, *b;
+
+        if (find_binding(m, dev))
+                return 0;
+
+        fd = open(dev_path, O_WRONLY | O_DIRECT);
+        if (fd < 0 && errno == EINVAL) {
+                info("merge: %s doesn't support O_DIRECT, writing it buffered", dev_path);
+                fd = open(dev_path, O_WRONLY);
+        }
+
+        if (fd < 0) {
+                error("merge: couldn't open %s: %s", dev_path, strerror(errno));
+                return 0;
+        }
+
+        if ((fcntl(fd, F_GETFL) & O_DIRECT) && !direct_aligned(fd)) {
+                info("merge: %s may not take sector aligned O_DIRECT writes, writing it buffered",
+                     dev_path);
+                if (fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT)) {
+                        error("merge: couldn't clear O_DIRECT on %s: %s", dev_path, strerror(errno));
+                        close(fd);
+                        return 0;
+                }
+        }
+
+        bindings = realloc(m->bindings, sizeof(*bindings) * (m->nr_bindings + 1));
+        if (!bindings) {
+                close(fd);
+                return 0;
+        }
+        m->bindings = bindings;
+
+        b = create_binding(m, dev, fd);
+        if (!b) {
+                close(fd);
+                return 0;
+        }
+
+        m->bindings[m->nr_bindings++] = b;
+        return 1;
+}
+
+struct journal_replayer *merge_get_replayer(struct merge *m)
+{
+        return &m->replayer;
+}
+
+struct journal_parallel_replayer *merge_get_parallel_replayer(struct merge *m)
+{
+        return &m->parallel;
+}
+
+int merge_flush(struct merge *m)
+{
+        unsigned i;
+        int r = !m->failed;
+        struct binding *b;
+
+        for (i = 0; r && i < m->nr_bindings; i++) {
+                b = m->bindings[i];
+                if (!write_batch(b))
+                        r = 0;
+
+                else if (fdatasync(b->fd)) {
+                        error("merge: couldn't sync %s: %s",
+                              journal_device_name(b->dev), strerror(errno));
+                        b->failed = 1;
+                        r = 0;
+                }
+        }
+
+        if (r) {
+                pthread_mutex_lock(&m->lock);
+                m->stats.syncs++;
+                pthread_mutex_unlock(&m->lock);
+        }
+
+        return r;
+}
+
+void merge_get_stats(struct merge *m, struct merge_stats *stats)
+{
+        pthread_mutex_lock(&m->lock);
+        *stats = m->stats;
+        pthread_mutex_unlock(&m->lock);
+}
+
+/*----------------------------------------------------------------*/
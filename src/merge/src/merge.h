@@ -1,15 +1,115 @@
 #ifndef MERGE_MERGE_H
 #define MERGE_MERGE_H
 
+#include "journal/journal.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
 /*----------------------------------------------------------------*/
 
+/*
+ * The merge engine writes replayed transactions out to the devices they
+ * belong to.  It's a journal_replayer: replayed ios are copied into
+ * their device's batch, where they're sorted by sector, later writes
+ * replace whatever they overlap, and adjacent ranges are joined.  Once
+ * a device's batch holds |batch_size| bytes, or it's flushed, each run
+ * of adjacent sectors goes to the device as a single vectored write of
+ * up to |max_write| bytes, with up to |queue_depth| writes in flight to
+ * each device, using io_uring.  Where io_uring isn't available the
+ * writes are made one at a time with pwritev(2).
+ *
+ * Each device has a batch and a ring of its own, so the devices can be
+ * merged side by side, see merge_get_parallel_replayer().
+ *
+ * Devices are opened O_DIRECT, falling back to buffered where that
+ * isn't supported, eg, for files on tmpfs, or where the device needs
+ * writes aligned to more than the journal's sectors.
+ *
+ * Merging competes with the journal for the disks, so writes are paced
+ * to a rate, shared by all the devices, that's adjusted every
+ * |adjust_ms|.  While the journal's
+ * commits take longer than |target_commit_us| on average, or the
+ * merge's writes longer than |target_write_us|, the rate is halved;
+ * otherwise it goes up by a sixteenth of |max_rate|.  It never drops
+ * below |min_rate|, and that floor rises to |max_rate| as the journal
+ * fills from |low_fill| to |high_fill| percent of its capacity, so a
+ * journal that's nearly full is merged flat out, whatever the
+ * latencies.  A target of 0 is ignored, and a journal without a
+ * capacity never fills.  Rates are in bytes a second.
+ */
+
 struct merge;
 
-struct merge *merge_create(struct journal *j);
+struct merge_options {
+        unsigned queue_depth;
+        size_t batch_size;
+        size_t max_write;
+
+        uint64_t min_rate;
+        uint64_t max_rate;
+        unsigned target_commit_us;
+        unsigned target_write_us;
+        unsigned low_fill;
+        unsigned high_fill;
+        unsigned adjust_ms;
+};
+
+struct merge_stats {
+        uint64_t ios;           /* replayed ios taken in */
+        uint64_t bytes;         /* of data they held, uncompressed */
+        uint64_t superseded;    /* bytes overwritten while they were in a batch */
+
+        uint64_t batches;
+        uint64_t writes;        /* issued to the devices */
+        uint64_t written;       /* bytes */
+        uint64_t write_ns;      /* total time from issue to completion, less pacing */
+        uint64_t syncs;
+
+        /* the rate controller's decisions, and what they were based on */
+        uint64_t rate;
+        uint64_t paced_ns;      /* spent holding writes back */
+        uint64_t speedups;
+        uint64_t backoffs;
+        uint64_t flat_out;      /* decisions made because the journal was full */
+        unsigned fill;          /* percent of the journal's capacity */
+        uint64_t commit_latency_ns;     /* averages since the decision before */
+        uint64_t write_latency_ns;
+};
+
+void merge_options_init(struct merge_options *opts);
+
+/* |opts| may be NULL for the defaults */
+struct merge *merge_create(struct journal *j, struct merge_options *opts);
+
+/* Anything that hasn't been flushed is forgotten, it's still in the journal */
 void merge_destroy(struct merge *m);
 
+/*
+ * Replayed ios for |dev| are written to |dev_path|, a block device or a
+ * file, which must already exist.  Ios for a device that hasn't been
+ * bound fail the merge.
+ */
 int merge_bind_device(struct merge *m, struct journal_device *dev, const char *dev_path);
-struct journal_replayer* merge_get_replayer(struct merge *m);
+
+/* Replays every device, from one thread at a time */
+struct journal_replayer *merge_get_replayer(struct merge *m);
+
+/*
+ * For journal_replay_parallel(): each device gets its own binding's
+ * replayer, so the devices are merged on threads of their own.  Don't
+ * use it and merge_get_replayer() at the same time.
+ */
+struct journal_parallel_replayer *merge_get_parallel_replayer(struct merge *m);
+
+/*
+ * Writes out every device's batch, and syncs them.  Once it returns
+ * everything replayed so far is on the devices, so it can be dropped
+ * from the journal.  Fails if any write has.
+ */
+int merge_flush(struct merge *m);
+
+void merge_get_stats(struct merge *m, struct merge_stats *stats);
 
 /*----------------------------------------------------------------*/
 
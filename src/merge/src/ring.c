@@ -0,0 +1,278 @@
+#include "ring.h"
+
+#include "log/log.h"
+
+#include <errno.h>
+#include <linux/io_uring.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------*/
+
+struct ring {
+        unsigned depth;
+        unsigned outstanding;
+        int fd;                 /* -1 when writes are synchronous */
+
+        /* submission queue */
+        void *sq_map;
+        size_t sq_map_len;
+        unsigned *sq_head;
+        unsigned *sq_tail;
+        unsigned sq_mask;
+        unsigned *sq_array;
+        struct io_uring_sqe *sqes;
+        size_t sqes_len;
+        unsigned to_submit;
+
+        /* completion queue, which may share the submission queue's mapping */
+        void *cq_map;
+        size_t cq_map_len;
+        unsigned *cq_head;
+        unsigned *cq_tail;
+        unsigned cq_mask;
+        struct io_uring_cqe *cqes;
+
+        /* synchronous writes completed, but not yet waited for */
+        struct ring_completion *done;
+        unsigned nr_done;
+};
+
+static int setup_ring(struct ring *r)
+{
+        struct io_uring_params p;
+        unsigned char *sq, *cq;
+
+        memset(&p, 0, sizeof(p));
+        r->fd = syscall(__NR_io_uring_setup, r->depth, &p);
+        if (r->fd < 0)
+                return 0;
+
+        r->sq_map_len = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+        r->cq_map_len = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+        if (p.features & IORING_FEAT_SINGLE_MMAP) {
+                if (r->cq_map_len > r->sq_map_len)
+                        r->sq_map_len = r->cq_map_len;
+                r->cq_map_len = 0;
+        }
+
+        r->sq_map = mmap(NULL, r->sq_map_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                         r->fd, IORING_OFF_SQ_RING);
+        if (r->sq_map == MAP_FAILED)
+                return 0;
+
+        if (r->cq_map_len) {
+                r->cq_map = mmap(NULL, r->cq_map_len, PROT_READ | PROT_WRITE,
+                                 MAP_SHARED | MAP_POPULATE, r->fd, IORING_OFF_CQ_RING);
+                if (r->cq_map == MAP_FAILED) {
+                        r->cq_map = NULL;
+                        return 0;
+                }
+        }
+
+        r->sqes_len = p.sq_entries * sizeof(struct io_uring_sqe);
+        r->sqes = mmap(NULL, r->sqes_len, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                       r->fd, IORING_OFF_SQES);
+        if (r->sqes == MAP_FAILED) {
+                r->sqes = NULL;
+                return 0;
+        }
+
+        sq = r->sq_map;
+        r->sq_head = (unsigned *) (sq + p.sq_off.head);
+        r->sq_tail = (unsigned *) (sq + p.sq_off.tail);
+        r->sq_mask = *(unsigned *) (sq + p.sq_off.ring_mask);
+        r->sq_array = (unsigned *) (sq + p.sq_off.array);
+
+        cq = r->cq_map ? r->cq_map : r->sq_map;
+        r->cq_head = (unsigned *) (cq + p.cq_off.head);
+        r->cq_tail = (unsigned *) (cq + p.cq_off.tail);
+        r->cq_mask = *(unsigned *) (cq + p.cq_off.ring_mask);
+        r->cqes = (struct io_uring_cqe *) (cq + p.cq_off.cqes);
+
+        /* the kernel rounds the depth up to a power of two */
+        return p.sq_entries >= r->depth && p.cq_entries >= r->depth;
+}
+
+static void teardown_ring(struct ring *r)
+{
+        if (r->sqes)
+                munmap(r->sqes, r->sqes_len);
+        if (r->cq_map)
+                munmap(r->cq_map, r->cq_map_len);
+        if (r->sq_map && r->sq_map != MAP_FAILED)
+                munmap(r->sq_map, r->sq_map_len);
+        if (r->fd >= 0)
+                close(r->fd);
+
+        r->sqes = NULL;
+        r->cq_map = r->sq_map = NULL;
+        r->fd = -1;
+}
+
+struct ring *ring_create(unsigned depth)
+{
+        struct ring *r;
+
+        if (!depth)
+                return NULL;
+
+        r = malloc(sizeof(*r));
+        if (!r)
+                return NULL;
+
+        memset(r, 0, sizeof(*r));
+        r->depth = depth;
+        if (!setup_ring(r)) {
+                info("io_uring isn't available (%s), writing synchronously", strerror(errno));
+                teardown_ring(r);
+
+                r->done = malloc(sizeof(*r->done) * depth);
+                if (!r->done) {
+                        free(r);
+                        return NULL;
+                }
+        }
+
+        return r;
+}
+
+void ring_destroy(struct ring *r)
+{
+        struct ring_completion done[16];
+
+        /* the kernel may still be reading the iovecs */
+        while (r->outstanding && ring_wait(r, r->outstanding, done, 16) >= 0)
+                ;
+
+        teardown_ring(r);
+        free(r->done);
+        free(r);
+}
+
+int ring_async(struct ring *r)
+{
+        return r->fd >= 0;
+}
+
+unsigned ring_outstanding(struct ring *r)
+{
+        return r->outstanding;
+}
+
+/* Anything the kernel won't take now is left for ring_wait() */
+static void submit(struct ring *r)
+{
+        int ret;
+
+        do {
+                ret = syscall(__NR_io_uring_enter, r->fd, r->to_submit, 0, 0, NULL, 0);
+        } while (ret < 0 && errno == EINTR);
+
+        if (ret > 0)
+                r->to_submit -= ret;
+}
+
+int ring_writev(struct ring *r, int fd, const struct iovec *iov, unsigned nr_iov,
+                uint64_t offset, void *context)
+{
+        unsigned tail, index;
+        ssize_t n;
+        struct io_uring_sqe *sqe;
+
+        if (r->outstanding == r->depth)
+                return 0;
+
+        if (!ring_async(r)) {
+                do {
+                        n = pwritev(fd, iov, nr_iov, offset);
+                } while (n < 0 && errno == EINTR);
+
+                r->done[r->nr_done].context = context;
+                r->done[r->nr_done].result = (n < 0) ? -errno : (int) n;
+                r->nr_done++;
+                r->outstanding++;
+                return 1;
+        }
+
+        tail = *r->sq_tail;
+        index = tail & r->sq_mask;
+        sqe = r->sqes + index;
+
+        memset(sqe, 0, sizeof(*sqe));
+        sqe->opcode = IORING_OP_WRITEV;
+        sqe->fd = fd;
+        sqe->addr = (uint64_t) (uintptr_t) iov;
+        sqe->len = nr_iov;
+        sqe->off = offset;
+        sqe->user_data = (uint64_t) (uintptr_t) context;
+
+        r->sq_array[index] = index;
+        __atomic_store_n(r->sq_tail, tail + 1, __ATOMIC_RELEASE);
+        r->to_submit++;
+        r->outstanding++;
+        submit(r);
+        return 1;
+}
+
+static unsigned reap(struct ring *r, struct ring_completion *done, unsigned max)
+{
+        unsigned n = 0, head = *r->cq_head;
+        unsigned tail = __atomic_load_n(r->cq_tail, __ATOMIC_ACQUIRE);
+        struct io_uring_cqe *cqe;
+
+        while (head != tail && n < max) {
+                cqe = r->cqes + (head & r->cq_mask);
+                done[n].context = (void *) (uintptr_t) cqe->user_data;
+                done[n].result = cqe->res;
+                n++;
+                head++;
+        }
+        __atomic_store_n(r->cq_head, head, __ATOMIC_RELEASE);
+
+        r->outstanding -= n;
+        return n;
+}
+
+int ring_wait(struct ring *r, unsigned min, struct ring_completion *done, unsigned max)
+{
+        int ret;
+        unsigned n;
+
+        if (min > r->outstanding)
+                min = r->outstanding;
+        if (min > max)
+                min = max;
+
+        if (!ring_async(r)) {
+                n = (r->nr_done < max) ? r->nr_done : max;
+                memcpy(done, r->done, sizeof(*done) * n);
+                memmove(r->done, r->done + n, sizeof(*done) * (r->nr_done - n));
+                r->nr_done -= n;
+                r->outstanding -= n;
+                return n;
+        }
+
+        n = reap(r, done, max);
+        while (r->to_submit || n < min) {
+                ret = syscall(__NR_io_uring_enter, r->fd, r->to_submit, (n < min) ? min - n : 0,
+                              (n < min) ? IORING_ENTER_GETEVENTS : 0, NULL, 0);
+                if (ret < 0) {
+                        if (errno == EINTR || errno == EAGAIN || errno == EBUSY)
+                                continue;
+
+                        error("io_uring_enter failed: %s", strerror(errno));
+                        return -1;
+                }
+
+                r->to_submit -= ret;
+                n += reap(r, done + n, max - n);
+        }
+
+        return n;
+}
+
+/*----------------------------------------------------------------*/
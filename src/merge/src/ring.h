@@ -0,0 +1,51 @@
+#ifndef MERGE_RING_H
+#define MERGE_RING_H
+
+#include <stdint.h>
+#include <sys/uio.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Just enough of io_uring for vectored writes, driven through the
+ * system calls, so nothing more than the kernel headers is needed.  If
+ * the kernel won't set up a ring the writes are made synchronously
+ * instead, and completed by the next ring_wait().
+ *
+ * Up to |depth| writes may be outstanding; the iovecs have to stay put
+ * until the write's completed.  A ring is only used by one thread.
+ */
+struct ring;
+
+struct ring_completion {
+        void *context;
+        int result;             /* bytes written, or -errno */
+};
+
+struct ring *ring_create(unsigned depth);
+void ring_destroy(struct ring *r);
+
+/* 0 if writes are being done synchronously */
+int ring_async(struct ring *r);
+
+unsigned ring_outstanding(struct ring *r);
+
+/*
+ * Starts the write straight away, so its time in the kernel doesn't
+ * depend on when the caller next waits.  Fails if |depth| writes are
+ * already outstanding.
+ */
+int ring_writev(struct ring *r, int fd, const struct iovec *iov, unsigned nr_iov,
+                uint64_t offset, void *context);
+
+/*
+ * Submits anything the kernel couldn't take earlier, and waits for at
+ * least |min| writes to complete, or as many as are outstanding.  Up to
+ * |max| completions are put in |done|.  Returns how many, or -1 if the
+ * ring has failed.
+ */
+int ring_wait(struct ring *r, unsigned min, struct ring_completion *done, unsigned max);
+
+/*----------------------------------------------------------------*/
+
+#endif
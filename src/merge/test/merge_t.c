@@ -0,0 +1,454 @@
+#include "merge/merge.h"
+#include "journal/journal.h"
+#include "log/log.h"
+
+#include <assert.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/*----------------------------------------------------------------*/
+
+enum {
+        BLOCK_SIZE = 4096,
+        SECTORS = BLOCK_SIZE >> JOURNAL_SECTOR_SHIFT,
+        DEV_SIZE = 1024 * 1024,
+        NR_DEVS = 2
+};
+
+static char dir_[] = "/tmp/merge_t.XXXXXX";
+static char journal_dir_[64];
+static char dev_paths_[NR_DEVS][64];
+
+/* what the devices should hold */
+static unsigned char images_[NR_DEVS][DEV_SIZE];
+
+static void remove_journal()
+{
+        char cmd[128];
+
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", journal_dir_);
+        assert(!system(cmd));
+}
+
+/* Both devices start out full of 0xee, so writing zeroes shows */
+static void create_devices()
+{
+        int fd;
+        unsigned i;
+
+        for (i = 0; i < NR_DEVS; i++) {
+                memset(images_[i], 0xee, DEV_SIZE);
+                fd = open(dev_paths_[i], O_WRONLY | O_CREAT | O_TRUNC, 0644);
+                assert(fd >= 0);
+                assert(write(fd, images_[i], DEV_SIZE) == DEV_SIZE);
+                close(fd);
+        }
+}
+
+static void check_devices()
+{
+        int fd;
+        unsigned i;
+        static unsigned char data[DEV_SIZE];
+
+        for (i = 0; i < NR_DEVS; i++) {
+                fd = open(dev_paths_[i], O_RDONLY);
+                assert(fd >= 0);
+                assert(read(fd, data, DEV_SIZE) == DEV_SIZE);
+                close(fd);
+                assert(!memcmp(data, images_[i], DEV_SIZE));
+        }
+}
+
+static void remove_devices()
+{
+        unsigned i;
+
+        for (i = 0; i < NR_DEVS; i++)
+                unlink(dev_paths_[i]);
+}
+
+static void notify(void *context)
+{
+        (*((unsigned *) context))++;
+}
+
+/*
+ * Commits a write of |count| blocks at |sector| of device |d|, zeroes
+ * if |seed| is 0, and waits for it to be durable.
+ */
+static uint64_t commit_write(struct journal *j, struct journal_device **devs, unsigned d,
+                             uint64_t sector, unsigned count, unsigned seed)
+{
+        unsigned i, notified = 0;
+        uint64_t id;
+        size_t len = count * BLOCK_SIZE;
+        unsigned char *data = malloc(len);
+        struct journal_io io;
+        struct journal_transaction *t = journal_begin(j);
+        struct thunk th = { notify, &notified };
+
+        assert(t && data);
+        for (i = 0; i < len; i++)
+                data[i] = seed ? (seed * 31 + i) & 0xff : 0;
+
+        io.dev = devs[d];
+        io.start_sector = sector;
+        io.end_sector = sector + count * SECTORS;
+        io.codec = 0;
+        io.len = seed ? len : 0;
+        io.data = seed ? data : NULL;
+        assert(journal_record_io(t, &io));
+        assert(journal_commit(t, &th, &id));
+        while (!*((volatile unsigned *) &notified))
+                usleep(100);
+
+        memcpy(images_[d] + (sector << JOURNAL_SECTOR_SHIFT), data, len);
+        free(data);
+        return id;
+}
+
+/* Replays everything in the journal, and drops it */
+static void replay_all(struct journal *j, struct merge *m)
+{
+        unsigned i, count = journal_transaction_count(j);
+        uint64_t id;
+
+        for (i = 0; i < count; i++)
+                assert(journal_transaction_replay_front(j, i, merge_get_replayer(m)));
+
+        if (count) {
+                assert(journal_transaction_front(j, count - 1, &id));
+                journal_drop(j, id);
+        }
+}
+
+static struct journal *open_journal(struct journal_device **devs, struct journal_options *opts)
+{
+        unsigned i;
+        char name[16];
+        struct journal *j = journal_create(journal_dir_, opts);
+
+        assert(j);
+        for (i = 0; i < NR_DEVS; i++) {
+                snprintf(name, sizeof(name), "dev%u", i);
+                devs[i] = journal_register_device(j, name);
+                assert(devs[i]);
+        }
+
+        return j;
+}
+
+static struct merge *open_merge(struct journal *j, struct journal_device **devs,
+                                struct merge_options *opts)
+{
+        unsigned i;
+        struct merge *m = merge_create(j, opts);
+
+        assert(m);
+        for (i = 0; i < NR_DEVS; i++)
+                assert(merge_bind_device(m, devs[i], dev_paths_[i]));
+        assert(!merge_bind_device(m, devs[0], dev_paths_[1]));
+
+        return m;
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Adjacent ios go out as one write, and sectors overwritten while
+ * they're in the batch are only written once.
+ */
+void test_merge()
+{
+        unsigned i;
+        struct merge_stats stats;
+        struct journal_device *devs[NR_DEVS];
+        struct journal *j = open_journal(devs, NULL);
+        struct merge *m;
+
+        create_devices();
+        m = open_merge(j, devs, NULL);
+        for (i = 0; i < 64; i++)
+                commit_write(j, devs, 0, i * SECTORS, 1, i + 1);
+        commit_write(j, devs, 1, 64, 4, 100);
+        replay_all(j, m);
+
+        /* overwrites the middle of what's already in the batch */
+        commit_write(j, devs, 0, 8 * SECTORS, 2, 200);
+        commit_write(j, devs, 1, 72, 1, 0);
+        replay_all(j, m);
+
+        assert(merge_flush(m));
+        check_devices();
+
+        merge_get_stats(m, &stats);
+        assert(stats.ios == 67);
+        assert(stats.bytes == 71 * BLOCK_SIZE);
+        assert(stats.superseded == 3 * BLOCK_SIZE);
+        assert(stats.batches == NR_DEVS);
+        assert(stats.writes == 2);
+        assert(stats.written == 68 * BLOCK_SIZE);
+        assert(stats.syncs == 1);
+
+        /* nothing left to write */
+        assert(merge_flush(m));
+        merge_get_stats(m, &stats);
+        assert(stats.writes == 2 && stats.syncs == 2);
+
+        merge_destroy(m);
+        journal_destroy(j);
+        remove_journal();
+}
+
+/*
+ * With a small batch, short writes and one write in flight at a time,
+ * it all still ends up on the devices.
+ */
+void test_small_batches()
+{
+        unsigned i;
+        uint64_t sector;
+        struct merge_stats stats;
+        struct merge_options opts;
+        struct journal_device *devs[NR_DEVS];
+        struct journal *j = open_journal(devs, NULL);
+        struct merge *m;
+
+        merge_options_init(&opts);
+        opts.queue_depth = 1;
+        opts.batch_size = 16 * BLOCK_SIZE;
+        opts.max_write = 3 * BLOCK_SIZE;
+
+        create_devices();
+        m = open_merge(j, devs, &opts);
+        for (i = 0; i < 256; i++) {
+                sector = ((i * 37) % (DEV_SIZE / BLOCK_SIZE - 4)) * SECTORS;
+                commit_write(j, devs, i % NR_DEVS, sector, 1 + i % 4, (i % 7) ? i + 1 : 0);
+                if (i % 16 == 15)
+                        replay_all(j, m);
+        }
+
+        assert(merge_flush(m));
+        check_devices();
+
+        merge_get_stats(m, &stats);
+        assert(stats.batches > 1);
+        assert(stats.writes * 3 * BLOCK_SIZE >= stats.written);
+
+        merge_destroy(m);
+        journal_destroy(j);
+        remove_journal();
+}
+
+/* Ios for a device that hasn't been bound fail the flush */
+void test_unbound()
+{
+        struct journal_device *devs[NR_DEVS];
+        struct journal *j = open_journal(devs, NULL);
+        struct merge *m;
+
+        create_devices();
+        m = merge_create(j, NULL);
+        assert(m);
+        assert(merge_bind_device(m, devs[0], dev_paths_[0]));
+        assert(!merge_bind_device(m, devs[1], "/nonexistent/dev1"));
+
+        commit_write(j, devs, 1, 0, 1, 1);
+        replay_all(j, m);
+        assert(!merge_flush(m));
+
+        merge_destroy(m);
+        journal_destroy(j);
+        remove_journal();
+}
+
+/*
+ * Replayed in parallel, each device is merged on a thread of its own,
+ * from its own batch.
+ */
+void test_parallel()
+{
+        unsigned i, count;
+        uint64_t id;
+        struct merge_stats stats;
+        struct merge_options opts;
+        struct journal_device *devs[NR_DEVS];
+        struct journal *j = open_journal(devs, NULL);
+        struct merge *m;
+
+        merge_options_init(&opts);
+        opts.batch_size = 16 * BLOCK_SIZE;
+
+        create_devices();
+        m = open_merge(j, devs, &opts);
+        for (i = 0; i < 128; i++)
+                commit_write(j, devs, i % NR_DEVS, ((i * 37) % 128) * SECTORS, 1 + i % 3,
+                             (i % 5) ? i + 1 : 0);
+
+        count = journal_transaction_count(j);
+        assert(journal_replay_parallel(j, count, merge_get_parallel_replayer(m)) == count);
+        assert(merge_flush(m));
+        check_devices();
+        assert(journal_transaction_front(j, count - 1, &id));
+        journal_drop(j, id);
+
+        merge_get_stats(m, &stats);
+        /* replay leaves out ios whose sectors were all overwritten later */
+        assert(stats.ios && stats.ios <= 128);
+        assert(stats.batches > NR_DEVS);
+        merge_destroy(m);
+
+        /* a device that isn't bound stops the replay, and fails the flush */
+        commit_write(j, devs, 1, 0, 1, 1);
+        m = merge_create(j, NULL);
+        assert(m);
+        assert(merge_bind_device(m, devs[0], dev_paths_[0]));
+        assert(journal_replay_parallel(j, 1, merge_get_parallel_replayer(m)) == 0);
+        assert(!merge_flush(m));
+
+        merge_destroy(m);
+        journal_destroy(j);
+        remove_journal();
+}
+
+/*
+ * Writes that take longer than the target slow the merge down to its
+ * minimum rate, unless the journal is full, when it goes flat out.
+ */
+void test_rate_control()
+{
+        unsigned i, count;
+        uint64_t id;
+        struct merge_stats stats;
+        struct merge_options opts;
+        struct journal_options jopts;
+        struct journal_device *devs[NR_DEVS];
+        struct journal *j = open_journal(devs, NULL);
+        struct merge *m;
+
+        merge_options_init(&opts);
+        opts.queue_depth = 1;
+        opts.batch_size = 4 * BLOCK_SIZE;
+        opts.max_write = BLOCK_SIZE;
+        opts.min_rate = 1024 * 1024;
+        opts.max_rate = 64 * 1024 * 1024;
+        opts.target_commit_us = 0;
+        opts.target_write_us = 1;
+        opts.adjust_ms = 1;
+
+        create_devices();
+        m = open_merge(j, devs, &opts);
+        for (i = 0; i < 64; i++)
+                commit_write(j, devs, i % NR_DEVS, i * 2 * SECTORS, 1, i + 1);
+        replay_all(j, m);
+        assert(merge_flush(m));
+        check_devices();
+
+        merge_get_stats(m, &stats);
+        assert(stats.backoffs > 0);
+        assert(stats.paced_ns > 0);
+        assert(stats.fill == 0);
+        assert(stats.rate < opts.max_rate);
+
+        merge_destroy(m);
+        journal_destroy(j);
+        remove_journal();
+
+        /* the journal's already over its capacity */
+        journal_options_init(&jopts);
+        jopts.capacity = 16 * BLOCK_SIZE;
+        j = open_journal(devs, &jopts);
+
+        create_devices();
+        m = open_merge(j, devs, &opts);
+        for (i = 0; i < 64; i++)
+                commit_write(j, devs, i % NR_DEVS, i * 2 * SECTORS, 1, i + 1);
+
+        /* it's not dropped until it's on the devices, so it stays full */
+        count = journal_transaction_count(j);
+        for (i = 0; i < count; i++)
+                assert(journal_transaction_replay_front(j, i, merge_get_replayer(m)));
+        assert(merge_flush(m));
+        check_devices();
+        assert(journal_transaction_front(j, count - 1, &id));
+        journal_drop(j, id);
+
+        merge_get_stats(m, &stats);
+        assert(stats.fill == 100);
+        assert(stats.flat_out > 0);
+        assert(stats.backoffs == 0);
+        assert(stats.rate == opts.max_rate);
+
+        merge_destroy(m);
+        journal_destroy(j);
+        remove_journal();
+}
+
+/*
+ * With the default targets a fast device keeps up, even while the rate
+ * is so low that the merge sleeps for longer than the write target
+ * between writes.
+ */
+void test_default_targets()
+{
+        unsigned i;
+        struct merge_stats stats;
+        struct merge_options opts;
+        struct journal_device *devs[NR_DEVS];
+        struct journal *j = open_journal(devs, NULL);
+        struct merge *m;
+
+        merge_options_init(&opts);
+        opts.queue_depth = 2;
+        opts.max_write = 16 * BLOCK_SIZE;
+        opts.min_rate = 1024 * 1024;
+
+        create_devices();
+        for (i = 0; i < 2 * DEV_SIZE / opts.max_write; i++)
+                commit_write(j, devs, i % NR_DEVS, (i / NR_DEVS) * 16 * SECTORS, 16, i + 1);
+
+        m = open_merge(j, devs, &opts);
+        replay_all(j, m);
+        assert(merge_flush(m));
+        check_devices();
+
+        merge_get_stats(m, &stats);
+        assert(stats.writes == 2 * DEV_SIZE / opts.max_write);
+        assert(stats.paced_ns > 0);
+        assert(stats.speedups > 0);
+        assert(stats.backoffs == 0);
+
+        merge_destroy(m);
+        journal_destroy(j);
+        remove_journal();
+}
+
+int main(int argc, char **argv)
+{
+        unsigned i;
+
+        assert(mkdtemp(dir_));
+        snprintf(journal_dir_, sizeof(journal_dir_), "%s/journal", dir_);
+        for (i = 0; i < NR_DEVS; i++)
+                snprintf(dev_paths_[i], sizeof(dev_paths_[i]), "%s/dev%u", dir_, i);
+        log_init(dir_, DEBUG, DEBUG);
+
+        test_merge();
+        test_small_batches();
+        test_unbound();
+        test_parallel();
+        test_rate_control();
+        test_default_targets();
+
+        log_exit();
+        remove_devices();
+        snprintf(journal_dir_, sizeof(journal_dir_), "%s/log.log", dir_);
+        unlink(journal_dir_);
+        rmdir(dir_);
+        return 0;
+}
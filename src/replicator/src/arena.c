@@ -0,0 +1,163 @@
+#include "arena.h"
+
+#include "csp/io.h"
+#include "log/log.h"
+#include "server_stats.h"
+#include "utility/dynamic_buffer.h"
+
+/*----------------------------------------------------------------*/
+
+enum {
+        POOL_CHUNK = 1024,
+        RESPONSE_HINT = 128
+};
+
+struct request_arena *arena_create(size_t buffer_size)
+{
+        struct request_arena *a = malloc(sizeof(*a));
+
+        if (!a)
+                return NULL;
+
+        a->chunk_size = POOL_CHUNK;
+        a->largest = 0;
+        a->mem = pool_create("request arena", a->chunk_size);
+        a->in = dynamic_buffer_create(buffer_size);
+        a->header = xdr_buffer_create(sizeof(msg_header));
+        a->body = xdr_buffer_create(RESPONSE_HINT);
+        a->out = dynamic_buffer_create(RESPONSE_HINT);
+
+        if (!a->mem || !a->in || !a->header || !a->body || !a->out) {
+                arena_destroy(a);
+                return NULL;
+        }
+
+        return a;
+}
+
+void arena_destroy(struct request_arena *a)
+{
+        if (a->mem)
+                pool_destroy(a->mem);
+        if (a->in)
+                dynamic_buffer_destroy(a->in);
+        if (a->header)
+                xdr_buffer_destroy(a->header);
+        if (a->body)
+                xdr_buffer_destroy(a->body);
+        if (a->out)
+                dynamic_buffer_destroy(a->out);
+        free(a);
+}
+
+void *arena_input(struct request_arena *a, size_t len)
+{
+        if (len > a->largest)
+                a->largest = len;
+
+        return dynamic_buffer_get(a->in, len);
+}
+
+void *arena_frame_response(struct request_arena *a, uint32_t req_id,
+                           response *resp, size_t *len)
+{
+        msg_header header;
+        size_t header_len;
+        unsigned char *frame;
+
+        xdr_buffer_reset(a->header);
+        xdr_buffer_reset(a->body);
+
+        if (!xdr_pack_response(a->body, resp))
+                return NULL;
+
+        header.request_id = req_id;
+        header.msg_size = xdr_buffer_size(a->body);
+        if (!xdr_pack_msg_header(a->header, &header))
+                return NULL;
+
+        header_len = xdr_buffer_size(a->header);
+        *len = header_len + header.msg_size;
+        frame = dynamic_buffer_get(a->out, *len);
+        if (!frame)
+                return NULL;
+
+        xdr_buffer_copy(a->header, frame);
+        xdr_buffer_copy(a->body, frame + header_len);
+
+        return frame;
+}
+
+/*
+ * An unpacked request is about the size of the raw one, since opaque
+ * data is copied into the pool.  The pool only keeps a single spare
+ * chunk, so a request that spills out of the first chunk would malloc
+ * every time round.  Instead we grow the pool so a whole request, and
+ * the bits allocated while answering it, fit in one chunk.
+ */
+void arena_recycle(struct request_arena *a)
+{
+        struct pool *mem;
+        size_t needed = a->largest + POOL_CHUNK;
+
+        a->largest = 0;
+        if (needed > a->chunk_size) {
+                mem = pool_create("request arena", needed);
+                if (mem) {
+                        pool_destroy(a->mem);
+                        a->mem = mem;
+                        a->chunk_size = needed;
+                        return;
+                }
+        }
+
+        pool_empty(a->mem);
+}
+
+int arena_read_request(struct request_arena *a, int fd, struct credit *credit,
+                       command **cmd, uint32_t *req_id, uint32_t *len, uint64_t *arrived)
+{
+        void *data;
+        msg_header header_raw, *header;
+
+        if (csp_read_exact(fd, &header_raw, sizeof(header_raw)) < 0)
+                return 0;
+
+        *arrived = stats_now();
+
+        if (!xdr_unpack_using(msg_header_alloc, &header_raw, sizeof(header_raw), a->mem, &header))
+                return 0;
+
+        if (!credit_charge(credit, header->msg_size)) {
+                warn("client overran its flow control window (%u byte request)",
+                     (unsigned) header->msg_size);
+                return 0;
+        }
+
+        data = arena_input(a, header->msg_size);
+        if (!data)
+                return 0;
+
+        if (csp_read_exact(fd, data, header->msg_size) < 0)
+                return 0;
+
+        if (!xdr_unpack_using(command_alloc, data, header->msg_size, a->mem, cmd))
+                return 0;
+
+        *req_id = header->request_id;
+        *len = header->msg_size;
+        return 1;
+}
+
+int arena_write_response(struct request_arena *a, int fd, uint32_t req_id, response *resp)
+{
+        size_t len;
+        void *frame = arena_frame_response(a, req_id, resp, &len);
+
+        if (!frame)
+                return 0;
+
+        return csp_write_exact(fd, frame, len) >= 0;
+}
+
+/*----------------------------------------------------------------*/
@@ -0,0 +1,61 @@
+#ifndef REPLICATOR_ARENA_H
+#define REPLICATOR_ARENA_H
+
+#include "credit.h"
+#include "protocol.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Everything a connection needs to read, unpack, and answer a request.
+ * It's recycled between requests rather than freed, so once a
+ * connection has seen its largest messages the request path doesn't
+ * call malloc at all.
+ */
+struct request_arena {
+        struct pool *mem;               /* unpacked requests, emptied by arena_recycle() */
+        struct dynamic_buffer *in;      /* the raw request */
+        struct xdr_buffer *header;
+        struct xdr_buffer *body;
+        struct dynamic_buffer *out;     /* the framed response */
+
+        size_t chunk_size;              /* of |mem| */
+        size_t largest;                 /* raw request seen since the last recycle */
+};
+
+struct request_arena *arena_create(size_t buffer_size);
+void arena_destroy(struct request_arena *a);
+
+/* Space for a raw request of |len| bytes */
+void *arena_input(struct request_arena *a, size_t len);
+
+/*
+ * Packs a response with its msg_header in front, ready to write.  The
+ * frame is valid until the next call.
+ */
+void *arena_frame_response(struct request_arena *a, uint32_t req_id,
+                           response *resp, size_t *len);
+
+/* Everything from the last request is finished with */
+void arena_recycle(struct request_arena *a);
+
+/*
+ * The request path, shared by the server and the test that checks it
+ * doesn't allocate.
+ *
+ * Reads a request from |fd| and unpacks it into the arena.  It's
+ * charged to |credit| once the header's in, before the payload's
+ * buffered; a client that's overrun its window fails the read.
+ * |arrived| is when the header came in, so idle time isn't counted as
+ * latency.
+ */
+int arena_read_request(struct request_arena *a, int fd, struct credit *credit,
+                       command **cmd, uint32_t *req_id, uint32_t *len, uint64_t *arrived);
+int arena_write_response(struct request_arena *a, int fd, uint32_t req_id, response *resp);
+
+/*----------------------------------------------------------------*/
+
+#endif
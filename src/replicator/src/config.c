@@ -0,0 +1,684 @@
+#include "config.h"
+
+#include "compress/compress.h"
+#include "mm/pool.h"
+
+#include <ctype.h>
+#include <errno.h>
+#include <getopt.h>
+#include <limits.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------*/
+
+enum {
+        DEFAULT_PORT = 6776,
+        DEFAULT_BACKLOG = 20,
+        DEFAULT_BUFFER_SIZE = 256 * 1024,
+        DEFAULT_MAX_MESSAGE_SIZE = 4 * 1024 * 1024,
+        DEFAULT_CREDIT_BYTES = 16 * 1024 * 1024,
+        DEFAULT_MEMORY_LIMIT = 1024 * 1024 * 1024,
+        DEFAULT_DEDUP_WINDOW = 0,
+        DEFAULT_JOURNAL_SEGMENT_SIZE = 64 * 1024 * 1024,
+        DEFAULT_JOURNAL_CHECKPOINT_INTERVAL = 256 * 1024 * 1024,
+        DEFAULT_JOURNAL_RECYCLE_SEGMENTS = 4,
+        DEFAULT_JOURNAL_LOW_WATERMARK = 60,
+        DEFAULT_JOURNAL_HIGH_WATERMARK = 90,
+        DEFAULT_JOURNAL_SPILL_THRESHOLD = 8 * 1024 * 1024,
+        MAX_LINE = 1024
+};
+
+struct config *config_create()
+{
+        int i;
+        struct pool *mem;
+        struct config *cfg;
+
+        mem = pool_create("config", 1024);
+        if (!mem)
+                return NULL;
+
+        cfg = pool_zalloc(mem, sizeof(*cfg));
+        if (!cfg) {
+                pool_destroy(mem);
+                return NULL;
+        }
+
+        cfg->mem = mem;
+        list_init(&cfg->listeners);
+        cfg->listen_backlog = DEFAULT_BACKLOG;
+        cfg->journal_dir = pool_strdup(mem, "journal");
+        cfg->journal_segment_size = DEFAULT_JOURNAL_SEGMENT_SIZE;
+        cfg->journal_mode = JOURNAL_DIRECT;
+        cfg->journal_checkpoint_interval = DEFAULT_JOURNAL_CHECKPOINT_INTERVAL;
+        cfg->journal_recycle_segments = DEFAULT_JOURNAL_RECYCLE_SEGMENTS;
+        cfg->journal_low_watermark = DEFAULT_JOURNAL_LOW_WATERMARK;
+        cfg->journal_high_watermark = DEFAULT_JOURNAL_HIGH_WATERMARK;
+        cfg->journal_spill_threshold = DEFAULT_JOURNAL_SPILL_THRESHOLD;
+        cfg->log_dir = pool_strdup(mem, ".");
+        cfg->log_level = DEBUG;
+        cfg->log_flush_level = EVENT;
+        cfg->buffer_size = DEFAULT_BUFFER_SIZE;
+        cfg->max_message_size = DEFAULT_MAX_MESSAGE_SIZE;
+        cfg->credit_bytes = DEFAULT_CREDIT_BYTES;
+        cfg->memory_limit = DEFAULT_MEMORY_LIMIT;
+        cfg->dedup_window = DEFAULT_DEDUP_WINDOW;
+
+        for (i = 0; i < CODEC_COUNT; i++)
+                if (compress_available(i))
+                        cfg->compression |= 1 << i;
+
+        if (!cfg->journal_dir || !cfg->log_dir) {
+                pool_destroy(mem);
+                return NULL;
+        }
+
+        return cfg;
+}
+
+void config_destroy(struct config *cfg)
+{
+        pool_destroy(cfg->mem);
+}
+
+/*----------------------------------------------------------------*/
+
+static int parse_uint(const char *str, unsigned *result)
+{
+        char *end;
+        unsigned long n;
+
+        errno = 0;
+        n = strtoul(str, &end, 10);
+        if (errno || end == str || *end || n > UINT_MAX)
+                return 0;
+
+        *result = n;
+        return 1;
+}
+
+/* accepts an optional k, m or g suffix */
+static int parse_size(const char *str, size_t *result)
+{
+        char *end;
+        unsigned shift = 0;
+        unsigned long long n;
+
+        /* strtoull() would take "-1" as a huge size */
+        if (!isdigit((unsigned char) *str))
+                return 0;
+
+        errno = 0;
+        n = strtoull(str, &end, 10);
+        if (errno || end == str)
+                return 0;
+
+        switch (tolower(*end)) {
+        case 'g':
+                shift += 10;
+                /* fall through */
+        case 'm':
+                shift += 10;
+                /* fall through */
+        case 'k':
+                shift += 10;
+                end++;
+                break;
+        }
+
+        if (*end || n > (SIZE_MAX >> shift))
+                return 0;
+
+        *result = n << shift;
+        return 1;
+}
+
+static int parse_level(const char *str, enum log_level *result)
+{
+        static const char *levels[FATAL + 1] = {
+                "debug",
+                "info",
+                "warn",
+                "event",
+                "error",
+                "fatal"
+        };
+
+        int i;
+        for (i = 0; i <= FATAL; i++) {
+                if (!strcasecmp(str, levels[i])) {
+                        *result = i;
+                        return 1;
+                }
+        }
+
+        return 0;
+}
+
+static int parse_listener_options(struct listener_config *lc, char *opts)
+{
+        char *opt, *save;
+
+        for (opt = strtok_r(opts, ",", &save); opt; opt = strtok_r(NULL, ",", &save)) {
+                if (!strncmp(opt, "max_connections=", 16)) {
+                        if (!parse_uint(opt + 16, &lc->max_connections))
+                                return 0;
+                } else
+                        return 0;
+        }
+
+        return 1;
+}
+
+int config_add_listener(struct config *cfg, const char *spec)
+{
+        char *copy, *opts, *port;
+        struct listener_config *lc;
+
+        copy = pool_strdup(cfg->mem, spec);
+        lc = pool_zalloc(cfg->mem, sizeof(*lc));
+        if (!copy || !lc)
+                return 0;
+
+        opts = strchr(copy, ',');
+        if (opts) {
+                *opts++ = '\0';
+                if (!parse_listener_options(lc, opts))
+                        return 0;
+        }
+
+        if (!strncmp(copy, "tcp:", 4)) {
+                lc->type = LISTENER_TCP;
+                lc->address = copy + 4;
+
+                /* the last colon, so ipv6 addresses can be given */
+                port = strrchr(lc->address, ':');
+                if (!port || port == lc->address)
+                        return 0;
+
+                *port++ = '\0';
+                if (!parse_uint(port, &lc->port) || !lc->port || lc->port > 65535)
+                        return 0;
+
+        } else if (!strncmp(copy, "unix:", 5)) {
+                lc->type = LISTENER_UNIX;
+                lc->address = copy + 5;
+                if (!*lc->address)
+                        return 0;
+
+        } else
+                return 0;
+
+        list_add(&cfg->listeners, &lc->list);
+        return 1;
+}
+
+/*----------------------------------------------------------------*/
+
+static char *trim(char *str)
+{
+        char *end;
+
+        while (isspace(*str))
+                str++;
+
+        end = str + strlen(str);
+        while (end > str && isspace(end[-1]))
+                end--;
+        *end = '\0';
+
+        return str;
+}
+
+/*
+ * Every setting can be given either in the config file or on the
+ * command line, so both are driven from this table.
+ */
+struct setting {
+        const char *name;
+        int short_name;
+        const char *help;
+        int (*set)(struct config *cfg, const char *value);
+};
+
+static int set_listen(struct config *cfg, const char *value)
+{
+        return config_add_listener(cfg, value);
+}
+
+static int set_listen_backlog(struct config *cfg, const char *value)
+{
+        return parse_uint(value, &cfg->listen_backlog);
+}
+
+static int set_journal_dir(struct config *cfg, const char *value)
+{
+        return (cfg->journal_dir = pool_strdup(cfg->mem, value)) != NULL;
+}
+
+/* The array is copied each time, lanes are few and only set at startup */
+static int set_journal_lane(struct config *cfg, const char *value)
+{
+        const char **lanes = pool_alloc(cfg->mem, sizeof(*lanes) * (cfg->nr_journal_lanes + 1));
+        char *dir = pool_strdup(cfg->mem, value);
+
+        if (!lanes || !dir)
+                return 0;
+
+        memcpy(lanes, cfg->journal_lanes, sizeof(*lanes) * cfg->nr_journal_lanes);
+        lanes[cfg->nr_journal_lanes++] = dir;
+        cfg->journal_lanes = lanes;
+        return 1;
+}
+
+static int set_journal_segment_size(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->journal_segment_size) && cfg->journal_segment_size;
+}
+
+static int set_journal_mode(struct config *cfg, const char *value)
+{
+        if (!strcasecmp(value, "direct"))
+                cfg->journal_mode = JOURNAL_DIRECT;
+        else if (!strcasecmp(value, "buffered"))
+                cfg->journal_mode = JOURNAL_BUFFERED;
+        else
+                return 0;
+
+        return 1;
+}
+
+static int set_journal_checkpoint_interval(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->journal_checkpoint_interval);
+}
+
+static int set_journal_recycle_segments(struct config *cfg, const char *value)
+{
+        return parse_uint(value, &cfg->journal_recycle_segments);
+}
+
+static int set_journal_capacity(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->journal_capacity);
+}
+
+static int set_journal_low_watermark(struct config *cfg, const char *value)
+{
+        return parse_uint(value, &cfg->journal_low_watermark) && cfg->journal_low_watermark < 100;
+}
+
+static int set_journal_high_watermark(struct config *cfg, const char *value)
+{
+        return parse_uint(value, &cfg->journal_high_watermark) &&
+                cfg->journal_high_watermark && cfg->journal_high_watermark <= 100;
+}
+
+static int set_journal_spill_threshold(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->journal_spill_threshold);
+}
+
+static int set_log_dir(struct config *cfg, const char *value)
+{
+        return (cfg->log_dir = pool_strdup(cfg->mem, value)) != NULL;
+}
+
+static int set_log_level(struct config *cfg, const char *value)
+{
+        return parse_level(value, &cfg->log_level);
+}
+
+static int set_log_flush_level(struct config *cfg, const char *value)
+{
+        return parse_level(value, &cfg->log_flush_level);
+}
+
+static int set_buffer_size(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->buffer_size) && cfg->buffer_size;
+}
+
+static int set_socket_rcvbuf(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->socket_rcvbuf);
+}
+
+static int set_socket_sndbuf(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->socket_sndbuf);
+}
+
+/* the protocol carries these as 32 bit quantities */
+static int parse_window(const char *str, size_t *result)
+{
+        return parse_size(str, result) && *result && *result <= UINT32_MAX;
+}
+
+static int set_max_message_size(struct config *cfg, const char *value)
+{
+        return parse_window(value, &cfg->max_message_size);
+}
+
+static int set_credit_bytes(struct config *cfg, const char *value)
+{
+        return parse_window(value, &cfg->credit_bytes);
+}
+
+static int set_memory_limit(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->memory_limit) && cfg->memory_limit;
+}
+
+static int set_compression(struct config *cfg, const char *value)
+{
+        char *copy, *name, *save;
+        enum compress_codec codec;
+
+        copy = pool_strdup(cfg->mem, value);
+        if (!copy)
+                return 0;
+
+        cfg->compression = 1 << CODEC_NONE;
+        for (name = strtok_r(copy, ",", &save); name; name = strtok_r(NULL, ",", &save)) {
+                if (!compress_lookup(trim(name), &codec)) {
+                        fprintf(stderr, "unknown codec '%s'\n", name);
+                        return 0;
+                }
+
+                if (!compress_available(codec)) {
+                        fprintf(stderr, "codec '%s' isn't built in\n", name);
+                        return 0;
+                }
+
+                cfg->compression |= 1 << codec;
+        }
+
+        return 1;
+}
+
+static int set_dedup_window(struct config *cfg, const char *value)
+{
+        return parse_size(value, &cfg->dedup_window);
+}
+
+static int set_stats_socket(struct config *cfg, const char *value)
+{
+        return (cfg->stats_socket = pool_strdup(cfg->mem, value)) != NULL;
+}
+
+static struct setting settings_[] = {
+        { "listen", 'l', "listener spec, may be repeated", set_listen },
+        { "listen_backlog", 0, "backlog passed to listen(2)", set_listen_backlog },
+        { "journal_dir", 'j', "directory holding the journal", set_journal_dir },
+        { "journal_lane", 0, "another directory to stripe the journal across, may be repeated",
+          set_journal_lane },
+        { "journal_segment_size", 0, "size the journal's segment files grow to", set_journal_segment_size },
+        { "journal_mode", 0, "direct or buffered journal writes", set_journal_mode },
+        { "journal_checkpoint_interval", 0, "bytes journalled between checkpoints, 0 disables",
+          set_journal_checkpoint_interval },
+        { "journal_recycle_segments", 0, "reclaimed segments kept for reuse",
+          set_journal_recycle_segments },
+        { "journal_capacity", 0, "bytes of segments before commits are throttled, 0 for no limit",
+          set_journal_capacity },
+        { "journal_low_watermark", 0, "percent of the capacity where throttling starts",
+          set_journal_low_watermark },
+        { "journal_high_watermark", 0, "percent of the capacity where commits are held back",
+          set_journal_high_watermark },
+        { "journal_spill_threshold", 0, "bytes a transaction holds before writing them out, 0 never",
+          set_journal_spill_threshold },
+        { "log_dir", 0, "directory the log is written to", set_log_dir },
+        { "log_level", 0, "minimum level written to the log", set_log_level },
+        { "log_flush_level", 0, "minimum level flushed immediately", set_log_flush_level },
+        { "buffer_size", 0, "initial per connection buffer size", set_buffer_size },
+        { "socket_rcvbuf", 0, "SO_RCVBUF for client sockets", set_socket_rcvbuf },
+        { "socket_sndbuf", 0, "SO_SNDBUF for client sockets", set_socket_sndbuf },
+        { "max_message_size", 0, "largest request a client may send", set_max_message_size },
+        { "credit_bytes", 0, "bytes a client may have outstanding", set_credit_bytes },
+        { "memory_limit", 0, "total credit shared by all clients", set_memory_limit },
+        { "compression", 0, "codecs clients may use, eg, lz4,zstd", set_compression },
+        { "dedup_window", 0, "per connection window for journalling repeated blocks as references, 0 disables", set_dedup_window },
+        { "stats_socket", 0, "unix socket serving a text stats dump", set_stats_socket },
+        { NULL, 0, NULL, NULL }
+};
+
+static struct setting *lookup_setting(const char *name)
+{
+        struct setting *s;
+
+        for (s = settings_; s->name; s++)
+                if (!strcmp(s->name, name))
+                        return s;
+
+        return NULL;
+}
+
+/*----------------------------------------------------------------*/
+
+int config_read_file(struct config *cfg, const char *path)
+{
+        FILE *fp;
+        char line[MAX_LINE];
+        unsigned line_nr = 0;
+        int r = 1;
+
+        fp = fopen(path, "r");
+        if (!fp) {
+                fprintf(stderr, "couldn't open config file '%s'\n", path);
+                return 0;
+        }
+
+        while (fgets(line, sizeof(line), fp)) {
+                char *key, *value, *comment;
+                struct setting *s;
+
+                line_nr++;
+
+                comment = strchr(line, '#');
+                if (comment)
+                        *comment = '\0';
+
+                key = trim(line);
+                if (!*key)
+                        continue;
+
+                value = strchr(key, '=');
+                if (!value) {
+                        fprintf(stderr, "%s:%u: expected 'key = value'\n", path, line_nr);
+                        r = 0;
+                        break;
+                }
+                *value++ = '\0';
+                key = trim(key);
+                value = trim(value);
+
+                s = lookup_setting(key);
+                if (!s) {
+                        fprintf(stderr, "%s:%u: unknown setting '%s'\n", path, line_nr, key);
+                        r = 0;
+                        break;
+                }
+
+                if (!s->set(cfg, value)) {
+                        fprintf(stderr, "%s:%u: bad value '%s' for '%s'\n",
+                                path, line_nr, value, key);
+                        r = 0;
+                        break;
+                }
+        }
+
+        fclose(fp);
+        return r;
+}
+
+/*----------------------------------------------------------------*/
+
+enum {
+        NR_SETTINGS = sizeof(settings_) / sizeof(*settings_) - 1,
+        OPT_CONFIG = 'c',
+        OPT_HELP = 'h',
+        OPT_SETTING_BASE = 256
+};
+
+void config_usage(const char *prog)
+{
+        struct setting *s;
+
+        fprintf(stderr, "usage: %s [options]\n", prog);
+        fprintf(stderr, "  -c, --%-20s %s\n", "config", "read settings from a file");
+        for (s = settings_; s->name; s++) {
+                char name[64], *c;
+
+                snprintf(name, sizeof(name), "%s", s->name);
+                for (c = name; *c; c++)
+                        if (*c == '_')
+                                *c = '-';
+
+                if (s->short_name)
+                        fprintf(stderr, "  -%c, --%-20s %s\n", s->short_name, name, s->help);
+                else
+                        fprintf(stderr, "      --%-20s %s\n", name, s->help);
+        }
+        fprintf(stderr, "  -h, --%-20s %s\n", "help", "print this message");
+}
+
+/*
+ * Long options use the setting names with '-' in place of '_'.
+ */
+static void build_options(struct option *opts, char (*names)[64], char *short_opts)
+{
+        int i;
+        char *p;
+
+        p = short_opts;
+        *p++ = OPT_CONFIG;
+        *p++ = ':';
+        *p++ = OPT_HELP;
+
+        for (i = 0; i < NR_SETTINGS; i++) {
+                char *c;
+
+                strncpy(names[i], settings_[i].name, sizeof(names[i]) - 1);
+                names[i][sizeof(names[i]) - 1] = '\0';
+                for (c = names[i]; *c; c++)
+                        if (*c == '_')
+                                *c = '-';
+
+                opts[i].name = names[i];
+                opts[i].has_arg = required_argument;
+                opts[i].flag = NULL;
+                opts[i].val = settings_[i].short_name ? settings_[i].short_name : OPT_SETTING_BASE + i;
+
+                if (settings_[i].short_name) {
+                        *p++ = settings_[i].short_name;
+                        *p++ = ':';
+                }
+        }
+        *p = '\0';
+
+        opts[i].name = "config";
+        opts[i].has_arg = required_argument;
+        opts[i].flag = NULL;
+        opts[i].val = OPT_CONFIG;
+        i++;
+
+        opts[i].name = "help";
+        opts[i].has_arg = no_argument;
+        opts[i].flag = NULL;
+        opts[i].val = OPT_HELP;
+        i++;
+
+        memset(opts + i, 0, sizeof(*opts));
+}
+
+static struct setting *setting_for_opt(int opt)
+{
+        int i;
+
+        if (opt >= OPT_SETTING_BASE && opt < OPT_SETTING_BASE + NR_SETTINGS)
+                return settings_ + (opt - OPT_SETTING_BASE);
+
+        for (i = 0; i < NR_SETTINGS; i++)
+                if (settings_[i].short_name && settings_[i].short_name == opt)
+                        return settings_ + i;
+
+        return NULL;
+}
+
+int config_parse_args(struct config *cfg, int argc, char **argv)
+{
+        int opt, seen_listen = 0;
+        struct option opts[NR_SETTINGS + 3];
+        char names[NR_SETTINGS][64];
+        char short_opts[2 * NR_SETTINGS + 4];
+
+        build_options(opts, names, short_opts);
+
+        /*
+         * First pass just picks up the config file, so the rest of the
+         * command line can override it.
+         */
+        opterr = 0;
+        optind = 0;
+        while ((opt = getopt_long(argc, argv, short_opts, opts, NULL)) != -1) {
+                if (opt == OPT_CONFIG && !config_read_file(cfg, optarg))
+                        return 0;
+        }
+
+        opterr = 1;
+        optind = 0;
+        while ((opt = getopt_long(argc, argv, short_opts, opts, NULL)) != -1) {
+                struct setting *s;
+
+                switch (opt) {
+                case OPT_CONFIG:
+                        break;
+
+                case OPT_HELP:
+                        config_usage(argv[0]);
+                        return 0;
+
+                default:
+                        s = setting_for_opt(opt);
+                        if (!s) {
+                                config_usage(argv[0]);
+                                return 0;
+                        }
+
+                        /* listeners on the command line replace those in the file */
+                        if (s->set == set_listen && !seen_listen) {
+                                list_init(&cfg->listeners);
+                                seen_listen = 1;
+                        }
+
+                        if (!s->set(cfg, optarg)) {
+                                fprintf(stderr, "bad value '%s' for --%s\n", optarg, opts[s - settings_].name);
+                                return 0;
+                        }
+                }
+        }
+
+        if (optind != argc) {
+                fprintf(stderr, "unexpected argument '%s'\n", argv[optind]);
+                config_usage(argv[0]);
+                return 0;
+        }
+
+        if (cfg->credit_bytes < cfg->max_message_size) {
+                fprintf(stderr, "credit_bytes must be at least max_message_size\n");
+                return 0;
+        }
+
+        if (list_empty(&cfg->listeners)) {
+                char spec[32];
+                snprintf(spec, sizeof(spec), "tcp:0.0.0.0:%d", DEFAULT_PORT);
+                if (!config_add_listener(cfg, spec))
+                        return 0;
+        }
+
+        return 1;
+}
+
+/*----------------------------------------------------------------*/
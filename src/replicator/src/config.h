@@ -0,0 +1,101 @@
+#ifndef REPLICATOR_CONFIG_H
+#define REPLICATOR_CONFIG_H
+
+#include "datastruct/list.h"
+#include "journal/journal.h"
+#include "log/log.h"
+
+#include <stdlib.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Server configuration.  Built up from defaults, then an optional config
+ * file, then the command line; later sources override earlier ones.
+ */
+enum listener_type {
+        LISTENER_TCP,
+        LISTENER_UNIX
+};
+
+struct listener_config {
+        struct list list;
+
+        enum listener_type type;
+        char *address;          /* host for tcp, path for unix sockets */
+        unsigned port;          /* tcp only */
+        unsigned max_connections; /* 0 means unlimited */
+};
+
+struct config {
+        struct pool *mem;
+
+        struct list listeners;
+        unsigned listen_backlog;
+
+        char *journal_dir;
+        size_t journal_segment_size;
+        enum journal_mode journal_mode;
+        size_t journal_checkpoint_interval;     /* 0 disables checkpoints */
+        unsigned journal_recycle_segments;
+        size_t journal_capacity;                /* 0 for no limit */
+        unsigned journal_low_watermark;         /* percent of the capacity */
+        unsigned journal_high_watermark;
+        size_t journal_spill_threshold;         /* 0 never spills */
+        const char **journal_lanes;             /* striped across as well as journal_dir */
+        unsigned nr_journal_lanes;
+
+        char *log_dir;
+        enum log_level log_level;
+        enum log_level log_flush_level;
+
+        size_t buffer_size;     /* initial per connection receive buffer */
+        size_t socket_rcvbuf;   /* 0 leaves the kernel default */
+        size_t socket_sndbuf;
+
+        /* flow control, see protocol.xdr */
+        size_t max_message_size;
+        size_t credit_bytes;    /* per connection window */
+        size_t memory_limit;    /* shared by all the connection windows */
+
+        unsigned compression;   /* bit set of the codecs clients may use */
+        size_t dedup_window;    /* bytes of recent blocks kept per connection, 0 for none */
+
+        char *stats_socket;     /* NULL for none */
+};
+
+struct config *config_create();
+void config_destroy(struct config *cfg);
+
+/*
+ * The config file is a series of 'key = value' lines, '#' starts a
+ * comment.  Keys are the long command line options with '_' in place of
+ * '-', eg,
+ *
+ *   listen = tcp:0.0.0.0:6776,max_connections=64
+ *   listen = unix:/var/run/replicator.sock
+ *   journal_dir = /var/lib/replicator
+ *   log_level = info
+ *   buffer_size = 256k
+ */
+int config_read_file(struct config *cfg, const char *path);
+
+/*
+ * Parses the command line, reading any config file named with
+ * --config before applying the other options.  Returns 0 on a bad
+ * command line, having printed a message to stderr.
+ */
+int config_parse_args(struct config *cfg, int argc, char **argv);
+void config_usage(const char *prog);
+
+/*
+ * Parses a listener spec of the form:
+ *
+ *   tcp:<host>:<port>[,max_connections=<n>]
+ *   unix:<path>[,max_connections=<n>]
+ */
+int config_add_listener(struct config *cfg, const char *spec);
+
+/*----------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,76 @@
+#include "credit.h"
+
+#include <assert.h>
+#include <string.h>
+
+/*----------------------------------------------------------------*/
+
+void credit_budget_init(struct credit_budget *b, uint64_t limit)
+{
+        b->limit = limit;
+        b->reserved = 0;
+}
+
+void credit_init(struct credit *c, uint32_t logon_size)
+{
+        memset(c, 0, sizeof(*c));
+        c->max_message = logon_size;
+        c->bytes = logon_size;
+}
+
+static inline uint64_t min64(uint64_t lhs, uint64_t rhs)
+{
+        return lhs <= rhs ? lhs : rhs;
+}
+
+int credit_grant(struct credit *c, struct credit_budget *b,
+                 uint32_t max_message, uint32_t bytes)
+{
+        uint64_t available = b->limit - b->reserved;
+
+        assert(!c->budget);
+
+        bytes = min64(bytes, available);
+        if (bytes < max_message)
+                return 0;
+
+        b->reserved += bytes;
+        c->budget = b;
+        c->max_message = max_message;
+        c->bytes = bytes;
+
+        return 1;
+}
+
+void credit_release(struct credit *c)
+{
+        if (c->budget) {
+                c->budget->reserved -= c->bytes;
+                c->budget = NULL;
+        }
+}
+
+int credit_charge(struct credit *c, uint32_t len)
+{
+        if (len > c->max_message || c->used_bytes + c->held_bytes + len > c->bytes)
+                return 0;
+
+        c->used_bytes += len;
+        return 1;
+}
+
+void credit_complete(struct credit *c, uint32_t len, uint32_t held)
+{
+        assert(c->used_bytes >= len);
+        assert(held <= len);
+
+        c->used_bytes -= len;
+        c->held_bytes += held;
+}
+
+void credit_absorbed(struct credit *c)
+{
+        c->held_bytes = 0;
+}
+
+/*----------------------------------------------------------------*/
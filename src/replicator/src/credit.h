@@ -0,0 +1,66 @@
+#ifndef REPLICATOR_CREDIT_H
+#define REPLICATOR_CREDIT_H
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Credit based flow control.  Each connection is granted a window at
+ * LOGON, which is reserved from a server wide budget.  So however
+ * aggressive a client is, the memory tied up in its requests is bounded
+ * by its window, and the sum of the windows is bounded by the budget.
+ */
+struct credit_budget {
+        uint64_t limit;
+        uint64_t reserved;
+};
+
+void credit_budget_init(struct credit_budget *b, uint64_t limit);
+
+struct credit {
+        struct credit_budget *budget;
+
+        /* the window granted at logon */
+        uint32_t max_message;
+        uint32_t bytes;
+
+        /* outstanding */
+        uint32_t used_bytes;
+        uint32_t held_bytes;    /* journal data not yet absorbed */
+};
+
+/*
+ * Before logon a connection gets a small window, just big enough for the
+ * LOGON request.
+ */
+void credit_init(struct credit *c, uint32_t logon_size);
+
+/*
+ * Reserves a window from the budget.  The window may be smaller than
+ * asked for if the budget is running low, but it is never smaller than
+ * |max_message|; if that much isn't available this fails.
+ */
+int credit_grant(struct credit *c, struct credit_budget *b,
+                 uint32_t max_message, uint32_t bytes);
+
+/* Gives the window back to the budget */
+void credit_release(struct credit *c);
+
+/*
+ * A request of |len| bytes has arrived.  Fails if the client has
+ * overrun its window.
+ */
+int credit_charge(struct credit *c, uint32_t len);
+
+/*
+ * The response to a request of |len| bytes has been sent.  |held| of
+ * those bytes are still in use, and will be returned with
+ * credit_absorbed() once the journal has taken them.
+ */
+void credit_complete(struct credit *c, uint32_t len, uint32_t held);
+void credit_absorbed(struct credit *c);
+
+/*----------------------------------------------------------------*/
+
+#endif
@@ -1,247 +1,1065 @@
+#include "arena.h"
+#include "compress/compress.h"
+#include "config.h"
+#include "credit.h"
 #include "csp/control.h"
 #include "csp/io.h"
 #include "csp/process.h"
 #include "datastruct/list.h"
+#include "dedup/dedup.h"
+#include "journal/journal.h"
 #include "log/log.h"
 #include "protocol.h"
-#include "utility/dynamic_buffer.h"
+#include "server_stats.h"
 
+#include <netdb.h>
+#include <signal.h>
 #include <stdio.h>
-#include <strings.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/ioctl.h>
 #include <sys/types.h>
 #include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
 
 /*
  * Server
  */
+struct server;
+
+struct listener {
+        struct list list;
+        struct server *server;
+        struct listener_config *cfg;
+        int socket;
+        unsigned nr_clients;
+};
+
+/* a device bound with JOURNAL_OPEN */
+struct client_device {
+        unsigned shortname;
+        struct journal_device *dev;
+};
+
+/* the journal's id for the client's transaction number |nr| */
+struct committed_txn {
+        uint64_t nr;
+        uint64_t id;
+};
+
 struct client {
         struct list list;
+        struct listener *listener;
+        unsigned id;
         int socket;
-        struct dynamic_buffer *db;
+        struct request_arena *arena;
+
+        uint64_t requests;      /* served since logon */
+        uint64_t bytes;
+        uint32_t peak_held;
+
+        int logged_on;
+        struct credit credit;
+        compression codec;
+
+        /*
+         * The dedup window names each block by the client's number for
+         * the transaction it's in, counted from 1, and its io in that,
+         * so a repeat can be journalled as a reference to it.
+         * |committed| has the journal's ids for the latest transactions
+         * committed, by number, NULL if the window's disabled.
+         */
+        uint64_t nr_txns;
+        uint32_t txn_ios;
+        struct committed_txn *committed;
+        struct dedup_window *window;
+        struct dedup_stats dedup;
+        void *scratch;
+        size_t scratch_len;
+
+        struct client_device *devices;
+        unsigned nr_devices;
+        struct journal_transaction *txn;
+        int durable;            /* eventfd, signalled when a commit is durable or a spill written */
 };
 
 struct server {
+        struct config *cfg;
+        struct journal *journal;
+        struct credit_budget budget;
+        struct dedup_stats dedup;       /* from disconnected clients */
+        struct server_stats stats;
+        int stats_socket;
         int stop_requested;
-        int listen_socket;
+        struct list listeners;
         struct list clients;
+        unsigned next_client_id;
 };
 
-static int read_request(int fd, struct dynamic_buffer *db, struct pool *mem, command **result, uint32_t *req_id)
+static int set_socket_options(struct server *s, int fd)
 {
-        void *data;
-        msg_header header_raw, *header;
-
-        /* read the header */
-        if (csp_read_exact(fd, &header_raw, sizeof(header)) < 0)
-                return 0;
+        int size;
 
-        if (!xdr_unpack_using(msg_header_alloc, &header_raw, sizeof(header_raw), mem, &header))
-                return 0;
-
-        /* read the payload */
-        data = dynamic_buffer_get(db, header->msg_size);
-        if (csp_read_exact(fd, data, header->msg_size) < 0)
-                return 0;
+        if (s->cfg->socket_rcvbuf) {
+                size = s->cfg->socket_rcvbuf;
+                if (setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size)) < 0)
+                        return 0;
+        }
 
-        if (!xdr_unpack_using(command_alloc, data, header->msg_size, mem, result))
-                return 0;
+        if (s->cfg->socket_sndbuf) {
+                size = s->cfg->socket_sndbuf;
+                if (setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &size, sizeof(size)) < 0)
+                        return 0;
+        }
 
-        *req_id = header->request_id;
         return 1;
 }
 
-static int write_buffer(int fd, struct xdr_buffer *buf)
+static int open_tcp_socket(struct listener_config *lc, unsigned backlog)
 {
-        struct xdr_cursor *c = NULL;
+        int fd = -1, r, flag = 1;
+        char port[16];
+        struct addrinfo hints, *addrs, *a;
 
-        int r = 0;
-        size_t len = xdr_buffer_size(buf);
-        void *data = malloc(len);
+        memset(&hints, 0, sizeof(hints));
+        hints.ai_family = AF_UNSPEC;
+        hints.ai_socktype = SOCK_STREAM;
+        hints.ai_flags = AI_PASSIVE;
+        snprintf(port, sizeof(port), "%u", lc->port);
 
-        if (!data)
-                return 0;
-
-        c = xdr_cursor_create(buf);
-        if (!c)
-                goto out;
+        r = getaddrinfo(lc->address, port, &hints, &addrs);
+        if (r) {
+                fprintf(stderr, "couldn't resolve '%s': %s\n", lc->address, gai_strerror(r));
+                return -1;
+        }
 
-        if (!xdr_cursor_read(c, data, len))
-                goto out;
+        for (a = addrs; a; a = a->ai_next) {
+                fd = socket(a->ai_family, a->ai_socktype, a->ai_protocol);
+                if (fd < 0)
+                        continue;
 
-        fprintf(stderr, "replicator writing %u bytes to socket\n", (unsigned int) len);
-        if (!csp_write_exact(fd, data, len))
-                goto out;
+                setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
 
-        r = 1;
+                if (!bind(fd, a->ai_addr, a->ai_addrlen) && !listen(fd, backlog))
+                        break;
 
-out:
-        if (c)
-                xdr_cursor_destroy(c);
-        free(data);
+                close(fd);
+                fd = -1;
+        }
 
-        return r;
+        freeaddrinfo(addrs);
+        return fd;
 }
 
-static int write_response(int fd, uint32_t req_id, response *resp)
+static int open_unix_socket(const char *path, unsigned backlog)
 {
-        int r = 0;
-        msg_header header;
-        struct xdr_buffer *buf = NULL, *buf2 = NULL;
+        int fd;
+        struct sockaddr_un addr;
+
+        if (strlen(path) >= sizeof(addr.sun_path))
+                return -1;
 
-        buf = xdr_buffer_create(128);
-        if (!buf)
-                goto out;
+        fd = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (fd < 0)
+                return -1;
 
-        if (!xdr_pack_response(buf, resp))
-                goto out;
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, path);
 
-        header.request_id = req_id;
-        header.msg_size = xdr_buffer_size(buf);
+        /* a stale socket from a previous run would stop us binding */
+        unlink(path);
+
+        if (bind(fd, (struct sockaddr *) &addr, sizeof(addr)) < 0 ||
+            listen(fd, backlog) < 0) {
+                close(fd);
+                return -1;
+        }
 
-        buf2 = xdr_buffer_create(8);
-        if (!buf2)
-                goto out;
+        return fd;
+}
+
+static struct listener *prepare_listener(struct server *s, struct listener_config *lc)
+{
+        struct listener *l;
+
+        l = malloc(sizeof(*l));
+        if (!l)
+                return NULL;
+
+        l->server = s;
+        l->cfg = lc;
+        l->nr_clients = 0;
+        l->socket = (lc->type == LISTENER_TCP) ?
+                open_tcp_socket(lc, s->cfg->listen_backlog) :
+                open_unix_socket(lc->address, s->cfg->listen_backlog);
+
+        if (l->socket < 0) {
+                free(l);
+                return NULL;
+        }
 
-        if (!xdr_pack_msg_header(buf2, &header))
-                goto out;
+        csp_set_non_blocking(l->socket);
+        return l;
+}
 
-        if (!write_buffer(fd, buf2))
-                goto out;
+static void destroy_server(struct server *s)
+{
+        struct listener *l, *tmp;
 
-        if (!write_buffer(fd, buf))
-                goto out;
+        list_iterate_items_safe (l, tmp, &s->listeners) {
+                close(l->socket);
+                if (l->cfg->type == LISTENER_UNIX)
+                        unlink(l->cfg->address);
+                free(l);
+        }
 
-        r = 1;
+        if (s->stats_socket >= 0) {
+                close(s->stats_socket);
+                unlink(s->cfg->stats_socket);
+        }
 
-out:
-        if (buf)
-                xdr_buffer_destroy(buf);
-        if (buf2)
-                xdr_buffer_destroy(buf2);
+        if (s->journal)
+                journal_destroy(s->journal);
 
-        return r;
+        free(s);
 }
 
-struct server *prepare_server(const char *host, int port)
+struct server *prepare_server(struct config *cfg)
 {
         struct server *s;
-        struct sockaddr_in server_address;
+        struct listener_config *lc;
+        struct journal_options jopts;
 
         s = malloc(sizeof(*s));
         if (!s)
                 return NULL;
 
-        s->listen_socket = socket(AF_INET, SOCK_STREAM, 0);
-        if (s->listen_socket < 0) {
-                free(s);
-                return NULL;
+        s->cfg = cfg;
+        s->journal = NULL;
+        credit_budget_init(&s->budget, cfg->memory_limit);
+        memset(&s->dedup, 0, sizeof(s->dedup));
+        server_stats_init(&s->stats);
+        s->stats_socket = -1;
+        s->stop_requested = 0;
+        list_init(&s->listeners);
+        list_init(&s->clients);
+        s->next_client_id = 0;
+
+        list_iterate_items (lc, &cfg->listeners) {
+                struct listener *l = prepare_listener(s, lc);
+                if (!l) {
+                        if (lc->type == LISTENER_TCP)
+                                fprintf(stderr, "couldn't listen on tcp:%s:%u\n", lc->address, lc->port);
+                        else
+                                fprintf(stderr, "couldn't listen on unix:%s\n", lc->address);
+                        destroy_server(s);
+                        return NULL;
+                }
+
+                list_add(&s->listeners, &l->list);
         }
 
-        bzero(&server_address, sizeof(server_address));
-        server_address.sin_family = AF_INET;
-        server_address.sin_addr.s_addr = htonl(INADDR_ANY);
-        server_address.sin_port = htons(port);
+        if (cfg->stats_socket) {
+                s->stats_socket = open_unix_socket(cfg->stats_socket, cfg->listen_backlog);
+                if (s->stats_socket < 0) {
+                        fprintf(stderr, "couldn't listen on stats socket %s\n", cfg->stats_socket);
+                        destroy_server(s);
+                        return NULL;
+                }
 
-        int flag = 1;
-        setsockopt(s->listen_socket, SOL_SOCKET, SO_REUSEADDR, &flag, sizeof(flag));
+                csp_set_non_blocking(s->stats_socket);
+        }
 
-        if (bind(s->listen_socket, (struct sockaddr *) &server_address, sizeof(server_address)) < 0) {
-                close(s->listen_socket);
-                free(s);
+        journal_options_init(&jopts);
+        jopts.segment_size = cfg->journal_segment_size;
+        jopts.mode = cfg->journal_mode;
+        jopts.checkpoint_interval = cfg->journal_checkpoint_interval;
+        jopts.recycle_segments = cfg->journal_recycle_segments;
+        jopts.capacity = cfg->journal_capacity;
+        jopts.low_watermark = cfg->journal_low_watermark;
+        jopts.high_watermark = cfg->journal_high_watermark;
+        jopts.spill_threshold = cfg->journal_spill_threshold;
+        jopts.nr_lanes = cfg->nr_journal_lanes;
+        jopts.lanes = cfg->journal_lanes;
+        s->journal = journal_create(cfg->journal_dir, &jopts);
+        if (!s->journal) {
+                fprintf(stderr, "couldn't open journal %s\n", cfg->journal_dir);
+                destroy_server(s);
                 return NULL;
         }
 
-        if (listen(s->listen_socket, 20)) {
-                close(s->listen_socket);
-                free(s);
-                return NULL;
+        return s;
+}
+
+static void destroy_client(struct client *c)
+{
+        struct dedup_stats *d = &c->dedup;
+
+        if (d->ios)
+                info("client %u wrote %llu ios: %llu zero, %llu repeats (%llu as references)",
+                     c->id, (unsigned long long) d->ios, (unsigned long long) d->zero_ios,
+                     (unsigned long long) d->dup_ios, (unsigned long long) d->ref_ios);
+        dedup_stats_add(&c->listener->server->dedup, d);
+
+        if (c->txn)
+                journal_rollback(c->txn);
+
+        credit_release(&c->credit);
+        list_del(&c->list);
+        c->listener->nr_clients--;
+        close(c->socket);
+        close(c->durable);
+        arena_destroy(c->arena);
+        dedup_window_destroy(c->window);
+        free(c->committed);
+        free(c->scratch);
+        free(c->devices);
+        free(c);
+}
+
+static void fail(response *resp, const char *reason)
+{
+        resp->discriminator = FAIL;
+        resp->u.reason = (char *) reason;
+}
+
+enum {
+        PROTOCOL_MAJOR = 1,
+        PROTOCOL_MINOR = 1,
+        PROTOCOL_PATCH = 1,
+
+        /* the window a client has before logging on */
+        LOGON_MESSAGE_SIZE = 64,
+
+        /*
+         * Compressed ios are only decompressed to check for zeroes when
+         * they've shrunk by at least this factor.
+         */
+        ZERO_CHECK_RATIO = 64,
+
+        /* transactions a repeat can refer back to */
+        NR_COMMITTED = 1024
+};
+
+/*
+ * Picks the first of the client's codecs that we're allowed to use.
+ */
+static compression choose_codec(struct config *cfg, logon_detail *l)
+{
+        unsigned i;
+
+        for (i = 0; i < l->codecs.len; i++) {
+                unsigned codec = l->codecs.array[i];
+                if (codec < CODEC_COUNT && (cfg->compression & (1 << codec)))
+                        return (compression) codec;
         }
 
-        csp_set_non_blocking(s->listen_socket);
+        return COMPRESS_NONE;
+}
 
-        s->stop_requested = 0;
-        list_init(&s->clients);
-        return s;
+static void logon(struct client *c, logon_detail *l, response *resp)
+{
+        version *v = &l->v;
+        struct config *cfg = c->listener->server->cfg;
+        struct credit_budget *budget = &c->listener->server->budget;
+
+        if (c->logged_on) {
+                fail(resp, "already logged on");
+                return;
+        }
+
+        if (v->major > PROTOCOL_MAJOR ||
+            (v->major == PROTOCOL_MAJOR && v->minor > PROTOCOL_MINOR)) {
+                fail(resp, "unsupported protocol version");
+                return;
+        }
+
+        if (!credit_grant(&c->credit, budget, cfg->max_message_size, cfg->credit_bytes)) {
+                warn("memory limit reached, refusing logon");
+                fail(resp, "server busy");
+                return;
+        }
+
+        c->logged_on = 1;
+        c->codec = choose_codec(cfg, l);
+        if (c->codec != COMPRESS_NONE)
+                info("client using %s compression", compress_name(c->codec));
+
+        resp->discriminator = LOGON_RESPONSE;
+        resp->u.logon.credit.max_message = c->credit.max_message;
+        resp->u.logon.credit.bytes = c->credit.bytes;
+        resp->u.logon.codec = c->codec;
 }
 
-void client_loop(struct client *c)
+/*
+ * The data is left compressed, it's the journal's job to carry it
+ * through as it is.
+ */
+static int check_io(struct client *c, io_detail *io, response *resp)
+{
+        if (!io->len || (io->len & ((1 << JOURNAL_SECTOR_SHIFT) - 1))) {
+                fail(resp, "io isn't a whole number of sectors");
+                return 0;
+        }
+
+        if (io->codec == COMPRESS_NONE) {
+                if (io->len != io->data.len) {
+                        fail(resp, "bad io length");
+                        return 0;
+                }
+
+        } else if (io->codec != c->codec) {
+                fail(resp, "io uses a codec that wasn't agreed at logon");
+                return 0;
+        }
+
+        return 1;
+}
+
+/*
+ * A compressed block can only be zero if it compressed extremely well,
+ * and those are cheap to decompress.
+ */
+static enum dedup_zero compressed_zero(struct client *c, io_detail *io)
+{
+        size_t len = io->len;
+
+        if ((uint64_t) io->data.len * ZERO_CHECK_RATIO > io->len ||
+            io->len > c->listener->server->cfg->max_message_size)
+                return ZERO_NO;
+
+        if (c->scratch_len < io->len) {
+                void *scratch = realloc(c->scratch, io->len);
+                if (!scratch)
+                        return ZERO_NO;
+
+                c->scratch = scratch;
+                c->scratch_len = io->len;
+        }
+
+        if (!decompress_block(io->codec, io->data.data, io->data.len, c->scratch, &len) ||
+            len != io->len)
+                return ZERO_NO;
+
+        return dedup_is_zero(c->scratch, len) ? ZERO_YES : ZERO_NO;
+}
+
+/*
+ * Zero blocks only need their metadata journalled, and repeats of a
+ * recent block a reference to it, see record_io().  Compressed blocks
+ * are compared as they are; the same data compressed with the same
+ * codec gives the same bytes.
+ */
+static enum dedup_class classify_io(struct client *c, io_detail *io, uint64_t *match)
+{
+        uint64_t key = ((uint64_t) io->len << 8) | io->codec;
+        enum dedup_zero zero = (io->codec == COMPRESS_NONE) ? ZERO_SCAN : compressed_zero(c, io);
+
+        return dedup_classify(c->window, &c->dedup, io->data.data, io->data.len,
+                              key, zero, (c->nr_txns << 32) | c->txn_ios, match);
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Journalling.
+ */
+static void bind_devices(struct client *c, device_binding *bindings, unsigned count,
+                         response *resp)
+{
+        unsigned i;
+        struct journal *j = c->listener->server->journal;
+        struct client_device *devices = malloc(sizeof(*devices) * (count ? count : 1));
+
+        if (!devices) {
+                fail(resp, "out of memory");
+                return;
+        }
+
+        for (i = 0; i < count; i++) {
+                devices[i].shortname = bindings[i].shortname;
+                devices[i].dev = journal_register_device(j, bindings[i].logical_name);
+                if (!devices[i].dev) {
+                        free(devices);
+                        fail(resp, "couldn't register device");
+                        return;
+                }
+        }
+
+        free(c->devices);
+        c->devices = devices;
+        c->nr_devices = count;
+}
+
+static struct journal_device *lookup_device(struct client *c, unsigned shortname)
+{
+        unsigned i;
+
+        for (i = 0; i < c->nr_devices; i++)
+                if (c->devices[i].shortname == shortname)
+                        return c->devices[i].dev;
+
+        return NULL;
+}
+
+/* Runs on the journal's writer thread */
+static void wake_client(void *context)
+{
+        struct client *c = context;
+        uint64_t one = 1;
+
+        /* an eventfd write only fails if the counter overflows */
+        if (write(c->durable, &one, sizeof(one)) != sizeof(one))
+                abort();
+}
+
+/*
+ * A spill takes the transaction's data so far, this io's included, so
+ * once it's written every byte the transaction's holding goes back to
+ * the client.  That way a transaction isn't limited to the window.
+ */
+static uint32_t wait_for_spill(struct client *c, uint32_t held, response *resp)
+{
+        uint64_t count;
+
+        if (csp_read_exact(c->durable, &count, sizeof(count)) < 0)
+                fatal("couldn't wait for the journal");
+
+        if (journal_failed(c->listener->server->journal)) {
+                fail(resp, "journal failed");
+                return held;
+        }
+
+        resp->discriminator = IO_RESPONSE;
+        resp->u.released = c->credit.held_bytes + held;
+        credit_absorbed(&c->credit);
+        return 0;
+}
+
+/*
+ * A repeat of a block from a committed transaction is journalled as a
+ * reference to it, which keeps that transaction in the journal for as
+ * long as this one is.  Repeats within the transaction being built, of
+ * one too long ago to remember, or of one that's been dropped, are
+ * journalled in full.
+ */
+static int record_ref(struct client *c, struct journal_io *jio, uint64_t match)
+{
+        uint64_t nr = match >> 32;
+        struct committed_txn *ct = c->committed + nr % NR_COMMITTED;
+
+        return ct->nr == nr && journal_record_ref(c->txn, jio, ct->id, (uint32_t) match);
+}
+
+/*
+ * Zero blocks are journalled without their data, and repeats, where
+ * they can be, as references.
+ *
+ * Returns the number of bytes held until the transaction ends, or
+ * spills.
+ */
+static uint32_t record_io(struct client *c, io_detail *io, uint32_t len, response *resp)
+{
+        int referenced;
+        unsigned spills, ios;
+        uint64_t match;
+        struct journal_io jio;
+        enum dedup_class class;
+        struct thunk notify = { wake_client, c };
+
+        if (!check_io(c, io, resp))
+                return 0;
+
+        jio.dev = lookup_device(c, io->dev);
+        if (!jio.dev) {
+                fail(resp, "io to a device that isn't bound");
+                return 0;
+        }
+
+        if (!c->txn) {
+                c->txn = journal_begin(c->listener->server->journal);
+                if (!c->txn) {
+                        fail(resp, "out of memory");
+                        return 0;
+                }
+                journal_notify_spills(c->txn, &notify);
+                c->nr_txns++;
+                c->txn_ios = 0;
+        }
+
+        class = classify_io(c, io, &match);
+        jio.start_sector = io->sector;
+        jio.end_sector = io->sector + (io->len >> JOURNAL_SECTOR_SHIFT);
+        if (class == BLOCK_ZERO) {
+                jio.codec = COMPRESS_NONE;
+                jio.len = 0;
+                jio.data = NULL;
+        } else {
+                jio.codec = io->codec;
+                jio.len = io->data.len;
+                jio.data = io->data.data;
+        }
+
+        spills = journal_transaction_spills(c->txn, &ios);
+        referenced = class == BLOCK_DUPLICATE && record_ref(c, &jio, match);
+        if (!referenced && !journal_record_io(c->txn, &jio)) {
+                /* the window has named a block after an io that isn't there */
+                dedup_window_reset(c->window);
+                fail(resp, "couldn't journal io");
+                return 0;
+        }
+        c->txn_ios++;
+
+        if (referenced) {
+                c->dedup.ref_ios++;
+                c->dedup.ref_bytes += io->data.len;
+        }
+
+        /* the journal keeps a copy of anything with data */
+        if (class == BLOCK_ZERO || referenced)
+                len = 0;
+
+        if (journal_transaction_spills(c->txn, &ios) != spills)
+                return wait_for_spill(c, len, resp);
+
+        return len;
+}
+
+/*
+ * Sleeps, rather than blocking the thread, so the other clients carry on
+ * and whoever's dropping transactions can free up space.
+ */
+static void throttle(struct journal *j)
+{
+        unsigned delay_us;
+
+        while (!journal_throttle(j, &delay_us))
+                csp_sleep((delay_us + 999) / 1000);
+
+        if (delay_us)
+                csp_sleep((delay_us + 999) / 1000);
+}
+
+/*
+ * The client waits for its transaction to be durable, while other
+ * clients carry on and may have their commits share the same sync.
+ * Commits are held back first if the journal's filling up.
+ */
+static void commit(struct client *c, response *resp)
+{
+        uint64_t id, count;
+        struct journal *j = c->listener->server->journal;
+        struct journal_transaction *txn = c->txn ? c->txn : journal_begin(j);
+        struct thunk notify = { wake_client, c };
+
+        /* where to note its id, unless it's empty and has no blocks */
+        struct committed_txn *ct = (c->txn && c->committed) ?
+                c->committed + c->nr_txns % NR_COMMITTED : NULL;
+
+        c->txn = NULL;
+        if (!txn) {
+                fail(resp, "out of memory");
+                return;
+        }
+
+        throttle(j);
+        if (!journal_commit(txn, &notify, &id)) {
+                fail(resp, "journal failed");
+                return;
+        }
+
+        if (csp_read_exact(c->durable, &count, sizeof(count)) < 0)
+                fatal("couldn't wait for the journal");
+
+        if (journal_failed(j)) {
+                fail(resp, "journal failed");
+                return;
+        }
+
+        if (ct) {
+                ct->nr = c->nr_txns;
+                ct->id = id;
+        }
+
+        resp->discriminator = TRANSACTION_RESPONSE;
+        resp->u.transaction_id = id;
+}
+
+static void rollback(struct client *c)
+{
+        if (c->txn) {
+                journal_rollback(c->txn);
+                c->txn = NULL;
+        }
+}
+
+static void transaction_bound(struct client *c, int last, response *resp)
 {
-        struct pool *mem = pool_create("client io", 1024);
+        uint64_t id;
+        struct journal *j = c->listener->server->journal;
+        unsigned count = journal_transaction_count(j);
 
-        if (!mem)
+        if (!count || !journal_transaction_front(j, last ? count - 1 : 0, &id)) {
+                fail(resp, "no transactions");
                 return;
+        }
+
+        resp->discriminator = TRANSACTION_RESPONSE;
+        resp->u.transaction_id = id;
+}
+
+/*----------------------------------------------------------------*/
+
+static void summarise_dedup(struct dedup_stats *d, dedup_summary *out)
+{
+        out->ios = d->ios;
+        out->bytes = d->bytes;
+        out->zero_ios = d->zero_ios;
+        out->zero_bytes = d->zero_bytes;
+        out->dup_ios = d->dup_ios;
+        out->dup_bytes = d->dup_bytes;
+        out->ref_ios = d->ref_ios;
+        out->ref_bytes = d->ref_bytes;
+}
+
+static int summarise_devices(struct journal *j, struct pool *mem, stats_summary *summary)
+{
+        unsigned i;
+        struct journal_device *dev;
+        struct journal_device_stats stats;
+
+        summary->devices.len = journal_device_count(j);
+        summary->devices.array = pool_alloc(mem, sizeof(*summary->devices.array) *
+                                            summary->devices.len);
+        if (summary->devices.len && !summary->devices.array)
+                return 0;
+
+        for (i = 0; i < summary->devices.len; i++) {
+                device_summary *ds = summary->devices.array + i;
+
+                dev = journal_get_device(j, i);
+                journal_get_device_stats(j, dev, &stats);
+                ds->name = (char *) journal_device_name(dev);
+                ds->journalled_bytes = stats.journalled;
+                ds->replayed_bytes = stats.replayed;
+                ds->coalesced_bytes = stats.coalesced;
+        }
+
+        return 1;
+}
+
+static void summarise_journal(struct journal *j, journal_summary *out)
+{
+        struct journal_stats stats;
+
+        journal_get_stats(j, &stats);
+        out->used_bytes = stats.used;
+        out->capacity_bytes = stats.capacity;
+        out->reclaimed_bytes = stats.reclaimed;
+        out->reclaim_rate = stats.reclaim_rate;
+        out->recycled_segments = stats.recycled;
+        out->throttled_commits = stats.throttled;
+        out->stalled_commits = stats.stalled;
+}
+
+/*
+ * Queued bytes are the only figure that needs a syscall, so they're
+ * sampled here rather than tracked on the request path.
+ */
+static int summarise(struct server *s, struct pool *mem, stats_summary *summary)
+{
+        unsigned i = 0;
+        int queued;
+        struct client *c;
+        struct dedup_stats dedup = s->dedup;
+
+        if (!server_stats_summarise(&s->stats, mem, summary))
+                return 0;
+
+        summary->connections.len = list_size(&s->clients);
+        summary->connections.array = pool_alloc(mem, sizeof(*summary->connections.array) *
+                                                summary->connections.len);
+        if (summary->connections.len && !summary->connections.array)
+                return 0;
+
+        list_iterate_items (c, &s->clients) {
+                connection_summary *cs = summary->connections.array + i++;
+
+                if (ioctl(c->socket, FIONREAD, &queued) < 0)
+                        queued = 0;
+
+                cs->id = c->id;
+                cs->total_requests = c->requests;
+                cs->total_bytes = c->bytes;
+                cs->queued_bytes = queued;
+                cs->held_bytes = c->credit.held_bytes;
+                cs->peak_held_bytes = c->peak_held;
+                dedup_stats_add(&dedup, &c->dedup);
+        }
+
+        summarise_dedup(&dedup, &summary->dedup);
+        summarise_journal(s->journal, &summary->journal);
+        return summarise_devices(s->journal, mem, summary);
+}
+
+/*
+ * Returns the number of the request's bytes that are still held once
+ * the response has been sent.
+ */
+static uint32_t process_command(struct client *c, command *cmd, uint32_t len,
+                                struct pool *mem, response *resp)
+{
+        resp->discriminator = SUCCESS;
+
+        if (cmd->discriminator == LOGON) {
+                logon(c, &cmd->u.logon, resp);
+                return 0;
+        }
+
+        if (!c->logged_on) {
+                fail(resp, "not logged on");
+                return 0;
+        }
+
+        switch (cmd->discriminator) {
+        case STATS:
+                resp->discriminator = STATS_RESPONSE;
+                if (!summarise(c->listener->server, mem, &resp->u.stats))
+                        fail(resp, "out of memory");
+                break;
+
+        case JOURNAL_OPEN:
+                bind_devices(c, cmd->u.devices.array, cmd->u.devices.len, resp);
+                break;
+
+        case JOURNAL_CLOSE:
+                bind_devices(c, NULL, 0, resp);
+                break;
+
+        case JOURNAL_FIRST_TRANSACTION:
+                transaction_bound(c, 0, resp);
+                break;
+
+        case JOURNAL_LAST_TRANSACTION:
+                transaction_bound(c, 1, resp);
+                break;
+
+        case JOURNAL_IO:
+                return record_io(c, &cmd->u.io, len, resp);
+
+        case JOURNAL_ROLLBACK:
+                /* duplicates mustn't refer to ios that were never committed */
+                dedup_window_reset(c->window);
+                rollback(c);
+                credit_absorbed(&c->credit);
+                break;
+
+        case JOURNAL_COMMIT:
+                commit(c, resp);
+                credit_absorbed(&c->credit);
+                break;
+
+        case JOURNAL_DROP:
+                journal_drop(c->listener->server->journal, cmd->u.drop.t);
+                break;
+
+        default:
+                break;
+        }
+
+        return 0;
+}
+
+void client_loop(struct client *c)
+{
+        struct server_stats *stats = &c->listener->server->stats;
 
         for (;;) {
                 command *cmd;
                 response resp;
-                uint32_t req_id;
+                uint32_t req_id, len, held;
+                uint64_t arrived;
 
-                if (!read_request(c->socket, c->db, mem, &cmd, &req_id))
+                if (!arena_read_request(c->arena, c->socket, &c->credit, &cmd, &req_id, &len, &arrived))
                         break;
 
-                resp.discriminator = SUCCESS;
-                if (!write_response(c->socket, req_id, &resp))
+                held = process_command(c, cmd, len, c->arena->mem, &resp);
+                credit_complete(&c->credit, len, held);
+
+                if (!arena_write_response(c->arena, c->socket, req_id, &resp))
                         break;
 
-                pool_empty(mem);
+                server_stats_record(stats, cmd->discriminator, len, stats_now() - arrived);
+                c->requests++;
+                c->bytes += len;
+                if (c->credit.held_bytes > c->peak_held)
+                        c->peak_held = c->credit.held_bytes;
+
+                arena_recycle(c->arena);
         }
+
+        destroy_client(c);
 }
 
-void listen_loop(struct server *s)
+void listen_loop(struct listener *l)
 {
+        struct server *s = l->server;
+
         while (!s->stop_requested) {
                 int client;
-                struct sockaddr_in client_address;
-                socklen_t len;
+                struct sockaddr_storage client_address;
+                socklen_t len = sizeof(client_address);
                 struct client *c;
 
-                client = csp_accept(s->listen_socket, (struct sockaddr *) &client_address, &len);
+                client = csp_accept(l->socket, (struct sockaddr *) &client_address, &len);
                 if (client < 0) {
                         fprintf(stderr, "couldn't accept on socket\n");
                         exit(1);
                 }
 
+                if (l->cfg->max_connections && l->nr_clients >= l->cfg->max_connections) {
+                        warn("connection limit (%u) reached on %s, refusing client",
+                             l->cfg->max_connections, l->cfg->address);
+                        close(client);
+                        continue;
+                }
+
+                if (!set_socket_options(s, client))
+                        warn("couldn't set socket buffer sizes");
+
                 c = malloc(sizeof(*c));
                 if (!c) {
                         close(client);
                         break;
                 }
 
+                c->listener = l;
+                c->id = s->next_client_id++;
                 c->socket = client;
-                c->db = dynamic_buffer_create(256 * 1024);
-                if (!c->db) {
+                c->requests = 0;
+                c->bytes = 0;
+                c->peak_held = 0;
+                c->logged_on = 0;
+                c->codec = COMPRESS_NONE;
+                credit_init(&c->credit, LOGON_MESSAGE_SIZE);
+                c->nr_txns = 0;
+                c->txn_ios = 0;
+                memset(&c->dedup, 0, sizeof(c->dedup));
+                c->scratch = NULL;
+                c->scratch_len = 0;
+                c->devices = NULL;
+                c->nr_devices = 0;
+                c->txn = NULL;
+                c->durable = eventfd(0, 0);
+                c->window = dedup_window_create(s->cfg->dedup_window);
+                c->committed = s->cfg->dedup_window ?
+                        calloc(NR_COMMITTED, sizeof(*c->committed)) : NULL;
+                c->arena = arena_create(s->cfg->buffer_size);
+                if (!c->arena || !c->window || (s->cfg->dedup_window && !c->committed) ||
+                    c->durable < 0) {
+                        if (c->arena)
+                                arena_destroy(c->arena);
+                        if (c->window)
+                                dedup_window_destroy(c->window);
+                        free(c->committed);
+                        if (c->durable >= 0)
+                                close(c->durable);
                         free(c);
                         close(client);
                         break;
                 }
 
+                csp_set_non_blocking(c->durable);
+
+                l->nr_clients++;
                 list_add(&s->clients, &c->list);
                 csp_spawn((process_fn) client_loop, c);
         }
 }
 
+/*
+ * Serves a text dump of the stats to anyone who connects, eg,
+ * socat - UNIX-CONNECT:<stats_socket>
+ */
+void stats_loop(struct server *s)
+{
+        while (!s->stop_requested) {
+                int fd;
+                char *text = NULL;
+                size_t len = 0;
+                FILE *fp;
+                stats_summary summary;
+                struct pool *mem;
+
+                fd = csp_accept(s->stats_socket, NULL, NULL);
+                if (fd < 0) {
+                        warn("couldn't accept on stats socket");
+                        break;
+                }
+
+                mem = pool_create("stats", 1024);
+                fp = open_memstream(&text, &len);
+                if (mem && fp && summarise(s, mem, &summary)) {
+                        server_stats_print(fp, &summary);
+                        fclose(fp);
+                        fp = NULL;
+                        csp_write_exact(fd, text, len);
+                }
+
+                if (fp)
+                        fclose(fp);
+                free(text);
+                if (mem)
+                        pool_destroy(mem);
+                close(fd);
+        }
+}
+
 /*
  * Top level
  */
 int main(int argc, char **argv)
 {
+        struct config *cfg;
         struct server *s;
+        struct listener *l;
+
+        cfg = config_create();
+        if (!cfg) {
+                fprintf(stderr, "couldn't allocate config\n");
+                return 1;
+        }
+
+        if (!config_parse_args(cfg, argc, argv)) {
+                config_destroy(cfg);
+                return 1;
+        }
+
+        /* a client disconnecting mid write shouldn't take the server down */
+        signal(SIGPIPE, SIG_IGN);
 
-        log_init(".", DEBUG, EVENT);
+        log_init(cfg->log_dir, cfg->log_level, cfg->log_flush_level);
         csp_init();
 
-        s = prepare_server("localhost", 6776); /* FIXME: get from the command line */
+        s = prepare_server(cfg);
         if (!s) {
                 fprintf(stderr, "couldn't start server\n");
                 return 1;
         }
         event("SERVER_STARTED", "");
 
-        csp_spawn((process_fn) listen_loop, s);
+        list_iterate_items (l, &s->listeners)
+                csp_spawn((process_fn) listen_loop, l);
+        if (s->stats_socket >= 0)
+                csp_spawn((process_fn) stats_loop, s);
         csp_start();
 
+        destroy_server(s);
         csp_exit();
         log_exit();
+        config_destroy(cfg);
 
         return 0;
 }
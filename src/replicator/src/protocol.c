@@ -0,0 +1,1221 @@
+#include "protocol.h"
+#include <string.h>
+
+/*----------------------------------------------------------------*/
+
+int xdr_pack_version(struct xdr_buffer *buf, version *input)
+{
+    if (!xdr_pack_uint(buf, ((*input).major)))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).minor)))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).patch)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_version(struct xdr_cursor *c, struct pool *mem, version *output)
+{
+    if (!xdr_unpack_uint(c, (&((*output).major))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).minor))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).patch))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_version_alloc(struct xdr_cursor *c, struct pool *mem, version **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_version(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_compression(struct xdr_buffer *buf, compression *input)
+{
+    if (!xdr_pack_uint(buf, (uint) (*input)))
+        return 0;
+    return 1;
+}
+
+int xdr_unpack_compression(struct xdr_cursor *c, struct pool *mem, compression *output)
+{
+    if (!xdr_unpack_uint(c, (uint *) output))
+        return 0;
+    return 1;
+}
+int xdr_unpack_compression_alloc(struct xdr_cursor *c, struct pool *mem, compression **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_compression(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_logon_detail(struct xdr_buffer *buf, logon_detail *input)
+{
+    if (!xdr_pack_version(buf, (&((*input).v))))
+        return 0;
+
+    {
+        unsigned int i;
+        if (!xdr_pack_uint(buf, (((*input).codecs).len)))
+            return 0;
+        for (i = 0; i < (((*input).codecs).len); i++) {
+            if (!xdr_pack_compression(buf, (&((((*input).codecs).array)[i]))))
+                return 0;
+
+        }
+    }
+    return 1;
+}
+
+int xdr_unpack_logon_detail(struct xdr_cursor *c, struct pool *mem, logon_detail *output)
+{
+    if (!xdr_unpack_version(c, mem, (&((*output).v))))
+        return 0;
+
+    {
+        unsigned int i;
+        if (!xdr_unpack_uint(c, (&(((*output).codecs).len))))
+            return 0;
+        if ((((*output).codecs).len) > xdr_cursor_remaining(c) / 4)
+            return 0;
+        if (!((((*output).codecs).array) = pool_alloc(mem, sizeof(*(((*output).codecs).array)) * (((*output).codecs).len))))
+            return 0;
+        for (i = 0; i < (((*output).codecs).len); i++) {
+            if (!xdr_unpack_compression(c, mem, (&((((*output).codecs).array)[i]))))
+                return 0;
+
+        }
+    }
+    return 1;
+}
+int xdr_unpack_logon_detail_alloc(struct xdr_cursor *c, struct pool *mem, logon_detail **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_logon_detail(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_device_binding(struct xdr_buffer *buf, device_binding *input)
+{
+    if (!xdr_pack_uint(buf, ((*input).shortname)))
+        return 0;
+
+    {
+        unsigned len = strlen(((*input).logical_name));
+        if (!xdr_pack_uint(buf, len))
+            return 0;
+        if (!xdr_buffer_write(buf, ((*input).logical_name), len))
+            return 0;
+
+    }
+    {
+        unsigned len = strlen(((*input).path));
+        if (!xdr_pack_uint(buf, len))
+            return 0;
+        if (!xdr_buffer_write(buf, ((*input).path), len))
+            return 0;
+
+    }
+    return 1;
+}
+
+int xdr_unpack_device_binding(struct xdr_cursor *c, struct pool *mem, device_binding *output)
+{
+    if (!xdr_unpack_uint(c, (&((*output).shortname))))
+        return 0;
+
+    {
+        uint32_t len;
+        if (!xdr_unpack_uint(c, (&len)))
+            return 0;
+        if (!(((*output).logical_name) = pool_alloc(mem, len + 1)))
+            return 0;
+        if (!xdr_cursor_read(c, ((*output).logical_name), len))
+            return 0;
+        ((*output).logical_name)[len] = '\0';
+
+    }
+    {
+        uint32_t len;
+        if (!xdr_unpack_uint(c, (&len)))
+            return 0;
+        if (!(((*output).path) = pool_alloc(mem, len + 1)))
+            return 0;
+        if (!xdr_cursor_read(c, ((*output).path), len))
+            return 0;
+        ((*output).path)[len] = '\0';
+
+    }
+    return 1;
+}
+int xdr_unpack_device_binding_alloc(struct xdr_cursor *c, struct pool *mem, device_binding **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_device_binding(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_io_detail(struct xdr_buffer *buf, io_detail *input)
+{
+    if (!xdr_pack_uint(buf, ((*input).dev)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).sector)))
+        return 0;
+
+    if (!xdr_pack_compression(buf, (&((*input).codec))))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).len)))
+        return 0;
+
+    {
+        if (!xdr_pack_uint(buf, (((*input).data).len)))
+            return 0;
+        if (!xdr_buffer_write(buf, (void *) (((*input).data).data), (((*input).data).len)))
+            return 0;
+    }
+    return 1;
+}
+
+int xdr_unpack_io_detail(struct xdr_cursor *c, struct pool *mem, io_detail *output)
+{
+    if (!xdr_unpack_uint(c, (&((*output).dev))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).sector))))
+        return 0;
+
+    if (!xdr_unpack_compression(c, mem, (&((*output).codec))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).len))))
+        return 0;
+
+    {
+        if (!xdr_unpack_uint(c, (&(((*output).data).len))))
+            return 0;
+        if ((((*output).data).len) > xdr_cursor_remaining(c))
+            return 0;
+        if (!((((*output).data).data) = pool_alloc(mem, (((*output).data).len))))
+            return 0;
+        if (!xdr_cursor_read(c, (void *) (((*output).data).data), (((*output).data).len)))
+            return 0;
+    }
+    return 1;
+}
+int xdr_unpack_io_detail_alloc(struct xdr_cursor *c, struct pool *mem, io_detail **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_io_detail(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_transaction_id(struct xdr_buffer *buf, transaction_id *input)
+{
+    if (!xdr_pack_hyper(buf, (*input)))
+        return 0;
+    return 1;
+}
+
+int xdr_unpack_transaction_id(struct xdr_cursor *c, struct pool *mem, transaction_id *output)
+{
+    if (!xdr_unpack_hyper(c, output))
+        return 0;
+    return 1;
+}
+int xdr_unpack_transaction_id_alloc(struct xdr_cursor *c, struct pool *mem, transaction_id **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_transaction_id(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_drop_detail(struct xdr_buffer *buf, drop_detail *input)
+{
+    if (!xdr_pack_transaction_id(buf, (&((*input).t))))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_drop_detail(struct xdr_cursor *c, struct pool *mem, drop_detail *output)
+{
+    if (!xdr_unpack_transaction_id(c, mem, (&((*output).t))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_drop_detail_alloc(struct xdr_cursor *c, struct pool *mem, drop_detail **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_drop_detail(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_merge_detail(struct xdr_buffer *buf, merge_detail *input)
+{
+    if (!xdr_pack_transaction_id(buf, (&((*input).t))))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_merge_detail(struct xdr_cursor *c, struct pool *mem, merge_detail *output)
+{
+    if (!xdr_unpack_transaction_id(c, mem, (&((*output).t))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_merge_detail_alloc(struct xdr_cursor *c, struct pool *mem, merge_detail **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_merge_detail(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_command_type(struct xdr_buffer *buf, command_type *input)
+{
+    if (!xdr_pack_uint(buf, (uint) (*input)))
+        return 0;
+    return 1;
+}
+
+int xdr_unpack_command_type(struct xdr_cursor *c, struct pool *mem, command_type *output)
+{
+    if (!xdr_unpack_uint(c, (uint *) output))
+        return 0;
+    return 1;
+}
+int xdr_unpack_command_type_alloc(struct xdr_cursor *c, struct pool *mem, command_type **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_command_type(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_command(struct xdr_buffer *buf, command *input)
+{
+    if (!xdr_pack_command_type(buf, (&((*input).discriminator))))
+        return 0;
+
+
+    switch (((*input).discriminator)) {
+        case LOGON: {
+            if (!xdr_pack_logon_detail(buf, (&(((*input).u).logon))))
+                return 0;
+
+            break;
+        }
+
+        case JOURNAL_OPEN: {
+            {
+                unsigned int i;
+                if (!xdr_pack_uint(buf, ((((*input).u).devices).len)))
+                    return 0;
+                for (i = 0; i < ((((*input).u).devices).len); i++) {
+                    if (!xdr_pack_device_binding(buf, (&(((((*input).u).devices).array)[i]))))
+                        return 0;
+
+                }
+            }
+            break;
+        }
+
+        case JOURNAL_CLOSE: {
+
+            break;
+        }
+
+        case JOURNAL_FIRST_TRANSACTION: {
+
+            break;
+        }
+
+        case JOURNAL_LAST_TRANSACTION: {
+
+            break;
+        }
+
+        case JOURNAL_IO: {
+            if (!xdr_pack_io_detail(buf, (&(((*input).u).io))))
+                return 0;
+
+            break;
+        }
+
+        case JOURNAL_COMMIT: {
+
+            break;
+        }
+
+        case JOURNAL_ROLLBACK: {
+
+            break;
+        }
+
+        case JOURNAL_DROP: {
+            if (!xdr_pack_drop_detail(buf, (&(((*input).u).drop))))
+                return 0;
+
+            break;
+        }
+
+        case MERGE: {
+            if (!xdr_pack_merge_detail(buf, (&(((*input).u).merge))))
+                return 0;
+
+            break;
+        }
+
+        case STATS: {
+
+            break;
+        }
+
+    }
+    return 1;
+}
+
+int xdr_unpack_command(struct xdr_cursor *c, struct pool *mem, command *output)
+{
+    if (!xdr_unpack_command_type(c, mem, (&((*output).discriminator))))
+        return 0;
+    switch (((*output).discriminator)) {
+        case LOGON: {
+            if (!xdr_unpack_logon_detail(c, mem, (&(((*output).u).logon))))
+                return 0;
+
+            break;
+        }
+
+        case JOURNAL_OPEN: {
+            {
+                unsigned int i;
+                if (!xdr_unpack_uint(c, (&((((*output).u).devices).len))))
+                    return 0;
+                if (((((*output).u).devices).len) > xdr_cursor_remaining(c) / 4)
+                    return 0;
+                if (!(((((*output).u).devices).array) = pool_alloc(mem, sizeof(*((((*output).u).devices).array)) * ((((*output).u).devices).len))))
+                    return 0;
+                for (i = 0; i < ((((*output).u).devices).len); i++) {
+                    if (!xdr_unpack_device_binding(c, mem, (&(((((*output).u).devices).array)[i]))))
+                        return 0;
+
+                }
+            }
+            break;
+        }
+
+        case JOURNAL_CLOSE: {
+
+            break;
+        }
+
+        case JOURNAL_FIRST_TRANSACTION: {
+
+            break;
+        }
+
+        case JOURNAL_LAST_TRANSACTION: {
+
+            break;
+        }
+
+        case JOURNAL_IO: {
+            if (!xdr_unpack_io_detail(c, mem, (&(((*output).u).io))))
+                return 0;
+
+            break;
+        }
+
+        case JOURNAL_COMMIT: {
+
+            break;
+        }
+
+        case JOURNAL_ROLLBACK: {
+
+            break;
+        }
+
+        case JOURNAL_DROP: {
+            if (!xdr_unpack_drop_detail(c, mem, (&(((*output).u).drop))))
+                return 0;
+
+            break;
+        }
+
+        case MERGE: {
+            if (!xdr_unpack_merge_detail(c, mem, (&(((*output).u).merge))))
+                return 0;
+
+            break;
+        }
+
+        case STATS: {
+
+            break;
+        }
+
+    }
+    return 1;
+}
+int xdr_unpack_command_alloc(struct xdr_cursor *c, struct pool *mem, command **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_command(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_msg_header(struct xdr_buffer *buf, msg_header *input)
+{
+    if (!xdr_pack_uint(buf, ((*input).msg_size)))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).request_id)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_msg_header(struct xdr_cursor *c, struct pool *mem, msg_header *output)
+{
+    if (!xdr_unpack_uint(c, (&((*output).msg_size))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).request_id))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_msg_header_alloc(struct xdr_cursor *c, struct pool *mem, msg_header **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_msg_header(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_flow_control(struct xdr_buffer *buf, flow_control *input)
+{
+    if (!xdr_pack_uint(buf, ((*input).max_message)))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).bytes)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_flow_control(struct xdr_cursor *c, struct pool *mem, flow_control *output)
+{
+    if (!xdr_unpack_uint(c, (&((*output).max_message))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).bytes))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_flow_control_alloc(struct xdr_cursor *c, struct pool *mem, flow_control **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_flow_control(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_logon_response(struct xdr_buffer *buf, logon_response *input)
+{
+    if (!xdr_pack_flow_control(buf, (&((*input).credit))))
+        return 0;
+
+    if (!xdr_pack_compression(buf, (&((*input).codec))))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_logon_response(struct xdr_cursor *c, struct pool *mem, logon_response *output)
+{
+    if (!xdr_unpack_flow_control(c, mem, (&((*output).credit))))
+        return 0;
+
+    if (!xdr_unpack_compression(c, mem, (&((*output).codec))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_logon_response_alloc(struct xdr_cursor *c, struct pool *mem, logon_response **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_logon_response(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_latency_summary(struct xdr_buffer *buf, latency_summary *input)
+{
+    if (!xdr_pack_uhyper(buf, ((*input).p50)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).p99)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).p999)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).max)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_latency_summary(struct xdr_cursor *c, struct pool *mem, latency_summary *output)
+{
+    if (!xdr_unpack_uhyper(c, (&((*output).p50))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).p99))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).p999))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).max))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_latency_summary_alloc(struct xdr_cursor *c, struct pool *mem, latency_summary **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_latency_summary(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_command_summary(struct xdr_buffer *buf, command_summary *input)
+{
+    if (!xdr_pack_command_type(buf, (&((*input).cmd))))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).count)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).bytes)))
+        return 0;
+
+    if (!xdr_pack_latency_summary(buf, (&((*input).latency))))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_command_summary(struct xdr_cursor *c, struct pool *mem, command_summary *output)
+{
+    if (!xdr_unpack_command_type(c, mem, (&((*output).cmd))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).count))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).bytes))))
+        return 0;
+
+    if (!xdr_unpack_latency_summary(c, mem, (&((*output).latency))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_command_summary_alloc(struct xdr_cursor *c, struct pool *mem, command_summary **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_command_summary(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_connection_summary(struct xdr_buffer *buf, connection_summary *input)
+{
+    if (!xdr_pack_uint(buf, ((*input).id)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).total_requests)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).total_bytes)))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).queued_bytes)))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).held_bytes)))
+        return 0;
+
+    if (!xdr_pack_uint(buf, ((*input).peak_held_bytes)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_connection_summary(struct xdr_cursor *c, struct pool *mem, connection_summary *output)
+{
+    if (!xdr_unpack_uint(c, (&((*output).id))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).total_requests))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).total_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).queued_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).held_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uint(c, (&((*output).peak_held_bytes))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_connection_summary_alloc(struct xdr_cursor *c, struct pool *mem, connection_summary **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_connection_summary(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_dedup_summary(struct xdr_buffer *buf, dedup_summary *input)
+{
+    if (!xdr_pack_uhyper(buf, ((*input).ios)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).zero_ios)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).zero_bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).dup_ios)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).dup_bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).ref_ios)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).ref_bytes)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_dedup_summary(struct xdr_cursor *c, struct pool *mem, dedup_summary *output)
+{
+    if (!xdr_unpack_uhyper(c, (&((*output).ios))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).zero_ios))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).zero_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).dup_ios))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).dup_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).ref_ios))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).ref_bytes))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_dedup_summary_alloc(struct xdr_cursor *c, struct pool *mem, dedup_summary **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_dedup_summary(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_device_summary(struct xdr_buffer *buf, device_summary *input)
+{
+    {
+        unsigned len = strlen(((*input).name));
+        if (!xdr_pack_uint(buf, len))
+            return 0;
+        if (!xdr_buffer_write(buf, ((*input).name), len))
+            return 0;
+
+    }
+    if (!xdr_pack_uhyper(buf, ((*input).journalled_bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).replayed_bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).coalesced_bytes)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_device_summary(struct xdr_cursor *c, struct pool *mem, device_summary *output)
+{
+    {
+        uint32_t len;
+        if (!xdr_unpack_uint(c, (&len)))
+            return 0;
+        if (!(((*output).name) = pool_alloc(mem, len + 1)))
+            return 0;
+        if (!xdr_cursor_read(c, ((*output).name), len))
+            return 0;
+        ((*output).name)[len] = '\0';
+
+    }
+    if (!xdr_unpack_uhyper(c, (&((*output).journalled_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).replayed_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).coalesced_bytes))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_device_summary_alloc(struct xdr_cursor *c, struct pool *mem, device_summary **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_device_summary(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_journal_summary(struct xdr_buffer *buf, journal_summary *input)
+{
+    if (!xdr_pack_uhyper(buf, ((*input).used_bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).capacity_bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).reclaimed_bytes)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).reclaim_rate)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).recycled_segments)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).throttled_commits)))
+        return 0;
+
+    if (!xdr_pack_uhyper(buf, ((*input).stalled_commits)))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_journal_summary(struct xdr_cursor *c, struct pool *mem, journal_summary *output)
+{
+    if (!xdr_unpack_uhyper(c, (&((*output).used_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).capacity_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).reclaimed_bytes))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).reclaim_rate))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).recycled_segments))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).throttled_commits))))
+        return 0;
+
+    if (!xdr_unpack_uhyper(c, (&((*output).stalled_commits))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_journal_summary_alloc(struct xdr_cursor *c, struct pool *mem, journal_summary **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_journal_summary(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_stats_summary(struct xdr_buffer *buf, stats_summary *input)
+{
+    {
+        unsigned int i;
+        if (!xdr_pack_uint(buf, (((*input).commands).len)))
+            return 0;
+        for (i = 0; i < (((*input).commands).len); i++) {
+            if (!xdr_pack_command_summary(buf, (&((((*input).commands).array)[i]))))
+                return 0;
+
+        }
+    }
+    {
+        unsigned int i;
+        if (!xdr_pack_uint(buf, (((*input).connections).len)))
+            return 0;
+        for (i = 0; i < (((*input).connections).len); i++) {
+            if (!xdr_pack_connection_summary(buf, (&((((*input).connections).array)[i]))))
+                return 0;
+
+        }
+    }
+    if (!xdr_pack_dedup_summary(buf, (&((*input).dedup))))
+        return 0;
+
+    {
+        unsigned int i;
+        if (!xdr_pack_uint(buf, (((*input).devices).len)))
+            return 0;
+        for (i = 0; i < (((*input).devices).len); i++) {
+            if (!xdr_pack_device_summary(buf, (&((((*input).devices).array)[i]))))
+                return 0;
+
+        }
+    }
+    if (!xdr_pack_journal_summary(buf, (&((*input).journal))))
+        return 0;
+
+    return 1;
+}
+
+int xdr_unpack_stats_summary(struct xdr_cursor *c, struct pool *mem, stats_summary *output)
+{
+    {
+        unsigned int i;
+        if (!xdr_unpack_uint(c, (&(((*output).commands).len))))
+            return 0;
+        if ((((*output).commands).len) > xdr_cursor_remaining(c) / 4)
+            return 0;
+        if (!((((*output).commands).array) = pool_alloc(mem, sizeof(*(((*output).commands).array)) * (((*output).commands).len))))
+            return 0;
+        for (i = 0; i < (((*output).commands).len); i++) {
+            if (!xdr_unpack_command_summary(c, mem, (&((((*output).commands).array)[i]))))
+                return 0;
+
+        }
+    }
+    {
+        unsigned int i;
+        if (!xdr_unpack_uint(c, (&(((*output).connections).len))))
+            return 0;
+        if ((((*output).connections).len) > xdr_cursor_remaining(c) / 4)
+            return 0;
+        if (!((((*output).connections).array) = pool_alloc(mem, sizeof(*(((*output).connections).array)) * (((*output).connections).len))))
+            return 0;
+        for (i = 0; i < (((*output).connections).len); i++) {
+            if (!xdr_unpack_connection_summary(c, mem, (&((((*output).connections).array)[i]))))
+                return 0;
+
+        }
+    }
+    if (!xdr_unpack_dedup_summary(c, mem, (&((*output).dedup))))
+        return 0;
+
+    {
+        unsigned int i;
+        if (!xdr_unpack_uint(c, (&(((*output).devices).len))))
+            return 0;
+        if ((((*output).devices).len) > xdr_cursor_remaining(c) / 4)
+            return 0;
+        if (!((((*output).devices).array) = pool_alloc(mem, sizeof(*(((*output).devices).array)) * (((*output).devices).len))))
+            return 0;
+        for (i = 0; i < (((*output).devices).len); i++) {
+            if (!xdr_unpack_device_summary(c, mem, (&((((*output).devices).array)[i]))))
+                return 0;
+
+        }
+    }
+    if (!xdr_unpack_journal_summary(c, mem, (&((*output).journal))))
+        return 0;
+
+    return 1;
+}
+int xdr_unpack_stats_summary_alloc(struct xdr_cursor *c, struct pool *mem, stats_summary **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_stats_summary(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_response_code(struct xdr_buffer *buf, response_code *input)
+{
+    if (!xdr_pack_uint(buf, (uint) (*input)))
+        return 0;
+    return 1;
+}
+
+int xdr_unpack_response_code(struct xdr_cursor *c, struct pool *mem, response_code *output)
+{
+    if (!xdr_unpack_uint(c, (uint *) output))
+        return 0;
+    return 1;
+}
+int xdr_unpack_response_code_alloc(struct xdr_cursor *c, struct pool *mem, response_code **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_response_code(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+int xdr_pack_response(struct xdr_buffer *buf, response *input)
+{
+    if (!xdr_pack_response_code(buf, (&((*input).discriminator))))
+        return 0;
+
+
+    switch (((*input).discriminator)) {
+        case SUCCESS: {
+
+            break;
+        }
+
+        case FAIL: {
+            {
+                unsigned len = strlen((((*input).u).reason));
+                if (!xdr_pack_uint(buf, len))
+                    return 0;
+                if (!xdr_buffer_write(buf, (((*input).u).reason), len))
+                    return 0;
+
+            }
+            break;
+        }
+
+        case TRANSACTION_RESPONSE: {
+            if (!xdr_pack_hyper(buf, (((*input).u).transaction_id)))
+                return 0;
+
+            break;
+        }
+
+        case LOGON_RESPONSE: {
+            if (!xdr_pack_logon_response(buf, (&(((*input).u).logon))))
+                return 0;
+
+            break;
+        }
+
+        case STATS_RESPONSE: {
+            if (!xdr_pack_stats_summary(buf, (&(((*input).u).stats))))
+                return 0;
+
+            break;
+        }
+
+        case IO_RESPONSE: {
+            if (!xdr_pack_uint(buf, (((*input).u).released)))
+                return 0;
+
+            break;
+        }
+
+    }
+    return 1;
+}
+
+int xdr_unpack_response(struct xdr_cursor *c, struct pool *mem, response *output)
+{
+    if (!xdr_unpack_response_code(c, mem, (&((*output).discriminator))))
+        return 0;
+    switch (((*output).discriminator)) {
+        case SUCCESS: {
+
+            break;
+        }
+
+        case FAIL: {
+            {
+                uint32_t len;
+                if (!xdr_unpack_uint(c, (&len)))
+                    return 0;
+                if (!((((*output).u).reason) = pool_alloc(mem, len + 1)))
+                    return 0;
+                if (!xdr_cursor_read(c, (((*output).u).reason), len))
+                    return 0;
+                (((*output).u).reason)[len] = '\0';
+
+            }
+            break;
+        }
+
+        case TRANSACTION_RESPONSE: {
+            if (!xdr_unpack_hyper(c, (&(((*output).u).transaction_id))))
+                return 0;
+
+            break;
+        }
+
+        case LOGON_RESPONSE: {
+            if (!xdr_unpack_logon_response(c, mem, (&(((*output).u).logon))))
+                return 0;
+
+            break;
+        }
+
+        case STATS_RESPONSE: {
+            if (!xdr_unpack_stats_summary(c, mem, (&(((*output).u).stats))))
+                return 0;
+
+            break;
+        }
+
+        case IO_RESPONSE: {
+            if (!xdr_unpack_uint(c, (&(((*output).u).released))))
+                return 0;
+
+            break;
+        }
+
+    }
+    return 1;
+}
+int xdr_unpack_response_alloc(struct xdr_cursor *c, struct pool *mem, response **output)
+{
+    *output = pool_alloc(mem, sizeof(**output));
+    if (!*output)
+        return 0;
+
+    if (!xdr_unpack_response(c, mem, *output))
+        return 0;
+
+    return 1;
+}
+
+/*----------------------------------------------------------------*/
+
@@ -0,0 +1,288 @@
+#ifndef XDR_OUTPUT_1629304108_H
+#define XDR_OUTPUT_1629304108_H
+
+#include "xdr/xdr.h"
+#include "mm/pool.h"
+
+/*----------------------------------------------------------------*/
+
+typedef struct {
+    uint32_t major;
+    uint32_t minor;
+    uint32_t patch;
+} version;
+
+typedef enum {
+    COMPRESS_NONE,
+    COMPRESS_LZ4,
+    COMPRESS_ZSTD,
+} compression;
+
+typedef struct {
+    version v;
+    struct {
+        compression *array;
+        uint32_t len;
+    } codecs;
+} logon_detail;
+
+typedef struct {
+    uint32_t shortname;
+    char *logical_name;
+    char *path;
+} device_binding;
+
+typedef struct {
+    uint32_t dev;
+    uint64_t sector;
+    compression codec;
+    uint32_t len;
+    struct {
+        uint8_t *data;
+        uint32_t len;
+    } data;
+} io_detail;
+
+typedef int64_t transaction_id;
+
+typedef struct {
+    transaction_id t;
+} drop_detail;
+
+typedef struct {
+    transaction_id t;
+} merge_detail;
+
+typedef enum {
+    LOGON,
+    JOURNAL_OPEN,
+    JOURNAL_CLOSE,
+    JOURNAL_FIRST_TRANSACTION,
+    JOURNAL_LAST_TRANSACTION,
+    JOURNAL_IO,
+    JOURNAL_COMMIT,
+    JOURNAL_ROLLBACK,
+    JOURNAL_DROP,
+    MERGE,
+    STATS,
+} command_type;
+
+typedef struct {
+    command_type discriminator;
+    union {
+        logon_detail logon;
+        struct {
+            device_binding *array;
+            uint32_t len;
+        } devices;
+
+
+
+        io_detail io;
+
+
+        drop_detail drop;
+        merge_detail merge;
+
+
+    } u;
+} command;
+
+typedef struct {
+    uint32_t msg_size;
+    uint32_t request_id;
+} msg_header;
+
+typedef struct {
+    uint32_t max_message;
+    uint32_t bytes;
+} flow_control;
+
+typedef struct {
+    flow_control credit;
+    compression codec;
+} logon_response;
+
+typedef struct {
+    uint64_t p50;
+    uint64_t p99;
+    uint64_t p999;
+    uint64_t max;
+} latency_summary;
+
+typedef struct {
+    command_type cmd;
+    uint64_t count;
+    uint64_t bytes;
+    latency_summary latency;
+} command_summary;
+
+typedef struct {
+    uint32_t id;
+    uint64_t total_requests;
+    uint64_t total_bytes;
+    uint32_t queued_bytes;
+    uint32_t held_bytes;
+    uint32_t peak_held_bytes;
+} connection_summary;
+
+typedef struct {
+    uint64_t ios;
+    uint64_t bytes;
+    uint64_t zero_ios;
+    uint64_t zero_bytes;
+    uint64_t dup_ios;
+    uint64_t dup_bytes;
+    uint64_t ref_ios;
+    uint64_t ref_bytes;
+} dedup_summary;
+
+typedef struct {
+    char *name;
+    uint64_t journalled_bytes;
+    uint64_t replayed_bytes;
+    uint64_t coalesced_bytes;
+} device_summary;
+
+typedef struct {
+    uint64_t used_bytes;
+    uint64_t capacity_bytes;
+    uint64_t reclaimed_bytes;
+    uint64_t reclaim_rate;
+    uint64_t recycled_segments;
+    uint64_t throttled_commits;
+    uint64_t stalled_commits;
+} journal_summary;
+
+typedef struct {
+    struct {
+        command_summary *array;
+        uint32_t len;
+    } commands;
+    struct {
+        connection_summary *array;
+        uint32_t len;
+    } connections;
+    dedup_summary dedup;
+    struct {
+        device_summary *array;
+        uint32_t len;
+    } devices;
+    journal_summary journal;
+} stats_summary;
+
+typedef enum {
+    SUCCESS,
+    FAIL,
+    TRANSACTION_RESPONSE,
+    LOGON_RESPONSE,
+    STATS_RESPONSE,
+    IO_RESPONSE,
+} response_code;
+
+typedef struct {
+    response_code discriminator;
+    union {
+
+        char *reason;
+        int64_t transaction_id;
+        logon_response logon;
+        stats_summary stats;
+        uint32_t released;
+
+    } u;
+} response;
+
+/*----------------------------------------------------------------*/
+
+int xdr_pack_version(struct xdr_buffer *buf, version *input);
+int xdr_unpack_version(struct xdr_cursor *c, struct pool *mem, version *output);
+int xdr_unpack_version_alloc(struct xdr_cursor *c, struct pool *mem, version **output);
+
+int xdr_pack_compression(struct xdr_buffer *buf, compression *input);
+int xdr_unpack_compression(struct xdr_cursor *c, struct pool *mem, compression *output);
+int xdr_unpack_compression_alloc(struct xdr_cursor *c, struct pool *mem, compression **output);
+
+int xdr_pack_logon_detail(struct xdr_buffer *buf, logon_detail *input);
+int xdr_unpack_logon_detail(struct xdr_cursor *c, struct pool *mem, logon_detail *output);
+int xdr_unpack_logon_detail_alloc(struct xdr_cursor *c, struct pool *mem, logon_detail **output);
+
+int xdr_pack_device_binding(struct xdr_buffer *buf, device_binding *input);
+int xdr_unpack_device_binding(struct xdr_cursor *c, struct pool *mem, device_binding *output);
+int xdr_unpack_device_binding_alloc(struct xdr_cursor *c, struct pool *mem, device_binding **output);
+
+int xdr_pack_io_detail(struct xdr_buffer *buf, io_detail *input);
+int xdr_unpack_io_detail(struct xdr_cursor *c, struct pool *mem, io_detail *output);
+int xdr_unpack_io_detail_alloc(struct xdr_cursor *c, struct pool *mem, io_detail **output);
+
+int xdr_pack_transaction_id(struct xdr_buffer *buf, transaction_id *input);
+int xdr_unpack_transaction_id(struct xdr_cursor *c, struct pool *mem, transaction_id *output);
+int xdr_unpack_transaction_id_alloc(struct xdr_cursor *c, struct pool *mem, transaction_id **output);
+
+int xdr_pack_drop_detail(struct xdr_buffer *buf, drop_detail *input);
+int xdr_unpack_drop_detail(struct xdr_cursor *c, struct pool *mem, drop_detail *output);
+int xdr_unpack_drop_detail_alloc(struct xdr_cursor *c, struct pool *mem, drop_detail **output);
+
+int xdr_pack_merge_detail(struct xdr_buffer *buf, merge_detail *input);
+int xdr_unpack_merge_detail(struct xdr_cursor *c, struct pool *mem, merge_detail *output);
+int xdr_unpack_merge_detail_alloc(struct xdr_cursor *c, struct pool *mem, merge_detail **output);
+
+int xdr_pack_command_type(struct xdr_buffer *buf, command_type *input);
+int xdr_unpack_command_type(struct xdr_cursor *c, struct pool *mem, command_type *output);
+int xdr_unpack_command_type_alloc(struct xdr_cursor *c, struct pool *mem, command_type **output);
+
+int xdr_pack_command(struct xdr_buffer *buf, command *input);
+int xdr_unpack_command(struct xdr_cursor *c, struct pool *mem, command *output);
+int xdr_unpack_command_alloc(struct xdr_cursor *c, struct pool *mem, command **output);
+
+int xdr_pack_msg_header(struct xdr_buffer *buf, msg_header *input);
+int xdr_unpack_msg_header(struct xdr_cursor *c, struct pool *mem, msg_header *output);
+int xdr_unpack_msg_header_alloc(struct xdr_cursor *c, struct pool *mem, msg_header **output);
+
+int xdr_pack_flow_control(struct xdr_buffer *buf, flow_control *input);
+int xdr_unpack_flow_control(struct xdr_cursor *c, struct pool *mem, flow_control *output);
+int xdr_unpack_flow_control_alloc(struct xdr_cursor *c, struct pool *mem, flow_control **output);
+
+int xdr_pack_logon_response(struct xdr_buffer *buf, logon_response *input);
+int xdr_unpack_logon_response(struct xdr_cursor *c, struct pool *mem, logon_response *output);
+int xdr_unpack_logon_response_alloc(struct xdr_cursor *c, struct pool *mem, logon_response **output);
+
+int xdr_pack_latency_summary(struct xdr_buffer *buf, latency_summary *input);
+int xdr_unpack_latency_summary(struct xdr_cursor *c, struct pool *mem, latency_summary *output);
+int xdr_unpack_latency_summary_alloc(struct xdr_cursor *c, struct pool *mem, latency_summary **output);
+
+int xdr_pack_command_summary(struct xdr_buffer *buf, command_summary *input);
+int xdr_unpack_command_summary(struct xdr_cursor *c, struct pool *mem, command_summary *output);
+int xdr_unpack_command_summary_alloc(struct xdr_cursor *c, struct pool *mem, command_summary **output);
+
+int xdr_pack_connection_summary(struct xdr_buffer *buf, connection_summary *input);
+int xdr_unpack_connection_summary(struct xdr_cursor *c, struct pool *mem, connection_summary *output);
+int xdr_unpack_connection_summary_alloc(struct xdr_cursor *c, struct pool *mem, connection_summary **output);
+
+int xdr_pack_dedup_summary(struct xdr_buffer *buf, dedup_summary *input);
+int xdr_unpack_dedup_summary(struct xdr_cursor *c, struct pool *mem, dedup_summary *output);
+int xdr_unpack_dedup_summary_alloc(struct xdr_cursor *c, struct pool *mem, dedup_summary **output);
+
+int xdr_pack_device_summary(struct xdr_buffer *buf, device_summary *input);
+int xdr_unpack_device_summary(struct xdr_cursor *c, struct pool *mem, device_summary *output);
+int xdr_unpack_device_summary_alloc(struct xdr_cursor *c, struct pool *mem, device_summary **output);
+
+int xdr_pack_journal_summary(struct xdr_buffer *buf, journal_summary *input);
+int xdr_unpack_journal_summary(struct xdr_cursor *c, struct pool *mem, journal_summary *output);
+int xdr_unpack_journal_summary_alloc(struct xdr_cursor *c, struct pool *mem, journal_summary **output);
+
+int xdr_pack_stats_summary(struct xdr_buffer *buf, stats_summary *input);
+int xdr_unpack_stats_summary(struct xdr_cursor *c, struct pool *mem, stats_summary *output);
+int xdr_unpack_stats_summary_alloc(struct xdr_cursor *c, struct pool *mem, stats_summary **output);
+
+int xdr_pack_response_code(struct xdr_buffer *buf, response_code *input);
+int xdr_unpack_response_code(struct xdr_cursor *c, struct pool *mem, response_code *output);
+int xdr_unpack_response_code_alloc(struct xdr_cursor *c, struct pool *mem, response_code **output);
+
+int xdr_pack_response(struct xdr_buffer *buf, response *input);
+int xdr_unpack_response(struct xdr_cursor *c, struct pool *mem, response *output);
+int xdr_unpack_response_alloc(struct xdr_cursor *c, struct pool *mem, response **output);
+
+/*----------------------------------------------------------------*/
+
+#endif
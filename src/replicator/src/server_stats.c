@@ -0,0 +1,160 @@
+#include "server_stats.h"
+
+#include <string.h>
+#include <time.h>
+
+/*----------------------------------------------------------------*/
+
+static const char *command_names_[NR_COMMAND_TYPES] = {
+        "LOGON",
+        "JOURNAL_OPEN",
+        "JOURNAL_CLOSE",
+        "JOURNAL_FIRST_TRANSACTION",
+        "JOURNAL_LAST_TRANSACTION",
+        "JOURNAL_IO",
+        "JOURNAL_COMMIT",
+        "JOURNAL_ROLLBACK",
+        "JOURNAL_DROP",
+        "MERGE",
+        "STATS"
+};
+
+void server_stats_init(struct server_stats *s)
+{
+        unsigned i;
+
+        for (i = 0; i < NR_COMMAND_TYPES; i++) {
+                s->commands[i].count = 0;
+                s->commands[i].bytes = 0;
+                histogram_init(&s->commands[i].latency);
+        }
+}
+
+const char *command_name(command_type cmd)
+{
+        return (unsigned) cmd < NR_COMMAND_TYPES ? command_names_[cmd] : "UNKNOWN";
+}
+
+uint64_t stats_now()
+{
+        struct timespec ts;
+
+        clock_gettime(CLOCK_MONOTONIC, &ts);
+        return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+void server_stats_record(struct server_stats *s, command_type cmd,
+                         uint32_t bytes, uint64_t latency)
+{
+        struct command_stats *cs;
+
+        if ((unsigned) cmd >= NR_COMMAND_TYPES)
+                return;
+
+        cs = s->commands + cmd;
+        cs->count++;
+        cs->bytes += bytes;
+        histogram_record(&cs->latency, latency);
+}
+
+int server_stats_summarise(struct server_stats *s, struct pool *mem, stats_summary *summary)
+{
+        unsigned i;
+
+        summary->commands.len = NR_COMMAND_TYPES;
+        summary->commands.array = pool_alloc(mem, sizeof(*summary->commands.array) * NR_COMMAND_TYPES);
+        if (!summary->commands.array)
+                return 0;
+
+        for (i = 0; i < NR_COMMAND_TYPES; i++) {
+                struct command_stats *cs = s->commands + i;
+                command_summary *out = summary->commands.array + i;
+
+                out->cmd = i;
+                out->count = cs->count;
+                out->bytes = cs->bytes;
+                out->latency.p50 = histogram_percentile(&cs->latency, 50.0);
+                out->latency.p99 = histogram_percentile(&cs->latency, 99.0);
+                out->latency.p999 = histogram_percentile(&cs->latency, 99.9);
+                out->latency.max = cs->latency.max;
+        }
+
+        return 1;
+}
+
+static double usecs(uint64_t ns)
+{
+        return ns / 1000.0;
+}
+
+static double percent(uint64_t n, uint64_t total)
+{
+        return total ? 100.0 * n / total : 0.0;
+}
+
+void server_stats_print(FILE *fp, stats_summary *summary)
+{
+        unsigned i;
+        dedup_summary *d = &summary->dedup;
+        journal_summary *j = &summary->journal;
+
+        fprintf(fp, "%-26s %12s %14s %10s %10s %10s %10s\n",
+                "command", "count", "bytes", "p50 us", "p99 us", "p99.9 us", "max us");
+        for (i = 0; i < summary->commands.len; i++) {
+                command_summary *cs = summary->commands.array + i;
+
+                if (!cs->count)
+                        continue;
+
+                fprintf(fp, "%-26s %12llu %14llu %10.1f %10.1f %10.1f %10.1f\n",
+                        command_name(cs->cmd),
+                        (unsigned long long) cs->count, (unsigned long long) cs->bytes,
+                        usecs(cs->latency.p50), usecs(cs->latency.p99),
+                        usecs(cs->latency.p999), usecs(cs->latency.max));
+        }
+
+        fprintf(fp, "\n%-10s %12s %14s %12s %12s %12s\n",
+                "connection", "total reqs", "total bytes", "queued", "held", "peak held");
+        for (i = 0; i < summary->connections.len; i++) {
+                connection_summary *c = summary->connections.array + i;
+
+                fprintf(fp, "%-10u %12llu %14llu %12u %12u %12u\n",
+                        c->id, (unsigned long long) c->total_requests,
+                        (unsigned long long) c->total_bytes,
+                        c->queued_bytes, c->held_bytes, c->peak_held_bytes);
+        }
+
+        fprintf(fp, "\ndedup: %llu ios, %llu zero (%.1f%% of bytes), %llu repeats "
+                "(%.1f%% of bytes), %llu journalled as references (%.1f%% of bytes)\n",
+                (unsigned long long) d->ios,
+                (unsigned long long) d->zero_ios, percent(d->zero_bytes, d->bytes),
+                (unsigned long long) d->dup_ios, percent(d->dup_bytes, d->bytes),
+                (unsigned long long) d->ref_ios, percent(d->ref_bytes, d->bytes));
+
+        fprintf(fp, "journal: %llu bytes used", (unsigned long long) j->used_bytes);
+        if (j->capacity_bytes)
+                fprintf(fp, " (%.1f%% of %llu)", percent(j->used_bytes, j->capacity_bytes),
+                        (unsigned long long) j->capacity_bytes);
+        fprintf(fp, ", %llu reclaimed at %llu bytes/s, %llu segments recycled, "
+                "%llu commits throttled, %llu stalled\n",
+                (unsigned long long) j->reclaimed_bytes, (unsigned long long) j->reclaim_rate,
+                (unsigned long long) j->recycled_segments,
+                (unsigned long long) j->throttled_commits, (unsigned long long) j->stalled_commits);
+
+        if (!summary->devices.len)
+                return;
+
+        fprintf(fp, "\n%-20s %14s %14s %14s %10s\n",
+                "device", "journalled", "replayed", "coalesced", "saved");
+        for (i = 0; i < summary->devices.len; i++) {
+                device_summary *ds = summary->devices.array + i;
+
+                fprintf(fp, "%-20s %14llu %14llu %14llu %9.1f%%\n", ds->name,
+                        (unsigned long long) ds->journalled_bytes,
+                        (unsigned long long) ds->replayed_bytes,
+                        (unsigned long long) ds->coalesced_bytes,
+                        percent(ds->coalesced_bytes, ds->replayed_bytes + ds->coalesced_bytes));
+        }
+}
+
+/*----------------------------------------------------------------*/
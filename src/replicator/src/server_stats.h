@@ -0,0 +1,49 @@
+#ifndef REPLICATOR_SERVER_STATS_H
+#define REPLICATOR_SERVER_STATS_H
+
+#include "protocol.h"
+#include "stats/histogram.h"
+
+#include <stdio.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Per command type counts, bytes and latency histograms.  Everything
+ * runs in the one csp thread, so there's no locking.
+ */
+enum {
+        NR_COMMAND_TYPES = STATS + 1
+};
+
+struct command_stats {
+        uint64_t count;
+        uint64_t bytes;
+        struct histogram latency;
+};
+
+struct server_stats {
+        struct command_stats commands[NR_COMMAND_TYPES];
+};
+
+void server_stats_init(struct server_stats *s);
+const char *command_name(command_type cmd);
+
+/* monotonic nanoseconds, for timing requests */
+uint64_t stats_now();
+
+void server_stats_record(struct server_stats *s, command_type cmd,
+                         uint32_t bytes, uint64_t latency);
+
+/*
+ * Fills in the command part of a summary, allocating from |mem|.  The
+ * caller fills in the connections and dedup counters.
+ */
+int server_stats_summarise(struct server_stats *s, struct pool *mem, stats_summary *summary);
+
+/* The text form served on the stats socket */
+void server_stats_print(FILE *fp, stats_summary *summary);
+
+/*----------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,240 @@
+#include "arena.h"
+#include "credit.h"
+#include "csp/control.h"
+#include "csp/process.h"
+#include "protocol.h"
+#include "server_stats.h"
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/*
+ * Runs requests over a socket through the server's request path,
+ * arena_read_request() and arena_write_response(), with the rest of
+ * what client_loop() does around them, and checks that once it's
+ * warmed up nothing calls malloc.  The commands are answered by a stub
+ * rather than process_command(), which hands ios to the journal.
+ */
+
+/*----------------------------------------------------------------*/
+
+/* allocation counting hook, see the -Wl,--wrap flags in the Makefile */
+static int counting_ = 0;
+static unsigned long allocations_ = 0;
+
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+
+void *__wrap_malloc(size_t size)
+{
+        if (counting_)
+                allocations_++;
+        return __real_malloc(size);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+        if (counting_)
+                allocations_++;
+        return __real_calloc(n, size);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+        if (counting_)
+                allocations_++;
+        return __real_realloc(ptr, size);
+}
+
+/*----------------------------------------------------------------*/
+
+enum {
+        NR_REQUESTS = 5,
+        ITERATIONS = 1000
+};
+
+struct raw {
+        unsigned char *data;
+        size_t len;
+};
+
+/* framed, with its msg_header in front */
+static void pack_command(command *cmd, struct raw *raw)
+{
+        uint32_t header[2];
+        struct xdr_buffer *b = xdr_buffer_create(128);
+
+        assert(b);
+        assert(xdr_pack_command(b, cmd));
+        header[0] = htonl(xdr_buffer_size(b));
+        header[1] = 0;
+        raw->len = sizeof(header) + xdr_buffer_size(b);
+        raw->data = malloc(raw->len);
+        assert(raw->data);
+        memcpy(raw->data, header, sizeof(header));
+        xdr_buffer_copy(b, raw->data + sizeof(header));
+        xdr_buffer_destroy(b);
+}
+
+static void pack_io(struct raw *raw, uint32_t len)
+{
+        command cmd;
+        uint8_t *data = malloc(len);
+
+        assert(data);
+        memset(data, len & 0xff, len);
+        cmd.discriminator = JOURNAL_IO;
+        cmd.u.io.dev = 1;
+        cmd.u.io.sector = 0;
+        cmd.u.io.codec = COMPRESS_NONE;
+        cmd.u.io.len = len;
+        cmd.u.io.data.data = data;
+        cmd.u.io.data.len = len;
+        pack_command(&cmd, raw);
+        free(data);
+}
+
+static void prepare(struct raw *requests)
+{
+        command cmd;
+        compression codec = COMPRESS_LZ4;
+
+        cmd.discriminator = LOGON;
+        cmd.u.logon.v.major = 1;
+        cmd.u.logon.v.minor = 1;
+        cmd.u.logon.v.patch = 1;
+        cmd.u.logon.codecs.array = &codec;
+        cmd.u.logon.codecs.len = 1;
+        pack_command(&cmd, requests + 0);
+
+        pack_io(requests + 1, 4096);
+        pack_io(requests + 2, 65536);
+        pack_io(requests + 3, 512);
+
+        cmd.discriminator = JOURNAL_COMMIT;
+        pack_command(&cmd, requests + 4);
+}
+
+struct connection {
+        int client;
+        int server;
+        struct request_arena *arena;
+        struct credit_budget budget;
+        struct credit credit;
+        struct server_stats stats;
+        unsigned char response[256];
+};
+
+/* stands in for process_command() */
+static void answer(command *cmd, response *resp)
+{
+        switch (cmd->discriminator) {
+        case LOGON:
+                resp->discriminator = LOGON_RESPONSE;
+                resp->u.logon.credit.max_message = 1 << 22;
+                resp->u.logon.credit.bytes = 1 << 24;
+                resp->u.logon.codec = cmd->u.logon.codecs.array[0];
+                break;
+
+        case JOURNAL_IO:
+                assert(cmd->u.io.data.len == cmd->u.io.len);
+                assert(cmd->u.io.data.data[cmd->u.io.len - 1] == (cmd->u.io.len & 0xff));
+                resp->discriminator = SUCCESS;
+                break;
+
+        default:
+                resp->discriminator = FAIL;
+                resp->u.reason = "not yet";
+                break;
+        }
+}
+
+/* client_loop(), once round, with the client's side of the socket */
+static void serve(struct connection *c, uint32_t req_id, struct raw *raw)
+{
+        command *cmd;
+        response resp;
+        uint32_t header[2], id, len;
+        uint64_t arrived;
+
+        ((uint32_t *) raw->data)[1] = htonl(req_id);
+        assert(write(c->client, raw->data, raw->len) == (ssize_t) raw->len);
+
+        assert(arena_read_request(c->arena, c->server, &c->credit, &cmd, &id, &len, &arrived));
+        assert(id == req_id);
+        assert(len == raw->len - sizeof(header));
+
+        answer(cmd, &resp);
+        credit_complete(&c->credit, len, 0);
+        assert(arena_write_response(c->arena, c->server, req_id, &resp));
+        server_stats_record(&c->stats, cmd->discriminator, len, stats_now() - arrived);
+        arena_recycle(c->arena);
+
+        assert(read(c->client, header, sizeof(header)) == sizeof(header));
+        assert(ntohl(header[1]) == req_id);
+        assert(ntohl(header[0]) <= sizeof(c->response));
+        assert(read(c->client, c->response, ntohl(header[0])) == (ssize_t) ntohl(header[0]));
+        assert(ntohl(*(uint32_t *) c->response) == resp.discriminator);
+}
+
+static void steady_state(void *context)
+{
+        unsigned i, j;
+        int fds[2];
+        struct raw requests[NR_REQUESTS];
+
+        /* the histograms are too big for a process's stack */
+        static struct connection c;
+
+        assert(!socketpair(AF_UNIX, SOCK_STREAM, 0, fds));
+        c.client = fds[0];
+        c.server = fds[1];
+        c.arena = arena_create(1024);
+        assert(c.arena);
+        credit_budget_init(&c.budget, 1 << 30);
+        credit_init(&c.credit, 1 << 20);
+        assert(credit_grant(&c.credit, &c.budget, 1 << 22, 1 << 24));
+        server_stats_init(&c.stats);
+        prepare(requests);
+
+        /* warm up, the arena grows to fit the largest messages */
+        for (j = 0; j < NR_REQUESTS; j++)
+                serve(&c, j, requests + j);
+
+        counting_ = 1;
+        for (i = 0; i < ITERATIONS; i++)
+                for (j = 0; j < NR_REQUESTS; j++)
+                        serve(&c, i * NR_REQUESTS + j, requests + j);
+        counting_ = 0;
+
+        if (allocations_)
+                fprintf(stderr, "%lu allocations in the steady state\n", allocations_);
+        assert(!allocations_);
+
+        for (j = 0; j < NR_REQUESTS; j++)
+                free(requests[j].data);
+        credit_release(&c.credit);
+        arena_destroy(c.arena);
+        close(c.client);
+        close(c.server);
+}
+
+void test_steady_state_does_not_allocate()
+{
+        csp_init();
+        csp_spawn(steady_state, NULL);
+        csp_start();
+        csp_exit();
+}
+
+int main(int argc, char **argv)
+{
+        test_steady_state_does_not_allocate();
+        return 0;
+}
@@ -0,0 +1,269 @@
+#include "mm/pool.h"
+#include "protocol.h"
+#include "xdr/xdr.h"
+
+#include <arpa/inet.h>
+#include <assert.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/prctl.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+/*
+ * Runs the real server, and talks to it over a unix socket the way a
+ * client would, sticking to the window it's granted.
+ */
+
+/*----------------------------------------------------------------*/
+
+enum {
+        CREDIT_BYTES = 1 << 20,
+        SPILL_THRESHOLD = 256 << 10,
+        IO_SIZE = 64 << 10,
+        NR_IOS = 64             /* 4m, four times the window */
+};
+
+struct server {
+        char dir[64];
+        char socket[128];
+        pid_t pid;
+};
+
+static void start_server(struct server *s)
+{
+        char journal[128], listen[160], credit[32], spill[32];
+
+        strcpy(s->dir, "/tmp/server_t.XXXXXX");
+        assert(mkdtemp(s->dir));
+        snprintf(s->socket, sizeof(s->socket), "%s/socket", s->dir);
+        snprintf(journal, sizeof(journal), "%s/journal", s->dir);
+        snprintf(listen, sizeof(listen), "unix:%s", s->socket);
+        snprintf(credit, sizeof(credit), "%u", CREDIT_BYTES);
+        snprintf(spill, sizeof(spill), "%u", SPILL_THRESHOLD);
+        assert(!mkdir(journal, 0700));
+
+        s->pid = fork();
+        assert(s->pid >= 0);
+        if (!s->pid) {
+                /* don't outlive a failed assertion */
+                prctl(PR_SET_PDEATHSIG, SIGKILL);
+                execl("../../../bin/replicator", "replicator",
+                      "--listen", listen, "--journal-dir", journal, "--log-dir", s->dir,
+                      "--max-message-size", "128k", "--credit-bytes", credit,
+                      "--journal-spill-threshold", spill, (char *) NULL);
+                _exit(127);
+        }
+}
+
+static void stop_server(struct server *s)
+{
+        char cmd[128];
+        int status;
+
+        kill(s->pid, SIGKILL);
+        assert(waitpid(s->pid, &status, 0) == s->pid);
+
+        snprintf(cmd, sizeof(cmd), "rm -rf %s", s->dir);
+        assert(!system(cmd));
+}
+
+/* the server takes a moment to start listening */
+static int connect_server(struct server *s)
+{
+        unsigned i;
+        struct sockaddr_un addr;
+        int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+
+        assert(fd >= 0);
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strcpy(addr.sun_path, s->socket);
+
+        for (i = 0; i < 500; i++) {
+                if (!connect(fd, (struct sockaddr *) &addr, sizeof(addr)))
+                        return fd;
+                usleep(10000);
+        }
+
+        assert(!"couldn't connect to the server");
+        return -1;
+}
+
+/*----------------------------------------------------------------*/
+
+static void write_all(int fd, const void *data, size_t len)
+{
+        const unsigned char *p = data;
+
+        while (len) {
+                ssize_t n = write(fd, p, len);
+                assert(n > 0);
+                p += n;
+                len -= n;
+        }
+}
+
+static void read_all(int fd, void *data, size_t len)
+{
+        unsigned char *p = data;
+
+        while (len) {
+                ssize_t n = read(fd, p, len);
+                assert(n > 0);
+                p += n;
+                len -= n;
+        }
+}
+
+/* returns the length of the framed request */
+static uint32_t send_command(int fd, command *cmd, uint32_t req_id)
+{
+        uint32_t header[2];
+        unsigned char *body;
+        struct xdr_buffer *b = xdr_buffer_create(128);
+
+        assert(b);
+        assert(xdr_pack_command(b, cmd));
+        header[0] = htonl(xdr_buffer_size(b));
+        header[1] = htonl(req_id);
+        body = malloc(xdr_buffer_size(b));
+        assert(body);
+        xdr_buffer_copy(b, body);
+
+        write_all(fd, header, sizeof(header));
+        write_all(fd, body, xdr_buffer_size(b));
+
+        free(body);
+        xdr_buffer_destroy(b);
+        return sizeof(header) + ntohl(header[0]);
+}
+
+static response *read_response(int fd, struct pool *mem)
+{
+        uint32_t header[2];
+        void *body;
+        response *resp;
+
+        read_all(fd, header, sizeof(header));
+        body = pool_alloc(mem, ntohl(header[0]));
+        assert(body);
+        read_all(fd, body, ntohl(header[0]));
+        assert(xdr_unpack_using(response_alloc, body, ntohl(header[0]), mem, &resp));
+
+        if (resp->discriminator == FAIL)
+                fprintf(stderr, "request failed: %s\n", resp->u.reason);
+        return resp;
+}
+
+static response *call(int fd, struct pool *mem, command *cmd)
+{
+        send_command(fd, cmd, 0);
+        return read_response(fd, mem);
+}
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Io bytes stay charged to the window until the journal has them, so
+ * a transaction bigger than the window only gets through if the
+ * server hands back what has spilled.
+ */
+void test_transaction_larger_than_window()
+{
+        struct server s;
+        int fd;
+        unsigned i, in_flight = 0;
+        uint64_t used = 0, released = 0;
+        uint8_t *data = malloc(IO_SIZE);
+        struct pool *mem = pool_create("server_t", 1024);
+        device_binding binding;
+        flow_control credit;
+        command cmd;
+        response *resp;
+
+        assert(data && mem);
+        start_server(&s);
+        fd = connect_server(&s);
+
+        cmd.discriminator = LOGON;
+        cmd.u.logon.v.major = 1;
+        cmd.u.logon.v.minor = 1;
+        cmd.u.logon.v.patch = 1;
+        cmd.u.logon.codecs.array = NULL;
+        cmd.u.logon.codecs.len = 0;
+        resp = call(fd, mem, &cmd);
+        assert(resp->discriminator == LOGON_RESPONSE);
+        credit = resp->u.logon.credit;
+        assert(credit.bytes <= CREDIT_BYTES);
+
+        binding.shortname = 1;
+        binding.logical_name = "server_t";
+        binding.path = "";
+        cmd.discriminator = JOURNAL_OPEN;
+        cmd.u.devices.array = &binding;
+        cmd.u.devices.len = 1;
+        assert(call(fd, mem, &cmd)->discriminator == SUCCESS);
+
+        for (i = 0; i < NR_IOS; i++) {
+                uint32_t len;
+
+                /* unique blocks, so nothing's taken as a repeat */
+                memset(data, i, IO_SIZE);
+                cmd.discriminator = JOURNAL_IO;
+                cmd.u.io.dev = 1;
+                cmd.u.io.sector = (uint64_t) i * (IO_SIZE >> 9);
+                cmd.u.io.codec = COMPRESS_NONE;
+                cmd.u.io.len = IO_SIZE;
+                cmd.u.io.data.data = data;
+                cmd.u.io.data.len = IO_SIZE;
+
+                /* leave room for the commit */
+                while (used + IO_SIZE + 1024 > credit.bytes) {
+                        assert(in_flight);
+                        pool_empty(mem);
+                        resp = read_response(fd, mem);
+                        in_flight--;
+
+                        if (resp->discriminator == IO_RESPONSE) {
+                                assert(resp->u.released <= used);
+                                used -= resp->u.released;
+                                released += resp->u.released;
+                        } else
+                                assert(resp->discriminator == SUCCESS);
+                }
+
+                len = send_command(fd, &cmd, i);
+                used += len;
+                in_flight++;
+        }
+
+        while (in_flight--) {
+                pool_empty(mem);
+                resp = read_response(fd, mem);
+                assert(resp->discriminator == IO_RESPONSE || resp->discriminator == SUCCESS);
+                if (resp->discriminator == IO_RESPONSE)
+                        released += resp->u.released;
+        }
+        assert(released >= (uint64_t) NR_IOS * IO_SIZE - CREDIT_BYTES);
+
+        pool_empty(mem);
+        cmd.discriminator = JOURNAL_COMMIT;
+        assert(call(fd, mem, &cmd)->discriminator == TRANSACTION_RESPONSE);
+
+        close(fd);
+        stop_server(&s);
+        pool_destroy(mem);
+        free(data);
+}
+
+int main(int argc, char **argv)
+{
+        test_transaction_larger_than_window();
+        return 0;
+}
@@ -0,0 +1,101 @@
+#include "histogram.h"
+
+#include <string.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * Values below 2 * HISTOGRAM_SUB_COUNT are counted exactly.  Above that
+ * a value is shifted down until it has HISTOGRAM_SUB_BITS + 1
+ * significant bits, and the shift picks the range.
+ */
+static unsigned bucket_index(uint64_t value)
+{
+        unsigned shift;
+
+        if (value < 2 * HISTOGRAM_SUB_COUNT)
+                return value;
+
+        shift = 63 - __builtin_clzll(value) - HISTOGRAM_SUB_BITS;
+        return shift * HISTOGRAM_SUB_COUNT + (value >> shift);
+}
+
+/* the largest value that lands in a bucket */
+static uint64_t bucket_value(unsigned index)
+{
+        unsigned shift;
+        uint64_t sub;
+
+        if (index < 2 * HISTOGRAM_SUB_COUNT)
+                return index;
+
+        shift = index / HISTOGRAM_SUB_COUNT - 1;
+        sub = index - shift * HISTOGRAM_SUB_COUNT;
+        return (sub << shift) + (1ULL << shift) - 1;
+}
+
+void histogram_init(struct histogram *h)
+{
+        memset(h, 0, sizeof(*h));
+}
+
+void histogram_record(struct histogram *h, uint64_t value)
+{
+        if (value > HISTOGRAM_MAX)
+                value = HISTOGRAM_MAX;
+
+        if (!h->count || value < h->min)
+                h->min = value;
+
+        if (value > h->max)
+                h->max = value;
+
+        h->count++;
+        h->counts[bucket_index(value)]++;
+}
+
+void histogram_merge(struct histogram *dest, struct histogram *src)
+{
+        unsigned i;
+
+        if (!src->count)
+                return;
+
+        if (!dest->count || src->min < dest->min)
+                dest->min = src->min;
+
+        if (src->max > dest->max)
+                dest->max = src->max;
+
+        dest->count += src->count;
+        for (i = 0; i < HISTOGRAM_BUCKETS; i++)
+                dest->counts[i] += src->counts[i];
+}
+
+uint64_t histogram_percentile(struct histogram *h, double percentile)
+{
+        unsigned i;
+        uint64_t seen = 0, wanted;
+
+        if (!h->count)
+                return 0;
+
+        if (percentile >= 100.0)
+                return h->max;
+
+        wanted = (uint64_t) (h->count * percentile / 100.0 + 0.5);
+        if (!wanted)
+                wanted = 1;
+
+        for (i = 0; i < HISTOGRAM_BUCKETS; i++) {
+                seen += h->counts[i];
+                if (seen >= wanted) {
+                        uint64_t v = bucket_value(i);
+                        return v > h->max ? h->max : v;
+                }
+        }
+
+        return h->max;
+}
+
+/*----------------------------------------------------------------*/
@@ -0,0 +1,48 @@
+#ifndef STATS_HISTOGRAM_H
+#define STATS_HISTOGRAM_H
+
+#include <stdint.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * A fixed size, log linear histogram in the style of HdrHistogram.
+ * Each power of two range is split into 64 linear sub buckets, so any
+ * recorded value is reported to within 1/64 (~1.6%).  Values above
+ * HISTOGRAM_MAX are clamped.
+ *
+ * Recording is a couple of shifts and an increment, cheap enough for
+ * the request path.
+ */
+enum {
+        HISTOGRAM_SUB_BITS = 6,
+        HISTOGRAM_SUB_COUNT = 1 << HISTOGRAM_SUB_BITS,
+        HISTOGRAM_RANGE_BITS = 40,      /* ~18 minutes in nanoseconds */
+        HISTOGRAM_BUCKETS = (HISTOGRAM_RANGE_BITS - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT
+};
+
+#define HISTOGRAM_MAX ((1ULL << HISTOGRAM_RANGE_BITS) - 1)
+
+struct histogram {
+        uint64_t count;
+        uint64_t min;
+        uint64_t max;
+        uint64_t counts[HISTOGRAM_BUCKETS];
+};
+
+void histogram_init(struct histogram *h);
+void histogram_record(struct histogram *h, uint64_t value);
+
+/* adds |src| into |dest| */
+void histogram_merge(struct histogram *dest, struct histogram *src);
+
+/*
+ * The smallest value that |percentile| percent of the recordings are
+ * less than or equal to (to the histogram's precision), eg, 99.9.
+ * Returns 0 for an empty histogram.
+ */
+uint64_t histogram_percentile(struct histogram *h, double percentile);
+
+/*----------------------------------------------------------------*/
+
+#endif
@@ -0,0 +1,93 @@
+#include "stats/histogram.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* within the histogram's precision, rounding up */
+static int close_to(uint64_t actual, uint64_t expected)
+{
+        return actual >= expected && actual <= expected + expected / HISTOGRAM_SUB_COUNT + 1;
+}
+
+void test_empty()
+{
+        struct histogram h;
+
+        histogram_init(&h);
+        assert(histogram_percentile(&h, 50.0) == 0);
+        assert(histogram_percentile(&h, 100.0) == 0);
+}
+
+void test_small_values_exact()
+{
+        uint64_t v;
+        struct histogram h;
+
+        for (v = 0; v < 2 * HISTOGRAM_SUB_COUNT; v++) {
+                histogram_init(&h);
+                histogram_record(&h, v);
+                assert(histogram_percentile(&h, 50.0) == v);
+        }
+}
+
+void test_uniform()
+{
+        uint64_t v;
+        struct histogram h;
+
+        histogram_init(&h);
+        for (v = 1; v <= 100000; v++)
+                histogram_record(&h, v * 1000);
+
+        assert(h.count == 100000);
+        assert(h.min == 1000);
+        assert(h.max == 100000000);
+        assert(close_to(histogram_percentile(&h, 50.0), 50000000));
+        assert(close_to(histogram_percentile(&h, 99.0), 99000000));
+        assert(close_to(histogram_percentile(&h, 99.9), 99900000));
+        assert(histogram_percentile(&h, 100.0) == 100000000);
+}
+
+void test_outlier()
+{
+        unsigned i;
+        struct histogram h;
+
+        histogram_init(&h);
+        for (i = 0; i < 999; i++)
+                histogram_record(&h, 10000);
+        histogram_record(&h, 5000000);
+
+        assert(close_to(histogram_percentile(&h, 50.0), 10000));
+        assert(close_to(histogram_percentile(&h, 99.9), 10000));
+        assert(histogram_percentile(&h, 99.99) == 5000000);
+}
+
+void test_clamp_and_merge()
+{
+        struct histogram a, b;
+
+        histogram_init(&a);
+        histogram_init(&b);
+        histogram_record(&a, 100);
+        histogram_record(&b, ~0ULL);
+        assert(b.max == HISTOGRAM_MAX);
+
+        histogram_merge(&a, &b);
+        assert(a.count == 2);
+        assert(a.min == 100);
+        assert(a.max == HISTOGRAM_MAX);
+        assert(histogram_percentile(&a, 50.0) == 100);
+        assert(histogram_percentile(&a, 100.0) == HISTOGRAM_MAX);
+}
+
+int main(int argc, char **argv)
+{
+        test_empty();
+        test_small_values_exact();
+        test_uniform();
+        test_outlier();
+        test_clamp_and_merge();
+        return 0;
+}
@@ -0,0 +1,144 @@
+#include "crc32c.h"
+
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <nmmintrin.h>
+#elif defined(__aarch64__)
+#include <arm_acle.h>
+#include <sys/auxv.h>
+#endif
+
+/*----------------------------------------------------------------*/
+
+enum {
+        POLY = 0x82f63b78       /* reflected */
+};
+
+typedef uint32_t (*crc_fn)(uint32_t, const unsigned char *, size_t);
+
+/*
+ * Slicing by 8, tables_[0] is the usual byte at a time table.
+ */
+static uint32_t tables_[8][256];
+
+static void init_tables()
+{
+        unsigned i, j;
+        uint32_t crc;
+
+        for (i = 0; i < 256; i++) {
+                crc = i;
+                for (j = 0; j < 8; j++)
+                        crc = (crc >> 1) ^ ((crc & 1) ? POLY : 0);
+                tables_[0][i] = crc;
+        }
+
+        for (i = 0; i < 256; i++)
+                for (j = 1; j < 8; j++)
+                        tables_[j][i] = (tables_[j - 1][i] >> 8) ^ tables_[0][tables_[j - 1][i] & 0xff];
+}
+
+static uint32_t crc_table(uint32_t crc, const unsigned char *data, size_t len)
+{
+        uint64_t word;
+
+        for (; len >= 8; len -= 8, data += 8) {
+                memcpy(&word, data, 8);
+                word ^= crc;
+                crc = tables_[7][word & 0xff] ^
+                      tables_[6][(word >> 8) & 0xff] ^
+                      tables_[5][(word >> 16) & 0xff] ^
+                      tables_[4][(word >> 24) & 0xff] ^
+                      tables_[3][(word >> 32) & 0xff] ^
+                      tables_[2][(word >> 40) & 0xff] ^
+                      tables_[1][(word >> 48) & 0xff] ^
+                      tables_[0][word >> 56];
+        }
+
+        while (len--)
+                crc = (crc >> 8) ^ tables_[0][(crc ^ *data++) & 0xff];
+
+        return crc;
+}
+
+#if defined(__x86_64__)
+__attribute__((target("sse4.2")))
+static uint32_t crc_hw(uint32_t crc, const unsigned char *data, size_t len)
+{
+        uint64_t word, c = crc;
+
+        for (; len >= 8; len -= 8, data += 8) {
+                memcpy(&word, data, 8);
+                c = _mm_crc32_u64(c, word);
+        }
+
+        crc = c;
+        while (len--)
+                crc = _mm_crc32_u8(crc, *data++);
+
+        return crc;
+}
+
+static int hw_available()
+{
+        return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(__aarch64__)
+__attribute__((target("+crc")))
+static uint32_t crc_hw(uint32_t crc, const unsigned char *data, size_t len)
+{
+        uint64_t word;
+
+        for (; len >= 8; len -= 8, data += 8) {
+                memcpy(&word, data, 8);
+                crc = __crc32cd(crc, word);
+        }
+
+        while (len--)
+                crc = __crc32cb(crc, *data++);
+
+        return crc;
+}
+
+static int hw_available()
+{
+        return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+#else
+#define crc_hw crc_table
+
+static int hw_available()
+{
+        return 0;
+}
+#endif
+
+/*
+ * Chosen before main() runs, so crc32c() needs no locking.
+ */
+static crc_fn impl_ = crc_table;
+
+__attribute__((constructor))
+static void crc32c_init()
+{
+        init_tables();
+        if (hw_available())
+                impl_ = crc_hw;
+}
+
+/*----------------------------------------------------------------*/
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len)
+{
+        return ~impl_(~crc, data, len);
+}
+
+int crc32c_hardware()
+{
+        return impl_ != crc_table;
+}
+
+/*----------------------------------------------------------------*/
@@ -0,0 +1,25 @@
+#ifndef UTILITY_CRC32C_H
+#define UTILITY_CRC32C_H
+
+#include <stdint.h>
+#include <stdlib.h>
+
+/*----------------------------------------------------------------*/
+
+/*
+ * CRC32C (Castagnoli), as used by iSCSI and ext4.  Uses the SSE4.2 or
+ * ARMv8 crc instructions when the cpu has them, and a table otherwise.
+ *
+ * Pass 0 as |crc| to start; the result can be passed back in to carry
+ * on over more data, ie,
+ *
+ *   crc32c(crc32c(0, a, a_len), b, b_len) == crc32c(0, ab, a_len + b_len)
+ */
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+/* Non zero if crc32c() is using cpu instructions. */
+int crc32c_hardware();
+
+/*----------------------------------------------------------------*/
+
+#endif
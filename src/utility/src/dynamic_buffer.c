@@ -41,6 +41,7 @@ void *dynamic_buffer_get(struct dynamic_buffer *db, size_t required_space)
                 return NULL;
 
         db->data = n;
+        db->len = required_space;
         return db->data;
 }
 
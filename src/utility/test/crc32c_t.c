@@ -0,0 +1,69 @@
+#include "utility/crc32c.h"
+
+#include <assert.h>
+#include <stdio.h>
+#include <string.h>
+
+/*----------------------------------------------------------------*/
+
+/* A bit at a time, slow but obviously right. */
+static uint32_t reference(uint32_t crc, const unsigned char *data, size_t len)
+{
+        unsigned i;
+
+        crc = ~crc;
+        while (len--) {
+                crc ^= *data++;
+                for (i = 0; i < 8; i++)
+                        crc = (crc >> 1) ^ ((crc & 1) ? 0x82f63b78 : 0);
+        }
+
+        return ~crc;
+}
+
+void test_known_values()
+{
+        unsigned char zeroes[32];
+
+        /* from rfc 3720 */
+        memset(zeroes, 0, sizeof(zeroes));
+        assert(crc32c(0, "123456789", 9) == 0xe3069283);
+        assert(crc32c(0, zeroes, sizeof(zeroes)) == 0x8a9136aa);
+        assert(crc32c(0, "", 0) == 0);
+}
+
+/* Every length and alignment around the word size */
+void test_matches_reference()
+{
+        unsigned i, offset, len;
+        unsigned char data[1024];
+
+        for (i = 0; i < sizeof(data); i++)
+                data[i] = (i * 131 + 7) & 0xff;
+
+        for (offset = 0; offset < 8; offset++)
+                for (len = 0; len + offset <= sizeof(data); len += (len < 64) ? 1 : 61)
+                        assert(crc32c(0, data + offset, len) == reference(0, data + offset, len));
+}
+
+void test_continuation()
+{
+        unsigned split;
+        unsigned char data[100];
+        uint32_t whole;
+
+        memset(data, 0x5a, sizeof(data));
+        whole = crc32c(0, data, sizeof(data));
+        for (split = 0; split <= sizeof(data); split++)
+                assert(crc32c(crc32c(0, data, split), data + split, sizeof(data) - split) == whole);
+}
+
+int main(int argc, char **argv)
+{
+        printf("crc32c using %s\n", crc32c_hardware() ? "cpu instructions" : "tables");
+
+        test_known_values();
+        test_matches_reference();
+        test_continuation();
+        return 0;
+}
@@ -134,6 +134,47 @@ size_t xdr_buffer_size(struct xdr_buffer *buf)
          return buf->allocated;
 }
 
+static int chunk_owned_(struct chunk *c)
+{
+        return c->start == (void *) (c + 1);
+}
+
+void xdr_buffer_reset(struct xdr_buffer *buf)
+{
+        struct chunk *c, *tmp, *keep = NULL;
+
+        list_iterate_items (c, &buf->chunks)
+                if (chunk_owned_(c) && (!keep || (keep->end - keep->start) < (c->end - c->start)))
+                        keep = c;
+
+        list_iterate_items_safe (c, tmp, &buf->chunks) {
+                if (c != keep) {
+                        list_del(&c->list);
+                        free(c);
+                }
+        }
+
+        if ((!keep || buf->allocated > (keep->end - keep->start)) &&
+            buf->allocated > buf->chunk_size)
+                buf->chunk_size = buf->allocated;
+
+        if (keep)
+                keep->alloc_end = keep->start;
+
+        buf->allocated = 0;
+}
+
+void xdr_buffer_copy(struct xdr_buffer *buf, void *dest)
+{
+        struct chunk *c;
+
+        list_iterate_items (c, &buf->chunks) {
+                size_t len = c->alloc_end - c->start;
+                memcpy(dest, c->start, len);
+                dest += len;
+        }
+}
+
 /*--------------------------------*/
 
 struct xdr_cursor {
@@ -179,12 +220,14 @@ static void cursor_next_chunk_(struct xdr_cursor *c)
 static
 int cursor_read_(struct xdr_cursor *c, void *data, uint32_t len)
 {
-        /* the cursor has run off the end */
-        if (!c->c)
-                return 0;
-
         while (len) {
-                uint32_t l = min(len, c->c->end - c->where);
+                uint32_t l;
+
+                /* the cursor has run off the end */
+                if (!c->c)
+                        return 0;
+
+                l = min(len, c->c->end - c->where);
                 if (data)
                         memcpy(data, c->where, l);
                 data += l;
@@ -228,39 +271,47 @@ int xdr_cursor_read(struct xdr_cursor *c, void *data, uint32_t len)
         return r;
 }
 
-/*--------------------------------*/
-
-int xdr_unpack_using_(xdr_unpack_fn fn, void *data, size_t len, struct pool *mem, void **result)
+size_t xdr_cursor_remaining(struct xdr_cursor *c)
 {
-        struct xdr_buffer *b;
-        struct xdr_cursor *c;
+        size_t n;
+        struct list *l;
 
-        /* decode */
-        b = xdr_buffer_create(1024);
-        if (!b)
+        if (!c->c)
                 return 0;
 
-        if (!xdr_buffer_add_block(b, data, len)) {
-                xdr_buffer_destroy(b);
-                return 0;
-        }
+        n = c->c->end - c->where;
+        for (l = list_next(&c->buf->chunks, &c->c->list); l; l = list_next(&c->buf->chunks, l))
+                n += list_item(l, struct chunk)->end - list_item(l, struct chunk)->start;
 
-        c = xdr_cursor_create(b);
-        if (!c) {
-                xdr_buffer_destroy(b);
-                return 0;
-        }
+        return n;
+}
 
-        if (!fn(c, mem, result)) {
-                xdr_cursor_destroy(c);
-                xdr_buffer_destroy(b);
-                return 0;
-        }
+/*--------------------------------*/
 
-        xdr_cursor_destroy(c);
-        xdr_buffer_destroy(b);
+/*
+ * This is on the path of every request, so the buffer, its single block
+ * and the cursor all live on the stack.
+ */
+int xdr_unpack_using_(xdr_unpack_fn fn, void *data, size_t len, struct pool *mem, void **result)
+{
+        struct xdr_buffer b;
+        struct chunk block;
+        struct xdr_cursor c;
 
-        return 1;
+        b.chunk_size = 0;
+        b.allocated = len;
+        list_init(&b.chunks);
+
+        block.start = data;
+        block.end = data + len;
+        block.alloc_end = block.end;
+        list_add(&b.chunks, &block.list);
+
+        c.buf = &b;
+        c.c = len ? &block : NULL;
+        c.where = data;
+
+        return fn(&c, mem, result);
 }
 
 /*----------------------------------------------------------------*/
@@ -39,6 +39,20 @@ int xdr_buffer_write(struct xdr_buffer *buf, const void *data, uint32_t len);
 
 size_t xdr_buffer_size(struct xdr_buffer *buf);
 
+/*
+ * Empties the buffer, but hangs on to the memory it allocated so it can
+ * be refilled without going back to malloc.  If the contents needed
+ * more than one chunk, the chunk size is raised so next time they'll
+ * fit in one.  External blocks are forgotten.
+ */
+void xdr_buffer_reset(struct xdr_buffer *buf);
+
+/*
+ * Copies the contents into a flat buffer of at least xdr_buffer_size()
+ * bytes.
+ */
+void xdr_buffer_copy(struct xdr_buffer *buf, void *dest);
+
 struct xdr_cursor;
 
 struct xdr_cursor *xdr_cursor_create(struct xdr_buffer *buf);
@@ -46,6 +60,9 @@ void xdr_cursor_destroy(struct xdr_cursor *c);
 int xdr_cursor_forward(struct xdr_cursor *c, uint32_t offset);
 int xdr_cursor_read(struct xdr_cursor *c, void *data, uint32_t len);
 
+/* bytes left to read, used to check lengths taken from the wire */
+size_t xdr_cursor_remaining(struct xdr_cursor *c);
+
 /*
  * A little utility to do the grunt work of unpacking.
  *
@@ -53,6 +70,8 @@ int xdr_cursor_read(struct xdr_cursor *c, void *data, uint32_t len);
  * data, len - the raw data to be unpacked
  * mem       - the allocator to use for the result
  * result    - the result iff successful
+ *
+ * Nothing is allocated other than from |mem|.
  */
 typedef int (*xdr_unpack_fn)(struct xdr_cursor *c, struct pool *, void **);
 int xdr_unpack_using_(xdr_unpack_fn fn, void *data, size_t len,
@@ -51,6 +51,7 @@ void test_write()
         };
 
         int i, j;
+        size_t consumed = 0;
         unsigned char data[MAX];
         struct xdr_buffer *b = xdr_buffer_create(1024);
         struct xdr_cursor *c;
@@ -64,10 +65,13 @@ void test_write()
 
         c = xdr_cursor_create(b);
         for (i = 0; i < MAX; i++) {
+                assert(xdr_cursor_remaining(c) == xdr_buffer_size(b) - consumed);
                 assert(xdr_cursor_read(c, data, i));
+                consumed += (i + 3) / 4 * 4;
                 for (j = 0; j < i; j++)
                         assert(data[j] == ((unsigned char) i & 0xff));
         }
+        assert(xdr_cursor_remaining(c) == 0);
 
         xdr_cursor_destroy(c);
         xdr_buffer_destroy(b);
@@ -82,11 +86,37 @@ void test_size()
         assert(xdr_buffer_size(b) == 8);
 }
 
+void test_reset_and_copy()
+{
+        int i, j;
+        char data[100], flat[2000];
+        struct xdr_buffer *b = xdr_buffer_create(64);
+
+        assert(b);
+        for (i = 0; i < 3; i++) {
+                for (j = 0; j < 20; j++) {
+                        memset(data, 'a' + j, sizeof(data));
+                        assert(xdr_buffer_write(b, data, sizeof(data)));
+                }
+
+                assert(xdr_buffer_size(b) == 2000);
+                xdr_buffer_copy(b, flat);
+                for (j = 0; j < 2000; j++)
+                        assert(flat[j] == 'a' + j / 100);
+
+                xdr_buffer_reset(b);
+                assert(xdr_buffer_size(b) == 0);
+        }
+
+        xdr_buffer_destroy(b);
+}
+
 int main(int argc, char **argv)
 {
         test_create_destroy();
         test_add_block();
         test_write();
         test_size();
+        test_reset_and_copy();
         return 0;
 }
@@ -0,0 +1,61 @@
+/* local stand-in for flex output; NOT committed */
+#include "xdrgen.h"
+#include "xdrgen.tab.h"
+#include <stdio.h>
+#include <ctype.h>
+#include <string.h>
+#include <stdlib.h>
+FILE *yyin;
+char yytext[1024];
+static int get(void) { int c = fgetc(yyin); return c; }
+int yylex(void)
+{
+        int c;
+        static const struct { const char *s; int t; } kw[] = {
+                {"bool",BOOL},{"case",CASE},{"const",CONST},{"default",DEFAULT},{"double",DOUBLE},
+                {"quadruple",QUADRUPLE},{"enum",ENUM},{"float",FLOAT},{"hyper",HYPER},{"int",INT},
+                {"opaque",OPAQUE},{"string",STRING},{"struct",STRUCT},{"switch",SWITCH},
+                {"typedef",TYPEDEF},{"union",UNION},{"unsigned",UNSIGNED},{"void",VOID},{0,0}};
+again:
+        c = get();
+        if (c == EOF) return 0;
+        if (c == '\n') { inc_line(); goto again; }
+        if (c == ' ' || c == '\t' || c == '\r') goto again;
+        if (c == '/') {
+                int d = get();
+                if (d == '*') {
+                        int prev = 0;
+                        while ((c = get()) != EOF) {
+                                if (c == '\n') inc_line();
+                                if (prev == '*' && c == '/') break;
+                                prev = c;
+                        }
+                        goto again;
+                }
+                ungetc(d, yyin);
+                return c;
+        }
+        if (isdigit(c) || (c == '-')) {
+                int n = 0;
+                if (c == '-') { int d = get(); if (!isdigit(d)) { ungetc(d, yyin); return c; } yytext[n++] = c; c = d; }
+                yytext[n++] = c;
+                while ((c = get()) != EOF && isalnum(c)) yytext[n++] = c;
+                ungetc(c, yyin);
+                yytext[n] = 0;
+                yylval.i = strtol(yytext, NULL, 0);
+                return INTEGER;
+        }
+        if (isalpha(c)) {
+                int n = 0, i;
+                yytext[n++] = c;
+                while ((c = get()) != EOF && (isalnum(c) || c == '_')) yytext[n++] = c;
+                ungetc(c, yyin);
+                yytext[n] = 0;
+                for (i = 0; kw[i].s; i++)
+                        if (!strcmp(kw[i].s, yytext)) return kw[i].t;
+                yylval.str = dup_string(yytext);
+                return IDENTIFIER;
+        }
+        return c;
+}
+int yywrap() { return 1; }
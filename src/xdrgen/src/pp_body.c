@@ -18,7 +18,7 @@ static void pack(const char *fn, var_t v)
         emit("if (!xdr_pack_%s(buf, ", fn);
         emit_var(v);
         emit("))"); nl();
-        push(); emit("return 0;"); pop();
+        push(); emit("return 0;"); pop(); nl();
 }
 
 static void pp_expr(struct const_expr *ce)
@@ -327,7 +327,28 @@ static void unpack_decl_internal(struct decl_internal *di, var_t v)
 
                 {
                         var_t v2 = field(v, "len");
+                        var_t a = field(v, "array");
                         unpack_basic("uint", v2);
+
+                        /*
+                         * Every element takes at least 4 bytes on the
+                         * wire, so a length that couldn't fit in what's
+                         * left is rejected before it's allocated.
+                         */
+                        emit("if (");
+                        emit_var(v2);
+                        emit(" > xdr_cursor_remaining(c) / 4)"); push(); nl();
+                        emit("return 0;"); pop(); nl();
+
+                        emit("if (!(");
+                        emit_var(a);
+                        emit(" = pool_alloc(mem, sizeof(*");
+                        emit_var(a);
+                        emit(") * ");
+                        emit_var(v2);
+                        emit(")))"); push(); nl();
+                        emit("return 0;"); pop(); nl();
+
                         emit("for (i = 0; i < ");
                         emit_var(v2);
                 }
@@ -355,6 +376,18 @@ static void unpack_decl_internal(struct decl_internal *di, var_t v)
 
                 unpack_basic("uint", field(v, "len"));
 
+                emit("if (");
+                emit_var(field(v, "len"));
+                emit(" > xdr_cursor_remaining(c))"); push(); nl();
+                emit("return 0;"); pop(); nl();
+
+                emit("if (!(");
+                emit_var(field(v, "data"));
+                emit(" = pool_alloc(mem, ");
+                emit_var(field(v, "len"));
+                emit(")))"); push(); nl();
+                emit("return 0;"); pop(); nl();
+
                 emit("if (!xdr_cursor_read(c, (void *) ");
                 emit_var(field(v, "data"));
 
@@ -0,0 +1,1891 @@
+/* A Bison parser, made by GNU Bison 3.8.2.  */
+
+/* Bison implementation for Yacc-like parsers in C
+
+   Copyright (C) 1984, 1989-1990, 2000-2015, 2018-2021 Free Software Foundation,
+   Inc.
+
+   This program is free software: you can redistribute it and/or modify
+   it under the terms of the GNU General Public License as published by
+   the Free Software Foundation, either version 3 of the License, or
+   (at your option) any later version.
+
+   This program is distributed in the hope that it will be useful,
+   but WITHOUT ANY WARRANTY; without even the implied warranty of
+   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+   GNU General Public License for more details.
+
+   You should have received a copy of the GNU General Public License
+   along with this program.  If not, see <https://www.gnu.org/licenses/>.  */
+
+/* As a special exception, you may create a larger work that contains
+   part or all of the Bison parser skeleton and distribute that work
+   under terms of your choice, so long as that work isn't itself a
+   parser generator using the skeleton or a modified version thereof
+   as a parser skeleton.  Alternatively, if you modify or redistribute
+   the parser skeleton itself, you may (at your option) remove this
+   special exception, which will cause the skeleton and the resulting
+   Bison output files to be licensed under the GNU General Public
+   License without this special exception.
+
+   This special exception was added by the Free Software Foundation in
+   version 2.2 of Bison.  */
+
+/* C LALR(1) parser skeleton written by Richard Stallman, by
+   simplifying the original so-called "semantic" parser.  */
+
+/* DO NOT RELY ON FEATURES THAT ARE NOT DOCUMENTED in the manual,
+   especially those whose name start with YY_ or yy_.  They are
+   private implementation details that can be changed or removed.  */
+
+/* All symbols defined below should begin with yy or YY, to avoid
+   infringing on user name space.  This should be done even for local
+   variables, as they might otherwise be expanded by user macros.
+   There are some unavoidable exceptions within include files to
+   define necessary library symbols; they are noted "INFRINGES ON
+   USER NAME SPACE" below.  */
+
+/* Identify Bison output, and Bison version.  */
+#define YYBISON 30802
+
+/* Bison version string.  */
+#define YYBISON_VERSION "3.8.2"
+
+/* Skeleton name.  */
+#define YYSKELETON_NAME "yacc.c"
+
+/* Pure parsers.  */
+#define YYPURE 0
+
+/* Push parsers.  */
+#define YYPUSH 0
+
+/* Pull parsers.  */
+#define YYPULL 1
+
+
+
+
+/* First part of user prologue.  */
+#line 1 "src/xdrgen/src/xdrgen.y"
+
+#include "ast.h"
+#include "xdrgen.h"
+
+#include <stdio.h>
+
+static void yyerror(char *s) {
+        fprintf(stderr, "<stdin>:%u %s\n", get_line(), s);
+        exit(1);
+}
+
+struct type *simple_type(enum type_type type) {
+       struct type *t = zalloc(sizeof(*t));
+       t->type = type;
+       return t;
+}
+
+/* FIXME: rename */
+static void list_move_(struct list *new_head, struct list *old_head)
+{
+        list_init(new_head);
+        list_splice(new_head, old_head);
+}
+
+static void add_tail(struct list *head, struct list *item)
+{
+        list_add(head, item);
+}
+
+#line 101 "src/xdrgen/src/xdrgen.tab.c"
+
+# ifndef YY_CAST
+#  ifdef __cplusplus
+#   define YY_CAST(Type, Val) static_cast<Type> (Val)
+#   define YY_REINTERPRET_CAST(Type, Val) reinterpret_cast<Type> (Val)
+#  else
+#   define YY_CAST(Type, Val) ((Type) (Val))
+#   define YY_REINTERPRET_CAST(Type, Val) ((Type) (Val))
+#  endif
+# endif
+# ifndef YY_NULLPTR
+#  if defined __cplusplus
+#   if 201103L <= __cplusplus
+#    define YY_NULLPTR nullptr
+#   else
+#    define YY_NULLPTR 0
+#   endif
+#  else
+#   define YY_NULLPTR ((void*)0)
+#  endif
+# endif
+
+#include "xdrgen.tab.h"
+/* Symbol kind.  */
+enum yysymbol_kind_t
+{
+  YYSYMBOL_YYEMPTY = -2,
+  YYSYMBOL_YYEOF = 0,                      /* "end of file"  */
+  YYSYMBOL_YYerror = 1,                    /* error  */
+  YYSYMBOL_YYUNDEF = 2,                    /* "invalid token"  */
+  YYSYMBOL_BOOL = 3,                       /* BOOL  */
+  YYSYMBOL_CASE = 4,                       /* CASE  */
+  YYSYMBOL_CONST = 5,                      /* CONST  */
+  YYSYMBOL_DEFAULT = 6,                    /* DEFAULT  */
+  YYSYMBOL_DOUBLE = 7,                     /* DOUBLE  */
+  YYSYMBOL_QUADRUPLE = 8,                  /* QUADRUPLE  */
+  YYSYMBOL_ENUM = 9,                       /* ENUM  */
+  YYSYMBOL_FLOAT = 10,                     /* FLOAT  */
+  YYSYMBOL_HYPER = 11,                     /* HYPER  */
+  YYSYMBOL_INT = 12,                       /* INT  */
+  YYSYMBOL_OPAQUE = 13,                    /* OPAQUE  */
+  YYSYMBOL_STRING = 14,                    /* STRING  */
+  YYSYMBOL_STRUCT = 15,                    /* STRUCT  */
+  YYSYMBOL_SWITCH = 16,                    /* SWITCH  */
+  YYSYMBOL_TYPEDEF = 17,                   /* TYPEDEF  */
+  YYSYMBOL_UNION = 18,                     /* UNION  */
+  YYSYMBOL_UNSIGNED = 19,                  /* UNSIGNED  */
+  YYSYMBOL_VOID = 20,                      /* VOID  */
+  YYSYMBOL_INTEGER = 21,                   /* INTEGER  */
+  YYSYMBOL_IDENTIFIER = 22,                /* IDENTIFIER  */
+  YYSYMBOL_23_ = 23,                       /* ';'  */
+  YYSYMBOL_24_ = 24,                       /* '='  */
+  YYSYMBOL_25_ = 25,                       /* '<'  */
+  YYSYMBOL_26_ = 26,                       /* '>'  */
+  YYSYMBOL_27_ = 27,                       /* '['  */
+  YYSYMBOL_28_ = 28,                       /* ']'  */
+  YYSYMBOL_29_ = 29,                       /* '*'  */
+  YYSYMBOL_30_ = 30,                       /* '('  */
+  YYSYMBOL_31_ = 31,                       /* ')'  */
+  YYSYMBOL_32_ = 32,                       /* '{'  */
+  YYSYMBOL_33_ = 33,                       /* '}'  */
+  YYSYMBOL_34_ = 34,                       /* ':'  */
+  YYSYMBOL_35_ = 35,                       /* ','  */
+  YYSYMBOL_YYACCEPT = 36,                  /* $accept  */
+  YYSYMBOL_specification = 37,             /* specification  */
+  YYSYMBOL_definition_list = 38,           /* definition_list  */
+  YYSYMBOL_definition = 39,                /* definition  */
+  YYSYMBOL_typedef = 40,                   /* typedef  */
+  YYSYMBOL_const_def = 41,                 /* const_def  */
+  YYSYMBOL_declaration = 42,               /* declaration  */
+  YYSYMBOL_union_detail = 43,              /* union_detail  */
+  YYSYMBOL_case_list = 44,                 /* case_list  */
+  YYSYMBOL_case = 45,                      /* case  */
+  YYSYMBOL_default_ = 46,                  /* default_  */
+  YYSYMBOL_struct_detail = 47,             /* struct_detail  */
+  YYSYMBOL_declaration_list = 48,          /* declaration_list  */
+  YYSYMBOL_enum_detail = 49,               /* enum_detail  */
+  YYSYMBOL_enum_fields = 50,               /* enum_fields  */
+  YYSYMBOL_enum_field = 51,                /* enum_field  */
+  YYSYMBOL_type = 52,                      /* type  */
+  YYSYMBOL_const_expr = 53,                /* const_expr  */
+  YYSYMBOL_identifier = 54                 /* identifier  */
+};
+typedef enum yysymbol_kind_t yysymbol_kind_t;
+
+
+
+
+#ifdef short
+# undef short
+#endif
+
+/* On compilers that do not define __PTRDIFF_MAX__ etc., make sure
+   <limits.h> and (if available) <stdint.h> are included
+   so that the code can choose integer types of a good width.  */
+
+#ifndef __PTRDIFF_MAX__
+# include <limits.h> /* INFRINGES ON USER NAME SPACE */
+# if defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stdint.h> /* INFRINGES ON USER NAME SPACE */
+#  define YY_STDINT_H
+# endif
+#endif
+
+/* Narrow types that promote to a signed type and that can represent a
+   signed or unsigned integer of at least N bits.  In tables they can
+   save space and decrease cache pressure.  Promoting to a signed type
+   helps avoid bugs in integer arithmetic.  */
+
+#ifdef __INT_LEAST8_MAX__
+typedef __INT_LEAST8_TYPE__ yytype_int8;
+#elif defined YY_STDINT_H
+typedef int_least8_t yytype_int8;
+#else
+typedef signed char yytype_int8;
+#endif
+
+#ifdef __INT_LEAST16_MAX__
+typedef __INT_LEAST16_TYPE__ yytype_int16;
+#elif defined YY_STDINT_H
+typedef int_least16_t yytype_int16;
+#else
+typedef short yytype_int16;
+#endif
+
+/* Work around bug in HP-UX 11.23, which defines these macros
+   incorrectly for preprocessor constants.  This workaround can likely
+   be removed in 2023, as HPE has promised support for HP-UX 11.23
+   (aka HP-UX 11i v2) only through the end of 2022; see Table 2 of
+   <https://h20195.www2.hpe.com/V2/getpdf.aspx/4AA4-7673ENW.pdf>.  */
+#ifdef __hpux
+# undef UINT_LEAST8_MAX
+# undef UINT_LEAST16_MAX
+# define UINT_LEAST8_MAX 255
+# define UINT_LEAST16_MAX 65535
+#endif
+
+#if defined __UINT_LEAST8_MAX__ && __UINT_LEAST8_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST8_TYPE__ yytype_uint8;
+#elif (!defined __UINT_LEAST8_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST8_MAX <= INT_MAX)
+typedef uint_least8_t yytype_uint8;
+#elif !defined __UINT_LEAST8_MAX__ && UCHAR_MAX <= INT_MAX
+typedef unsigned char yytype_uint8;
+#else
+typedef short yytype_uint8;
+#endif
+
+#if defined __UINT_LEAST16_MAX__ && __UINT_LEAST16_MAX__ <= __INT_MAX__
+typedef __UINT_LEAST16_TYPE__ yytype_uint16;
+#elif (!defined __UINT_LEAST16_MAX__ && defined YY_STDINT_H \
+       && UINT_LEAST16_MAX <= INT_MAX)
+typedef uint_least16_t yytype_uint16;
+#elif !defined __UINT_LEAST16_MAX__ && USHRT_MAX <= INT_MAX
+typedef unsigned short yytype_uint16;
+#else
+typedef int yytype_uint16;
+#endif
+
+#ifndef YYPTRDIFF_T
+# if defined __PTRDIFF_TYPE__ && defined __PTRDIFF_MAX__
+#  define YYPTRDIFF_T __PTRDIFF_TYPE__
+#  define YYPTRDIFF_MAXIMUM __PTRDIFF_MAX__
+# elif defined PTRDIFF_MAX
+#  ifndef ptrdiff_t
+#   include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  endif
+#  define YYPTRDIFF_T ptrdiff_t
+#  define YYPTRDIFF_MAXIMUM PTRDIFF_MAX
+# else
+#  define YYPTRDIFF_T long
+#  define YYPTRDIFF_MAXIMUM LONG_MAX
+# endif
+#endif
+
+#ifndef YYSIZE_T
+# ifdef __SIZE_TYPE__
+#  define YYSIZE_T __SIZE_TYPE__
+# elif defined size_t
+#  define YYSIZE_T size_t
+# elif defined __STDC_VERSION__ && 199901 <= __STDC_VERSION__
+#  include <stddef.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYSIZE_T size_t
+# else
+#  define YYSIZE_T unsigned
+# endif
+#endif
+
+#define YYSIZE_MAXIMUM                                  \
+  YY_CAST (YYPTRDIFF_T,                                 \
+           (YYPTRDIFF_MAXIMUM < YY_CAST (YYSIZE_T, -1)  \
+            ? YYPTRDIFF_MAXIMUM                         \
+            : YY_CAST (YYSIZE_T, -1)))
+
+#define YYSIZEOF(X) YY_CAST (YYPTRDIFF_T, sizeof (X))
+
+
+/* Stored state numbers (used for stacks). */
+typedef yytype_int8 yy_state_t;
+
+/* State numbers in computations.  */
+typedef int yy_state_fast_t;
+
+#ifndef YY_
+# if defined YYENABLE_NLS && YYENABLE_NLS
+#  if ENABLE_NLS
+#   include <libintl.h> /* INFRINGES ON USER NAME SPACE */
+#   define YY_(Msgid) dgettext ("bison-runtime", Msgid)
+#  endif
+# endif
+# ifndef YY_
+#  define YY_(Msgid) Msgid
+# endif
+#endif
+
+
+#ifndef YY_ATTRIBUTE_PURE
+# if defined __GNUC__ && 2 < __GNUC__ + (96 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_PURE __attribute__ ((__pure__))
+# else
+#  define YY_ATTRIBUTE_PURE
+# endif
+#endif
+
+#ifndef YY_ATTRIBUTE_UNUSED
+# if defined __GNUC__ && 2 < __GNUC__ + (7 <= __GNUC_MINOR__)
+#  define YY_ATTRIBUTE_UNUSED __attribute__ ((__unused__))
+# else
+#  define YY_ATTRIBUTE_UNUSED
+# endif
+#endif
+
+/* Suppress unused-variable warnings by "using" E.  */
+#if ! defined lint || defined __GNUC__
+# define YY_USE(E) ((void) (E))
+#else
+# define YY_USE(E) /* empty */
+#endif
+
+/* Suppress an incorrect diagnostic about yylval being uninitialized.  */
+#if defined __GNUC__ && ! defined __ICC && 406 <= __GNUC__ * 100 + __GNUC_MINOR__
+# if __GNUC__ * 100 + __GNUC_MINOR__ < 407
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")
+# else
+#  define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN                           \
+    _Pragma ("GCC diagnostic push")                                     \
+    _Pragma ("GCC diagnostic ignored \"-Wuninitialized\"")              \
+    _Pragma ("GCC diagnostic ignored \"-Wmaybe-uninitialized\"")
+# endif
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END      \
+    _Pragma ("GCC diagnostic pop")
+#else
+# define YY_INITIAL_VALUE(Value) Value
+#endif
+#ifndef YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+# define YY_IGNORE_MAYBE_UNINITIALIZED_END
+#endif
+#ifndef YY_INITIAL_VALUE
+# define YY_INITIAL_VALUE(Value) /* Nothing. */
+#endif
+
+#if defined __cplusplus && defined __GNUC__ && ! defined __ICC && 6 <= __GNUC__
+# define YY_IGNORE_USELESS_CAST_BEGIN                          \
+    _Pragma ("GCC diagnostic push")                            \
+    _Pragma ("GCC diagnostic ignored \"-Wuseless-cast\"")
+# define YY_IGNORE_USELESS_CAST_END            \
+    _Pragma ("GCC diagnostic pop")
+#endif
+#ifndef YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_BEGIN
+# define YY_IGNORE_USELESS_CAST_END
+#endif
+
+
+#define YY_ASSERT(E) ((void) (0 && (E)))
+
+#if !defined yyoverflow
+
+/* The parser invokes alloca or malloc; define the necessary symbols.  */
+
+# ifdef YYSTACK_USE_ALLOCA
+#  if YYSTACK_USE_ALLOCA
+#   ifdef __GNUC__
+#    define YYSTACK_ALLOC __builtin_alloca
+#   elif defined __BUILTIN_VA_ARG_INCR
+#    include <alloca.h> /* INFRINGES ON USER NAME SPACE */
+#   elif defined _AIX
+#    define YYSTACK_ALLOC __alloca
+#   elif defined _MSC_VER
+#    include <malloc.h> /* INFRINGES ON USER NAME SPACE */
+#    define alloca _alloca
+#   else
+#    define YYSTACK_ALLOC alloca
+#    if ! defined _ALLOCA_H && ! defined EXIT_SUCCESS
+#     include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+      /* Use EXIT_SUCCESS as a witness for stdlib.h.  */
+#     ifndef EXIT_SUCCESS
+#      define EXIT_SUCCESS 0
+#     endif
+#    endif
+#   endif
+#  endif
+# endif
+
+# ifdef YYSTACK_ALLOC
+   /* Pacify GCC's 'empty if-body' warning.  */
+#  define YYSTACK_FREE(Ptr) do { /* empty */; } while (0)
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+    /* The OS might guarantee only one guard page at the bottom of the stack,
+       and a page size can be as small as 4096 bytes.  So we cannot safely
+       invoke alloca (N) if N exceeds 4096.  Use a slightly smaller number
+       to allow for a few compiler-allocated temporary stack slots.  */
+#   define YYSTACK_ALLOC_MAXIMUM 4032 /* reasonable circa 2006 */
+#  endif
+# else
+#  define YYSTACK_ALLOC YYMALLOC
+#  define YYSTACK_FREE YYFREE
+#  ifndef YYSTACK_ALLOC_MAXIMUM
+#   define YYSTACK_ALLOC_MAXIMUM YYSIZE_MAXIMUM
+#  endif
+#  if (defined __cplusplus && ! defined EXIT_SUCCESS \
+       && ! ((defined YYMALLOC || defined malloc) \
+             && (defined YYFREE || defined free)))
+#   include <stdlib.h> /* INFRINGES ON USER NAME SPACE */
+#   ifndef EXIT_SUCCESS
+#    define EXIT_SUCCESS 0
+#   endif
+#  endif
+#  ifndef YYMALLOC
+#   define YYMALLOC malloc
+#   if ! defined malloc && ! defined EXIT_SUCCESS
+void *malloc (YYSIZE_T); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+#  ifndef YYFREE
+#   define YYFREE free
+#   if ! defined free && ! defined EXIT_SUCCESS
+void free (void *); /* INFRINGES ON USER NAME SPACE */
+#   endif
+#  endif
+# endif
+#endif /* !defined yyoverflow */
+
+#if (! defined yyoverflow \
+     && (! defined __cplusplus \
+         || (defined YYSTYPE_IS_TRIVIAL && YYSTYPE_IS_TRIVIAL)))
+
+/* A type that is properly aligned for any stack member.  */
+union yyalloc
+{
+  yy_state_t yyss_alloc;
+  YYSTYPE yyvs_alloc;
+};
+
+/* The size of the maximum gap between one aligned stack and the next.  */
+# define YYSTACK_GAP_MAXIMUM (YYSIZEOF (union yyalloc) - 1)
+
+/* The size of an array large to enough to hold all stacks, each with
+   N elements.  */
+# define YYSTACK_BYTES(N) \
+     ((N) * (YYSIZEOF (yy_state_t) + YYSIZEOF (YYSTYPE)) \
+      + YYSTACK_GAP_MAXIMUM)
+
+# define YYCOPY_NEEDED 1
+
+/* Relocate STACK from its old location to the new one.  The
+   local variables YYSIZE and YYSTACKSIZE give the old and new number of
+   elements in the stack, and YYPTR gives the new location of the
+   stack.  Advance YYPTR to a properly aligned location for the next
+   stack.  */
+# define YYSTACK_RELOCATE(Stack_alloc, Stack)                           \
+    do                                                                  \
+      {                                                                 \
+        YYPTRDIFF_T yynewbytes;                                         \
+        YYCOPY (&yyptr->Stack_alloc, Stack, yysize);                    \
+        Stack = &yyptr->Stack_alloc;                                    \
+        yynewbytes = yystacksize * YYSIZEOF (*Stack) + YYSTACK_GAP_MAXIMUM; \
+        yyptr += yynewbytes / YYSIZEOF (*yyptr);                        \
+      }                                                                 \
+    while (0)
+
+#endif
+
+#if defined YYCOPY_NEEDED && YYCOPY_NEEDED
+/* Copy COUNT objects from SRC to DST.  The source and destination do
+   not overlap.  */
+# ifndef YYCOPY
+#  if defined __GNUC__ && 1 < __GNUC__
+#   define YYCOPY(Dst, Src, Count) \
+      __builtin_memcpy (Dst, Src, YY_CAST (YYSIZE_T, (Count)) * sizeof (*(Src)))
+#  else
+#   define YYCOPY(Dst, Src, Count)              \
+      do                                        \
+        {                                       \
+          YYPTRDIFF_T yyi;                      \
+          for (yyi = 0; yyi < (Count); yyi++)   \
+            (Dst)[yyi] = (Src)[yyi];            \
+        }                                       \
+      while (0)
+#  endif
+# endif
+#endif /* !YYCOPY_NEEDED */
+
+/* YYFINAL -- State number of the termination state.  */
+#define YYFINAL  3
+/* YYLAST -- Last index in YYTABLE.  */
+#define YYLAST   118
+
+/* YYNTOKENS -- Number of terminals.  */
+#define YYNTOKENS  36
+/* YYNNTS -- Number of nonterminals.  */
+#define YYNNTS  19
+/* YYNRULES -- Number of rules.  */
+#define YYNRULES  50
+/* YYNSTATES -- Number of states.  */
+#define YYNSTATES  108
+
+/* YYMAXUTOK -- Last valid token kind.  */
+#define YYMAXUTOK   277
+
+
+/* YYTRANSLATE(TOKEN-NUM) -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex, with out-of-bounds checking.  */
+#define YYTRANSLATE(YYX)                                \
+  (0 <= (YYX) && (YYX) <= YYMAXUTOK                     \
+   ? YY_CAST (yysymbol_kind_t, yytranslate[YYX])        \
+   : YYSYMBOL_YYUNDEF)
+
+/* YYTRANSLATE[TOKEN-NUM] -- Symbol number corresponding to TOKEN-NUM
+   as returned by yylex.  */
+static const yytype_int8 yytranslate[] =
+{
+       0,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+      30,    31,    29,     2,    35,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,    34,    23,
+      25,    24,    26,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,    27,     2,    28,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,    32,     2,    33,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     2,     2,     2,     2,
+       2,     2,     2,     2,     2,     2,     1,     2,     3,     4,
+       5,     6,     7,     8,     9,    10,    11,    12,    13,    14,
+      15,    16,    17,    18,    19,    20,    21,    22
+};
+
+#if YYDEBUG
+/* YYRLINE[YYN] -- Source line where rule number YYN was defined.  */
+static const yytype_int16 yyrline[] =
+{
+       0,    82,    82,    90,    93,    99,   104,   111,   121,   128,
+     135,   144,   152,   157,   165,   174,   183,   192,   200,   209,
+     219,   228,   238,   249,   255,   262,   266,   272,   280,   285,
+     291,   295,   301,   307,   311,   317,   322,   331,   332,   333,
+     334,   335,   336,   337,   339,   346,   353,   359,   368,   374,
+     383
+};
+#endif
+
+/** Accessing symbol of state STATE.  */
+#define YY_ACCESSING_SYMBOL(State) YY_CAST (yysymbol_kind_t, yystos[State])
+
+#if YYDEBUG || 0
+/* The user-facing name of the symbol whose (internal) number is
+   YYSYMBOL.  No bounds checking.  */
+static const char *yysymbol_name (yysymbol_kind_t yysymbol) YY_ATTRIBUTE_UNUSED;
+
+/* YYTNAME[SYMBOL-NUM] -- String name of the symbol SYMBOL-NUM.
+   First, the terminals, then, starting at YYNTOKENS, nonterminals.  */
+static const char *const yytname[] =
+{
+  "\"end of file\"", "error", "\"invalid token\"", "BOOL", "CASE",
+  "CONST", "DEFAULT", "DOUBLE", "QUADRUPLE", "ENUM", "FLOAT", "HYPER",
+  "INT", "OPAQUE", "STRING", "STRUCT", "SWITCH", "TYPEDEF", "UNION",
+  "UNSIGNED", "VOID", "INTEGER", "IDENTIFIER", "';'", "'='", "'<'", "'>'",
+  "'['", "']'", "'*'", "'('", "')'", "'{'", "'}'", "':'", "','", "$accept",
+  "specification", "definition_list", "definition", "typedef", "const_def",
+  "declaration", "union_detail", "case_list", "case", "default_",
+  "struct_detail", "declaration_list", "enum_detail", "enum_fields",
+  "enum_field", "type", "const_expr", "identifier", YY_NULLPTR
+};
+
+static const char *
+yysymbol_name (yysymbol_kind_t yysymbol)
+{
+  return yytname[yysymbol];
+}
+#endif
+
+#define YYPACT_NINF (-54)
+
+#define yypact_value_is_default(Yyn) \
+  ((Yyn) == YYPACT_NINF)
+
+#define YYTABLE_NINF (-1)
+
+#define yytable_value_is_error(Yyn) \
+  0
+
+/* YYPACT[STATE-NUM] -- Index in YYTABLE of the portion describing
+   STATE-NUM.  */
+static const yytype_int8 yypact[] =
+{
+     -54,    30,    19,   -54,    -7,    -7,    -7,    93,    -7,   -54,
+     -54,   -54,   -54,    -1,     6,    20,   -54,   -54,     6,   -54,
+     -54,   -54,    -7,    -7,    20,    40,    -2,   -54,    34,    -9,
+     -54,    40,    33,    -7,    36,    93,    37,   -54,     8,    38,
+     -54,    31,   -54,   -54,   -54,   -54,    -7,    14,    39,   -54,
+      41,   -54,    15,   -54,    42,   -54,    44,    66,   -54,     0,
+      33,    23,    93,   -54,    25,    33,   -54,   -54,   -54,    -7,
+      33,   -54,   -54,    45,   -54,    48,    54,   -54,    57,    56,
+     -54,    63,    62,   -54,   -54,   -54,   -54,   -54,   -54,    59,
+     -54,   -54,    88,    33,    10,   -54,    60,    61,   -54,   -54,
+      68,    93,    93,   -54,    47,    70,   -54,   -54
+};
+
+/* YYDEFACT[STATE-NUM] -- Default reduction number in state STATE-NUM.
+   Performed when YYTABLE does not specify something else to do.  Zero
+   means the default is an error.  */
+static const yytype_int8 yydefact[] =
+{
+       3,     0,     2,     1,     0,     0,     0,     0,     0,     4,
+       5,     6,    50,     0,     0,     0,    43,    42,     0,    41,
+      40,    39,     0,     0,     0,     0,     0,    12,     0,     0,
+      47,     0,     0,     0,     0,     0,     0,    44,     0,     0,
+      45,     0,    46,    38,    37,     7,     0,    22,     0,    48,
+       0,    49,     0,    33,    35,     8,     0,     0,     9,     0,
+       0,     0,     0,    18,     0,     0,    10,    11,    32,     0,
+       0,    30,    29,     0,    17,     0,     0,    13,     0,     0,
+      20,     0,     0,    34,    36,    31,    16,    15,    14,     0,
+      21,    19,     0,     0,     0,    25,     0,     0,    24,    26,
+       0,     0,     0,    23,     0,     0,    27,    28
+};
+
+/* YYPGOTO[NTERM-NUM].  */
+static const yytype_int8 yypgoto[] =
+{
+     -54,   -54,   -54,   -54,   -54,   -54,   -30,    78,   -54,    16,
+     -54,    90,   -54,    98,   -54,    49,   -54,   -53,    -4
+};
+
+/* YYDEFGOTO[NTERM-NUM].  */
+static const yytype_int8 yydefgoto[] =
+{
+       0,     1,     2,     9,    10,    11,    28,    42,    94,    95,
+     100,    36,    57,    34,    52,    53,    29,    50,    51
+};
+
+/* YYTABLE[YYPACT[STATE-NUM]] -- What to do in state STATE-NUM.  If
+   positive, shift that token.  If negative, reduce the rule whose
+   number is the opposite.  If YYTABLE_NINF, syntax error.  */
+static const yytype_int8 yytable[] =
+{
+      13,    14,    15,    30,    31,    56,    75,    76,    78,    43,
+      44,    81,    82,    12,    93,    12,    97,    84,    38,    39,
+      46,    49,    12,    32,     4,    47,    74,    73,     5,    54,
+       3,    30,    79,    59,     6,    60,     7,     8,    33,    64,
+      96,    65,    63,    98,    49,    12,    49,    12,    68,    77,
+      69,    80,    35,    30,    49,    12,    41,    45,    30,    55,
+      58,    62,    66,    61,    67,    54,    70,    71,    85,    16,
+     106,   104,   105,    17,    86,    18,    19,    20,    21,    22,
+      23,    24,    87,    88,    25,    26,    27,    89,    12,    90,
+      91,    92,    93,   107,   101,   102,    16,    30,    30,    72,
+      17,   103,    18,    19,    20,    21,    22,    23,    24,    48,
+      99,    25,    26,    27,    40,    12,    37,     0,    83
+};
+
+static const yytype_int8 yycheck[] =
+{
+       4,     5,     6,     7,     8,    35,    59,    60,    61,    11,
+      12,    64,    65,    22,     4,    22,     6,    70,    22,    23,
+      29,    21,    22,    24,     5,    29,    26,    57,     9,    33,
+       0,    35,    62,    25,    15,    27,    17,    18,    32,    25,
+      93,    27,    46,    33,    21,    22,    21,    22,    33,    26,
+      35,    26,    32,    57,    21,    22,    16,    23,    62,    23,
+      23,    30,    23,    25,    23,    69,    24,    23,    23,     3,
+      23,   101,   102,     7,    26,     9,    10,    11,    12,    13,
+      14,    15,    28,    26,    18,    19,    20,    31,    22,    26,
+      28,    32,     4,    23,    34,    34,     3,   101,   102,    33,
+       7,    33,     9,    10,    11,    12,    13,    14,    15,    31,
+      94,    18,    19,    20,    24,    22,    18,    -1,    69
+};
+
+/* YYSTOS[STATE-NUM] -- The symbol kind of the accessing symbol of
+   state STATE-NUM.  */
+static const yytype_int8 yystos[] =
+{
+       0,    37,    38,     0,     5,     9,    15,    17,    18,    39,
+      40,    41,    22,    54,    54,    54,     3,     7,     9,    10,
+      11,    12,    13,    14,    15,    18,    19,    20,    42,    52,
+      54,    54,    24,    32,    49,    32,    47,    49,    54,    54,
+      47,    16,    43,    11,    12,    23,    29,    54,    43,    21,
+      53,    54,    50,    51,    54,    23,    42,    48,    23,    25,
+      27,    25,    30,    54,    25,    27,    23,    23,    33,    35,
+      24,    23,    33,    42,    26,    53,    53,    26,    53,    42,
+      26,    53,    53,    51,    53,    23,    26,    28,    26,    31,
+      26,    28,    32,     4,    44,    45,    53,     6,    33,    45,
+      46,    34,    34,    33,    42,    42,    23,    23
+};
+
+/* YYR1[RULE-NUM] -- Symbol kind of the left-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr1[] =
+{
+       0,    36,    37,    38,    38,    39,    39,    40,    40,    40,
+      40,    41,    42,    42,    42,    42,    42,    42,    42,    42,
+      42,    42,    42,    43,    43,    44,    44,    45,    46,    47,
+      48,    48,    49,    50,    50,    51,    51,    52,    52,    52,
+      52,    52,    52,    52,    52,    52,    52,    52,    53,    53,
+      54
+};
+
+/* YYR2[RULE-NUM] -- Number of symbols on the right-hand side of rule RULE-NUM.  */
+static const yytype_int8 yyr2[] =
+{
+       0,     2,     1,     0,     2,     1,     1,     3,     4,     4,
+       4,     5,     1,     4,     5,     5,     5,     4,     3,     5,
+       4,     5,     2,     8,     7,     1,     2,     5,     4,     3,
+       2,     3,     3,     1,     3,     1,     3,     2,     2,     1,
+       1,     1,     1,     1,     2,     2,     2,     1,     1,     1,
+       1
+};
+
+
+enum { YYENOMEM = -2 };
+
+#define yyerrok         (yyerrstatus = 0)
+#define yyclearin       (yychar = YYEMPTY)
+
+#define YYACCEPT        goto yyacceptlab
+#define YYABORT         goto yyabortlab
+#define YYERROR         goto yyerrorlab
+#define YYNOMEM         goto yyexhaustedlab
+
+
+#define YYRECOVERING()  (!!yyerrstatus)
+
+#define YYBACKUP(Token, Value)                                    \
+  do                                                              \
+    if (yychar == YYEMPTY)                                        \
+      {                                                           \
+        yychar = (Token);                                         \
+        yylval = (Value);                                         \
+        YYPOPSTACK (yylen);                                       \
+        yystate = *yyssp;                                         \
+        goto yybackup;                                            \
+      }                                                           \
+    else                                                          \
+      {                                                           \
+        yyerror (YY_("syntax error: cannot back up")); \
+        YYERROR;                                                  \
+      }                                                           \
+  while (0)
+
+/* Backward compatibility with an undocumented macro.
+   Use YYerror or YYUNDEF. */
+#define YYERRCODE YYUNDEF
+
+
+/* Enable debugging if requested.  */
+#if YYDEBUG
+
+# ifndef YYFPRINTF
+#  include <stdio.h> /* INFRINGES ON USER NAME SPACE */
+#  define YYFPRINTF fprintf
+# endif
+
+# define YYDPRINTF(Args)                        \
+do {                                            \
+  if (yydebug)                                  \
+    YYFPRINTF Args;                             \
+} while (0)
+
+
+
+
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)                    \
+do {                                                                      \
+  if (yydebug)                                                            \
+    {                                                                     \
+      YYFPRINTF (stderr, "%s ", Title);                                   \
+      yy_symbol_print (stderr,                                            \
+                  Kind, Value); \
+      YYFPRINTF (stderr, "\n");                                           \
+    }                                                                     \
+} while (0)
+
+
+/*-----------------------------------.
+| Print this symbol's value on YYO.  |
+`-----------------------------------*/
+
+static void
+yy_symbol_value_print (FILE *yyo,
+                       yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+{
+  FILE *yyoutput = yyo;
+  YY_USE (yyoutput);
+  if (!yyvaluep)
+    return;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/*---------------------------.
+| Print this symbol on YYO.  |
+`---------------------------*/
+
+static void
+yy_symbol_print (FILE *yyo,
+                 yysymbol_kind_t yykind, YYSTYPE const * const yyvaluep)
+{
+  YYFPRINTF (yyo, "%s %s (",
+             yykind < YYNTOKENS ? "token" : "nterm", yysymbol_name (yykind));
+
+  yy_symbol_value_print (yyo, yykind, yyvaluep);
+  YYFPRINTF (yyo, ")");
+}
+
+/*------------------------------------------------------------------.
+| yy_stack_print -- Print the state stack from its BOTTOM up to its |
+| TOP (included).                                                   |
+`------------------------------------------------------------------*/
+
+static void
+yy_stack_print (yy_state_t *yybottom, yy_state_t *yytop)
+{
+  YYFPRINTF (stderr, "Stack now");
+  for (; yybottom <= yytop; yybottom++)
+    {
+      int yybot = *yybottom;
+      YYFPRINTF (stderr, " %d", yybot);
+    }
+  YYFPRINTF (stderr, "\n");
+}
+
+# define YY_STACK_PRINT(Bottom, Top)                            \
+do {                                                            \
+  if (yydebug)                                                  \
+    yy_stack_print ((Bottom), (Top));                           \
+} while (0)
+
+
+/*------------------------------------------------.
+| Report that the YYRULE is going to be reduced.  |
+`------------------------------------------------*/
+
+static void
+yy_reduce_print (yy_state_t *yyssp, YYSTYPE *yyvsp,
+                 int yyrule)
+{
+  int yylno = yyrline[yyrule];
+  int yynrhs = yyr2[yyrule];
+  int yyi;
+  YYFPRINTF (stderr, "Reducing stack by rule %d (line %d):\n",
+             yyrule - 1, yylno);
+  /* The symbols being reduced.  */
+  for (yyi = 0; yyi < yynrhs; yyi++)
+    {
+      YYFPRINTF (stderr, "   $%d = ", yyi + 1);
+      yy_symbol_print (stderr,
+                       YY_ACCESSING_SYMBOL (+yyssp[yyi + 1 - yynrhs]),
+                       &yyvsp[(yyi + 1) - (yynrhs)]);
+      YYFPRINTF (stderr, "\n");
+    }
+}
+
+# define YY_REDUCE_PRINT(Rule)          \
+do {                                    \
+  if (yydebug)                          \
+    yy_reduce_print (yyssp, yyvsp, Rule); \
+} while (0)
+
+/* Nonzero means print parse trace.  It is left uninitialized so that
+   multiple parsers can coexist.  */
+int yydebug;
+#else /* !YYDEBUG */
+# define YYDPRINTF(Args) ((void) 0)
+# define YY_SYMBOL_PRINT(Title, Kind, Value, Location)
+# define YY_STACK_PRINT(Bottom, Top)
+# define YY_REDUCE_PRINT(Rule)
+#endif /* !YYDEBUG */
+
+
+/* YYINITDEPTH -- initial size of the parser's stacks.  */
+#ifndef YYINITDEPTH
+# define YYINITDEPTH 200
+#endif
+
+/* YYMAXDEPTH -- maximum size the stacks can grow to (effective only
+   if the built-in stack extension method is used).
+
+   Do not make this value too large; the results are undefined if
+   YYSTACK_ALLOC_MAXIMUM < YYSTACK_BYTES (YYMAXDEPTH)
+   evaluated with infinite-precision integer arithmetic.  */
+
+#ifndef YYMAXDEPTH
+# define YYMAXDEPTH 10000
+#endif
+
+
+
+
+
+
+/*-----------------------------------------------.
+| Release the memory associated to this symbol.  |
+`-----------------------------------------------*/
+
+static void
+yydestruct (const char *yymsg,
+            yysymbol_kind_t yykind, YYSTYPE *yyvaluep)
+{
+  YY_USE (yyvaluep);
+  if (!yymsg)
+    yymsg = "Deleting";
+  YY_SYMBOL_PRINT (yymsg, yykind, yyvaluep, yylocationp);
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  YY_USE (yykind);
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+}
+
+
+/* Lookahead token kind.  */
+int yychar;
+
+/* The semantic value of the lookahead symbol.  */
+YYSTYPE yylval;
+/* Number of syntax errors so far.  */
+int yynerrs;
+
+
+
+
+/*----------.
+| yyparse.  |
+`----------*/
+
+int
+yyparse (void)
+{
+    yy_state_fast_t yystate = 0;
+    /* Number of tokens to shift before error messages enabled.  */
+    int yyerrstatus = 0;
+
+    /* Refer to the stacks through separate pointers, to allow yyoverflow
+       to reallocate them elsewhere.  */
+
+    /* Their size.  */
+    YYPTRDIFF_T yystacksize = YYINITDEPTH;
+
+    /* The state stack: array, bottom, top.  */
+    yy_state_t yyssa[YYINITDEPTH];
+    yy_state_t *yyss = yyssa;
+    yy_state_t *yyssp = yyss;
+
+    /* The semantic value stack: array, bottom, top.  */
+    YYSTYPE yyvsa[YYINITDEPTH];
+    YYSTYPE *yyvs = yyvsa;
+    YYSTYPE *yyvsp = yyvs;
+
+  int yyn;
+  /* The return value of yyparse.  */
+  int yyresult;
+  /* Lookahead symbol kind.  */
+  yysymbol_kind_t yytoken = YYSYMBOL_YYEMPTY;
+  /* The variables used to return semantic value and location from the
+     action routines.  */
+  YYSTYPE yyval;
+
+
+
+#define YYPOPSTACK(N)   (yyvsp -= (N), yyssp -= (N))
+
+  /* The number of symbols on the RHS of the reduced rule.
+     Keep to zero when no symbol should be popped.  */
+  int yylen = 0;
+
+  YYDPRINTF ((stderr, "Starting parse\n"));
+
+  yychar = YYEMPTY; /* Cause a token to be read.  */
+
+  goto yysetstate;
+
+
+/*------------------------------------------------------------.
+| yynewstate -- push a new state, which is found in yystate.  |
+`------------------------------------------------------------*/
+yynewstate:
+  /* In all cases, when you get here, the value and location stacks
+     have just been pushed.  So pushing a state here evens the stacks.  */
+  yyssp++;
+
+
+/*--------------------------------------------------------------------.
+| yysetstate -- set current state (the top of the stack) to yystate.  |
+`--------------------------------------------------------------------*/
+yysetstate:
+  YYDPRINTF ((stderr, "Entering state %d\n", yystate));
+  YY_ASSERT (0 <= yystate && yystate < YYNSTATES);
+  YY_IGNORE_USELESS_CAST_BEGIN
+  *yyssp = YY_CAST (yy_state_t, yystate);
+  YY_IGNORE_USELESS_CAST_END
+  YY_STACK_PRINT (yyss, yyssp);
+
+  if (yyss + yystacksize - 1 <= yyssp)
+#if !defined yyoverflow && !defined YYSTACK_RELOCATE
+    YYNOMEM;
+#else
+    {
+      /* Get the current used size of the three stacks, in elements.  */
+      YYPTRDIFF_T yysize = yyssp - yyss + 1;
+
+# if defined yyoverflow
+      {
+        /* Give user a chance to reallocate the stack.  Use copies of
+           these so that the &'s don't force the real ones into
+           memory.  */
+        yy_state_t *yyss1 = yyss;
+        YYSTYPE *yyvs1 = yyvs;
+
+        /* Each stack pointer address is followed by the size of the
+           data in use in that stack, in bytes.  This used to be a
+           conditional around just the two extra args, but that might
+           be undefined if yyoverflow is a macro.  */
+        yyoverflow (YY_("memory exhausted"),
+                    &yyss1, yysize * YYSIZEOF (*yyssp),
+                    &yyvs1, yysize * YYSIZEOF (*yyvsp),
+                    &yystacksize);
+        yyss = yyss1;
+        yyvs = yyvs1;
+      }
+# else /* defined YYSTACK_RELOCATE */
+      /* Extend the stack our own way.  */
+      if (YYMAXDEPTH <= yystacksize)
+        YYNOMEM;
+      yystacksize *= 2;
+      if (YYMAXDEPTH < yystacksize)
+        yystacksize = YYMAXDEPTH;
+
+      {
+        yy_state_t *yyss1 = yyss;
+        union yyalloc *yyptr =
+          YY_CAST (union yyalloc *,
+                   YYSTACK_ALLOC (YY_CAST (YYSIZE_T, YYSTACK_BYTES (yystacksize))));
+        if (! yyptr)
+          YYNOMEM;
+        YYSTACK_RELOCATE (yyss_alloc, yyss);
+        YYSTACK_RELOCATE (yyvs_alloc, yyvs);
+#  undef YYSTACK_RELOCATE
+        if (yyss1 != yyssa)
+          YYSTACK_FREE (yyss1);
+      }
+# endif
+
+      yyssp = yyss + yysize - 1;
+      yyvsp = yyvs + yysize - 1;
+
+      YY_IGNORE_USELESS_CAST_BEGIN
+      YYDPRINTF ((stderr, "Stack size increased to %ld\n",
+                  YY_CAST (long, yystacksize)));
+      YY_IGNORE_USELESS_CAST_END
+
+      if (yyss + yystacksize - 1 <= yyssp)
+        YYABORT;
+    }
+#endif /* !defined yyoverflow && !defined YYSTACK_RELOCATE */
+
+
+  if (yystate == YYFINAL)
+    YYACCEPT;
+
+  goto yybackup;
+
+
+/*-----------.
+| yybackup.  |
+`-----------*/
+yybackup:
+  /* Do appropriate processing given the current state.  Read a
+     lookahead token if we need one and don't already have one.  */
+
+  /* First try to decide what to do without reference to lookahead token.  */
+  yyn = yypact[yystate];
+  if (yypact_value_is_default (yyn))
+    goto yydefault;
+
+  /* Not known => get a lookahead token if don't already have one.  */
+
+  /* YYCHAR is either empty, or end-of-input, or a valid lookahead.  */
+  if (yychar == YYEMPTY)
+    {
+      YYDPRINTF ((stderr, "Reading a token\n"));
+      yychar = yylex ();
+    }
+
+  if (yychar <= YYEOF)
+    {
+      yychar = YYEOF;
+      yytoken = YYSYMBOL_YYEOF;
+      YYDPRINTF ((stderr, "Now at end of input.\n"));
+    }
+  else if (yychar == YYerror)
+    {
+      /* The scanner already issued an error message, process directly
+         to error recovery.  But do not keep the error token as
+         lookahead, it is too special and may lead us to an endless
+         loop in error recovery. */
+      yychar = YYUNDEF;
+      yytoken = YYSYMBOL_YYerror;
+      goto yyerrlab1;
+    }
+  else
+    {
+      yytoken = YYTRANSLATE (yychar);
+      YY_SYMBOL_PRINT ("Next token is", yytoken, &yylval, &yylloc);
+    }
+
+  /* If the proper action on seeing token YYTOKEN is to reduce or to
+     detect an error, take that action.  */
+  yyn += yytoken;
+  if (yyn < 0 || YYLAST < yyn || yycheck[yyn] != yytoken)
+    goto yydefault;
+  yyn = yytable[yyn];
+  if (yyn <= 0)
+    {
+      if (yytable_value_is_error (yyn))
+        goto yyerrlab;
+      yyn = -yyn;
+      goto yyreduce;
+    }
+
+  /* Count tokens shifted since error; after three, turn off error
+     status.  */
+  if (yyerrstatus)
+    yyerrstatus--;
+
+  /* Shift the lookahead token.  */
+  YY_SYMBOL_PRINT ("Shifting", yytoken, &yylval, &yylloc);
+  yystate = yyn;
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+  /* Discard the shifted token.  */
+  yychar = YYEMPTY;
+  goto yynewstate;
+
+
+/*-----------------------------------------------------------.
+| yydefault -- do the default action for the current state.  |
+`-----------------------------------------------------------*/
+yydefault:
+  yyn = yydefact[yystate];
+  if (yyn == 0)
+    goto yyerrlab;
+  goto yyreduce;
+
+
+/*-----------------------------.
+| yyreduce -- do a reduction.  |
+`-----------------------------*/
+yyreduce:
+  /* yyn is the number of a rule to reduce with.  */
+  yylen = yyr2[yyn];
+
+  /* If YYLEN is nonzero, implement the default value of the action:
+     '$$ = $1'.
+
+     Otherwise, the following line sets YYVAL to garbage.
+     This behavior is undocumented and Bison
+     users should not rely upon it.  Assigning to YYVAL
+     unconditionally makes the parser a bit smaller, and it avoids a
+     GCC warning that YYVAL may be used uninitialized.  */
+  yyval = yyvsp[1-yylen];
+
+
+  YY_REDUCE_PRINT (yyn);
+  switch (yyn)
+    {
+  case 2: /* specification: definition_list  */
+#line 82 "src/xdrgen/src/xdrgen.y"
+                                {
+                (yyval.spec) = zalloc(sizeof(*(yyval.spec)));
+                list_move_(&(yyval.spec)->definitions, &(yyvsp[0].list));
+                set_result((yyval.spec));
+              }
+#line 1210 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 3: /* definition_list: %empty  */
+#line 90 "src/xdrgen/src/xdrgen.y"
+                              {
+                  list_init(&(yyval.list));
+                }
+#line 1218 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 4: /* definition_list: definition_list definition  */
+#line 93 "src/xdrgen/src/xdrgen.y"
+                                             {
+                  list_move_(&(yyval.list), &(yyvsp[-1].list));
+                  add_tail(&(yyval.list), &(yyvsp[0].def)->list);
+                }
+#line 1227 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 5: /* definition: typedef  */
+#line 99 "src/xdrgen/src/xdrgen.y"
+                     {
+             (yyval.def) = zalloc(sizeof(*(yyval.def)));
+             (yyval.def)->type = DEF_TYPEDEF;
+             (yyval.def)->u.ttypedef.td = (yyvsp[0].tdef);
+           }
+#line 1237 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 6: /* definition: const_def  */
+#line 104 "src/xdrgen/src/xdrgen.y"
+                       {
+             (yyval.def) = zalloc(sizeof(*(yyval.def)));
+             (yyval.def)->type = DEF_CONSTANT;
+             (yyval.def)->u.tconst.cd = (yyvsp[0].cdef);
+           }
+#line 1247 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 7: /* typedef: TYPEDEF declaration ';'  */
+#line 111 "src/xdrgen/src/xdrgen.y"
+                                  {
+          if ((yyvsp[-1].decl)->type != DECL_OTHER)
+          	yyerror("you cannot use 'void' in this context");
+
+          (yyval.tdef) = zalloc(sizeof(*(yyval.tdef)));
+          (yyval.tdef)->identifier = (yyvsp[-1].decl)->u.tother.identifier;
+          (yyval.tdef)->ti = zalloc(sizeof(*(yyval.tdef)->ti));
+          (yyval.tdef)->ti->type = DEF_SIMPLE;
+          (yyval.tdef)->ti->u.tsimple.di = (yyvsp[-1].decl)->u.tother.di;
+        }
+#line 1262 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 8: /* typedef: ENUM identifier enum_detail ';'  */
+#line 121 "src/xdrgen/src/xdrgen.y"
+                                          {
+          (yyval.tdef) = zalloc(sizeof(*(yyval.tdef)));
+          (yyval.tdef)->identifier = (yyvsp[-2].str);
+          (yyval.tdef)->ti = zalloc(sizeof(*(yyval.tdef)->ti));
+          (yyval.tdef)->ti->type = DEF_ENUM;
+          (yyval.tdef)->ti->u.tenum.ed = (yyvsp[-1].edetail);
+        }
+#line 1274 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 9: /* typedef: STRUCT identifier struct_detail ';'  */
+#line 128 "src/xdrgen/src/xdrgen.y"
+                                              {
+          (yyval.tdef) = zalloc(sizeof(*(yyval.tdef)));
+          (yyval.tdef)->identifier = (yyvsp[-2].str);
+          (yyval.tdef)->ti = zalloc(sizeof(*(yyval.tdef)->ti));
+          (yyval.tdef)->ti->type = DEF_STRUCT;
+          (yyval.tdef)->ti->u.tstruct.sd = (yyvsp[-1].sdetail);
+        }
+#line 1286 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 10: /* typedef: UNION identifier union_detail ';'  */
+#line 135 "src/xdrgen/src/xdrgen.y"
+                                            {
+          (yyval.tdef) = zalloc(sizeof(*(yyval.tdef)));
+          (yyval.tdef)->identifier = (yyvsp[-2].str);
+          (yyval.tdef)->ti = zalloc(sizeof(*(yyval.tdef)->ti));
+          (yyval.tdef)->ti->type = DEF_UNION;
+          (yyval.tdef)->ti->u.tunion.ud = (yyvsp[-1].udetail);
+        }
+#line 1298 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 11: /* const_def: CONST identifier '=' const_expr ';'  */
+#line 144 "src/xdrgen/src/xdrgen.y"
+                                                {
+            (yyval.cdef) = zalloc(sizeof(*(yyval.cdef)));
+            list_init(&(yyval.cdef)->list);
+            (yyval.cdef)->identifier = (yyvsp[-3].str);
+            (yyval.cdef)->ce = (yyvsp[-1].cexpr);
+          }
+#line 1309 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 12: /* declaration: VOID  */
+#line 152 "src/xdrgen/src/xdrgen.y"
+                   {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_VOID;
+            }
+#line 1319 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 13: /* declaration: STRING identifier '<' '>'  */
+#line 157 "src/xdrgen/src/xdrgen.y"
+                                        {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-2].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_STRING;
+            }
+#line 1332 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 14: /* declaration: STRING identifier '<' const_expr '>'  */
+#line 165 "src/xdrgen/src/xdrgen.y"
+                                                   {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-3].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_STRING;
+              (yyval.decl)->u.tother.di->u.string.e = (yyvsp[-1].cexpr);
+            }
+#line 1346 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 15: /* declaration: OPAQUE identifier '[' const_expr ']'  */
+#line 174 "src/xdrgen/src/xdrgen.y"
+                                                   {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-3].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_OPAQUE;
+              (yyval.decl)->u.tother.di->u.opaque.e = (yyvsp[-1].cexpr);
+            }
+#line 1360 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 16: /* declaration: OPAQUE identifier '<' const_expr '>'  */
+#line 183 "src/xdrgen/src/xdrgen.y"
+                                                   {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-3].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_VAR_OPAQUE;
+              (yyval.decl)->u.tother.di->u.var_opaque.e = (yyvsp[-1].cexpr);
+            }
+#line 1374 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 17: /* declaration: OPAQUE identifier '<' '>'  */
+#line 192 "src/xdrgen/src/xdrgen.y"
+                                        {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-2].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_VAR_OPAQUE;
+            }
+#line 1387 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 18: /* declaration: type '*' identifier  */
+#line 200 "src/xdrgen/src/xdrgen.y"
+                                  {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[0].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_POINTER;
+              (yyval.decl)->u.tother.di->u.pointer.t = (yyvsp[-2].ty);
+            }
+#line 1401 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 19: /* declaration: type identifier '[' const_expr ']'  */
+#line 209 "src/xdrgen/src/xdrgen.y"
+                                                 {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-3].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_ARRAY;
+              (yyval.decl)->u.tother.di->u.array.t = (yyvsp[-4].ty);
+              (yyval.decl)->u.tother.di->u.array.e = (yyvsp[-1].cexpr);
+            }
+#line 1416 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 20: /* declaration: type identifier '<' '>'  */
+#line 219 "src/xdrgen/src/xdrgen.y"
+                                      {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-2].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_VAR_ARRAY;
+              (yyval.decl)->u.tother.di->u.var_array.t = (yyvsp[-3].ty);
+            }
+#line 1430 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 21: /* declaration: type identifier '<' const_expr '>'  */
+#line 228 "src/xdrgen/src/xdrgen.y"
+                                                 {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[-3].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_VAR_ARRAY;
+              (yyval.decl)->u.tother.di->u.var_array.t = (yyvsp[-4].ty);
+              (yyval.decl)->u.tother.di->u.var_array.e = (yyvsp[-1].cexpr);
+            }
+#line 1445 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 22: /* declaration: type identifier  */
+#line 238 "src/xdrgen/src/xdrgen.y"
+                              {
+              (yyval.decl) = zalloc(sizeof(*(yyval.decl)));
+              list_init(&(yyval.decl)->list);
+              (yyval.decl)->type = DECL_OTHER;
+              (yyval.decl)->u.tother.identifier = (yyvsp[0].str);
+              (yyval.decl)->u.tother.di = zalloc(sizeof(struct decl_internal));
+              (yyval.decl)->u.tother.di->type = DECL_SIMPLE;
+              (yyval.decl)->u.tother.di->u.simple.t = (yyvsp[-1].ty);
+            }
+#line 1459 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 23: /* union_detail: SWITCH '(' declaration ')' '{' case_list default_ '}'  */
+#line 249 "src/xdrgen/src/xdrgen.y"
+                                                                     {
+               (yyval.udetail) = zalloc(sizeof(*(yyval.udetail)));
+               (yyval.udetail)->discriminator = (yyvsp[-5].decl);
+               list_move_(&(yyval.udetail)->cases, &(yyvsp[-2].list));
+               (yyval.udetail)->default_case = (yyvsp[-1].decl);
+             }
+#line 1470 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 24: /* union_detail: SWITCH '(' declaration ')' '{' case_list '}'  */
+#line 255 "src/xdrgen/src/xdrgen.y"
+                                                            {
+               (yyval.udetail) = zalloc(sizeof(*(yyval.udetail)));
+               (yyval.udetail)->discriminator = (yyvsp[-4].decl);
+               list_move_(&(yyval.udetail)->cases, &(yyvsp[-1].list));
+             }
+#line 1480 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 25: /* case_list: case  */
+#line 262 "src/xdrgen/src/xdrgen.y"
+                 {
+            list_init(&(yyval.list));
+            add_tail(&(yyval.list), &(yyvsp[0].centry)->list);
+          }
+#line 1489 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 26: /* case_list: case_list case  */
+#line 266 "src/xdrgen/src/xdrgen.y"
+                           {
+            list_move_(&(yyval.list), &(yyvsp[-1].list));
+            add_tail(&(yyval.list), &(yyvsp[0].centry)->list);
+          }
+#line 1498 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 27: /* case: CASE const_expr ':' declaration ';'  */
+#line 272 "src/xdrgen/src/xdrgen.y"
+                                           {
+       (yyval.centry) = zalloc(sizeof(*(yyval.centry)));
+       list_init(&(yyval.centry)->list);
+       (yyval.centry)->ce = (yyvsp[-3].cexpr);
+       (yyval.centry)->d = (yyvsp[-1].decl);
+     }
+#line 1509 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 28: /* default_: DEFAULT ':' declaration ';'  */
+#line 280 "src/xdrgen/src/xdrgen.y"
+                                       {
+           (yyval.decl) = (yyvsp[-1].decl);
+         }
+#line 1517 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 29: /* struct_detail: '{' declaration_list '}'  */
+#line 285 "src/xdrgen/src/xdrgen.y"
+                                         {
+                (yyval.sdetail) = zalloc(sizeof(*(yyval.sdetail)));
+                list_move_(&(yyval.sdetail)->decls, &(yyvsp[-1].list));
+              }
+#line 1526 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 30: /* declaration_list: declaration ';'  */
+#line 291 "src/xdrgen/src/xdrgen.y"
+                                   {
+                   list_init(&(yyval.list));
+                   add_tail(&(yyval.list), &(yyvsp[-1].decl)->list);
+                 }
+#line 1535 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 31: /* declaration_list: declaration_list declaration ';'  */
+#line 295 "src/xdrgen/src/xdrgen.y"
+                                                    {
+                   list_move_(&(yyval.list), &(yyvsp[-2].list));
+                   add_tail(&(yyval.list), &(yyvsp[-1].decl)->list);
+                 }
+#line 1544 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 32: /* enum_detail: '{' enum_fields '}'  */
+#line 301 "src/xdrgen/src/xdrgen.y"
+                                  {
+              (yyval.edetail) = zalloc(sizeof(*(yyval.edetail)));
+              list_move_(&(yyval.edetail)->fields, &(yyvsp[-1].list));
+            }
+#line 1553 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 33: /* enum_fields: enum_field  */
+#line 307 "src/xdrgen/src/xdrgen.y"
+                         {
+              list_init(&(yyval.list));
+              add_tail(&(yyval.list), &(yyvsp[0].cdef)->list);
+            }
+#line 1562 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 34: /* enum_fields: enum_fields ',' enum_field  */
+#line 311 "src/xdrgen/src/xdrgen.y"
+                                         {
+              list_move_(&(yyval.list), &(yyvsp[-2].list));
+              add_tail(&(yyval.list), &(yyvsp[0].cdef)->list);
+            }
+#line 1571 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 35: /* enum_field: identifier  */
+#line 317 "src/xdrgen/src/xdrgen.y"
+                        {
+             (yyval.cdef) = zalloc(sizeof(*(yyval.cdef)));
+             list_init(&(yyval.cdef)->list);
+             (yyval.cdef)->identifier = (yyvsp[0].str);
+           }
+#line 1581 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 36: /* enum_field: identifier '=' const_expr  */
+#line 322 "src/xdrgen/src/xdrgen.y"
+                                       {
+             (yyval.cdef) = zalloc(sizeof(*(yyval.cdef)));
+             list_init(&(yyval.cdef)->list);
+             (yyval.cdef)->identifier = (yyvsp[-2].str);
+             (yyval.cdef)->ce = (yyvsp[0].cexpr);
+           }
+#line 1592 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 37: /* type: UNSIGNED INT  */
+#line 331 "src/xdrgen/src/xdrgen.y"
+                       { (yyval.ty) = simple_type(TUINT); }
+#line 1598 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 38: /* type: UNSIGNED HYPER  */
+#line 332 "src/xdrgen/src/xdrgen.y"
+                       { (yyval.ty) = simple_type(TUHYPER); }
+#line 1604 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 39: /* type: INT  */
+#line 333 "src/xdrgen/src/xdrgen.y"
+                       { (yyval.ty) = simple_type(TINT); }
+#line 1610 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 40: /* type: HYPER  */
+#line 334 "src/xdrgen/src/xdrgen.y"
+                       { (yyval.ty) = simple_type(THYPER); }
+#line 1616 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 41: /* type: FLOAT  */
+#line 335 "src/xdrgen/src/xdrgen.y"
+                       { (yyval.ty) = simple_type(TFLOAT); }
+#line 1622 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 42: /* type: DOUBLE  */
+#line 336 "src/xdrgen/src/xdrgen.y"
+                       { (yyval.ty) = simple_type(TDOUBLE); }
+#line 1628 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 43: /* type: BOOL  */
+#line 337 "src/xdrgen/src/xdrgen.y"
+                       { (yyval.ty) = simple_type(TBOOL); }
+#line 1634 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 44: /* type: ENUM enum_detail  */
+#line 340 "src/xdrgen/src/xdrgen.y"
+      {
+              (yyval.ty) = zalloc(sizeof(*(yyval.ty)));
+              (yyval.ty)->type = TENUM;
+              (yyval.ty)->u.tenum.ed = (yyvsp[0].edetail);
+      }
+#line 1644 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 45: /* type: STRUCT struct_detail  */
+#line 347 "src/xdrgen/src/xdrgen.y"
+      {
+              (yyval.ty) = zalloc(sizeof(*(yyval.ty)));
+              (yyval.ty)->type = TSTRUCT;
+              (yyval.ty)->u.tstruct.sd = (yyvsp[0].sdetail);
+      }
+#line 1654 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 46: /* type: UNION union_detail  */
+#line 354 "src/xdrgen/src/xdrgen.y"
+      {
+              (yyval.ty) = zalloc(sizeof(*(yyval.ty)));
+              (yyval.ty)->type = TUNION;
+              (yyval.ty)->u.tunion.ud = (yyvsp[0].udetail);
+      }
+#line 1664 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 47: /* type: identifier  */
+#line 360 "src/xdrgen/src/xdrgen.y"
+      {
+              (yyval.ty) = zalloc(sizeof(*(yyval.ty)));
+              (yyval.ty)->type = TTYPEDEF;
+              (yyval.ty)->u.ttypedef.t = (yyvsp[0].str);
+      }
+#line 1674 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 48: /* const_expr: INTEGER  */
+#line 369 "src/xdrgen/src/xdrgen.y"
+        {
+                (yyval.cexpr) = zalloc(sizeof(*(yyval.cexpr)));
+                (yyval.cexpr)->type = CE_LITERAL;
+                (yyval.cexpr)->u.literal = (yyvsp[0].i);
+        }
+#line 1684 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+  case 49: /* const_expr: identifier  */
+#line 375 "src/xdrgen/src/xdrgen.y"
+        {
+                (yyval.cexpr) = zalloc(sizeof(*(yyval.cexpr)));
+                (yyval.cexpr)->type = CE_REFERENCE;
+                (yyval.cexpr)->u.reference = (yyvsp[0].str);
+        }
+#line 1694 "src/xdrgen/src/xdrgen.tab.c"
+    break;
+
+
+#line 1698 "src/xdrgen/src/xdrgen.tab.c"
+
+      default: break;
+    }
+  /* User semantic actions sometimes alter yychar, and that requires
+     that yytoken be updated with the new translation.  We take the
+     approach of translating immediately before every use of yytoken.
+     One alternative is translating here after every semantic action,
+     but that translation would be missed if the semantic action invokes
+     YYABORT, YYACCEPT, or YYERROR immediately after altering yychar or
+     if it invokes YYBACKUP.  In the case of YYABORT or YYACCEPT, an
+     incorrect destructor might then be invoked immediately.  In the
+     case of YYERROR or YYBACKUP, subsequent parser actions might lead
+     to an incorrect destructor call or verbose syntax error message
+     before the lookahead is translated.  */
+  YY_SYMBOL_PRINT ("-> $$ =", YY_CAST (yysymbol_kind_t, yyr1[yyn]), &yyval, &yyloc);
+
+  YYPOPSTACK (yylen);
+  yylen = 0;
+
+  *++yyvsp = yyval;
+
+  /* Now 'shift' the result of the reduction.  Determine what state
+     that goes to, based on the state we popped back to and the rule
+     number reduced by.  */
+  {
+    const int yylhs = yyr1[yyn] - YYNTOKENS;
+    const int yyi = yypgoto[yylhs] + *yyssp;
+    yystate = (0 <= yyi && yyi <= YYLAST && yycheck[yyi] == *yyssp
+               ? yytable[yyi]
+               : yydefgoto[yylhs]);
+  }
+
+  goto yynewstate;
+
+
+/*--------------------------------------.
+| yyerrlab -- here on detecting error.  |
+`--------------------------------------*/
+yyerrlab:
+  /* Make sure we have latest lookahead translation.  See comments at
+     user semantic actions for why this is necessary.  */
+  yytoken = yychar == YYEMPTY ? YYSYMBOL_YYEMPTY : YYTRANSLATE (yychar);
+  /* If not already recovering from an error, report this error.  */
+  if (!yyerrstatus)
+    {
+      ++yynerrs;
+      yyerror (YY_("syntax error"));
+    }
+
+  if (yyerrstatus == 3)
+    {
+      /* If just tried and failed to reuse lookahead token after an
+         error, discard it.  */
+
+      if (yychar <= YYEOF)
+        {
+          /* Return failure if at end of input.  */
+          if (yychar == YYEOF)
+            YYABORT;
+        }
+      else
+        {
+          yydestruct ("Error: discarding",
+                      yytoken, &yylval);
+          yychar = YYEMPTY;
+        }
+    }
+
+  /* Else will try to reuse lookahead token after shifting the error
+     token.  */
+  goto yyerrlab1;
+
+
+/*---------------------------------------------------.
+| yyerrorlab -- error raised explicitly by YYERROR.  |
+`---------------------------------------------------*/
+yyerrorlab:
+  /* Pacify compilers when the user code never invokes YYERROR and the
+     label yyerrorlab therefore never appears in user code.  */
+  if (0)
+    YYERROR;
+  ++yynerrs;
+
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYERROR.  */
+  YYPOPSTACK (yylen);
+  yylen = 0;
+  YY_STACK_PRINT (yyss, yyssp);
+  yystate = *yyssp;
+  goto yyerrlab1;
+
+
+/*-------------------------------------------------------------.
+| yyerrlab1 -- common code for both syntax error and YYERROR.  |
+`-------------------------------------------------------------*/
+yyerrlab1:
+  yyerrstatus = 3;      /* Each real token shifted decrements this.  */
+
+  /* Pop stack until we find a state that shifts the error token.  */
+  for (;;)
+    {
+      yyn = yypact[yystate];
+      if (!yypact_value_is_default (yyn))
+        {
+          yyn += YYSYMBOL_YYerror;
+          if (0 <= yyn && yyn <= YYLAST && yycheck[yyn] == YYSYMBOL_YYerror)
+            {
+              yyn = yytable[yyn];
+              if (0 < yyn)
+                break;
+            }
+        }
+
+      /* Pop the current state because it cannot handle the error token.  */
+      if (yyssp == yyss)
+        YYABORT;
+
+
+      yydestruct ("Error: popping",
+                  YY_ACCESSING_SYMBOL (yystate), yyvsp);
+      YYPOPSTACK (1);
+      yystate = *yyssp;
+      YY_STACK_PRINT (yyss, yyssp);
+    }
+
+  YY_IGNORE_MAYBE_UNINITIALIZED_BEGIN
+  *++yyvsp = yylval;
+  YY_IGNORE_MAYBE_UNINITIALIZED_END
+
+
+  /* Shift the error token.  */
+  YY_SYMBOL_PRINT ("Shifting", YY_ACCESSING_SYMBOL (yyn), yyvsp, yylsp);
+
+  yystate = yyn;
+  goto yynewstate;
+
+
+/*-------------------------------------.
+| yyacceptlab -- YYACCEPT comes here.  |
+`-------------------------------------*/
+yyacceptlab:
+  yyresult = 0;
+  goto yyreturnlab;
+
+
+/*-----------------------------------.
+| yyabortlab -- YYABORT comes here.  |
+`-----------------------------------*/
+yyabortlab:
+  yyresult = 1;
+  goto yyreturnlab;
+
+
+/*-----------------------------------------------------------.
+| yyexhaustedlab -- YYNOMEM (memory exhaustion) comes here.  |
+`-----------------------------------------------------------*/
+yyexhaustedlab:
+  yyerror (YY_("memory exhausted"));
+  yyresult = 2;
+  goto yyreturnlab;
+
+
+/*----------------------------------------------------------.
+| yyreturnlab -- parsing is finished, clean up and return.  |
+`----------------------------------------------------------*/
+yyreturnlab:
+  if (yychar != YYEMPTY)
+    {
+      /* Make sure we have latest lookahead translation.  See comments at
+         user semantic actions for why this is necessary.  */
+      yytoken = YYTRANSLATE (yychar);
+      yydestruct ("Cleanup: discarding lookahead",
+                  yytoken, &yylval);
+    }
+  /* Do not reclaim the symbols of the rule whose action triggered
+     this YYABORT or YYACCEPT.  */
+  YYPOPSTACK (yylen);
+  YY_STACK_PRINT (yyss, yyssp);
+  while (yyssp != yyss)
+    {
+      yydestruct ("Cleanup: popping",
+                  YY_ACCESSING_SYMBOL (+*yyssp), yyvsp);
+      YYPOPSTACK (1);
+    }
+#ifndef yyoverflow
+  if (yyss != yyssa)
+    YYSTACK_FREE (yyss);
+#endif
+
+  return yyresult;
+}
+
+#line 385 "src/xdrgen/src/xdrgen.y"
+